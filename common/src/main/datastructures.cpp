@@ -11,8 +11,13 @@
 #include "datastructures.hpp"
 
 #include <algorithm>  // for std::copy, std::sort
+#include <atomic>
+#include <cerrno>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>  // for std::memcpy
 #include <fstream>
 #include <iomanip>  // for std::setprecision
 #include <iostream>
@@ -20,7 +25,26 @@
 #include <memory>  // for shared pointer.
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <vector>
+
+#include <fcntl.h>         // for open.
+#include <sys/mman.h>      // for mmap.
+#include <sys/resource.h>  // for getrusage.
+#include <sys/stat.h>      // for fstat.
+#include <unistd.h>        // for write and close.
+
+// NOTE: SSE2 is always there on x86-64. The AVX kernels are compiled with a target
+//       attribute and are only called when the CPU reports AVX support.
+#if defined(__SSE2__) || defined(_M_X64)
+#define WW_SIMD_SSE 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define WW_SIMD_AVX 1
+#endif
+#endif
 // ---
 // NOTE: Stream operator
 // ---
@@ -103,838 +127,1612 @@ std::ostream &operator<<(std::ostream &stream, const ww::sphere &S)
 
 namespace ww
 {
-//------------------------------------------------------------------------------
-tup Add(tup const &A, tup const &B)
+namespace
 {
-  tup const Result{A.X + B.X, A.Y + B.Y, A.Z + B.Z, A.W + B.W};
-  return (Result);
-}
+// NOTE: Relative cost of a traversal step and an object intersection used by the
+//       surface area heuristic.
+constexpr float BVH_TRAVERSAL_COST = 1.f;
+constexpr float BVH_INTERSECT_COST = 2.f;
+constexpr int BVH_BIN_COUNT = 16;
+constexpr int BVH_MAX_LEAF_SIZE = 4;
+
+// NOTE: Below this depth the builder splits at the median, so the depth of the
+//       tree, and the traversal stack, stays bounded.
+constexpr int BVH_MAX_SAH_DEPTH = 64;
+constexpr int BVH_STACK_SIZE = 128;
 
 //------------------------------------------------------------------------------
-tup Color(float const R, float const G, float const B)
+// NOTE: The instruction set of the matrix and sphere kernels. Read once per matrix
+//       product, inverse or world query, and handed down to the inner loops from there.
+std::atomic<simd> gSIMDLevel{SIMDSupported()};
+
+inline simd CurrentSIMD() { return (gSIMDLevel.load(std::memory_order_relaxed)); }
+
+//------------------------------------------------------------------------------
+// NOTE: What the pixel that this thread renders in RenderCost() has cost so far. Only
+//       there when built with WW_PIXEL_COST, otherwise COUNT_COST is nothing at all.
+#if WW_PIXEL_COST
+thread_local pixel_cost tPixelCost{};
+#define COUNT_COST(Counter, N) (tPixelCost.Counter += (N))
+#else
+#define COUNT_COST(Counter, N)
+#endif
+
+//------------------------------------------------------------------------------
+// NOTE: The closed form inverse is built from the 2x2 sub-determinants of the two upper
+//       rows (S) and the two lower rows (C) of M, for the column pairs 01, 02, 03, 12, 13
+//       and 23. Row Row of the adjugate is PX * A - PY * B + PZ * C, with every other
+//       element negated, where Pk is column k of M taken in the row order 1, 0, 3, 2 and
+//       A, B and C are the sub-determinants {C, C, S, S} listed in INVERSE_TERMS.
+struct inverse_term
 {
-  tup Result{R, G, B, 0.f};
-  return (Result);
-}
+  int X, Y, Z;  //!< Columns of M.
+  int A, B, C;  //!< Sub-determinant pairs.
+};
+constexpr inverse_term INVERSE_TERMS[4] = {
+    {1, 2, 3, 5, 4, 3},  //!<
+    {0, 2, 3, 5, 2, 1},  //!<
+    {0, 1, 3, 4, 2, 0},  //!<
+    {0, 1, 2, 3, 1, 0},  //!<
+};
+constexpr int INVERSE_PAIRS[6][2] = {{0, 1}, {0, 2}, {0, 3}, {1, 2}, {1, 3}, {2, 3}};
 
 //------------------------------------------------------------------------------
-tup Cross(tup const &A, tup const &B)
+void SubDeterminants(matrix const &M, float *S, float *C)
 {
-  tup const Result = Vector(A.Y * B.Z - A.Z * B.Y, A.Z * B.X - A.X * B.Z, A.X * B.Y - A.Y * B.X);
-  return (Result);
+  for (int Idx = 0;  ///<!
+       Idx < 6;      ///<!
+       ++Idx)
+  {
+    int const I = INVERSE_PAIRS[Idx][0];
+    int const J = INVERSE_PAIRS[Idx][1];
+    S[Idx] = M.R[0].C[I] * M.R[1].C[J] - M.R[1].C[I] * M.R[0].C[J];
+    C[Idx] = M.R[2].C[I] * M.R[3].C[J] - M.R[3].C[I] * M.R[2].C[J];
+  }
 }
 
 //------------------------------------------------------------------------------
-float Dot(tup const &A, tup const &B)
+inline float DeterminantFromSub(float const *S, float const *C)
 {
-  float const Result = A.X * B.X +  //!<
-                       A.Y * B.Y +  //<!
-                       A.Z * B.Z +  //<!
-                       A.W * B.W;   //<!
-  return (Result);
+  return (S[0] * C[5] - S[1] * C[4] + S[2] * C[3] + S[3] * C[2] - S[4] * C[1] + S[5] * C[0]);
 }
 
 //------------------------------------------------------------------------------
-bool Equal(float const A, float const B)
+void Adjugate(matrix const &M, float const *S, float const *C, float const InvDet, matrix &Result)
 {
-  //if (std::fabs(A - B) < 2.f * EPSILON)
-  if (std::fabs(A - B) < 1.f * EPSILON)
+  int const Order[4] = {1, 0, 3, 2};
+  for (int Row = 0;  ///<!
+       Row < 4;      ///<!
+       ++Row)
   {
-    return true;
+    inverse_term const &T = INVERSE_TERMS[Row];
+    for (int Lane = 0;  ///<!
+         Lane < 4;      ///<!
+         ++Lane)
+    {
+      float const *Sub = Lane < 2 ? C : S;
+      int const R = Order[Lane];
+      float V = M.R[R].C[T.X] * Sub[T.A] - M.R[R].C[T.Y] * Sub[T.B] + M.R[R].C[T.Z] * Sub[T.C];
+      if ((Row + Lane) & 1) V = -V;
+      Result.R[Row].C[Lane] = V * InvDet;
+    }
   }
-  return false;
 }
 
-//------------------------------------------------------------------------------
-bool Equal(tup const &A, tup const &B)
+#if WW_SIMD_SSE
+inline __m128 Load(tup const &T) { return (_mm_load_ps(T.C)); }
+
+inline tup Store(__m128 const V)
 {
-  bool const Result = Equal(A.X, B.X) &&  //<!
-                      Equal(A.Y, B.Y) &&  //<!
-                      Equal(A.Z, B.Z) &&  //<!
-                      Equal(A.W, B.W);
+  tup Result;
+  _mm_store_ps(Result.C, V);
   return (Result);
 }
 
 //------------------------------------------------------------------------------
-bool IsPoint(tup const &Tup)
+// NOTE: The lanes are added in the same order as the scalar code: ((x + y) + z) + w.
+inline float DotSSE(tup const &A, tup const &B)
 {
-  bool Result{};
-  Result = (Tup.W != 0);
-  return (Result);
+  __m128 const P = _mm_mul_ps(Load(A), Load(B));
+  __m128 Sum = _mm_add_ss(P, _mm_shuffle_ps(P, P, _MM_SHUFFLE(1, 1, 1, 1)));
+  Sum = _mm_add_ss(Sum, _mm_shuffle_ps(P, P, _MM_SHUFFLE(2, 2, 2, 2)));
+  Sum = _mm_add_ss(Sum, _mm_shuffle_ps(P, P, _MM_SHUFFLE(3, 3, 3, 3)));
+  return (_mm_cvtss_f32(Sum));
 }
 
 //------------------------------------------------------------------------------
-bool IsVector(tup const &Tup)
+// NOTE: Transpose so that every lane computes one row of the product.
+inline tup MulSSE(matrix const &A, tup const &T)
 {
-  bool Result{};
-  Result = !(Tup.W != 0);
-  return (Result);
+  __m128 C0 = Load(A.R[0]);
+  __m128 C1 = Load(A.R[1]);
+  __m128 C2 = Load(A.R[2]);
+  __m128 C3 = Load(A.R[3]);
+  _MM_TRANSPOSE4_PS(C0, C1, C2, C3);
+
+  __m128 const V = Load(T);
+  __m128 Result = _mm_mul_ps(C0, _mm_shuffle_ps(V, V, _MM_SHUFFLE(0, 0, 0, 0)));
+  Result = _mm_add_ps(Result, _mm_mul_ps(C1, _mm_shuffle_ps(V, V, _MM_SHUFFLE(1, 1, 1, 1))));
+  Result = _mm_add_ps(Result, _mm_mul_ps(C2, _mm_shuffle_ps(V, V, _MM_SHUFFLE(2, 2, 2, 2))));
+  Result = _mm_add_ps(Result, _mm_mul_ps(C3, _mm_shuffle_ps(V, V, _MM_SHUFFLE(3, 3, 3, 3))));
+  return (Store(Result));
 }
 
 //------------------------------------------------------------------------------
-tup Mul(float const S, tup const &Tup)
+// NOTE: Row R of the product is the sum of the rows of B scaled by the elements of row R in A.
+inline void MulSSE(matrix const &A, matrix const &B, matrix &M)
 {
-  tup const Result{S * Tup.X, S * Tup.Y, S * Tup.Z, S * Tup.W};
-  return (Result);
+  __m128 const B0 = Load(B.R[0]);
+  __m128 const B1 = Load(B.R[1]);
+  __m128 const B2 = Load(B.R[2]);
+  __m128 const B3 = Load(B.R[3]);
+  for (int Row = 0;  ///<!
+       Row < 4;      ///<!
+       ++Row)
+  {
+    __m128 Result = _mm_mul_ps(_mm_set1_ps(A.R[Row].C[0]), B0);
+    Result = _mm_add_ps(Result, _mm_mul_ps(_mm_set1_ps(A.R[Row].C[1]), B1));
+    Result = _mm_add_ps(Result, _mm_mul_ps(_mm_set1_ps(A.R[Row].C[2]), B2));
+    Result = _mm_add_ps(Result, _mm_mul_ps(_mm_set1_ps(A.R[Row].C[3]), B3));
+    _mm_store_ps(M.R[Row].C, Result);
+  }
 }
 
 //------------------------------------------------------------------------------
-tup Mul(tup const A, tup const B)
+// NOTE: Same as SubDeterminants. Lanes are the pairs 01, 02, 03, 12 of S, then
+//       13, 23 of S and 13, 23 of C, then 01, 02, 03, 12 of C.
+inline void SubDeterminantsSSE(matrix const &M, float *S, float *C)
 {
-  tup const Result{A.R * B.R, A.G * B.G, A.B * B.B, A.W * B.W};
-  return (Result);
+  __m128 const R0 = Load(M.R[0]);
+  __m128 const R1 = Load(M.R[1]);
+  __m128 const R2 = Load(M.R[2]);
+  __m128 const R3 = Load(M.R[3]);
+
+  auto Pairs = [](__m128 const A, __m128 const B) {
+    __m128 const AI = _mm_shuffle_ps(A, A, _MM_SHUFFLE(1, 0, 0, 0));
+    __m128 const AJ = _mm_shuffle_ps(A, A, _MM_SHUFFLE(2, 3, 2, 1));
+    __m128 const BI = _mm_shuffle_ps(B, B, _MM_SHUFFLE(1, 0, 0, 0));
+    __m128 const BJ = _mm_shuffle_ps(B, B, _MM_SHUFFLE(2, 3, 2, 1));
+    return (_mm_sub_ps(_mm_mul_ps(AI, BJ), _mm_mul_ps(BI, AJ)));
+  };
+  __m128 const AI = _mm_shuffle_ps(R0, R2, _MM_SHUFFLE(2, 1, 2, 1));
+  __m128 const AJ = _mm_shuffle_ps(R0, R2, _MM_SHUFFLE(3, 3, 3, 3));
+  __m128 const BI = _mm_shuffle_ps(R1, R3, _MM_SHUFFLE(2, 1, 2, 1));
+  __m128 const BJ = _mm_shuffle_ps(R1, R3, _MM_SHUFFLE(3, 3, 3, 3));
+
+  alignas(16) float Mixed[4];
+  _mm_storeu_ps(S, Pairs(R0, R1));
+  _mm_store_ps(Mixed, _mm_sub_ps(_mm_mul_ps(AI, BJ), _mm_mul_ps(BI, AJ)));
+  _mm_storeu_ps(C, Pairs(R2, R3));
+  S[4] = Mixed[0];
+  S[5] = Mixed[1];
+  C[4] = Mixed[2];
+  C[5] = Mixed[3];
 }
 
 //------------------------------------------------------------------------------
-float MagSquared(tup const &Tup)
+// NOTE: Same as Adjugate, one row of the result per iteration.
+inline void AdjugateSSE(matrix const &M, float const *S, float const *C, float const InvDet, matrix &Result)
 {
-  float const Result = Tup.X * Tup.X +  //<!
-                       Tup.Y * Tup.Y +  //<!
-                       Tup.Z * Tup.Z +  //<!
-                       Tup.W * Tup.W;   //<!
-  return (Result);
+  __m128 P[4] = {Load(M.R[1]), Load(M.R[0]), Load(M.R[3]), Load(M.R[2])};
+  _MM_TRANSPOSE4_PS(P[0], P[1], P[2], P[3]);
+
+  __m128 const Scale = _mm_set1_ps(InvDet);
+  __m128 const SignOdd = _mm_setr_ps(0.f, -0.f, 0.f, -0.f);
+  __m128 const SignEven = _mm_setr_ps(-0.f, 0.f, -0.f, 0.f);
+  for (int Row = 0;  ///<!
+       Row < 4;      ///<!
+       ++Row)
+  {
+    inverse_term const &T = INVERSE_TERMS[Row];
+    __m128 const A = _mm_setr_ps(C[T.A], C[T.A], S[T.A], S[T.A]);
+    __m128 const B = _mm_setr_ps(C[T.B], C[T.B], S[T.B], S[T.B]);
+    __m128 const D = _mm_setr_ps(C[T.C], C[T.C], S[T.C], S[T.C]);
+    __m128 V = _mm_sub_ps(_mm_mul_ps(P[T.X], A), _mm_mul_ps(P[T.Y], B));
+    V = _mm_add_ps(V, _mm_mul_ps(P[T.Z], D));
+    V = _mm_xor_ps(V, (Row & 1) ? SignEven : SignOdd);
+    _mm_store_ps(Result.R[Row].C, _mm_mul_ps(V, Scale));
+  }
 }
+#endif
 
+#if WW_SIMD_AVX
 //------------------------------------------------------------------------------
-float Mag(tup const &Tup) { return (std::sqrt(MagSquared(Tup))); }
+// NOTE: Lo in the lower four lanes and Hi in the upper four lanes.
+__attribute__((target("avx"))) inline __m256 Broadcast(float const Lo, float const Hi)
+{
+  return (_mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(Lo)), _mm_set1_ps(Hi), 1));
+}
 
 //------------------------------------------------------------------------------
-tup Negate(tup const &Tup)
+// NOTE: Same as MulSSE, but two rows of the product at a time. The rows of a
+//       matrix are next to each other in memory, so they are stored in one go.
+__attribute__((target("avx"))) void MulAVX(matrix const &A, matrix const &B, matrix &M)
 {
-  tup const Result{-Tup.X, -Tup.Y, -Tup.Z, -Tup.W};
-  return (Result);
+  __m256 const B0 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(B.R[0].C));
+  __m256 const B1 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(B.R[1].C));
+  __m256 const B2 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(B.R[2].C));
+  __m256 const B3 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(B.R[3].C));
+
+  for (int Row = 0;  ///<!
+       Row < 4;      ///<!
+       Row += 2)
+  {
+    tup const &Lo = A.R[Row];
+    tup const &Hi = A.R[Row + 1];
+    __m256 Result = _mm256_mul_ps(Broadcast(Lo.C[0], Hi.C[0]), B0);
+    Result = _mm256_add_ps(Result, _mm256_mul_ps(Broadcast(Lo.C[1], Hi.C[1]), B1));
+    Result = _mm256_add_ps(Result, _mm256_mul_ps(Broadcast(Lo.C[2], Hi.C[2]), B2));
+    Result = _mm256_add_ps(Result, _mm256_mul_ps(Broadcast(Lo.C[3], Hi.C[3]), B3));
+    _mm256_storeu_ps(M.R[Row].C, Result);
+  }
 }
+#endif
 
 //------------------------------------------------------------------------------
-tup Normalize(tup const &Tup)
+// \struct mapped_file - A read only memory mapping of a whole file. Unmapped when
+//                      it goes out of scope. pData is null when the mapping failed.
+struct mapped_file
 {
-  tup const Result = Tup / Mag(Tup);
-  return (Result);
-}
+  explicit mapped_file(std::string const &Filename)
+  {
+    int const FileDescriptor = ::open(Filename.c_str(), O_RDONLY);
+    if (FileDescriptor < 0) return;
+
+    struct stat Stat
+    {
+    };
+    if (::fstat(FileDescriptor, &Stat) == 0 && Stat.st_size > 0)
+    {
+      void *pMap = ::mmap(nullptr, static_cast<size_t>(Stat.st_size), PROT_READ, MAP_PRIVATE, FileDescriptor, 0);
+      if (pMap != MAP_FAILED)
+      {
+        pData = static_cast<char const *>(pMap);
+        Size = static_cast<size_t>(Stat.st_size);
+      }
+    }
+    ::close(FileDescriptor);
+  }
+  ~mapped_file()
+  {
+    if (pData) ::munmap(const_cast<char *>(pData), Size);
+  }
+  mapped_file(mapped_file const &) = delete;
+  mapped_file &operator=(mapped_file const &) = delete;
+
+  char const *pData{};
+  size_t Size{};
+};
 
 //------------------------------------------------------------------------------
-tup Point(float A, float B, float C)
+// \fn ScanInt - Skip whitespace and comments, then read a non-negative integer.
+// \return False when there is no number, or it does not fit in an int. P is moved
+//         past the number.
+bool ScanInt(char const *&P, char const *const End, int &Value)
 {
-  tup Result{A, B, C, 1.f};
-  return (Result);
+  while (P < End)
+  {
+    if (*P == '#')
+    {
+      while (P < End && *P != '\n') ++P;
+    }
+    else if (*P == ' ' || *P == '\n' || *P == '\r' || *P == '\t' || *P == '\v' || *P == '\f')
+    {
+      ++P;
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  if (P == End || *P < '0' || *P > '9') return (false);
+
+  long long Result{};
+  while (P < End && *P >= '0' && *P <= '9')
+  {
+    Result = Result * 10 + (*P - '0');
+    if (Result > std::numeric_limits<int>::max()) return (false);
+    ++P;
+  }
+  Value = static_cast<int>(Result);
+  return (true);
 }
 
 //------------------------------------------------------------------------------
-tup Sub(tup const &A, tup const &B)
+// NOTE: Wavefront OBJ parsing. A file is cut into one chunk per thread at line breaks.
+//       The chunks are read twice: first to count the vertices, normals and corners of
+//       each chunk, then, once the buffers have their final size, to parse straight into
+//       them at the offset of the chunk. Nothing is allocated per line.
+//------------------------------------------------------------------------------
+constexpr size_t MIN_OBJ_CHUNK = 1 << 20;  //!< Smaller files are not split over more threads.
+
+//------------------------------------------------------------------------------
+// \struct obj_chunk - The lines from Begin up to End, what they hold, and where in the
+//                     buffers of obj_data they go.
+struct obj_chunk
 {
-  tup const Result = {A.X - B.X, A.Y - B.Y, A.Z - B.Z, A.W - B.W};
-  return (Result);
-}
+  char const *Begin{};
+  char const *End{};
+  size_t Lines{};
+  size_t Vertices{};
+  size_t Normals{};
+  size_t Indices{};  //!< Three per triangle, after the polygons are split into fans.
+  size_t FirstLine{};
+  size_t FirstVertex{};
+  size_t FirstNormal{};
+  size_t FirstIndex{};
+  std::string Error{};  //!< Only set, and allocated, on failure.
+};
+
+enum class obj_line
+{
+  OTHER,   //!< Comments, texture coordinates, groups, materials and so on are skipped.
+  VERTEX,  //!< v x y z
+  NORMAL,  //!< vn x y z
+  FACE,    //!< f v/vt/vn v/vt/vn v/vt/vn ...
+};
 
 //------------------------------------------------------------------------------
-tup Vector(float A, float B, float C)
+inline bool IsBlank(char const C)
 {
-  tup Result{A, B, C, 0.f};
-  return (Result);
+  return (C == ' ' || C == '\t' || C == '\r' || C == '\v' || C == '\f');
 }
 
 //------------------------------------------------------------------------------
-float Radians(float Deg) { return (PI_F * Deg / 180.f); }
-// ---
-// NOTE: Canvas methods/functions.
-// ---
-void WritePixel(canvas &Canvas, int X, int Y, tup const &Color)
+inline void SkipBlanks(char const *&P, char const *const End)
 {
-  // std::cout << "X:" << X                       //!<
-  //          << ". Y:" << Y                     //!<
-  //          << ". clc:" << (X + Y * Canvas.W)  //!<
-  //          << ". size:" << Canvas.vXY.size()  //!<
-  //          << std::endl;
-
-  Assert(Canvas.vXY.size() > (X + Y * Canvas.W), __FILE__, __LINE__);
-  Canvas.vXY[X + Y * Canvas.W] = Color;
+  while (P < End && IsBlank(*P)) ++P;
 }
+
 //------------------------------------------------------------------------------
-tup PixelAt(canvas const &Canvas, int X, int Y)
+// NOTE: True at the end of a token on an OBJ line.
+inline bool IsTokenEnd(char const *const P, char const *const End)
 {
-  Assert(Canvas.vXY.size() > (X + Y * Canvas.W), __FILE__, __LINE__);
-  tup const Result = Canvas.vXY[X + Y * Canvas.W];
-  return (Result);
+  return (P == End || IsBlank(*P) || *P == '\n' || *P == '#');
 }
 
 //------------------------------------------------------------------------------
-// ---
-// NOTE: The Portable Pix Map header.
-//     : Returns a string with a magic number, the dimension and the pixel resolution.
-// ---
-std::string PPMHeader(canvas const &Canvas)
+// NOTE: Move P to the start of the next line.
+inline void NextLine(char const *&P, char const *const End)
 {
-  std::string const Result = "P3\n" + std::to_string(Canvas.W) + " " + std::to_string(Canvas.H) + "\n255";
-  return (Result);
+  while (P < End && *P != '\n') ++P;
+  if (P < End) ++P;
 }
 
 //------------------------------------------------------------------------------
-// NOTE: This is actually take two of creating a PPM file and it uses a slightly different
-//       approach compared to the file writing functin below.
-//       For now I will keep the code around for reference.
-//------------------------------------------------------------------------------
-int WriteToPPMFile(canvas const &Canvas, std::string const &Filename)
+// \fn ScanFloat - Read a decimal number like 12, -0.5 or 1.25e-3 without allocating.
+// \brief Up to 19 significant digits and a power of ten within 22 are exact in a double,
+//        so one multiply or divide rounds the number correctly before it is made a float.
+//        Anything else, rare in practice, is copied to the stack and handed to strtof.
+// \return False when there is no number. P is moved past the number.
+bool ScanFloat(char const *&P, char const *const End, float &Value)
 {
-  std::string Tmp{Filename};
-  if (!Tmp.size())
+  static double const POW10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  char const *const Start = P;
+  bool const Negative = P < End && *P == '-';
+  if (P < End && (*P == '-' || *P == '+')) ++P;
+
+  unsigned long long Mantissa{};
+  int Digits{};
+  int Exponent{};
+  bool Any{};
+  while (P < End && *P >= '0' && *P <= '9')
   {
-    // NOTE: Create a temporary filename.
-    static int FilenameModifier{};
-    wchar_t const FilenameM = L"ABCDEFG=#"[FilenameModifier];
-    FilenameModifier = (FilenameModifier + 1) % 7;
-    std::stringstream ss;
-    ss << FilenameM;
-    Tmp = Filename + ss.str();
+    if (Digits < 19)
+    {
+      Mantissa = Mantissa * 10 + (*P - '0');
+      Digits += Mantissa != 0;
+    }
+    else
+    {
+      ++Exponent;
+    }
+    Any = true;
+    ++P;
   }
-
-  FILE *fp = std::fopen(Tmp.c_str(), "w");
-  std::string const Header = PPMHeader(Canvas);
-  for (size_t Idx = 0;       //<!
-       Idx < Header.size();  //<!
-       ++Idx)
+  if (P < End && *P == '.')
   {
-    std::putc(Header[Idx], fp);
+    ++P;
+    while (P < End && *P >= '0' && *P <= '9')
+    {
+      if (Digits < 19)
+      {
+        Mantissa = Mantissa * 10 + (*P - '0');
+        Digits += Mantissa != 0;
+        --Exponent;
+      }
+      Any = true;
+      ++P;
+    }
   }
-  // NOTE: Body need to come on a separate line, so we do a new line here.
-  std::putc('\n', fp);
-
-  Assert(Canvas.vXY.size() == Canvas.W * Canvas.H, __FILE__, __LINE__);
+  if (!Any) return (false);
 
-  int PixelCount{};
-  for (size_t Idx = 0;           //<!
-       Idx < Canvas.vXY.size();  //<!
-       ++Idx, ++PixelCount)
+  if (P < End && (*P == 'e' || *P == 'E'))
   {
-    // NOTE: As per the standard the count per line should not exceed 70.
-    //     : So 33 pixels x 3 byte per pixel should do the trick.
-    if ((!(PixelCount % 15) || (!(Idx % Canvas.W))) && (Idx > 0))
+    char const *E = P + 1;
+    bool const NegativeExponent = E < End && *E == '-';
+    if (E < End && (*E == '-' || *E == '+')) ++E;
+    if (E == End || *E < '0' || *E > '9') return (false);
+    int Power{};
+    while (E < End && *E >= '0' && *E <= '9')
     {
-      std::putc('\n', fp);
-      PixelCount = 0;
+      Power = std::min(Power * 10 + (*E - '0'), 100000);
+      ++E;
     }
+    Exponent += NegativeExponent ? -Power : Power;
+    P = E;
+  }
 
-    // NOTE: Truncate the float values between 0.f and 1.f.
-    // clang-format off
-      int const cR = int(255 * std::max<float>(0.f, std::min<float>(1.f, Canvas.vXY[Idx].R)));
-      int const cG = int(255 * std::max<float>(0.f, std::min<float>(1.f, Canvas.vXY[Idx].G)));
-      int const cB = int(255 * std::max<float>(0.f, std::min<float>(1.f, Canvas.vXY[Idx].B)));
-    // clang-format on
-    std::string const Output = std::to_string(cR) + " " + std::to_string(cG) + " " + std::to_string(cB) + " ";
-
-    // NOTE: So we have a string with the data, lets write to the file.
-    for (size_t I = 0;       //<!
-         I < Output.size();  //<!
-         ++I)
-    {
-      std::putc(Output[I], fp);
-    }
+  if (Mantissa < (1ull << 53) && Exponent >= -22 && Exponent <= 22)
+  {
+    double const D = Exponent < 0 ? Mantissa / POW10[-Exponent] : Mantissa * POW10[Exponent];
+    Value = static_cast<float>(Negative ? -D : D);
+    return (true);
   }
-  std::putc('\n', fp);
-  std::fclose(fp);
 
-  // NOTE: move the file to the name it is supposed to have.
-  int const Result = std::rename(Tmp.c_str(), Filename.c_str());
-  return (Result);
+  char Buffer[64];
+  size_t const Length = static_cast<size_t>(P - Start);
+  if (Length >= sizeof(Buffer)) return (false);
+  std::copy(Start, P, Buffer);
+  Buffer[Length] = '\0';
+  Value = std::strtof(Buffer, nullptr);
+  return (true);
 }
 
 //------------------------------------------------------------------------------
-// NOTE: Write the canvas to a Portable Pix Map file.
-void WriteToPPM(canvas const &Canvas, std::string const &Filename)
+// \fn ScanIndex - Read an OBJ index, which may be negative, without allocating.
+bool ScanIndex(char const *&P, char const *const End, long long &Value)
 {
-  std::ofstream O(Filename, std::ofstream::out | std::ofstream::trunc);
-
-  O << PPMHeader(Canvas) << std::endl;
+  bool const Negative = P < End && *P == '-';
+  if (Negative) ++P;
+  if (P == End || *P < '0' || *P > '9') return (false);
 
-  int PixelCount{};
-  for (size_t Idx = 0;           //<!
-       Idx < Canvas.vXY.size();  //<!
-       ++Idx, ++PixelCount)
+  long long Result{};
+  while (P < End && *P >= '0' && *P <= '9')
   {
-    std::string Output{};
-    // NOTE: As per the standard the count per line should not exceed 70.
-    //     : So 33 pixels x 3 byte per pixel should do the trick.
-    if ((!(PixelCount % 33) || (!(Idx % Canvas.W))) && (Idx > 0))
-    {
-      Output += "\n";
-      PixelCount = 0;
-    }
-
-    // NOTE: Truncate the float values between 0.f and 1.f.
-    // clang-format off
-      Output += std::to_string(int(255 * std::max<float>(0.f, std::min<float>(1.f, Canvas.vXY[Idx].R))))  //!<
-         + " " + std::to_string(int(255 * std::max<float>(0.f, std::min<float>(1.f, Canvas.vXY[Idx].G))))  //<!
-         + " " + std::to_string(int(255 * std::max<float>(0.f, std::min<float>(1.f, Canvas.vXY[Idx].B))))  //<!
-         + " ";
-    // clang-format on
-    O << Output;
-
-    // Assert(Output.size() < 12, __FUNCTION__, __LINE__);
+    Result = std::min<long long>(Result * 10 + (*P - '0'), std::numeric_limits<int>::max() + 1ll);
+    ++P;
   }
-  O << std::endl;
-  O.close();
+  Value = Negative ? -Result : Result;
+  return (true);
 }
 
 //------------------------------------------------------------------------------
-// NOTE: Read a PPM file from disk.
-// Return: A shared pointer of the allocated canvas.
-// TODO: Fault checking and robustness.
-//------------------------------------------------------------------------------
-std::shared_ptr<canvas> ReadFromPPM(std::string const &Filename)
+// \fn OBJLine - What the line at P holds. P is moved past the keyword.
+obj_line OBJLine(char const *&P, char const *const End)
 {
-  std::shared_ptr<canvas> Result{};
-  std::ifstream I(Filename, std::ifstream::in);
-  if (I.is_open())
+  SkipBlanks(P, End);
+  if (End - P < 2) return (obj_line::OTHER);
+  if (P[0] == 'f' && IsBlank(P[1]))
   {
-    // std::istream_iterator<std::string> begin(I);
-    // std::istream_iterator<std::string> end{};
-    std::vector<std::string> vstrings{};  //(begin, end);
-    while (!I.eof() && I.good())
-    {
-      std::string myString{};
-      I >> myString;
-      if (myString.size())
-      {
-        vstrings.push_back(myString);
-      }
-    }
-    // std::cout << "Size of vstrings:" << vstrings.size() << ". Line:" << __LINE__ << std::endl;
-
-    // NOTE: Check to see if magic number is correct.
-    if (vstrings.size() && (vstrings[0] == "P3"))
-    {
-      if (vstrings.size() > 3)
-      {
-        int const W = std::stoi(vstrings[1]);    // Width
-        int const H = std::stoi(vstrings[2]);    // Height
-        float const L = std::stof(vstrings[3]);  // How many levels, aka resolution
-
-        // NOTE: Allocate on the heap, not stack.
-        std::shared_ptr<canvas> ptrCanvas = std::make_shared<canvas>(W, H);
-        canvas &Cv = *ptrCanvas;
-        Assert(Cv.W == W && Cv.H == H, __FUNCTION__, __LINE__);
-
-        if ((Cv.W == W) && (Cv.H == H) && (L > 0))
-        {
-          // NOTE: The rest of the vector consist of the individual colors, 3 bytes per pixel.
-          int CvX{};
-          int CvY{};
-          for (size_t Idx = 4;         //<!
-               Idx < vstrings.size();  //<!
-               Idx += 3)
-          {
-            float const R = std::stof(vstrings[Idx]) / L;
-            float const G = std::stof(vstrings[Idx + 1]) / L;
-            float const B = std::stof(vstrings[Idx + 2]) / L;
-
-            WritePixel(Cv, CvX, CvY, Color(R, G, B));
-
-            // Calculate new position
-            CvX++;
-            CvX %= W;
-            if (CvX == 0) ++CvY;
-          }
-          // NOTE: Update the return pointer.
-          Result = ptrCanvas;
-        }
-        else
-        {
-          std::cerr << __FUNCTION__ << ": Loading of " << Filename << " failed. Resolution:"  //<!
-                    << L << ". W:" << W << ". H:" << H << "." << std::endl;
-        }
-      }
-    }
+    P += 2;
+    return (obj_line::FACE);
   }
-  return (Result);
-}
-
-// ---
-// NOTE: Matrix functions.
-// ---
-matrix Matrix44()
-{
-  matrix Result{};
-  return (Result);
+  if (P[0] != 'v') return (obj_line::OTHER);
+  if (IsBlank(P[1]))
+  {
+    P += 2;
+    return (obj_line::VERTEX);
+  }
+  if (P[1] == 'n' && End - P > 2 && IsBlank(P[2]))
+  {
+    P += 3;
+    return (obj_line::NORMAL);
+  }
+  return (obj_line::OTHER);
 }
 
 //------------------------------------------------------------------------------
-matrix Matrix44(tup const &R0, tup const &R1, tup const &R2, tup const &R3)
+// \fn OBJError - Fail the chunk with a message about the line it is on.
+bool OBJError(obj_chunk &Chunk, size_t const Line, char const *Message)
 {
-  matrix Result{R0, R1, R2, R3};
-  return (Result);
+  Chunk.Error = "Line " + std::to_string(Chunk.FirstLine + Line + 1) + ": " + Message;
+  return (false);
 }
 
 //------------------------------------------------------------------------------
-// NOTE: Use the data structure for 4x4 matrix for all types of matrixes.
-matrix Matrix33(tup const &R0, tup const &R1, tup const &R2)
+// \fn CountOBJ - First pass. Count the lines, vertices, normals and triangle corners of
+//               the chunk. The lines are checked by the second pass.
+void CountOBJ(obj_chunk &Chunk)
 {
-  matrix M{R0, R1, R2, tup{}};
-  M.Dimension = 3;
-  return (M);
+  char const *P = Chunk.Begin;
+  for (Chunk.Lines = 0;  ///<!
+       P < Chunk.End;    ///<!
+       ++Chunk.Lines, NextLine(P, Chunk.End))
+  {
+    switch (OBJLine(P, Chunk.End))
+    {
+      case obj_line::VERTEX:
+        ++Chunk.Vertices;
+        break;
+      case obj_line::NORMAL:
+        ++Chunk.Normals;
+        break;
+      case obj_line::FACE:
+      {
+        size_t Corners{};
+        for (SkipBlanks(P, Chunk.End);   ///<!
+             !IsTokenEnd(P, Chunk.End);  ///<!
+             SkipBlanks(P, Chunk.End))
+        {
+          ++Corners;
+          while (!IsTokenEnd(P, Chunk.End)) ++P;
+        }
+        if (Corners >= 3) Chunk.Indices += 3 * (Corners - 2);
+        break;
+      }
+      case obj_line::OTHER:
+        break;
+    }
+  }
 }
 
 //------------------------------------------------------------------------------
-// NOTE: Use the data structure for 4x4 matrix for all types of matrixes.
-matrix Matrix22(tup const &R0, tup const &R1)
+// \fn OBJIndex - Turn the one based, or negative and relative, index of a v or vn into
+//                an index into the buffer of Count entries, where Defined are before the line.
+bool OBJIndex(long long const Value, size_t const Defined, size_t const Count, int &Index)
 {
-  matrix M{R0, R1, tup{}, tup{}};
-  M.Dimension = 2;
-  return (M);
+  long long const Result = Value > 0 ? Value - 1 : static_cast<long long>(Defined) + Value;
+  if (Value == 0 || Result < 0 || Result >= static_cast<long long>(Count)) return (false);
+  Index = static_cast<int>(Result);
+  return (true);
 }
 
 //------------------------------------------------------------------------------
-float Get(matrix const &M, int Row, int Col)
+// \fn ParseOBJ - Second pass. Parse the chunk into its part of the buffers of Obj, which
+//                have their final size.
+bool ParseOBJ(obj_chunk &Chunk, obj_data &Obj)
 {
-  Assert(Row < M.Dimension, __FUNCTION__, __LINE__);
-  Assert(Col < M.Dimension, __FUNCTION__, __LINE__);
-  return M.R[Row].C[Col];
-};
+  size_t Vertex = Chunk.FirstVertex;
+  size_t Normal = Chunk.FirstNormal;
+  int *pIndex = Obj.vIndices.data() + Chunk.FirstIndex;
+  int *pNormalIndex = Obj.vNormalIndices.data() + Chunk.FirstIndex;
+
+  auto ScanTup = [&](char const *&P, tup &T) {
+    for (int C = 0;  ///<!
+         C < 3;      ///<!
+         ++C)
+    {
+      SkipBlanks(P, Chunk.End);
+      if (!ScanFloat(P, Chunk.End, T.C[C]) || !IsTokenEnd(P, Chunk.End)) return (false);
+    }
+    return (true);
+  };
 
-void Set(matrix &M, int Row, int Col, float Value) { M.R[Row].C[Col] = Value; }
+  char const *P = Chunk.Begin;
+  for (size_t Line = 0;  ///<!
+       P < Chunk.End;    ///<!
+       ++Line, NextLine(P, Chunk.End))
+  {
+    switch (OBJLine(P, Chunk.End))
+    {
+      case obj_line::VERTEX:
+      {
+        tup &V = Obj.vVertices[Vertex++];
+        if (!ScanTup(P, V)) return (OBJError(Chunk, Line, "A vertex needs three numbers."));
+        V.W = 1.f;
+        break;
+      }
+      case obj_line::NORMAL:
+      {
+        tup &N = Obj.vNormals[Normal++];
+        if (!ScanTup(P, N)) return (OBJError(Chunk, Line, "A normal needs three numbers."));
+        N.W = 0.f;
+        break;
+      }
+      case obj_line::FACE:
+      {
+        // NOTE: Corner number K > 1 closes the triangle of the fan with the first and
+        //       the previous corner.
+        int First[2]{};
+        int Previous[2]{};
+        int K{};
+        for (SkipBlanks(P, Chunk.End);   ///<!
+             !IsTokenEnd(P, Chunk.End);  ///<!
+             SkipBlanks(P, Chunk.End), ++K)
+        {
 
-//------------------------------------------------------------------------------
-is_invertible_return IsInvertible(matrix const &M)
-{
-  // NOTE: When the determinant has already been calculated we just return that result.
-  //       Otherwise the Determinant is calculated and a tuple is returned..
-  is_invertible_return Result{M.ID};
+          // NOTE: v, v/vt, v//vn or v/vt/vn. The texture coordinate is not kept.
+          long long Value{};
+          int Corner[2]{-1, -1};
+          if (!ScanIndex(P, Chunk.End, Value) || !OBJIndex(Value, Vertex, Obj.vVertices.size(), Corner[0]))
+          {
+            return (OBJError(Chunk, Line, "Bad or out of range vertex index."));
+          }
+          if (P < Chunk.End && *P == '/')
+          {
+            ++P;
+            if (P < Chunk.End && *P != '/' && !ScanIndex(P, Chunk.End, Value))
+            {
+              return (OBJError(Chunk, Line, "Bad texture coordinate index."));
+            }
+            if (P < Chunk.End && *P == '/')
+            {
+              ++P;
+              if (!ScanIndex(P, Chunk.End, Value) || !OBJIndex(Value, Normal, Obj.vNormals.size(), Corner[1]))
+              {
+                return (OBJError(Chunk, Line, "Bad or out of range normal index."));
+              }
+            }
+          }
+          if (!IsTokenEnd(P, Chunk.End)) return (OBJError(Chunk, Line, "Bad face corner."));
 
-  if (!Result.IsInvertible)
-  {
-    Result.Determinant = Determinant(M);
-    Result.IsInvertible = Result.Determinant != 0;
+          if (K == 0)
+          {
+            First[0] = Corner[0];
+            First[1] = Corner[1];
+          }
+          else if (K > 1)
+          {
+            *pIndex++ = First[0];
+            *pIndex++ = Previous[0];
+            *pIndex++ = Corner[0];
+            *pNormalIndex++ = First[1];
+            *pNormalIndex++ = Previous[1];
+            *pNormalIndex++ = Corner[1];
+          }
+          Previous[0] = Corner[0];
+          Previous[1] = Corner[1];
+        }
+        if (K < 3) return (OBJError(Chunk, Line, "A face needs at least three corners."));
+        break;
+      }
+      case obj_line::OTHER:
+        break;
+    }
   }
-  return (Result);
+  return (true);
 }
 
 //------------------------------------------------------------------------------
-matrix Inverse(matrix const &M)
-{
-  // NOTE: Inverse of matrix is done by
-  // 1. Calculate the determinant. If different than zero ok
-  // 2. Calculate the cofactor of the input matrix.
-  // 3. Transpose the Resulting matrix.
-  // 4. Divide each element by the determinant.
-
-  matrix Result{};
-  float &DetM = Result.ID.Determinant;
-  DetM = Determinant(M);
-
-  if (Equal(DetM, 0.f)) return (Result);
-
-  // NOTE: Since we did not return above the matrix must be invertible
-  Result.ID.IsInvertible = true;
+// NOTE: Scene files, in a YAML like subset of the format used in the book. A list of
+//       items at the start of a line, each with its keys indented below it:
+//
+//         - add: camera                  - define: wall         - add: sphere
+//           width: 100                     value:                 material: wall
+//           height: 50                       color: [1, 0.9, 0.9] transform:
+//           field-of-view: 1.047             specular: 0            - [scale, 10, 0.01, 10]
+//
+//       The file is mapped and read in a single pass, line by line, without a syntax
+//       tree. An item is added to the world when the next item starts.
+//------------------------------------------------------------------------------
+constexpr size_t SCENE_ARENA_BLOCK = 4096;  //!< Objects per allocation.
+constexpr int SCENE_MAX_TOKENS = 8;         //!< Most values in a [ ... ] list.
 
-  for (int Row = 0;        ///<!
-       Row < M.Dimension;  ///<!
-       ++Row)
+//------------------------------------------------------------------------------
+// \struct object_arena - Objects of type T allocated SCENE_ARENA_BLOCK at a time. The pointer
+//                        to each object shares the control block of its block, so a million
+//                        spheres take a few hundred allocations instead of a million.
+template <typename T>
+struct object_arena
+{
+  shared_ptr_object New()
   {
-    for (int Col = 0;        ///<!
-         Col < M.Dimension;  ///<!
-         ++Col)
+    if (!pBlock || pBlock->size() == pBlock->capacity())
     {
-      Result.R[Row].C[Col] = Cofactor(M, Row, Col) / DetM;
+      pBlock = std::make_shared<std::vector<T>>();
+      pBlock->reserve(SCENE_ARENA_BLOCK);
     }
+    pBlock->emplace_back();
+    return (shared_ptr_object(pBlock, &pBlock->back()));
   }
 
-  // NOTE: The transposed matrix is not updated with the Determinant and the IsInvertible flag.
-  Result = Transpose(Result);
+  std::shared_ptr<std::vector<T>> pBlock{};
+};
+
+enum class scene_item
+{
+  NONE,
+  CAMERA,
+  LIGHT,
+  SPHERE,
+  OBJ,
+  DEFINE,
+};
+
+enum class scene_value
+{
+  NONE,
+  MATERIAL,
+  TRANSFORM,
+};
 
-  return (Result);
-}
 //------------------------------------------------------------------------------
-matrix Mul(matrix const &A, matrix const &B)
+// \struct scene_entry - The item being read, from its first line up to the next item.
+struct scene_entry
 {
-  matrix M{};
-  for (size_t Row = 0;  ///<!
-       Row < 4;         ///<!
-       ++Row)
-  {
-    for (size_t Col = 0;  ///<!
-         Col < 4;         ///<!
-         ++Col)
-    {
-      float const Mrc = Get(A, Row, 0) * Get(B, 0, Col) +  //
-                        Get(A, Row, 1) * Get(B, 1, Col) +  //
-                        Get(A, Row, 2) * Get(B, 2, Col) +  //
-                        Get(A, Row, 3) * Get(B, 3, Col);   //
-      Set(M, Row, Col, Mrc);
-    }
-  }
-  return (M);
-}
+  scene_item Kind{};
+  size_t Line{};
+  material Material{};
+  matrix Transform{I()};
+  int Width{};
+  int Height{};
+  float FieldOfView{};
+  tup From{Point(0.f, 0.f, 0.f)};
+  tup To{Point(0.f, 0.f, -1.f)};
+  tup Up{Vector(0.f, 1.f, 0.f)};
+  tup At{Point(0.f, 0.f, 0.f)};
+  tup Intensity{Color(1.f, 1.f, 1.f)};
+  std::string Name{};   //!< Of a define.
+  std::string File{};   //!< Of an obj.
+  scene_value Value{};  //!< What the value of a define is.
+};
 
 //------------------------------------------------------------------------------
-tup Mul(matrix const &A, tup const &T)
+// \struct scene_reader - The state of ReadScene(): the item being read, the block of keys
+//                        that is open, the names defined so far and where the result goes.
+struct scene_reader
 {
-  tup Result{};
-  for (size_t Idx = 0;  ///<!
-       Idx < 4;         ///<!
-       ++Idx)
-  {
-    Result.C[Idx] = Get(A, Idx, 0) * T.C[0] +  //
-                    Get(A, Idx, 1) * T.C[1] +  //
-                    Get(A, Idx, 2) * T.C[2] +  //
-                    Get(A, Idx, 3) * T.C[3];
-  }
-  return (Result);
-}
+  scene_reader(world &W, camera &C, std::string &E) : World(W), Camera(C), Error(E) {}
+
+  world &World;
+  camera &Camera;
+  std::string &Error;
+  std::string Directory{};  //!< Of the scene file, for the relative paths of OBJ files.
+  size_t Line{};
+  bool HasCamera{};
+  scene_entry Item{};
+
+  // NOTE: The key whose block of lines is open, and its indentation. -1 for none.
+  std::string_view Block{};
+  int BlockIndent{-1};
+
+  std::unordered_map<std::string, material> Materials{};
+  std::unordered_map<std::string, matrix> Transforms{};
+  std::unordered_map<std::string, shared_ptr_mesh_data> Meshes{};
+  object_arena<sphere> Spheres{};
+};
 
 //------------------------------------------------------------------------------
-matrix I()
+bool SceneError(scene_reader &R, size_t const Line, std::string const &Message)
 {
-  matrix Identity{};
-  Set(Identity, 0, 0, 1.f);
-  Set(Identity, 1, 1, 1.f);
-  Set(Identity, 2, 2, 1.f);
-  Set(Identity, 3, 3, 1.f);
-  return (Identity);
+  R.Error = "Line " + std::to_string(Line) + ": " + Message;
+  return (false);
 }
 
 //------------------------------------------------------------------------------
-bool Equal(matrix const &A, matrix const &B)
+inline std::string_view Trim(std::string_view S)
 {
-  return Equal(A.R[0], B.R[0]) &&  //
-         Equal(A.R[1], B.R[1]) &&  //
-         Equal(A.R[2], B.R[2]) &&  //
-         Equal(A.R[3], B.R[3]);
+  while (!S.empty() && IsBlank(S.front())) S.remove_prefix(1);
+  while (!S.empty() && IsBlank(S.back())) S.remove_suffix(1);
+  return (S);
 }
 
 //------------------------------------------------------------------------------
-matrix Transpose(matrix const &M)
+// \fn SplitKey - Split "key: value" at the colon. Value is empty for a key that opens a block.
+bool SplitKey(std::string_view const Text, std::string_view &Key, std::string_view &Value)
 {
-  matrix R{};
-  for (size_t Row = 0;  ///<!
-       Row < 4;         ///<!
-       ++Row)
-  {
-    for (size_t Col = 0;  ///<!
-         Col < 4;         ///<!
-         ++Col)
-    {
-      R.R[Row].C[Col] = M.R[Col].C[Row];
-    }
-  }
-  return (R);
+  size_t const Colon = Text.find(':');
+  if (Colon == std::string_view::npos) return (false);
+  Key = Trim(Text.substr(0, Colon));
+  Value = Trim(Text.substr(Colon + 1));
+  return (!Key.empty());
 }
 
 //------------------------------------------------------------------------------
-float Determinant22(matrix const &M)
+bool ParseFloat(std::string_view const S, float &Value)
 {
-  // NOTE: The determinant is D = a*d - b*c
-  float const Result = M.R[0].C[0] * M.R[1].C[1] - M.R[1].C[0] * M.R[0].C[1];
-  return (Result);
+  char const *P = S.data();
+  char const *const End = P + S.size();
+  return (ScanFloat(P, End, Value) && P == End);
 }
 
 //------------------------------------------------------------------------------
-float Determinant33(matrix const &M)
+bool ParseInt(std::string_view const S, int &Value)
 {
-  float const CF0 = Cofactor33(M, 0, 0);
-  float const CF1 = Cofactor33(M, 0, 1);
-  float const CF2 = Cofactor33(M, 0, 2);
-
-  float const Result = M.R0.C[0] * CF0 + M.R0.C[1] * CF1 + M.R0.C[2] * CF2;
-  return (Result);
+  char const *P = S.data();
+  char const *const End = P + S.size();
+  return (ScanInt(P, End, Value) && P == End);
 }
 
 //------------------------------------------------------------------------------
-float Determinant44(matrix const &M)
+// \fn ParseList - Split "[a, b, c]" into its trimmed tokens.
+// \return The number of tokens, or -1 when S is not such a list.
+int ParseList(std::string_view S, std::string_view (&Tokens)[SCENE_MAX_TOKENS])
 {
-  matrix const M0 = SubMatrix(M, 0, 0);
-  matrix const M1 = SubMatrix(M, 0, 1);
-  matrix const M2 = SubMatrix(M, 0, 2);
-  matrix const M3 = SubMatrix(M, 0, 3);
-  float const DetM0 = Determinant33(M0);
-  float const DetM1 = Determinant33(M1);
-  float const DetM2 = Determinant33(M2);
-  float const DetM3 = Determinant33(M3);
-  float const Result = M.R0.C[0] * DetM0 - M.R0.C[1] * DetM1 + M.R0.C[2] * DetM2 - M.R0.C[3] * DetM3;
-  return (Result);
+  if (S.size() < 2 || S.front() != '[' || S.back() != ']') return (-1);
+  S = Trim(S.substr(1, S.size() - 2));
+  int Count{};
+  while (!S.empty())
+  {
+    if (Count == SCENE_MAX_TOKENS) return (-1);
+    size_t const Comma = S.find(',');
+    Tokens[Count++] = Trim(S.substr(0, Comma));
+    if (Comma == std::string_view::npos) break;
+    S = S.substr(Comma + 1);
+  }
+  return (Count);
 }
 
 //------------------------------------------------------------------------------
-float Determinant(matrix const &M)
+// \fn ParseTup - Read "[x, y, z]" into T, with the given W.
+bool ParseTup(std::string_view const S, float const W, tup &T)
 {
-  float Result{};
-  if (M.Dimension == 4)
-    Result = Determinant44(M);
-  else if (M.Dimension == 3)
-    Result = Determinant33(M);
-  else if (M.Dimension == 2)
-    Result = Determinant22(M);
-  return (Result);
+  std::string_view Tokens[SCENE_MAX_TOKENS];
+  if (ParseList(S, Tokens) != 3) return (false);
+  for (int C = 0;  ///<!
+       C < 3;      ///<!
+       ++C)
+  {
+    if (!ParseFloat(Tokens[C], T.C[C])) return (false);
+  }
+  T.W = W;
+  return (true);
 }
 
 //------------------------------------------------------------------------------
-matrix SubMatrix(matrix const &M, int RemoveRow, int RemoveCol)
+// \fn ParseTransform - Apply "[translate, x, y, z]", the other operations of the book, or
+//                      the name of a defined transform, after R.Item.Transform.
+bool ParseTransform(scene_reader &R, std::string_view const S)
 {
-  matrix R{};
-  int ShiftR{};
-
-  // NOTE: For each row copy source until we get to the removerow
-  //       When we get to the remove row the source shifts by one,
-  //       so that we skip the RemoveRow.
-  for (int Row = 0;            ///<!
-       Row < M.Dimension - 1;  ///<!
-       ++Row)
+  if (S.empty() || S.front() != '[')
   {
-    if (Row == RemoveRow) ShiftR++;
-    R.R[Row] = M.R[Row + ShiftR];
+    auto const It = R.Transforms.find(std::string(S));
+    if (It == R.Transforms.end()) return (SceneError(R, R.Line, "Unknown transform '" + std::string(S) + "'."));
+    R.Item.Transform = It->second * R.Item.Transform;
+    return (true);
   }
 
-  // NOTE: Dimension reduces by 1 when we remove one row/column.
-  R.Dimension = M.Dimension - 1;
-
-  // NOTE: Copy the columns.
-  for (int Row = 0;        ///<!
-       Row < R.Dimension;  ///<! The rows are already in order, so we only need to
-       ++Row)              ///<! iterate over the result rows.
+  std::string_view Tokens[SCENE_MAX_TOKENS];
+  int const Count = ParseList(S, Tokens);
+  float V[SCENE_MAX_TOKENS]{};
+  for (int Idx = 1;  ///<!
+       Idx < Count;  ///<!
+       ++Idx)
   {
-    for (int Col = 0;        ///<!
-         Col < M.Dimension;  ///<!
-         ++Col)
-    {
-      if (Col < RemoveCol) continue;  // No point in copy of data that is already correctly placed.
-
-      if (Col < M.Dimension - 1)
-        R.R[Row].C[Col] = R.R[Row].C[Col + 1];
-      else
-        R.R[Row].C[Col] = 0.f;
-    }
+    if (!ParseFloat(Tokens[Idx], V[Idx - 1])) return (SceneError(R, R.Line, "Bad number in the transform."));
   }
 
-  return (R);
+  std::string_view const Op = Count > 0 ? Tokens[0] : std::string_view{};
+  matrix M{};
+  if (Op == "translate" && Count == 4) M = Translation(V[0], V[1], V[2]);
+  else if (Op == "scale" && Count == 4) M = Scaling(V[0], V[1], V[2]);
+  else if (Op == "rotate-x" && Count == 2) M = RotateX(V[0]);
+  else if (Op == "rotate-y" && Count == 2) M = RotateY(V[0]);
+  else if (Op == "rotate-z" && Count == 2) M = RotateZ(V[0]);
+  else if (Op == "shear" && Count == 7) M = Shearing(V[0], V[1], V[2], V[3], V[4], V[5]);
+  else return (SceneError(R, R.Line, "Expected translate, scale, rotate-x, rotate-y, rotate-z or shear with its numbers."));
+
+  R.Item.Transform = M * R.Item.Transform;
+  return (true);
 }
 
 //------------------------------------------------------------------------------
-float Minor(matrix const &M, int RemoveRow, int RemoveCol)
+bool ParseMaterialKey(scene_reader &R, std::string_view const Key, std::string_view const Value)
 {
-  matrix const SM = SubMatrix(M, RemoveRow, RemoveCol);
-  float Result = Determinant22(SM);
-
-  return (Result);
+  bool Ok{};
+  if (Key == "color") Ok = ParseTup(Value, 0.f, R.Item.Material.Color);
+  else if (Key == "ambient") Ok = ParseFloat(Value, R.Item.Material.Ambient);
+  else if (Key == "diffuse") Ok = ParseFloat(Value, R.Item.Material.Diffuse);
+  else if (Key == "specular") Ok = ParseFloat(Value, R.Item.Material.Specular);
+  else if (Key == "shininess") Ok = ParseFloat(Value, R.Item.Material.Shininess);
+  else return (SceneError(R, R.Line, "Unknown material key '" + std::string(Key) + "'."));
+
+  if (!Ok) return (SceneError(R, R.Line, "Bad value for '" + std::string(Key) + "'."));
+  return (true);
 }
 
 //------------------------------------------------------------------------------
-float Cofactor33(matrix const &M, int RemoveRow, int RemoveCol)
-{
-  Assert(M.Dimension == 3, __FUNCTION__, __LINE__);
-  // NOTE: Change sign for the Cofactor when the sum of Row and Col is an odd number.
-  //       So; move to -2 for sign and then add 1.
-  int const Sign = -((RemoveRow + RemoveCol) % 2) * 2 + 1;
-  float const Result = Sign * Minor(M, RemoveRow, RemoveCol);
-  return (Result);
-}
-
-//------------------------------------------------------------------------------
-float Cofactor44(matrix const &M, int RemoveRow, int RemoveCol)
+// \fn FinishItem - Add the item that was read to the world, or remember its definition,
+//                  and start over with an empty item.
+bool FinishItem(scene_reader &R)
 {
-  Assert(M.Dimension == 4, __FUNCTION__, __LINE__);
-  matrix const A = SubMatrix(M, RemoveRow, RemoveCol);
+  switch (R.Item.Kind)
+  {
+    case scene_item::CAMERA:
+    {
+      if (R.Item.Width <= 0 || R.Item.Height <= 0 || !(R.Item.FieldOfView > 0.f))
+      {
+        return (SceneError(R, R.Item.Line, "A camera needs a width, a height and a field-of-view."));
+      }
+      R.Camera = Camera(R.Item.Width, R.Item.Height, R.Item.FieldOfView);
+      R.Camera.Transform = ViewTransform(R.Item.From, R.Item.To, R.Item.Up);
+      R.HasCamera = true;
+      break;
+    }
+    case scene_item::LIGHT:
+    {
+      R.World.vPtrLights.push_back(std::make_shared<light>(PointLight(R.Item.At, R.Item.Intensity)));
+      break;
+    }
+    case scene_item::SPHERE:
+    {
+      shared_ptr_object const PtrSphere = R.Spheres.New();
+      PtrSphere->Transform = R.Item.Transform;
+      PtrSphere->Material = R.Item.Material;
+      R.World.vPtrObjects.push_back(PtrSphere);
+      break;
+    }
+    case scene_item::OBJ:
+    {
+      // NOTE: The same file is loaded once and its triangles shared by all its meshes.
+      if (R.Item.File.empty()) return (SceneError(R, R.Item.Line, "An obj needs a file."));
+      std::string const Path = R.Item.File.front() == '/' ? R.Item.File : R.Directory + R.Item.File;
+      shared_ptr_mesh_data &pData = R.Meshes[Path];
+      if (!pData)
+      {
+        obj_data Obj{};
+        obj_stats Stats{};
+        std::string Error{};
+        if (!ReadFromOBJ(Path, Obj, Error, Stats)) return (SceneError(R, R.Item.Line, Path + ": " + Error));
+        pData = MeshData(std::move(Obj.vVertices), std::move(Obj.vIndices));
+      }
+      shared_ptr_object const PtrMesh = ww::PtrMesh(pData);
+      PtrMesh->Transform = R.Item.Transform;
+      PtrMesh->Material = R.Item.Material;
+      R.World.vPtrObjects.push_back(PtrMesh);
+      break;
+    }
+    case scene_item::DEFINE:
+    {
+      if (R.Item.Value == scene_value::MATERIAL) R.Materials[R.Item.Name] = R.Item.Material;
+      else if (R.Item.Value == scene_value::TRANSFORM) R.Transforms[R.Item.Name] = R.Item.Transform;
+      else return (SceneError(R, R.Item.Line, "A define needs a value."));
+      break;
+    }
+    case scene_item::NONE:
+      break;
+  }
 
-  int const Sign = -((RemoveRow + RemoveCol) % 2) * 2 + 1;
-  float const Result = Sign * Determinant33(A);
-  return (Result);
+  R.Item = scene_entry{};
+  R.BlockIndent = -1;
+  return (true);
 }
 
 //------------------------------------------------------------------------------
-float Cofactor(matrix const &M, int RemoveRow, int RemoveCol)
+// \fn ReadSceneKey - A "key: value" line of the item, or a "key:" that opens a block.
+bool ReadSceneKey(scene_reader &R, int const Indent, std::string_view const Key, std::string_view const Value)
 {
-  float Result{};
+  bool const Object = R.Item.Kind == scene_item::SPHERE || R.Item.Kind == scene_item::OBJ;
+  if (Value.empty())
+  {
+    bool const Block = (Object && (Key == "material" || Key == "transform")) ||
+                       (R.Item.Kind == scene_item::DEFINE && Key == "value");
+    if (!Block) return (SceneError(R, R.Line, "Missing value for '" + std::string(Key) + "'."));
+    R.Block = Key;
+    R.BlockIndent = Indent;
+    return (true);
+  }
 
-  if (M.Dimension == 4)
-    Result = Cofactor44(M, RemoveRow, RemoveCol);
-  else if (M.Dimension == 3)
-    Result = Cofactor33(M, RemoveRow, RemoveCol);
+  bool Ok{true};
+  switch (R.Item.Kind)
+  {
+    case scene_item::CAMERA:
+    {
+      if (Key == "width") Ok = ParseInt(Value, R.Item.Width);
+      else if (Key == "height") Ok = ParseInt(Value, R.Item.Height);
+      else if (Key == "field-of-view") Ok = ParseFloat(Value, R.Item.FieldOfView);
+      else if (Key == "from") Ok = ParseTup(Value, 1.f, R.Item.From);
+      else if (Key == "to") Ok = ParseTup(Value, 1.f, R.Item.To);
+      else if (Key == "up") Ok = ParseTup(Value, 0.f, R.Item.Up);
+      else return (SceneError(R, R.Line, "Unknown camera key '" + std::string(Key) + "'."));
+      break;
+    }
+    case scene_item::LIGHT:
+    {
+      if (Key == "at") Ok = ParseTup(Value, 1.f, R.Item.At);
+      else if (Key == "intensity") Ok = ParseTup(Value, 0.f, R.Item.Intensity);
+      else return (SceneError(R, R.Line, "Unknown light key '" + std::string(Key) + "'."));
+      break;
+    }
+    case scene_item::SPHERE:
+    case scene_item::OBJ:
+    {
+      if (Key == "material")
+      {
+        auto const It = R.Materials.find(std::string(Value));
+        if (It == R.Materials.end()) return (SceneError(R, R.Line, "Unknown material '" + std::string(Value) + "'."));
+        R.Item.Material = It->second;
+      }
+      else if (Key == "file" && R.Item.Kind == scene_item::OBJ)
+      {
+        R.Item.File = Value;
+      }
+      else
+      {
+        return (SceneError(R, R.Line, "Unknown key '" + std::string(Key) + "'."));
+      }
+      break;
+    }
+    case scene_item::DEFINE:
+    {
+      // NOTE: A define extends a material or a transform defined before it.
+      if (Key != "extend") return (SceneError(R, R.Line, "Unknown define key '" + std::string(Key) + "'."));
+      std::string const Base(Value);
+      if (R.Materials.count(Base))
+      {
+        R.Item.Material = R.Materials[Base];
+        R.Item.Value = scene_value::MATERIAL;
+      }
+      else if (R.Transforms.count(Base))
+      {
+        R.Item.Transform = R.Transforms[Base];
+        R.Item.Value = scene_value::TRANSFORM;
+      }
+      else
+      {
+        return (SceneError(R, R.Line, "Unknown define '" + Base + "'."));
+      }
+      break;
+    }
+    case scene_item::NONE:
+      break;
+  }
 
-  return (Result);
+  if (!Ok) return (SceneError(R, R.Line, "Bad value for '" + std::string(Key) + "'."));
+  return (true);
 }
 
-matrix Translation(float X, float Y, float Z)
+//------------------------------------------------------------------------------
+// \fn ReadSceneBlockLine - A line of the open block: a transform of a list, or a key of a
+//                          material. The value of a define is either one.
+bool ReadSceneBlockLine(scene_reader &R, std::string_view const Text, bool const Item)
 {
-  matrix M{I()};
-  Set(M, 0, 3, X);
-  Set(M, 1, 3, Y);
-  Set(M, 2, 3, Z);
+  bool const Transform = R.Block == "transform" || (R.Block == "value" && R.Item.Value != scene_value::MATERIAL && Item);
+  if (Transform)
+  {
+    if (!Item) return (SceneError(R, R.Line, "Expected '- [ ... ]' or '- name' in the transform."));
+    if (R.Block == "value") R.Item.Value = scene_value::TRANSFORM;
+    return (ParseTransform(R, Trim(Text.substr(2))));
+  }
 
-  return (M);
+  std::string_view Key{};
+  std::string_view Value{};
+  if (Item || !SplitKey(Text, Key, Value)) return (SceneError(R, R.Line, "Expected 'key: value' in the material."));
+  if (R.Item.Value == scene_value::TRANSFORM) return (SceneError(R, R.Line, "A define holds a transform or a material."));
+  if (R.Block == "value") R.Item.Value = scene_value::MATERIAL;
+  return (ParseMaterialKey(R, Key, Value));
 }
 
 //------------------------------------------------------------------------------
-matrix Scaling(float X, float Y, float Z)
+// \fn ReadSceneLine - Read one line, from P up to End, which excludes the line break.
+bool ReadSceneLine(scene_reader &R, char const *P, char const *const End)
 {
-  matrix M{I()};
+  int Indent{};
+  while (P < End && *P == ' ')
+  {
+    ++P;
+    ++Indent;
+  }
+  if (P < End && *P == '\t') return (SceneError(R, R.Line, "Indent with spaces, not tabs."));
+
+  // NOTE: Comments run to the end of the line.
+  char const *E = P;
+  while (E < End && *E != '#') ++E;
+  std::string_view const Text = Trim(std::string_view(P, E - P));
+  if (Text.empty()) return (true);
+
+  bool const Item = Text.size() >= 2 && Text[0] == '-' && Text[1] == ' ';
+  std::string_view Key{};
+  std::string_view Value{};
+  if (Indent == 0)
+  {
+    // NOTE: A new item. The one before it is complete.
+    if (!Item || !SplitKey(Text.substr(2), Key, Value)) return (SceneError(R, R.Line, "Expected '- add:' or '- define:'."));
+    if (!FinishItem(R)) return (false);
+    R.Item.Line = R.Line;
+    if (Key == "add")
+    {
+      if (Value == "camera") R.Item.Kind = scene_item::CAMERA;
+      else if (Value == "light") R.Item.Kind = scene_item::LIGHT;
+      else if (Value == "sphere") R.Item.Kind = scene_item::SPHERE;
+      else if (Value == "obj") R.Item.Kind = scene_item::OBJ;
+      else return (SceneError(R, R.Line, "Can not add '" + std::string(Value) + "'."));
+    }
+    else if (Key == "define" && !Value.empty())
+    {
+      R.Item.Kind = scene_item::DEFINE;
+      R.Item.Name = Value;
+    }
+    else
+    {
+      return (SceneError(R, R.Line, "Expected '- add:' or '- define:'."));
+    }
+    return (true);
+  }
 
-  Set(M, 0, 0, X);
-  Set(M, 1, 1, Y);
-  Set(M, 2, 2, Z);
+  if (R.Item.Kind == scene_item::NONE) return (SceneError(R, R.Line, "Expected '- add:' or '- define:'."));
+  if (R.BlockIndent >= 0 && Indent > R.BlockIndent) return (ReadSceneBlockLine(R, Text, Item));
 
-  return (M);
+  R.BlockIndent = -1;
+  if (Item || !SplitKey(Text, Key, Value)) return (SceneError(R, R.Line, "Expected 'key: value'."));
+  return (ReadSceneKey(R, Indent, Key, Value));
 }
 
 //------------------------------------------------------------------------------
-matrix RotateX(float Alfa)
-{
-  matrix M{I()};
-  Set(M, 1, 1, std::cos(Alfa));
-  Set(M, 1, 2, -std::sin(Alfa));
-  Set(M, 2, 1, std::sin(Alfa));
-  Set(M, 2, 2, std::cos(Alfa));
+// NOTE: The scene cache is a header followed by sections of plain records, each section on
+//       a SCENE_CACHE_ALIGN boundary. Nothing in it needs parsing: the records are copied
+//       out of the mapped file, and the inverse transforms and the BVH are used as stored.
+//       The file is in the byte order of the machine that wrote it, and the header records
+//       the record sizes, so a cache from another build or machine is rejected, not misread.
+//------------------------------------------------------------------------------
+constexpr char SCENE_CACHE_MAGIC[8] = {'W', 'W', 'S', 'C', 'E', 'N', 'E', '\0'};
+constexpr uint32_t SCENE_CACHE_VERSION = 1;  //!< Bump on any change to the records below.
+constexpr size_t SCENE_CACHE_ALIGN = 64;
 
-  return (M);
-}
+//------------------------------------------------------------------------------
+// \struct cache_section - Where an array of records is in the file.
+struct cache_section
+{
+  uint64_t Offset{};
+  uint64_t Count{};
+};
 
 //------------------------------------------------------------------------------
-matrix RotateY(float Alfa)
+// \struct cache_object - An object, with its inverse transform. The transpose of the inverse
+//                        is cheap to recompute and is not stored.
+struct cache_object
 {
-  matrix M{I()};
-  Set(M, 0, 0, std::cos(Alfa));
-  Set(M, 0, 2, std::sin(Alfa));
-  Set(M, 2, 0, -std::sin(Alfa));
-  Set(M, 2, 2, std::cos(Alfa));
+  int32_t Kind{};
+  int32_t Mesh{-1};  //!< Index into the mesh section for a mesh.
+  float Radius{};
+  material Material{};
+  tup Center{};
+  matrix Matrix{};
+  matrix Inv{};
+};
 
-  return (M);
-}
+//------------------------------------------------------------------------------
+// \struct cache_mesh - A mesh_data, as ranges of the vertex, index, triangle, node and BVH
+//                      index sections that all the meshes share. The Offset of a range
+//                      counts records, not bytes.
+struct cache_mesh
+{
+  cache_section Vertices{};
+  cache_section Indices{};
+  cache_section Triangles{};
+  cache_section Nodes{};
+  cache_section BVHIndices{};
+  bounds Box{};
+};
 
 //------------------------------------------------------------------------------
-matrix RotateZ(float Alfa)
+// \struct cache_header - The start of the file.
+struct cache_header
 {
-  matrix M{I()};
-  Set(M, 0, 0, std::cos(Alfa));
-  Set(M, 0, 1, -std::sin(Alfa));
-  Set(M, 1, 0, std::sin(Alfa));
-  Set(M, 1, 1, std::cos(Alfa));
+  char Magic[8]{};
+  uint32_t Version{};
+  uint32_t HeaderBytes{};  //!< The sizes of the records, to catch a cache from another build.
+  uint32_t ObjectBytes{};
+  uint32_t MeshBytes{};
+  uint32_t NodeBytes{};
+  uint32_t TriangleBytes{};
+
+  int32_t HSize{};
+  int32_t VSize{};
+  float FieldOfView{};
+  float PixelSize{};
+  float HalfWidth{};
+  float HalfHeight{};
+  matrix CameraMatrix{};
+  matrix CameraInv{};
+
+  int32_t SoACount{};
+  int32_t SoAStride{};
+  int32_t SoABVHOrder{};
+
+  cache_section Objects{};
+  cache_section Lights{};
+  cache_section Nodes{};
+  cache_section Indices{};
+  cache_section SoAInv{};
+  cache_section SoAObject{};
+  cache_section Meshes{};
+  cache_section MeshVertices{};
+  cache_section MeshIndices{};
+  cache_section Triangles{};
+  cache_section MeshNodes{};
+  cache_section MeshBVHIndices{};
+};
 
-  return (M);
+//------------------------------------------------------------------------------
+// \fn CacheHeader - A header with the magic, the version and the record sizes filled in.
+cache_header CacheHeader()
+{
+  cache_header H{};
+  std::copy(SCENE_CACHE_MAGIC, SCENE_CACHE_MAGIC + 8, H.Magic);
+  H.Version = SCENE_CACHE_VERSION;
+  H.HeaderBytes = sizeof(cache_header);
+  H.ObjectBytes = sizeof(cache_object);
+  H.MeshBytes = sizeof(cache_mesh);
+  H.NodeBytes = sizeof(bvh_node);
+  H.TriangleBytes = sizeof(triangle);
+  return (H);
 }
 
 //------------------------------------------------------------------------------
-matrix Shearing(float Xy, float Xz, float Yx, float Yz, float Zx, float Zy)
+// \struct cache_writer - Appends sections to the file and remembers where they went.
+struct cache_writer
 {
-  matrix M{I()};
-  Set(M, 0, 1, Xy);
-  Set(M, 0, 2, Xz);
-  Set(M, 1, 0, Yx);
-  Set(M, 1, 2, Yz);
-  Set(M, 2, 0, Zx);
-  Set(M, 2, 1, Zy);
-  return (M);
-}
+  explicit cache_writer(std::string const &Filename)
+      : O(Filename, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc)
+  {
+  }
+
+  // NOTE: Align is false to continue the section written before.
+  template <typename T>
+  cache_section Write(T const *pData, size_t const Count, bool const Align = true)
+  {
+    static char const Zeros[SCENE_CACHE_ALIGN]{};
+    if (Align)
+    {
+      O.write(Zeros, (SCENE_CACHE_ALIGN - Offset % SCENE_CACHE_ALIGN) % SCENE_CACHE_ALIGN);
+      Offset = (Offset + SCENE_CACHE_ALIGN - 1) / SCENE_CACHE_ALIGN * SCENE_CACHE_ALIGN;
+    }
+
+    cache_section const Section{Offset, Count};
+    O.write(reinterpret_cast<char const *>(pData), Count * sizeof(T));
+    Offset += Count * sizeof(T);
+    return (Section);
+  }
+
+  template <typename T>
+  cache_section Write(std::vector<T> const &vData, bool const Align = true)
+  {
+    return (Write(vData.data(), vData.size(), Align));
+  }
+
+  std::ofstream O;
+  uint64_t Offset{};
+};
 
 //------------------------------------------------------------------------------
-matrix TranslateScaleRotate(                   //!<
-    float TransX, float TransY, float TransZ,  //!< Translation is in m(?)
-    float ScaleX, float ScaleY, float ScaleZ,  //!< Scale input is unitless.
-    float AlfaX, float AlfaY, float AlfaZ      //!< Input rotation in radians.
-)
+// \fn ReadSection - Copy Count records of Section, starting at record First, into vData.
+// \return False when they are not all inside the mapped file.
+template <typename T>
+bool ReadSection(mapped_file const &File, cache_section const &Section, std::vector<T> &vData, uint64_t const First = 0,
+                 uint64_t Count = ~uint64_t{})
 {
-  matrix const M = Translation(TransX, TransY, TransZ) *             //!<
-                   Scaling(ScaleX, ScaleY, ScaleZ) *                 //!<
-                   RotateX(AlfaX) * RotateY(AlfaY) * RotateZ(AlfaZ)  //!<
-      ;
+  if (Count == ~uint64_t{}) Count = Section.Count;
+  if (First > Section.Count || Count > Section.Count - First) return (false);
+  if (Section.Offset > File.Size || Section.Count > (File.Size - Section.Offset) / sizeof(T)) return (false);
 
-  return (M);
+  vData.resize(Count);
+  std::memcpy(static_cast<void *>(vData.data()), File.pData + Section.Offset + First * sizeof(T), Count * sizeof(T));
+  return (true);
 }
 
-/// ---
-/// \fn Sphere releated functions
-/// ---
 //------------------------------------------------------------------------------
-sphere Sphere(tup const &Center, float Radius)
+// \fn IsBVHInRange - True when the children and the leaves of BVH stay inside its arrays, and
+//                    every leaf entry is below Limit. Leaves must end at or before Slots, the
+//                    size of the array they are read from. A child must come after its parent,
+//                    as BuildBVHNode() lays them out, so the tree has no loops, and no inner
+//                    node may be deeper than the traversal stack holds. A cache that fails
+//                    this is corrupt.
+bool IsBVHInRange(bvh const &BVH, size_t const Limit, size_t const Slots)
 {
-  sphere S{};
-  S.Center = Center;
-  S.Radius = Radius;
-  return (S);
+  int const NumNodes = static_cast<int>(BVH.vNodes.size());
+  std::vector<int> vDepth(BVH.vNodes.size());
+  for (int Idx = 0;     ///<!
+       Idx < NumNodes;  ///<!
+       ++Idx)
+  {
+    bvh_node const &Node = BVH.vNodes[Idx];
+    if (Node.Count > 0)
+    {
+      if (Node.First < 0 || static_cast<size_t>(Node.First) + Node.Count > Slots) return (false);
+      continue;
+    }
+
+    // NOTE: The stack holds at most one sibling per level above a node, and two children are pushed.
+    if (Node.Left <= Idx || Node.Left >= NumNodes || Node.Right <= Idx || Node.Right >= NumNodes) return (false);
+    if (vDepth[Idx] + 2 > BVH_STACK_SIZE) return (false);
+    vDepth[Node.Left] = std::max(vDepth[Node.Left], vDepth[Idx] + 1);
+    vDepth[Node.Right] = std::max(vDepth[Node.Right], vDepth[Idx] + 1);
+  }
+  for (int const Index : BVH.vIndices)
+  {
+    if (Index < 0 || static_cast<size_t>(Index) >= Limit) return (false);
+  }
+  return (true);
 }
 
-/// ---
-/// Ray releated functions.
-/// ---
 //------------------------------------------------------------------------------
-ray Ray(tup const &O, tup const &D)
+// \struct task_deque - The task indices from Front up to Back that a worker of RunTasks()
+//                      has left. Both ends are packed into one word and moved with a compare
+//                      and swap: the owner takes from the front and thieves from the back.
+//                      No tasks are added once the workers run, other than the half a worker
+//                      steals into its own deque when that is empty. One per cache line, so
+//                      the owners do not slow each other down.
+struct alignas(64) task_deque
 {
-  Assert(IsPoint(O), __FUNCTION__, __LINE__);
-  Assert(IsVector(D), __FUNCTION__, __LINE__);
+  static uint64_t Pack(uint32_t const Front, uint32_t const Back) { return (uint64_t(Back) << 32 | Front); }
 
-  ray Result{};
-  Result.Origin = O;
-  Result.Direction = Normalize(D);
+  // \return The task, or -1 when the deque is empty.
+  int PopFront()
+  {
+    uint64_t Range = Tasks.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      uint32_t const Front = uint32_t(Range);
+      uint32_t const Back = uint32_t(Range >> 32);
+      if (Front >= Back) return (-1);
+      if (Tasks.compare_exchange_weak(Range, Pack(Front + 1, Back), std::memory_order_acq_rel)) return (int(Front));
+    }
+  }
 
-  return (Result);
-}
+  // \return The number of tasks taken from the back, at most half of them, rounded up.
+  //         They are the indices from First on.
+  int StealHalf(uint32_t &First)
+  {
+    uint64_t Range = Tasks.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      uint32_t const Front = uint32_t(Range);
+      uint32_t const Back = uint32_t(Range >> 32);
+      if (Front >= Back) return (0);
+      uint32_t const Count = (Back - Front + 1) / 2;
+      if (Tasks.compare_exchange_weak(Range, Pack(Front, Back - Count), std::memory_order_acq_rel))
+      {
+        First = Back - Count;
+        return (int(Count));
+      }
+    }
+  }
 
-//------------------------------------------------------------------------------
-int Count(intersections const &I) { return I.Count(); }
+  std::atomic<uint64_t> Tasks{};
+};
 
 //------------------------------------------------------------------------------
-tup PositionAt(ray const &R, float t)
+// \struct bvh_entry - An object while the BVH is being built.
+struct bvh_entry
 {
-  tup Result{};
-
-  Result = R.Origin + R.Direction * t;
-  Assert(IsPoint(Result), __FUNCTION__, __LINE__);
+  bounds Box{};
+  tup Centroid{};
+  int Index{};
+};
 
-  return (Result);
+//------------------------------------------------------------------------------
+// \fn IntersectBounds - Slab test of the ray against the box.
+// \return True when the ray overlaps the box between tMin and tMax. tNear is
+//         set to where the ray enters the box.
+bool IntersectBounds(bounds const &B, ray const &Ray, tup const &InvDir, float tMin, float tMax, float &tNear)
+{
+  for (int C = 0;  ///<!
+       C < 3;      ///<!
+       ++C)
+  {
+    float t0 = (B.Min.C[C] - Ray.Origin.C[C]) * InvDir.C[C];
+    float t1 = (B.Max.C[C] - Ray.Origin.C[C]) * InvDir.C[C];
+    if (t0 > t1) std::swap(t0, t1);
+
+    // NOTE: Widen the far side by the rounding error of the two operations above, so
+    //       that a flat box (a triangle in a plane) is not missed by a rounding.
+    t1 *= 1.f + 4.f * std::numeric_limits<float>::epsilon();
+
+    // NOTE: Written so that a NaN (0 * inf when the origin is on a slab) keeps the old value.
+    tMin = t0 > tMin ? t0 : tMin;
+    tMax = t1 < tMax ? t1 : tMax;
+    if (tMin > tMax) return (false);
+  }
+  tNear = tMin;
+  return (true);
 }
 
-// intersection Intersection(float t, object *Object);
-// intersections Intersections(intersection const &I1, intersection const &I2);
-// intersect Intersect(object *pObject, ray const &Ray);
 //------------------------------------------------------------------------------
-intersections IntersectSphere(sphere const &Sphere, ray const &Ray)
+// \fn TraverseBVHLeaves - Visit the leaves that the ray passes through, the nearest
+//                         nodes first.
+// \param tMax - Nodes further away than tMax are skipped. Visit may lower tMax through
+//               the reference it captures, to prune the rest of the traversal.
+// \param Visit - Called with the First entry in bvh::vIndices and the Count of a leaf.
+//                Returns true to stop.
+// \param Root - The node to start from, to finish the traversal of a packet ray alone.
+template <typename F>
+void TraverseBVHLeaves(bvh const &BVH, ray const &Ray, float const tMin, float const &tMax, F &&Visit,
+                       int const Root = 0)
 {
-  intersections Result{};
-  // NOTE: See explanation from:
-  // https://stackoverflow.com/questions/1073336/circle-line-segment-collision-detection-algorithm#1084899
-  //
-  // NOTE: The vector from the sphere's center to the ray origin
-  //       Remember that the sphere is centered at the world origin
-  tup const Sphere2Ray = Ray.Origin - Point(0.f, 0.f, 0.f);
-  // std::cout << "Sphere2Ray : " << Sphere2Ray << std::endl;
+  tup const InvDir{1.f / Ray.Direction.X, 1.f / Ray.Direction.Y, 1.f / Ray.Direction.Z, 0.f};
 
-  float const A = Dot(Ray.Direction, Ray.Direction);
-  float const B = 2 * Dot(Ray.Direction, Sphere2Ray);
-  float const C = Dot(Sphere2Ray, Sphere2Ray) - 1.f;
-  float const Discriminant = B * B - 4 * A * C;
-  // std::cout << "A:" << A << ". B:" << B << ". C:" << C << ". Discriminant:" << Discriminant << std::endl;
+  struct stack_entry
+  {
+    int Node;
+    float tNear;
+  };
+  stack_entry Stack[BVH_STACK_SIZE];
+  int Top{};
 
-  if (Discriminant >= 0)
+  float tNear{};
+  if (!IntersectBounds(BVH.vNodes[Root].Box, Ray, InvDir, tMin, tMax, tNear)) return;
+  Stack[Top++] = {Root, tNear};
+
+  while (Top > 0)
   {
-    float const t1 = (-B - std::sqrt(Discriminant)) / (2 * A);
-    float const t2 = (-B + std::sqrt(Discriminant)) / (2 * A);
-    intersection I{};
+    stack_entry const Entry = Stack[--Top];
 
-    if (t1 > t2)
+    // NOTE: The node may have been pushed before a closer hit was found.
+    if (Entry.tNear > tMax) continue;
+
+    bvh_node const &Node = BVH.vNodes[Entry.Node];
+    if (Node.Count > 0)
     {
-      I.t = t2;
-      Result.vI.push_back(I);
-      I.t = t1;
-      Result.vI.push_back(I);
+      if (Visit(Node.First, Node.Count)) return;
     }
     else
     {
-      I.t = t1;
-      Result.vI.push_back(I);
-      I.t = t2;
-      Result.vI.push_back(I);
+      float tLeft{};
+      float tRight{};
+      bool const HitLeft = IntersectBounds(BVH.vNodes[Node.Left].Box, Ray, InvDir, tMin, tMax, tLeft);
+      bool const HitRight = IntersectBounds(BVH.vNodes[Node.Right].Box, Ray, InvDir, tMin, tMax, tRight);
+
+      Assert(Top + 2 <= BVH_STACK_SIZE, __FUNCTION__, __LINE__);
+
+      // NOTE: Push the far child first so that the near child is visited first.
+      if (HitLeft && HitRight)
+      {
+        if (tLeft <= tRight)
+        {
+          Stack[Top++] = {Node.Right, tRight};
+          Stack[Top++] = {Node.Left, tLeft};
+        }
+        else
+        {
+          Stack[Top++] = {Node.Left, tLeft};
+          Stack[Top++] = {Node.Right, tRight};
+        }
+      }
+      else if (HitLeft)
+      {
+        Stack[Top++] = {Node.Left, tLeft};
+      }
+      else if (HitRight)
+      {
+        Stack[Top++] = {Node.Right, tRight};
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// \fn TraverseBVH - Same as TraverseBVHLeaves, but Visit is called with the index
+//                   of each object in the leaves.
+template <typename F>
+void TraverseBVH(bvh const &BVH, ray const &Ray, float const tMin, float const &tMax, F &&Visit)
+{
+  TraverseBVHLeaves(BVH, Ray, tMin, tMax, [&](int const First, int const Count) {
+    for (int Idx = First;      ///<!
+         Idx < First + Count;  ///<!
+         ++Idx)
+    {
+      if (Visit(BVH.vIndices[Idx])) return (true);
     }
+    return (false);
+  });
+}
+
+//------------------------------------------------------------------------------
+// \struct watertight_ray
+// \brief The ray set up for the watertight triangle test of Woop, Benthin and Wald,
+//        "Watertight Ray/Triangle Intersection", JCGT 2013. The triangle is moved into
+//        a space where the ray starts at the origin and points along +Z, so the hit
+//        is decided by the signs of three 2D edge functions. The edge functions of two
+//        triangles with a shared edge are computed the same way, which leaves no crack.
+// ---
+struct watertight_ray
+{
+  tup Origin{};
+  int KX{};
+  int KY{};
+  int KZ{};
+  float SX{};
+  float SY{};
+  float SZ{};
+};
+
+//------------------------------------------------------------------------------
+watertight_ray WatertightRay(ray const &Ray)
+{
+  watertight_ray W{};
+  W.Origin = Ray.Origin;
+
+  // NOTE: Z is the axis along which the direction is the longest.
+  tup const &D = Ray.Direction;
+  W.KZ = 0;
+  if (std::abs(D.Y) > std::abs(D.C[W.KZ])) W.KZ = 1;
+  if (std::abs(D.Z) > std::abs(D.C[W.KZ])) W.KZ = 2;
+  W.KX = (W.KZ + 1) % 3;
+  W.KY = (W.KX + 1) % 3;
+
+  // NOTE: Keep the winding of the triangles.
+  if (D.C[W.KZ] < 0.f) std::swap(W.KX, W.KY);
+
+  W.SX = D.C[W.KX] / D.C[W.KZ];
+  W.SY = D.C[W.KY] / D.C[W.KZ];
+  W.SZ = 1.f / D.C[W.KZ];
+  return (W);
+}
+
+//------------------------------------------------------------------------------
+bool IntersectTriangle(watertight_ray const &W, triangle const &Tri, float &t)
+{
+  COUNT_COST(Tests, 1);
+  float X[3];
+  float Y[3];
+  float Z[3];
+  for (int Corner = 0;  ///<!
+       Corner < 3;      ///<!
+       ++Corner)
+  {
+    float const PX = Tri.P[Corner][W.KX] - W.Origin.C[W.KX];
+    float const PY = Tri.P[Corner][W.KY] - W.Origin.C[W.KY];
+    Z[Corner] = Tri.P[Corner][W.KZ] - W.Origin.C[W.KZ];
+    X[Corner] = PX - W.SX * Z[Corner];
+    Y[Corner] = PY - W.SY * Z[Corner];
+  }
+
+  float U = X[2] * Y[1] - Y[2] * X[1];
+  float V = X[0] * Y[2] - Y[0] * X[2];
+  float E = X[1] * Y[0] - Y[1] * X[0];
+
+  // NOTE: On an edge, so the sign decides whether the neighbour or this triangle is hit.
+  //       Redo the edge functions in double precision, where they are exact.
+  if (U == 0.f || V == 0.f || E == 0.f)
+  {
+    U = static_cast<float>(double(X[2]) * double(Y[1]) - double(Y[2]) * double(X[1]));
+    V = static_cast<float>(double(X[0]) * double(Y[2]) - double(Y[0]) * double(X[2]));
+    E = static_cast<float>(double(X[1]) * double(Y[0]) - double(Y[1]) * double(X[0]));
   }
+
+  if ((U < 0.f || V < 0.f || E < 0.f) && (U > 0.f || V > 0.f || E > 0.f)) return (false);
+
+  float const Det = U + V + E;
+  if (Det == 0.f) return (false);
+
+  float const T = W.SZ * (U * Z[0] + V * Z[1] + E * Z[2]);
+  float const Result = T / Det;
+  if (!(Result > 0.f)) return (false);
+
+  t = Result;
+  return (true);
+}
+
+//------------------------------------------------------------------------------
+// \fn IntersectMesh - Closest hit with a positive t of the ray, in object space, with the
+//                     triangles of the mesh.
+intersect_return IntersectMesh(mesh const &Mesh, ray const &Ray)
+{
+  intersect_return Result{};
+  if (!Mesh.pData || Mesh.pData->vTriangles.empty()) return (Result);
+
+  mesh_data const &Data = *Mesh.pData;
+  watertight_ray const W = WatertightRay(Ray);
+  float tClosest = std::numeric_limits<float>::max();
+  TraverseBVHLeaves(Data.BVH, Ray, 0.f, tClosest, [&](int const First, int const Count) {
+    for (int Idx = First;      ///<!
+         Idx < First + Count;  ///<!
+         ++Idx)
+    {
+      float t{};
+      if (IntersectTriangle(W, Data.vTriangles[Idx], t) && t < tClosest)
+      {
+        tClosest = t;
+        Result.Count = 1;
+        Result.t[0] = t;
+        Result.Primitive[0] = Idx;
+      }
+    }
+    return (false);
+  });
   return (Result);
 }
 
 //------------------------------------------------------------------------------
-intersections Intersect(shared_ptr_object PtrSphere, ray const &RayIn)
+// \fn IsCloser - True when a hit at t on object Index is closer than the hit in Best,
+//                which is tClosest away. Equal t go to the lower index, so the closest
+//                hit does not depend on the order that the objects are visited in.
+inline bool IsCloser(float const t, int const Index, float const tClosest, world_hit const &Best)
 {
-  intersections Result{};
+  return (t > 0 && (t < tClosest || (t == tClosest && Index < Best.Index)));
+}
 
-  // NOTE: For now; let us set up a reference to a sphere
-  sphere &Sphere = *(dynamic_cast<sphere *>(PtrSphere.get()));
-  // ---
-  // NOTE: The object to which we are trying to calculate the intersect may
-  //       kind of not be placed at origin. So use its transform to 'move' the
-  //       ray by calculation of the inverse.
-  // ---
-  ray const Ray = Transform(RayIn, Inverse(Sphere.Transform));
+//------------------------------------------------------------------------------
+// \fn IntersectUnitSphere - The t values where the ray, in object space, hits the
+//                           unit sphere at the origin.
+intersect_return IntersectUnitSphere(ray const &Ray)
+{
+  COUNT_COST(Tests, 1);
+  intersect_return Result{};
 
   // ---
   // NOTE: See explanation from:
@@ -943,607 +1741,4004 @@ intersections Intersect(shared_ptr_object PtrSphere, ray const &RayIn)
   // NOTE: The vector from the sphere's center to the ray origin
   //       Remember that the sphere is centered at the world origin
   tup const Object2Ray = Ray.Origin - Point(0.f, 0.f, 0.f);
-  // std::cout << "Sphere2Ray : " << Sphere2Ray << std::endl;
 
   float const A = Dot(Ray.Direction, Ray.Direction);
   float const B = 2 * Dot(Ray.Direction, Object2Ray);
   float const C = Dot(Object2Ray, Object2Ray) - 1.f;
   float const Discriminant = B * B - 4 * A * C;
-  // std::cout << "A:" << A << ". B:" << B << ". C:" << C << ". Discriminant:" << Discriminant << std::endl;
 
   if (Discriminant >= 0)
   {
     float const t1 = (-B - std::sqrt(Discriminant)) / (2 * A);
     float const t2 = (-B + std::sqrt(Discriminant)) / (2 * A);
-    intersection I{};
 
-    // NOTE: take a copy of the object for future reference.
-    I.pObject = PtrSphere;
+    Result.Count = 2;
+    Result.t[0] = std::min<float>(t1, t2);
+    Result.t[1] = std::max<float>(t1, t2);
+  }
+  return (Result);
+}
 
-    if (t1 > t2)
+//------------------------------------------------------------------------------
+// NOTE: The sphere kernels below do the same operations, in the same order, as
+//       IntersectObject: transform the ray by the inverse, then solve the quadratic.
+//       So the t values are bit equal to those of IntersectObject at every SIMD level.
+//       The Spheres kernels test one ray against up to 8 spheres from First, and the
+//       Packet kernels test up to 8 rays of a packet from Lane against one sphere.
+//       Both fill t0 and t1 and return a bit mask of the hits.
+constexpr int SPHERE_CHUNK = 8;
+
+//------------------------------------------------------------------------------
+// \fn SolveScalar - Solve the quadratic for the ray O, D in object space. O is
+//                   already relative to the center of the sphere.
+inline bool SolveScalar(tup const &O, tup const &D, float &t0, float &t1)
+{
+  float const A = D.X * D.X + D.Y * D.Y + D.Z * D.Z + D.W * D.W;
+  float const B = 2 * (D.X * O.X + D.Y * O.Y + D.Z * O.Z + D.W * O.W);
+  float const C = (O.X * O.X + O.Y * O.Y + O.Z * O.Z + O.W * O.W) - 1.f;
+  float const Discriminant = B * B - 4 * A * C;
+  if (Discriminant < 0) return (false);
+
+  float const tA = (-B - std::sqrt(Discriminant)) / (2 * A);
+  float const tB = (-B + std::sqrt(Discriminant)) / (2 * A);
+  t0 = std::min<float>(tA, tB);
+  t1 = std::max<float>(tA, tB);
+  return (true);
+}
+
+//------------------------------------------------------------------------------
+// \fn TransformScalar - Row Row of the inverse of sphere Slot times T.
+inline float TransformScalar(sphere_soa const &S, int const Slot, int const Row, float const *T)
+{
+  return (S.Inv(Row, 0)[Slot] * T[0] +  //!<
+          S.Inv(Row, 1)[Slot] * T[1] +  //!<
+          S.Inv(Row, 2)[Slot] * T[2] +  //!<
+          S.Inv(Row, 3)[Slot] * T[3]);
+}
+
+//------------------------------------------------------------------------------
+int IntersectSpheresScalar(sphere_soa const &S, ray const &Ray, int const First, int const Count, float *t0,
+                           float *t1)
+{
+  int Mask{};
+  for (int Lane = 0;  ///<!
+       Lane < Count;  ///<!
+       ++Lane)
+  {
+    tup O{};
+    tup D{};
+    for (int Row = 0;  ///<!
+         Row < 4;      ///<!
+         ++Row)
     {
-      I.t = t2;
-      Result.vI.push_back(I);
-      I.t = t1;
-      Result.vI.push_back(I);
+      O.C[Row] = TransformScalar(S, First + Lane, Row, Ray.Origin.C);
+      D.C[Row] = TransformScalar(S, First + Lane, Row, Ray.Direction.C);
     }
-    else
+    O.W -= 1.f;
+    if (SolveScalar(O, D, t0[Lane], t1[Lane])) Mask |= 1 << Lane;
+  }
+  return (Mask);
+}
+
+//------------------------------------------------------------------------------
+int IntersectPacketScalar(sphere_soa const &S, int const Slot, ray_packet const &P, int const Lane, int const Count,
+                          float *t0, float *t1)
+{
+  int Mask{};
+  for (int N = 0;  ///<!
+       N < Count;  ///<!
+       ++N)
+  {
+    float const Origin[4] = {P.Origin[0][Lane + N], P.Origin[1][Lane + N], P.Origin[2][Lane + N],
+                             P.Origin[3][Lane + N]};
+    float const Direction[4] = {P.Direction[0][Lane + N], P.Direction[1][Lane + N], P.Direction[2][Lane + N],
+                                P.Direction[3][Lane + N]};
+    tup O{};
+    tup D{};
+    for (int Row = 0;  ///<!
+         Row < 4;      ///<!
+         ++Row)
     {
-      I.t = t1;
-      Result.vI.push_back(I);
-      I.t = t2;
-      Result.vI.push_back(I);
+      O.C[Row] = TransformScalar(S, Slot, Row, Origin);
+      D.C[Row] = TransformScalar(S, Slot, Row, Direction);
+    }
+    O.W -= 1.f;
+    if (SolveScalar(O, D, t0[N], t1[N])) Mask |= 1 << N;
+  }
+  return (Mask);
+}
+
+#if WW_SIMD_SSE
+//------------------------------------------------------------------------------
+// NOTE: Same as SolveScalar for four rays. O[3] is already relative to the center.
+inline int SolveSSE(__m128 const *O, __m128 const *D, float *t0, float *t1)
+{
+  auto Dot = [](__m128 const *A, __m128 const *B) {
+    __m128 V = _mm_mul_ps(A[0], B[0]);
+    V = _mm_add_ps(V, _mm_mul_ps(A[1], B[1]));
+    V = _mm_add_ps(V, _mm_mul_ps(A[2], B[2]));
+    V = _mm_add_ps(V, _mm_mul_ps(A[3], B[3]));
+    return (V);
+  };
+
+  __m128 const A = Dot(D, D);
+  __m128 const B = _mm_mul_ps(_mm_set1_ps(2.f), Dot(D, O));
+  __m128 const C = _mm_sub_ps(Dot(O, O), _mm_set1_ps(1.f));
+  __m128 const Discriminant = _mm_sub_ps(_mm_mul_ps(B, B), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4.f), A), C));
+  int const Mask = _mm_movemask_ps(_mm_cmpge_ps(Discriminant, _mm_setzero_ps()));
+  if (!Mask) return (Mask);
+
+  __m128 const NegB = _mm_xor_ps(B, _mm_set1_ps(-0.f));
+  __m128 const Root = _mm_sqrt_ps(Discriminant);
+  __m128 const TwoA = _mm_mul_ps(_mm_set1_ps(2.f), A);
+  __m128 const tA = _mm_div_ps(_mm_sub_ps(NegB, Root), TwoA);
+  __m128 const tB = _mm_div_ps(_mm_add_ps(NegB, Root), TwoA);
+
+  // NOTE: Argument order as std::min and std::max, which return the first argument when equal.
+  _mm_storeu_ps(t0, _mm_min_ps(tB, tA));
+  _mm_storeu_ps(t1, _mm_max_ps(tB, tA));
+  return (Mask);
+}
+
+//------------------------------------------------------------------------------
+// NOTE: Four spheres. Lanes past the last sphere read the padding and are masked by the caller.
+inline int IntersectSpheresSSE(sphere_soa const &S, ray const &Ray, int const First, float *t0, float *t1)
+{
+  auto Row = [&](int const R, tup const &T) {
+    __m128 V = _mm_mul_ps(_mm_loadu_ps(S.Inv(R, 0) + First), _mm_set1_ps(T.C[0]));
+    V = _mm_add_ps(V, _mm_mul_ps(_mm_loadu_ps(S.Inv(R, 1) + First), _mm_set1_ps(T.C[1])));
+    V = _mm_add_ps(V, _mm_mul_ps(_mm_loadu_ps(S.Inv(R, 2) + First), _mm_set1_ps(T.C[2])));
+    V = _mm_add_ps(V, _mm_mul_ps(_mm_loadu_ps(S.Inv(R, 3) + First), _mm_set1_ps(T.C[3])));
+    return (V);
+  };
+
+  __m128 const O[4] = {Row(0, Ray.Origin), Row(1, Ray.Origin), Row(2, Ray.Origin),
+                       _mm_sub_ps(Row(3, Ray.Origin), _mm_set1_ps(1.f))};
+  __m128 const D[4] = {Row(0, Ray.Direction), Row(1, Ray.Direction), Row(2, Ray.Direction), Row(3, Ray.Direction)};
+  return (SolveSSE(O, D, t0, t1));
+}
+
+//------------------------------------------------------------------------------
+// NOTE: Four rays of the packet. The packet is padded, so reading past Count is safe.
+inline int IntersectPacketSSE(sphere_soa const &S, int const Slot, ray_packet const &P, int const Lane, float *t0,
+                              float *t1)
+{
+  auto Row = [&](int const R, float const (*T)[ray_packet::MAX_RAYS]) {
+    __m128 V = _mm_mul_ps(_mm_set1_ps(S.Inv(R, 0)[Slot]), _mm_load_ps(T[0] + Lane));
+    V = _mm_add_ps(V, _mm_mul_ps(_mm_set1_ps(S.Inv(R, 1)[Slot]), _mm_load_ps(T[1] + Lane)));
+    V = _mm_add_ps(V, _mm_mul_ps(_mm_set1_ps(S.Inv(R, 2)[Slot]), _mm_load_ps(T[2] + Lane)));
+    V = _mm_add_ps(V, _mm_mul_ps(_mm_set1_ps(S.Inv(R, 3)[Slot]), _mm_load_ps(T[3] + Lane)));
+    return (V);
+  };
+
+  __m128 const O[4] = {Row(0, P.Origin), Row(1, P.Origin), Row(2, P.Origin),
+                       _mm_sub_ps(Row(3, P.Origin), _mm_set1_ps(1.f))};
+  __m128 const D[4] = {Row(0, P.Direction), Row(1, P.Direction), Row(2, P.Direction), Row(3, P.Direction)};
+  return (SolveSSE(O, D, t0, t1));
+}
+#endif
+
+#if WW_SIMD_AVX
+//------------------------------------------------------------------------------
+// NOTE: Same as SolveSSE, for eight rays.
+__attribute__((target("avx"))) inline int SolveAVX(__m256 const *O, __m256 const *D, float *t0, float *t1)
+{
+  __m256 DD = _mm256_mul_ps(D[0], D[0]);
+  __m256 DO = _mm256_mul_ps(D[0], O[0]);
+  __m256 OO = _mm256_mul_ps(O[0], O[0]);
+  for (int R = 1;  ///<!
+       R < 4;      ///<!
+       ++R)
+  {
+    DD = _mm256_add_ps(DD, _mm256_mul_ps(D[R], D[R]));
+    DO = _mm256_add_ps(DO, _mm256_mul_ps(D[R], O[R]));
+    OO = _mm256_add_ps(OO, _mm256_mul_ps(O[R], O[R]));
+  }
+
+  __m256 const A = DD;
+  __m256 const B = _mm256_mul_ps(_mm256_set1_ps(2.f), DO);
+  __m256 const C = _mm256_sub_ps(OO, _mm256_set1_ps(1.f));
+  __m256 const Discriminant =
+      _mm256_sub_ps(_mm256_mul_ps(B, B), _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(4.f), A), C));
+  int const Mask = _mm256_movemask_ps(_mm256_cmp_ps(Discriminant, _mm256_setzero_ps(), _CMP_GE_OQ));
+  if (!Mask) return (Mask);
+
+  __m256 const NegB = _mm256_xor_ps(B, _mm256_set1_ps(-0.f));
+  __m256 const Root = _mm256_sqrt_ps(Discriminant);
+  __m256 const TwoA = _mm256_mul_ps(_mm256_set1_ps(2.f), A);
+  __m256 const tA = _mm256_div_ps(_mm256_sub_ps(NegB, Root), TwoA);
+  __m256 const tB = _mm256_div_ps(_mm256_add_ps(NegB, Root), TwoA);
+  _mm256_storeu_ps(t0, _mm256_min_ps(tB, tA));
+  _mm256_storeu_ps(t1, _mm256_max_ps(tB, tA));
+  return (Mask);
+}
+
+//------------------------------------------------------------------------------
+// NOTE: Same as IntersectSpheresSSE, for eight spheres.
+__attribute__((target("avx"))) int IntersectSpheresAVX(sphere_soa const &S, ray const &Ray, int const First,
+                                                       float *t0, float *t1)
+{
+  __m256 O[4];
+  __m256 D[4];
+  for (int R = 0;  ///<!
+       R < 4;      ///<!
+       ++R)
+  {
+    __m256 const M0 = _mm256_loadu_ps(S.Inv(R, 0) + First);
+    __m256 const M1 = _mm256_loadu_ps(S.Inv(R, 1) + First);
+    __m256 const M2 = _mm256_loadu_ps(S.Inv(R, 2) + First);
+    __m256 const M3 = _mm256_loadu_ps(S.Inv(R, 3) + First);
+    O[R] = _mm256_mul_ps(M0, _mm256_set1_ps(Ray.Origin.C[0]));
+    O[R] = _mm256_add_ps(O[R], _mm256_mul_ps(M1, _mm256_set1_ps(Ray.Origin.C[1])));
+    O[R] = _mm256_add_ps(O[R], _mm256_mul_ps(M2, _mm256_set1_ps(Ray.Origin.C[2])));
+    O[R] = _mm256_add_ps(O[R], _mm256_mul_ps(M3, _mm256_set1_ps(Ray.Origin.C[3])));
+    D[R] = _mm256_mul_ps(M0, _mm256_set1_ps(Ray.Direction.C[0]));
+    D[R] = _mm256_add_ps(D[R], _mm256_mul_ps(M1, _mm256_set1_ps(Ray.Direction.C[1])));
+    D[R] = _mm256_add_ps(D[R], _mm256_mul_ps(M2, _mm256_set1_ps(Ray.Direction.C[2])));
+    D[R] = _mm256_add_ps(D[R], _mm256_mul_ps(M3, _mm256_set1_ps(Ray.Direction.C[3])));
+  }
+  O[3] = _mm256_sub_ps(O[3], _mm256_set1_ps(1.f));
+  return (SolveAVX(O, D, t0, t1));
+}
+
+//------------------------------------------------------------------------------
+// NOTE: Same as IntersectPacketSSE, for eight rays.
+__attribute__((target("avx"))) int IntersectPacketAVX(sphere_soa const &S, int const Slot, ray_packet const &P,
+                                                      int const Lane, float *t0, float *t1)
+{
+  __m256 O[4];
+  __m256 D[4];
+  for (int R = 0;  ///<!
+       R < 4;      ///<!
+       ++R)
+  {
+    __m256 const M0 = _mm256_set1_ps(S.Inv(R, 0)[Slot]);
+    __m256 const M1 = _mm256_set1_ps(S.Inv(R, 1)[Slot]);
+    __m256 const M2 = _mm256_set1_ps(S.Inv(R, 2)[Slot]);
+    __m256 const M3 = _mm256_set1_ps(S.Inv(R, 3)[Slot]);
+    O[R] = _mm256_mul_ps(M0, _mm256_load_ps(P.Origin[0] + Lane));
+    O[R] = _mm256_add_ps(O[R], _mm256_mul_ps(M1, _mm256_load_ps(P.Origin[1] + Lane)));
+    O[R] = _mm256_add_ps(O[R], _mm256_mul_ps(M2, _mm256_load_ps(P.Origin[2] + Lane)));
+    O[R] = _mm256_add_ps(O[R], _mm256_mul_ps(M3, _mm256_load_ps(P.Origin[3] + Lane)));
+    D[R] = _mm256_mul_ps(M0, _mm256_load_ps(P.Direction[0] + Lane));
+    D[R] = _mm256_add_ps(D[R], _mm256_mul_ps(M1, _mm256_load_ps(P.Direction[1] + Lane)));
+    D[R] = _mm256_add_ps(D[R], _mm256_mul_ps(M2, _mm256_load_ps(P.Direction[2] + Lane)));
+    D[R] = _mm256_add_ps(D[R], _mm256_mul_ps(M3, _mm256_load_ps(P.Direction[3] + Lane)));
+  }
+  O[3] = _mm256_sub_ps(O[3], _mm256_set1_ps(1.f));
+  return (SolveAVX(O, D, t0, t1));
+}
+#endif
+
+//------------------------------------------------------------------------------
+// \fn IntersectSpheres - Intersect the ray with Count, at most SPHERE_CHUNK, spheres
+//                        from First. The kernel follows Level.
+// \return Bit mask of the spheres that are hit. Their t values are in t0 and t1.
+int IntersectSpheres(simd const Level, sphere_soa const &S, ray const &Ray, int const First, int const Count,
+                     float *t0, float *t1)
+{
+  COUNT_COST(Tests, Count);
+  int const LaneMask = (1 << Count) - 1;
+#if WW_SIMD_AVX
+  if (Count > 4 && Level == simd::AVX)
+  {
+    return (IntersectSpheresAVX(S, Ray, First, t0, t1) & LaneMask);
+  }
+#endif
+#if WW_SIMD_SSE
+  if (Level != simd::SCALAR)
+  {
+    int Mask = IntersectSpheresSSE(S, Ray, First, t0, t1);
+    if (Count > 4) Mask |= IntersectSpheresSSE(S, Ray, First + 4, t0 + 4, t1 + 4) << 4;
+    return (Mask & LaneMask);
+  }
+#endif
+  return (IntersectSpheresScalar(S, Ray, First, Count, t0, t1));
+}
+
+//------------------------------------------------------------------------------
+// \fn IntersectPacket - Intersect Count, at most SPHERE_CHUNK, rays of the packet from
+//                       Lane with sphere Slot. The kernel follows Level.
+// \return Bit mask of the rays that hit. Their t values are in t0 and t1.
+int IntersectPacket(simd const Level, sphere_soa const &S, int const Slot, ray_packet const &P, int const Lane,
+                    int const Count, float *t0, float *t1)
+{
+  int const LaneMask = (1 << Count) - 1;
+#if WW_SIMD_AVX
+  if (Count > 4 && Level == simd::AVX)
+  {
+    return (IntersectPacketAVX(S, Slot, P, Lane, t0, t1) & LaneMask);
+  }
+#endif
+#if WW_SIMD_SSE
+  if (Level != simd::SCALAR)
+  {
+    int Mask = IntersectPacketSSE(S, Slot, P, Lane, t0, t1);
+    if (Count > 4) Mask |= IntersectPacketSSE(S, Slot, P, Lane + 4, t0 + 4, t1 + 4) << 4;
+    return (Mask & LaneMask);
+  }
+#endif
+  return (IntersectPacketScalar(S, Slot, P, Lane, Count, t0, t1));
+}
+
+//------------------------------------------------------------------------------
+// \fn VisitSphereHits - Call Hit(Slot, t) for the spheres from First to First + Count
+//                       that the ray hits, in order, with the smaller t first.
+//                       Hit returns true to stop.
+// \return True when Hit stopped the visit.
+template <typename F>
+bool VisitSphereHits(simd const Level, sphere_soa const &S, ray const &Ray, int const First, int const Count, F &&Hit)
+{
+  float t0[SPHERE_CHUNK];
+  float t1[SPHERE_CHUNK];
+  for (int Chunk = First;      ///<!
+       Chunk < First + Count;  ///<!
+       Chunk += SPHERE_CHUNK)
+  {
+    int const N = std::min<int>(SPHERE_CHUNK, First + Count - Chunk);
+    int const Mask = IntersectSpheres(Level, S, Ray, Chunk, N, t0, t1);
+    for (int Lane = 0;  ///<!
+         Lane < N;      ///<!
+         ++Lane)
+    {
+      if (!(Mask & (1 << Lane))) continue;
+      if (Hit(Chunk + Lane, t0[Lane]) || Hit(Chunk + Lane, t1[Lane])) return (true);
+    }
+  }
+  return (false);
+}
+
+//------------------------------------------------------------------------------
+// \fn VisitPacketHits - Call Hit(Lane, Slot, t) for the rays in Active that hit sphere
+//                       Slot, with the smaller t first.
+template <typename F>
+void VisitPacketHits(simd const Level, sphere_soa const &S, int const Slot, ray_packet const &P, int const Active,
+                     F &&Hit)
+{
+  float t0[SPHERE_CHUNK];
+  float t1[SPHERE_CHUNK];
+  for (int Chunk = 0;    ///<!
+       Chunk < P.Count;  ///<!
+       Chunk += SPHERE_CHUNK)
+  {
+    int const ChunkActive = (Active >> Chunk) & ((1 << SPHERE_CHUNK) - 1);
+    if (!ChunkActive) continue;
+
+    int const N = std::min<int>(SPHERE_CHUNK, P.Count - Chunk);
+    int const Mask = IntersectPacket(Level, S, Slot, P, Chunk, N, t0, t1) & ChunkActive;
+    for (int Lane = 0;  ///<!
+         Lane < N;      ///<!
+         ++Lane)
+    {
+      if (!(Mask & (1 << Lane))) continue;
+      Hit(Chunk + Lane, Slot, t0[Lane]);
+      Hit(Chunk + Lane, Slot, t1[Lane]);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// \fn BuildBVHNode - Build the node for the entries from First to First + Count.
+// \return Index of the node in BVH.vNodes.
+int BuildBVHNode(bvh &BVH, std::vector<bvh_entry> &vEntries, int const First, int const Count, int const Depth)
+{
+  int const NodeIdx = static_cast<int>(BVH.vNodes.size());
+  BVH.vNodes.push_back(bvh_node{});
+
+  bounds Box{};
+  bounds CentroidBox{};
+  for (int Idx = First;      ///<!
+       Idx < First + Count;  ///<!
+       ++Idx)
+  {
+    Box = Merge(Box, vEntries[Idx].Box);
+    bounds const C{vEntries[Idx].Centroid, vEntries[Idx].Centroid};
+    CentroidBox = Merge(CentroidBox, C);
+  }
+  BVH.vNodes[NodeIdx].Box = Box;
+
+  auto MakeLeaf = [&]() {
+    BVH.vNodes[NodeIdx].First = First;
+    BVH.vNodes[NodeIdx].Count = Count;
+    return (NodeIdx);
+  };
+
+  if (Count == 1) return MakeLeaf();
+
+  // NOTE: Split along the axis where the centroids are spread the most.
+  tup const Extent = CentroidBox.Max - CentroidBox.Min;
+  int Axis = 0;
+  if (Extent.Y > Extent.C[Axis]) Axis = 1;
+  if (Extent.Z > Extent.C[Axis]) Axis = 2;
+
+  // NOTE: All centroids are in the same spot, so there is nothing to split.
+  if (Extent.C[Axis] <= 0.f) return MakeLeaf();
+
+  float const AxisMin = CentroidBox.Min.C[Axis];
+  float const Scale = BVH_BIN_COUNT / Extent.C[Axis];
+  auto BinOf = [&](bvh_entry const &E) {
+    int const Bin = static_cast<int>((E.Centroid.C[Axis] - AxisMin) * Scale);
+    return (std::min<int>(Bin, BVH_BIN_COUNT - 1));
+  };
+
+  int SplitBin{};
+  if (Depth < BVH_MAX_SAH_DEPTH)
+  {
+    // NOTE: Binned surface area heuristic. Sort the centroids into bins and find the
+    //       bin boundary where the cost of the two children is the lowest.
+    bounds BinBox[BVH_BIN_COUNT]{};
+    int BinCount[BVH_BIN_COUNT]{};
+    for (int Idx = First;      ///<!
+         Idx < First + Count;  ///<!
+         ++Idx)
+    {
+      int const Bin = BinOf(vEntries[Idx]);
+      BinBox[Bin] = Merge(BinBox[Bin], vEntries[Idx].Box);
+      BinCount[Bin]++;
+    }
+
+    float AreaLeft[BVH_BIN_COUNT]{};
+    int CountLeft[BVH_BIN_COUNT]{};
+    bounds Acc{};
+    int N{};
+    for (int Bin = 0;              ///<!
+         Bin < BVH_BIN_COUNT - 1;  ///<!
+         ++Bin)
+    {
+      Acc = Merge(Acc, BinBox[Bin]);
+      N += BinCount[Bin];
+      AreaLeft[Bin] = SurfaceArea(Acc);
+      CountLeft[Bin] = N;
+    }
+
+    float BestCost = std::numeric_limits<float>::max();
+    Acc = bounds{};
+    N = 0;
+    for (int Bin = BVH_BIN_COUNT - 1;  ///<!
+         Bin > 0;                      ///<!
+         --Bin)
+    {
+      Acc = Merge(Acc, BinBox[Bin]);
+      N += BinCount[Bin];
+      if (N == 0 || CountLeft[Bin - 1] == 0) continue;
+      float const Cost = AreaLeft[Bin - 1] * CountLeft[Bin - 1] + SurfaceArea(Acc) * N;
+      if (Cost < BestCost)
+      {
+        BestCost = Cost;
+        SplitBin = Bin;
+      }
+    }
+
+    float const Area = SurfaceArea(Box);
+    float const SplitCost =
+        BVH_TRAVERSAL_COST + BVH_INTERSECT_COST * (Area > 0.f ? BestCost / Area : static_cast<float>(Count));
+    float const LeafCost = BVH_INTERSECT_COST * Count;
+    if (Count <= BVH_MAX_LEAF_SIZE && LeafCost <= SplitCost) return MakeLeaf();
+  }
+
+  int Mid{};
+  if (SplitBin > 0)
+  {
+    auto const It = std::partition(vEntries.begin() + First, vEntries.begin() + First + Count,
+                                   [&](bvh_entry const &E) { return BinOf(E) < SplitBin; });
+    Mid = static_cast<int>(It - vEntries.begin());
+  }
+  else
+  {
+    // NOTE: Median split along the axis.
+    Mid = First + Count / 2;
+    std::nth_element(vEntries.begin() + First, vEntries.begin() + Mid, vEntries.begin() + First + Count,
+                     [&](bvh_entry const &A, bvh_entry const &B) { return A.Centroid.C[Axis] < B.Centroid.C[Axis]; });
+  }
+
+  int const Left = BuildBVHNode(BVH, vEntries, First, Mid - First, Depth + 1);
+  int const Right = BuildBVHNode(BVH, vEntries, Mid, First + Count - Mid, Depth + 1);
+  BVH.vNodes[NodeIdx].Left = Left;
+  BVH.vNodes[NodeIdx].Right = Right;
+
+  return (NodeIdx);
+}
+
+//------------------------------------------------------------------------------
+// \fn BuildBVHFromEntries - Build BVH over the entries, which are reordered into the
+//                           leaf order. bvh::vIndices gets the Index of every entry.
+void BuildBVHFromEntries(bvh &BVH, std::vector<bvh_entry> &vEntries)
+{
+  auto const Start = std::chrono::steady_clock::now();
+
+  BVH.vNodes.clear();
+  BVH.vIndices.clear();
+
+  if (!vEntries.empty())
+  {
+    // NOTE: A binary tree has at most 2N-1 nodes.
+    BVH.vNodes.reserve(2 * vEntries.size() - 1);
+    BuildBVHNode(BVH, vEntries, 0, static_cast<int>(vEntries.size()), 0);
+  }
+
+  BVH.vIndices.reserve(vEntries.size());
+  for (auto const &E : vEntries)
+  {
+    BVH.vIndices.push_back(E.Index);
+  }
+
+  std::chrono::duration<double> const Elapsed = std::chrono::steady_clock::now() - Start;
+  BVH.BuildSeconds = Elapsed.count();
+}
+
+//------------------------------------------------------------------------------
+// \fn Contrast - The largest difference between the color channels of A and B.
+float Contrast(tup const &A, tup const &B)
+{
+  return (std::max<float>(std::abs(A.R - B.R), std::max<float>(std::abs(A.G - B.G), std::abs(A.B - B.B))));
+}
+
+//------------------------------------------------------------------------------
+// \fn SampleArea - The average color of the square of Size x Size pixels centered at X, Y.
+// \brief Traces one ray through the center of each quarter of the square. When the four
+//        colors differ more than the threshold, and Depth is below the cap, each quarter
+//        is sampled the same way instead. Rays counts the rays traced.
+tup SampleArea(world const &World, ray_generator const &G, antialias const &Settings, float const X, float const Y,
+               float const Size, int const Depth, long long &Rays)
+{
+  float const Offset = 0.25f * Size;
+  float const QX[4] = {X - Offset, X + Offset, X - Offset, X + Offset};
+  float const QY[4] = {Y - Offset, Y - Offset, Y + Offset, Y + Offset};
+
+  tup Colors[4];
+  for (int Q = 0;  ///<!
+       Q < 4;      ///<!
+       ++Q)
+  {
+    Colors[Q] = ColorAt(World, RayForSample(G, QX[Q], QY[Q]));
+  }
+  Rays += 4;
+
+  float MaxContrast{};
+  for (int Q = 1;  ///<!
+       Q < 4;      ///<!
+       ++Q)
+  {
+    MaxContrast = std::max<float>(MaxContrast, Contrast(Colors[0], Colors[Q]));
+  }
+
+  if (Depth < Settings.MaxDepth && MaxContrast > Settings.Threshold)
+  {
+    for (int Q = 0;  ///<!
+         Q < 4;      ///<!
+         ++Q)
+    {
+      Colors[Q] = SampleArea(World, G, Settings, QX[Q], QY[Q], 0.5f * Size, Depth + 1, Rays);
     }
   }
+
+  tup const Result = (Colors[0] + Colors[1] + Colors[2] + Colors[3]) * 0.25f;
   return (Result);
 }
+};  // namespace
 
 //------------------------------------------------------------------------------
-intersection Intersection(float t, shared_ptr_object pObject)
+simd SIMDSupported()
 {
-  intersection Result{};
-  Result.t = t;
-  Result.pObject = pObject;
+#if WW_SIMD_AVX
+  if (__builtin_cpu_supports("avx")) return (simd::AVX);
+#endif
+#if WW_SIMD_SSE
+  return (simd::SSE);
+#else
+  return (simd::SCALAR);
+#endif
+}
 
+//------------------------------------------------------------------------------
+simd SIMDLevel() { return (gSIMDLevel.load()); }
+
+//------------------------------------------------------------------------------
+simd SetSIMDLevel(simd const Level)
+{
+  simd const Result = std::min<simd>(Level, SIMDSupported());
+  gSIMDLevel.store(Result);
   return (Result);
 }
 
 //------------------------------------------------------------------------------
-intersections Intersections(intersection const &I1, intersection const &I2)
+tup Add(tup const &A, tup const &B)
 {
-  intersections Result{};
-  Result.vI.push_back(I1);
-  Result.vI.push_back(I2);
+#if WW_SIMD_SSE
+  return (Store(_mm_add_ps(Load(A), Load(B))));
+#else
+  tup const Result{A.X + B.X, A.Y + B.Y, A.Z + B.Z, A.W + B.W};
+  return (Result);
+#endif
+}
 
+//------------------------------------------------------------------------------
+tup Color(float const R, float const G, float const B)
+{
+  tup Result{R, G, B, 0.f};
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+tup Cross(tup const &A, tup const &B)
+{
+  tup const Result = Vector(A.Y * B.Z - A.Z * B.Y, A.Z * B.X - A.X * B.Z, A.X * B.Y - A.Y * B.X);
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+float Dot(tup const &A, tup const &B)
+{
+#if WW_SIMD_SSE
+  return (DotSSE(A, B));
+#else
+  float const Result = A.X * B.X +  //!<
+                       A.Y * B.Y +  //<!
+                       A.Z * B.Z +  //<!
+                       A.W * B.W;   //<!
+  return (Result);
+#endif
+}
+
+//------------------------------------------------------------------------------
+bool Equal(float const A, float const B)
+{
+  //if (std::fabs(A - B) < 2.f * EPSILON)
+  if (std::fabs(A - B) < 1.f * EPSILON)
+  {
+    return true;
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+bool Equal(tup const &A, tup const &B)
+{
+  bool const Result = Equal(A.X, B.X) &&  //<!
+                      Equal(A.Y, B.Y) &&  //<!
+                      Equal(A.Z, B.Z) &&  //<!
+                      Equal(A.W, B.W);
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+bool IsPoint(tup const &Tup)
+{
+  bool Result{};
+  Result = (Tup.W != 0);
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+bool IsVector(tup const &Tup)
+{
+  bool Result{};
+  Result = !(Tup.W != 0);
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+tup Mul(float const S, tup const &Tup)
+{
+#if WW_SIMD_SSE
+  return (Store(_mm_mul_ps(_mm_set1_ps(S), Load(Tup))));
+#else
+  tup const Result{S * Tup.X, S * Tup.Y, S * Tup.Z, S * Tup.W};
+  return (Result);
+#endif
+}
+
+//------------------------------------------------------------------------------
+tup Mul(tup const A, tup const B)
+{
+#if WW_SIMD_SSE
+  return (Store(_mm_mul_ps(Load(A), Load(B))));
+#else
+  tup const Result{A.R * B.R, A.G * B.G, A.B * B.B, A.W * B.W};
+  return (Result);
+#endif
+}
+
+//------------------------------------------------------------------------------
+float MagSquared(tup const &Tup)
+{
+  float const Result = Tup.X * Tup.X +  //<!
+                       Tup.Y * Tup.Y +  //<!
+                       Tup.Z * Tup.Z +  //<!
+                       Tup.W * Tup.W;   //<!
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+float Mag(tup const &Tup) { return (std::sqrt(MagSquared(Tup))); }
+
+//------------------------------------------------------------------------------
+tup Negate(tup const &Tup)
+{
+  tup const Result{-Tup.X, -Tup.Y, -Tup.Z, -Tup.W};
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+tup Normalize(tup const &Tup)
+{
+  tup const Result = Tup / Mag(Tup);
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+tup Point(float A, float B, float C)
+{
+  tup Result{A, B, C, 1.f};
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+tup Sub(tup const &A, tup const &B)
+{
+#if WW_SIMD_SSE
+  return (Store(_mm_sub_ps(Load(A), Load(B))));
+#else
+  tup const Result = {A.X - B.X, A.Y - B.Y, A.Z - B.Z, A.W - B.W};
+  return (Result);
+#endif
+}
+
+//------------------------------------------------------------------------------
+tup Vector(float A, float B, float C)
+{
+  tup Result{A, B, C, 0.f};
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+float Radians(float Deg) { return (PI_F * Deg / 180.f); }
+// ---
+// NOTE: Canvas methods/functions.
+// ---
+void WritePixel(canvas &Canvas, int X, int Y, tup const &Color)
+{
+  // std::cout << "X:" << X                       //!<
+  //          << ". Y:" << Y                     //!<
+  //          << ". clc:" << (X + Y * Canvas.W)  //!<
+  //          << ". size:" << Canvas.vXY.size()  //!<
+  //          << std::endl;
+
+  Assert(Canvas.vXY.size() > (X + Y * Canvas.W), __FILE__, __LINE__);
+  Canvas.vXY[X + Y * Canvas.W] = Color;
+}
+//------------------------------------------------------------------------------
+tup PixelAt(canvas const &Canvas, int X, int Y)
+{
+  Assert(Canvas.vXY.size() > (X + Y * Canvas.W), __FILE__, __LINE__);
+  tup const Result = Canvas.vXY[X + Y * Canvas.W];
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+// ---
+// NOTE: The Portable Pix Map header.
+//     : Returns a string with a magic number, the dimension and the pixel resolution.
+// ---
+std::string PPMHeader(canvas const &Canvas)
+{
+  std::string const Result = "P3\n" + std::to_string(Canvas.W) + " " + std::to_string(Canvas.H) + "\n255";
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+// NOTE: This is actually take two of creating a PPM file and it uses a slightly different
+//       approach compared to the file writing functin below.
+//       For now I will keep the code around for reference.
+//------------------------------------------------------------------------------
+int WriteToPPMFile(canvas const &Canvas, std::string const &Filename)
+{
+  std::string Tmp{Filename};
+  if (!Tmp.size())
+  {
+    // NOTE: Create a temporary filename.
+    static int FilenameModifier{};
+    wchar_t const FilenameM = L"ABCDEFG=#"[FilenameModifier];
+    FilenameModifier = (FilenameModifier + 1) % 7;
+    std::stringstream ss;
+    ss << FilenameM;
+    Tmp = Filename + ss.str();
+  }
+
+  FILE *fp = std::fopen(Tmp.c_str(), "w");
+  if (!fp) return (-1);
+
+  std::string const Header = PPMHeader(Canvas);
+  for (size_t Idx = 0;       //<!
+       Idx < Header.size();  //<!
+       ++Idx)
+  {
+    std::putc(Header[Idx], fp);
+  }
+  // NOTE: Body need to come on a separate line, so we do a new line here.
+  std::putc('\n', fp);
+
+  Assert(Canvas.vXY.size() == Canvas.W * Canvas.H, __FILE__, __LINE__);
+
+  int PixelCount{};
+  for (size_t Idx = 0;           //<!
+       Idx < Canvas.vXY.size();  //<!
+       ++Idx, ++PixelCount)
+  {
+    // NOTE: As per the standard the count per line should not exceed 70.
+    //     : So 33 pixels x 3 byte per pixel should do the trick.
+    if ((!(PixelCount % 15) || (!(Idx % Canvas.W))) && (Idx > 0))
+    {
+      std::putc('\n', fp);
+      PixelCount = 0;
+    }
+
+    // NOTE: Truncate the float values between 0.f and 1.f.
+    // clang-format off
+      int const cR = int(255 * std::max<float>(0.f, std::min<float>(1.f, Canvas.vXY[Idx].R)));
+      int const cG = int(255 * std::max<float>(0.f, std::min<float>(1.f, Canvas.vXY[Idx].G)));
+      int const cB = int(255 * std::max<float>(0.f, std::min<float>(1.f, Canvas.vXY[Idx].B)));
+    // clang-format on
+    std::string const Output = std::to_string(cR) + " " + std::to_string(cG) + " " + std::to_string(cB) + " ";
+
+    // NOTE: So we have a string with the data, lets write to the file.
+    for (size_t I = 0;       //<!
+         I < Output.size();  //<!
+         ++I)
+    {
+      std::putc(Output[I], fp);
+    }
+  }
+  std::putc('\n', fp);
+  if (std::fclose(fp) != 0) return (-1);
+
+  // NOTE: move the file to the name it is supposed to have.
+  int const Result = std::rename(Tmp.c_str(), Filename.c_str());
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+// NOTE: Write the canvas to a Portable Pix Map file.
+void WriteToPPM(canvas const &Canvas, std::string const &Filename)
+{
+  std::ofstream O(Filename, std::ofstream::out | std::ofstream::trunc);
+
+  O << PPMHeader(Canvas) << std::endl;
+
+  int PixelCount{};
+  for (size_t Idx = 0;           //<!
+       Idx < Canvas.vXY.size();  //<!
+       ++Idx, ++PixelCount)
+  {
+    std::string Output{};
+    // NOTE: As per the standard the count per line should not exceed 70.
+    //     : So 33 pixels x 3 byte per pixel should do the trick.
+    if ((!(PixelCount % 33) || (!(Idx % Canvas.W))) && (Idx > 0))
+    {
+      Output += "\n";
+      PixelCount = 0;
+    }
+
+    // NOTE: Truncate the float values between 0.f and 1.f.
+    // clang-format off
+      Output += std::to_string(int(255 * std::max<float>(0.f, std::min<float>(1.f, Canvas.vXY[Idx].R))))  //!<
+         + " " + std::to_string(int(255 * std::max<float>(0.f, std::min<float>(1.f, Canvas.vXY[Idx].G))))  //<!
+         + " " + std::to_string(int(255 * std::max<float>(0.f, std::min<float>(1.f, Canvas.vXY[Idx].B))))  //<!
+         + " ";
+    // clang-format on
+    O << Output;
+
+    // Assert(Output.size() < 12, __FUNCTION__, __LINE__);
+  }
+  O << std::endl;
+  O.close();
+}
+
+//------------------------------------------------------------------------------
+std::vector<unsigned char> PPMBinary(canvas const &Canvas)
+{
+  Assert(Canvas.vXY.size() == Canvas.W * Canvas.H, __FILE__, __LINE__);
+
+  std::string const Header = "P6\n" + std::to_string(Canvas.W) + " " + std::to_string(Canvas.H) + "\n255\n";
+  std::vector<unsigned char> Result(Header.size() + 3 * Canvas.vXY.size());
+  std::copy(Header.begin(), Header.end(), Result.begin());
+
+  // NOTE: Truncate the float values between 0.f and 1.f, same as for P3.
+  auto Quantize = [](float const V) {
+    return (static_cast<unsigned char>(int(255 * std::max<float>(0.f, std::min<float>(1.f, V)))));
+  };
+
+  unsigned char *pBody = Result.data() + Header.size();
+  for (auto const &Pixel : Canvas.vXY)
+  {
+    *pBody++ = Quantize(Pixel.R);
+    *pBody++ = Quantize(Pixel.G);
+    *pBody++ = Quantize(Pixel.B);
+  }
+
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+int WriteToPPMBinary(canvas const &Canvas, int const FileDescriptor)
+{
+  std::vector<unsigned char> const Buffer = PPMBinary(Canvas);
+
+  // NOTE: One write for the whole image. Pipes and sockets may accept less than
+  //       everything, so keep going until all is written.
+  size_t Written{};
+  while (Written < Buffer.size())
+  {
+    ssize_t const Result = ::write(FileDescriptor, Buffer.data() + Written, Buffer.size() - Written);
+    if (Result < 0)
+    {
+      if (errno == EINTR) continue;
+      return (-1);
+    }
+    Written += static_cast<size_t>(Result);
+  }
+  return (0);
+}
+
+//------------------------------------------------------------------------------
+int WriteToPPMBinary(canvas const &Canvas, std::string const &Filename)
+{
+  if (Filename == "-") return (WriteToPPMBinary(Canvas, STDOUT_FILENO));
+
+  int const FileDescriptor = ::open(Filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (FileDescriptor < 0) return (-1);
+
+  int const Result = WriteToPPMBinary(Canvas, FileDescriptor);
+  if (::close(FileDescriptor) != 0) return (-1);
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+// NOTE: Read a PPM file from disk.
+// Return: A shared pointer of the allocated canvas. Empty when the file could not be read.
+//------------------------------------------------------------------------------
+std::shared_ptr<canvas> ReadFromPPM(std::string const &Filename)
+{
+  std::string Error{};
+  std::shared_ptr<canvas> Result = ReadFromPPM(Filename, Error);
+  if (!Result)
+  {
+    std::cerr << __FUNCTION__ << ": Loading of " << Filename << " failed. " << Error << std::endl;
+  }
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+std::shared_ptr<canvas> ReadFromPPM(std::string const &Filename, std::string &Error)
+{
+  // NOTE: Allocate on the heap, not stack.
+  std::shared_ptr<canvas> Result = std::make_shared<canvas>(0, 0);
+  if (!ReadFromPPM(Filename, *Result, Error)) Result.reset();
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+bool ReadFromPPM(std::string const &Filename, canvas &Canvas, std::string &Error)
+{
+  // NOTE: Clearing keeps the storage of the canvas for the resize below.
+  Canvas.W = 0;
+  Canvas.H = 0;
+  Canvas.vXY.clear();
+
+  mapped_file const File(Filename);
+  if (!File.pData)
+  {
+    Error = "Unable to open and map the file.";
+    return (false);
+  }
+
+  char const *P = File.pData;
+  char const *const End = File.pData + File.Size;
+
+  // NOTE: The magic number is P3 for ASCII and P6 for binary.
+  if (File.Size < 2 || P[0] != 'P' || (P[1] != '3' && P[1] != '6'))
+  {
+    Error = "Not a P3 or P6 file.";
+    return (false);
+  }
+  bool const Binary = (P[1] == '6');
+  P += 2;
+
+  int W{};
+  int H{};
+  int L{};  // How many levels, aka resolution
+  if (!ScanInt(P, End, W) || !ScanInt(P, End, H) || !ScanInt(P, End, L))
+  {
+    Error = "Incomplete header.";
+    return (false);
+  }
+  if (W <= 0 || H <= 0 || L <= 0 || L > 65535)
+  {
+    Error = "Invalid header. W:" + std::to_string(W) + ". H:" + std::to_string(H) + ". Levels:" + std::to_string(L) + ".";
+    return (false);
+  }
+  if (static_cast<size_t>(W) * static_cast<size_t>(H) > static_cast<size_t>(std::numeric_limits<int>::max()))
+  {
+    Error = "Image too large.";
+    return (false);
+  }
+
+  size_t const Samples = 3 * static_cast<size_t>(W) * static_cast<size_t>(H);
+  float const Levels = static_cast<float>(L);
+
+  // NOTE: Parse straight into the canvas.
+  std::vector<tup> &vXY = Canvas.vXY;
+  vXY.resize(static_cast<size_t>(W) * static_cast<size_t>(H));
+
+  bool Ok{true};
+  if (Binary)
+  {
+    // NOTE: Exactly one whitespace separates the header from the body. Two bytes,
+    //       most significant first, per sample when there are more than 256 levels.
+    int const BytesPerSample = L < 256 ? 1 : 2;
+    if (P == End || !(IsBlank(*P) || *P == '\n'))
+    {
+      Error = "Incomplete header.";
+      Ok = false;
+    }
+    else if (static_cast<size_t>(End - ++P) < Samples * BytesPerSample)
+    {
+      Error = "The body is shorter than the header says.";
+      Ok = false;
+    }
+    else
+    {
+      unsigned char const *B = reinterpret_cast<unsigned char const *>(P);
+      for (size_t Idx = 0;          ///<!
+           Idx < vXY.size() && Ok;  ///<!
+           ++Idx)
+      {
+        for (int C = 0;  ///<!
+             C < 3;      ///<!
+             ++C)
+        {
+          int const V = BytesPerSample == 1 ? B[0] : (B[0] << 8) | B[1];
+          B += BytesPerSample;
+          if (V > L)
+          {
+            Error = "Sample larger than the number of levels.";
+            Ok = false;
+          }
+          vXY[Idx].C[C] = V / Levels;
+        }
+      }
+    }
+  }
+  else
+  {
+    for (size_t Idx = 0;          ///<!
+         Idx < vXY.size() && Ok;  ///<!
+         ++Idx)
+    {
+      for (int C = 0;    ///<!
+           C < 3 && Ok;  ///<!
+           ++C)
+      {
+        int V{};
+        if (!ScanInt(P, End, V))
+        {
+          Error = "The body is shorter than the header says, or contains something else than numbers.";
+          Ok = false;
+        }
+        else if (V > L)
+        {
+          Error = "Sample larger than the number of levels.";
+          Ok = false;
+        }
+        vXY[Idx].C[C] = V / Levels;
+      }
+    }
+  }
+
+  if (Ok)
+  {
+    Canvas.W = W;
+    Canvas.H = H;
+  }
+  else
+  {
+    vXY.clear();
+  }
+  return (Ok);
+}
+
+// ---
+// NOTE: Matrix functions.
+// ---
+matrix Matrix44()
+{
+  matrix Result{};
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+matrix Matrix44(tup const &R0, tup const &R1, tup const &R2, tup const &R3)
+{
+  matrix Result{R0, R1, R2, R3};
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+// NOTE: Use the data structure for 4x4 matrix for all types of matrixes.
+matrix Matrix33(tup const &R0, tup const &R1, tup const &R2)
+{
+  matrix M{R0, R1, R2, tup{}};
+  M.Dimension = 3;
+  return (M);
+}
+
+//------------------------------------------------------------------------------
+// NOTE: Use the data structure for 4x4 matrix for all types of matrixes.
+matrix Matrix22(tup const &R0, tup const &R1)
+{
+  matrix M{R0, R1, tup{}, tup{}};
+  M.Dimension = 2;
+  return (M);
+}
+
+//------------------------------------------------------------------------------
+float Get(matrix const &M, int Row, int Col)
+{
+  Assert(Row < M.Dimension, __FUNCTION__, __LINE__);
+  Assert(Col < M.Dimension, __FUNCTION__, __LINE__);
+  return M.R[Row].C[Col];
+};
+
+void Set(matrix &M, int Row, int Col, float Value) { M.R[Row].C[Col] = Value; }
+
+//------------------------------------------------------------------------------
+is_invertible_return IsInvertible(matrix const &M)
+{
+  // NOTE: When the determinant has already been calculated we just return that result.
+  //       Otherwise the Determinant is calculated and a tuple is returned..
+  is_invertible_return Result{M.ID};
+
+  if (!Result.IsInvertible)
+  {
+    Result.Determinant = Determinant(M);
+    Result.IsInvertible = Result.Determinant != 0;
+  }
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+matrix Inverse(matrix const &M)
+{
+  if (M.Dimension != 4) return (InverseCofactor(M));
+  if (IsAffine(M)) return (InverseAffine(M));
+
+  matrix Result{};
+  alignas(16) float S[6];
+  alignas(16) float C[6];
+#if WW_SIMD_SSE
+  bool const UseSSE = CurrentSIMD() != simd::SCALAR;
+  if (UseSSE)
+    SubDeterminantsSSE(M, S, C);
+  else
+#endif
+    SubDeterminants(M, S, C);
+
+  float &DetM = Result.ID.Determinant;
+  DetM = DeterminantFromSub(S, C);
+
+  // NOTE: Only an exact zero is singular. An absolute epsilon would also reject small scalings,
+  //       Scaling(0.1, 0.1, 0.1) has a determinant of 0.001.
+  if (DetM == 0.f) return (Result);
+
+  float const InvDet = 1.f / DetM;
+#if WW_SIMD_SSE
+  if (UseSSE)
+    AdjugateSSE(M, S, C, InvDet, Result);
+  else
+#endif
+    Adjugate(M, S, C, InvDet, Result);
+
+  // NOTE: Like the transposed cofactor matrix, the result does not carry the determinant.
+  Result.ID = is_invertible_return{};
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+matrix InverseAffine(matrix const &M)
+{
+  // NOTE: The inverse of [A t; 0 1] is [inv(A) -inv(A)t; 0 1], and inv(A) is the
+  //       transposed cofactor matrix of A divided by its determinant.
+  tup const &R0 = M.R[0];
+  tup const &R1 = M.R[1];
+  tup const &R2 = M.R[2];
+
+  matrix Result{};
+  float &DetM = Result.ID.Determinant;
+  float const C00 = R1.C[1] * R2.C[2] - R1.C[2] * R2.C[1];
+  float const C10 = R1.C[2] * R2.C[0] - R1.C[0] * R2.C[2];
+  float const C20 = R1.C[0] * R2.C[1] - R1.C[1] * R2.C[0];
+  DetM = R0.C[0] * C00 + R0.C[1] * C10 + R0.C[2] * C20;
+  if (DetM == 0.f) return (Result);
+
+  float const InvDet = 1.f / DetM;
+  Result.R[0] = tup{C00, R0.C[2] * R2.C[1] - R0.C[1] * R2.C[2], R0.C[1] * R1.C[2] - R0.C[2] * R1.C[1], 0.f};
+  Result.R[1] = tup{C10, R0.C[0] * R2.C[2] - R0.C[2] * R2.C[0], R0.C[2] * R1.C[0] - R0.C[0] * R1.C[2], 0.f};
+  Result.R[2] = tup{C20, R0.C[1] * R2.C[0] - R0.C[0] * R2.C[1], R0.C[0] * R1.C[1] - R0.C[1] * R1.C[0], 0.f};
+  for (int Row = 0;  ///<!
+       Row < 3;      ///<!
+       ++Row)
+  {
+    tup &R = Result.R[Row];
+    R.C[0] *= InvDet;
+    R.C[1] *= InvDet;
+    R.C[2] *= InvDet;
+    R.C[3] = -(R.C[0] * R0.C[3] + R.C[1] * R1.C[3] + R.C[2] * R2.C[3]);
+  }
+  Result.R[3] = tup{0.f, 0.f, 0.f, 1.f};
+
+  Result.ID = is_invertible_return{};
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+matrix InverseCofactor(matrix const &M)
+{
+  // NOTE: Inverse of matrix is done by
+  // 1. Calculate the determinant. If different than zero ok
+  // 2. Calculate the cofactor of the input matrix.
+  // 3. Transpose the Resulting matrix.
+  // 4. Divide each element by the determinant.
+
+  matrix Result{};
+  float &DetM = Result.ID.Determinant;
+  DetM = Determinant(M);
+
+  if (DetM == 0.f) return (Result);
+
+  // NOTE: Since we did not return above the matrix must be invertible
+  Result.ID.IsInvertible = true;
+
+  for (int Row = 0;        ///<!
+       Row < M.Dimension;  ///<!
+       ++Row)
+  {
+    for (int Col = 0;        ///<!
+         Col < M.Dimension;  ///<!
+         ++Col)
+    {
+      Result.R[Row].C[Col] = Cofactor(M, Row, Col) / DetM;
+    }
+  }
+
+  // NOTE: The transposed matrix is not updated with the Determinant and the IsInvertible flag.
+  Result = Transpose(Result);
+
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+bool IsAffine(matrix const &M)
+{
+  return (M.Dimension == 4 &&      //!<
+          M.R[3].C[0] == 0.f &&    //!<
+          M.R[3].C[1] == 0.f &&    //!<
+          M.R[3].C[2] == 0.f &&    //!<
+          M.R[3].C[3] == 1.f);
+}
+
+//------------------------------------------------------------------------------
+matrix Mul(matrix const &A, matrix const &B)
+{
+  matrix M{};
+  simd const Level = CurrentSIMD();
+#if WW_SIMD_AVX
+  if (Level == simd::AVX)
+  {
+    MulAVX(A, B, M);
+    return (M);
+  }
+#endif
+#if WW_SIMD_SSE
+  if (Level != simd::SCALAR)
+  {
+    MulSSE(A, B, M);
+    return (M);
+  }
+#endif
+  for (size_t Row = 0;  ///<!
+       Row < 4;         ///<!
+       ++Row)
+  {
+    for (size_t Col = 0;  ///<!
+         Col < 4;         ///<!
+         ++Col)
+    {
+      float const Mrc = Get(A, Row, 0) * Get(B, 0, Col) +  //
+                        Get(A, Row, 1) * Get(B, 1, Col) +  //
+                        Get(A, Row, 2) * Get(B, 2, Col) +  //
+                        Get(A, Row, 3) * Get(B, 3, Col);   //
+      Set(M, Row, Col, Mrc);
+    }
+  }
+  return (M);
+}
+
+//------------------------------------------------------------------------------
+tup Mul(matrix const &A, tup const &T)
+{
+#if WW_SIMD_SSE
+  return (MulSSE(A, T));
+#else
+  tup Result{};
+  for (size_t Idx = 0;  ///<!
+       Idx < 4;         ///<!
+       ++Idx)
+  {
+    Result.C[Idx] = Get(A, Idx, 0) * T.C[0] +  //
+                    Get(A, Idx, 1) * T.C[1] +  //
+                    Get(A, Idx, 2) * T.C[2] +  //
+                    Get(A, Idx, 3) * T.C[3];
+  }
+  return (Result);
+#endif
+}
+
+//------------------------------------------------------------------------------
+matrix I()
+{
+  matrix Identity{};
+  Set(Identity, 0, 0, 1.f);
+  Set(Identity, 1, 1, 1.f);
+  Set(Identity, 2, 2, 1.f);
+  Set(Identity, 3, 3, 1.f);
+  return (Identity);
+}
+
+//------------------------------------------------------------------------------
+bool Equal(matrix const &A, matrix const &B)
+{
+  return Equal(A.R[0], B.R[0]) &&  //
+         Equal(A.R[1], B.R[1]) &&  //
+         Equal(A.R[2], B.R[2]) &&  //
+         Equal(A.R[3], B.R[3]);
+}
+
+//------------------------------------------------------------------------------
+matrix Transpose(matrix const &M)
+{
+  matrix R{};
+  for (size_t Row = 0;  ///<!
+       Row < 4;         ///<!
+       ++Row)
+  {
+    for (size_t Col = 0;  ///<!
+         Col < 4;         ///<!
+         ++Col)
+    {
+      R.R[Row].C[Col] = M.R[Col].C[Row];
+    }
+  }
+  return (R);
+}
+
+//------------------------------------------------------------------------------
+float Determinant22(matrix const &M)
+{
+  // NOTE: The determinant is D = a*d - b*c
+  float const Result = M.R[0].C[0] * M.R[1].C[1] - M.R[1].C[0] * M.R[0].C[1];
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+float Determinant33(matrix const &M)
+{
+  float const CF0 = Cofactor33(M, 0, 0);
+  float const CF1 = Cofactor33(M, 0, 1);
+  float const CF2 = Cofactor33(M, 0, 2);
+
+  float const Result = M.R0.C[0] * CF0 + M.R0.C[1] * CF1 + M.R0.C[2] * CF2;
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+float Determinant44(matrix const &M)
+{
+  matrix const M0 = SubMatrix(M, 0, 0);
+  matrix const M1 = SubMatrix(M, 0, 1);
+  matrix const M2 = SubMatrix(M, 0, 2);
+  matrix const M3 = SubMatrix(M, 0, 3);
+  float const DetM0 = Determinant33(M0);
+  float const DetM1 = Determinant33(M1);
+  float const DetM2 = Determinant33(M2);
+  float const DetM3 = Determinant33(M3);
+  float const Result = M.R0.C[0] * DetM0 - M.R0.C[1] * DetM1 + M.R0.C[2] * DetM2 - M.R0.C[3] * DetM3;
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+float Determinant(matrix const &M)
+{
+  float Result{};
+  if (M.Dimension == 4)
+    Result = Determinant44(M);
+  else if (M.Dimension == 3)
+    Result = Determinant33(M);
+  else if (M.Dimension == 2)
+    Result = Determinant22(M);
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+matrix SubMatrix(matrix const &M, int RemoveRow, int RemoveCol)
+{
+  matrix R{};
+  int ShiftR{};
+
+  // NOTE: For each row copy source until we get to the removerow
+  //       When we get to the remove row the source shifts by one,
+  //       so that we skip the RemoveRow.
+  for (int Row = 0;            ///<!
+       Row < M.Dimension - 1;  ///<!
+       ++Row)
+  {
+    if (Row == RemoveRow) ShiftR++;
+    R.R[Row] = M.R[Row + ShiftR];
+  }
+
+  // NOTE: Dimension reduces by 1 when we remove one row/column.
+  R.Dimension = M.Dimension - 1;
+
+  // NOTE: Copy the columns.
+  for (int Row = 0;        ///<!
+       Row < R.Dimension;  ///<! The rows are already in order, so we only need to
+       ++Row)              ///<! iterate over the result rows.
+  {
+    for (int Col = 0;        ///<!
+         Col < M.Dimension;  ///<!
+         ++Col)
+    {
+      if (Col < RemoveCol) continue;  // No point in copy of data that is already correctly placed.
+
+      if (Col < M.Dimension - 1)
+        R.R[Row].C[Col] = R.R[Row].C[Col + 1];
+      else
+        R.R[Row].C[Col] = 0.f;
+    }
+  }
+
+  return (R);
+}
+
+//------------------------------------------------------------------------------
+float Minor(matrix const &M, int RemoveRow, int RemoveCol)
+{
+  matrix const SM = SubMatrix(M, RemoveRow, RemoveCol);
+  float Result = Determinant22(SM);
+
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+float Cofactor33(matrix const &M, int RemoveRow, int RemoveCol)
+{
+  Assert(M.Dimension == 3, __FUNCTION__, __LINE__);
+  // NOTE: Change sign for the Cofactor when the sum of Row and Col is an odd number.
+  //       So; move to -2 for sign and then add 1.
+  int const Sign = -((RemoveRow + RemoveCol) % 2) * 2 + 1;
+  float const Result = Sign * Minor(M, RemoveRow, RemoveCol);
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+float Cofactor44(matrix const &M, int RemoveRow, int RemoveCol)
+{
+  Assert(M.Dimension == 4, __FUNCTION__, __LINE__);
+  matrix const A = SubMatrix(M, RemoveRow, RemoveCol);
+
+  int const Sign = -((RemoveRow + RemoveCol) % 2) * 2 + 1;
+  float const Result = Sign * Determinant33(A);
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+float Cofactor(matrix const &M, int RemoveRow, int RemoveCol)
+{
+  float Result{};
+
+  if (M.Dimension == 4)
+    Result = Cofactor44(M, RemoveRow, RemoveCol);
+  else if (M.Dimension == 3)
+    Result = Cofactor33(M, RemoveRow, RemoveCol);
+
+  return (Result);
+}
+
+matrix Translation(float X, float Y, float Z)
+{
+  matrix M{I()};
+  Set(M, 0, 3, X);
+  Set(M, 1, 3, Y);
+  Set(M, 2, 3, Z);
+
+  return (M);
+}
+
+//------------------------------------------------------------------------------
+matrix Scaling(float X, float Y, float Z)
+{
+  matrix M{I()};
+
+  Set(M, 0, 0, X);
+  Set(M, 1, 1, Y);
+  Set(M, 2, 2, Z);
+
+  return (M);
+}
+
+//------------------------------------------------------------------------------
+matrix RotateX(float Alfa)
+{
+  matrix M{I()};
+  Set(M, 1, 1, std::cos(Alfa));
+  Set(M, 1, 2, -std::sin(Alfa));
+  Set(M, 2, 1, std::sin(Alfa));
+  Set(M, 2, 2, std::cos(Alfa));
+
+  return (M);
+}
+
+//------------------------------------------------------------------------------
+matrix RotateY(float Alfa)
+{
+  matrix M{I()};
+  Set(M, 0, 0, std::cos(Alfa));
+  Set(M, 0, 2, std::sin(Alfa));
+  Set(M, 2, 0, -std::sin(Alfa));
+  Set(M, 2, 2, std::cos(Alfa));
+
+  return (M);
+}
+
+//------------------------------------------------------------------------------
+matrix RotateZ(float Alfa)
+{
+  matrix M{I()};
+  Set(M, 0, 0, std::cos(Alfa));
+  Set(M, 0, 1, -std::sin(Alfa));
+  Set(M, 1, 0, std::sin(Alfa));
+  Set(M, 1, 1, std::cos(Alfa));
+
+  return (M);
+}
+
+//------------------------------------------------------------------------------
+matrix Shearing(float Xy, float Xz, float Yx, float Yz, float Zx, float Zy)
+{
+  matrix M{I()};
+  Set(M, 0, 1, Xy);
+  Set(M, 0, 2, Xz);
+  Set(M, 1, 0, Yx);
+  Set(M, 1, 2, Yz);
+  Set(M, 2, 0, Zx);
+  Set(M, 2, 1, Zy);
+  return (M);
+}
+
+//------------------------------------------------------------------------------
+matrix TranslateScaleRotate(                   //!<
+    float TransX, float TransY, float TransZ,  //!< Translation is in m(?)
+    float ScaleX, float ScaleY, float ScaleZ,  //!< Scale input is unitless.
+    float AlfaX, float AlfaY, float AlfaZ      //!< Input rotation in radians.
+)
+{
+  matrix const M = Translation(TransX, TransY, TransZ) *             //!<
+                   Scaling(ScaleX, ScaleY, ScaleZ) *                 //!<
+                   RotateX(AlfaX) * RotateY(AlfaY) * RotateZ(AlfaZ)  //!<
+      ;
+
+  return (M);
+}
+
+//------------------------------------------------------------------------------
+transform::transform() : M{I()}, MInv{I()}, MInvTransposed{I()} {}
+
+//------------------------------------------------------------------------------
+transform::transform(matrix const &Other) { *this = Other; }
+
+//------------------------------------------------------------------------------
+transform &transform::operator=(matrix const &Other)
+{
+  SetWithInverse(Other, ww::Inverse(Other));
+  return (*this);
+}
+
+//------------------------------------------------------------------------------
+void transform::SetWithInverse(matrix const &Other, matrix const &Inv)
+{
+  M = Other;
+  MInv = Inv;
+  MInvTransposed = ww::Transpose(Inv);
+}
+
+/// ---
+/// \fn Sphere releated functions
+/// ---
+//------------------------------------------------------------------------------
+sphere Sphere(tup const &Center, float Radius)
+{
+  sphere S{};
+  S.Center = Center;
+  S.Radius = Radius;
+  return (S);
+}
+
+/// ---
+/// Ray releated functions.
+/// ---
+//------------------------------------------------------------------------------
+ray Ray(tup const &O, tup const &D)
+{
+  Assert(IsPoint(O), __FUNCTION__, __LINE__);
+  Assert(IsVector(D), __FUNCTION__, __LINE__);
+
+  ray Result{};
+  Result.Origin = O;
+  Result.Direction = Normalize(D);
+
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+int Count(intersections const &I) { return I.Count(); }
+
+//------------------------------------------------------------------------------
+tup PositionAt(ray const &R, float t)
+{
+  tup Result{};
+
+  Result = R.Origin + R.Direction * t;
+  Assert(IsPoint(Result), __FUNCTION__, __LINE__);
+
+  return (Result);
+}
+
+// intersection Intersection(float t, object *Object);
+// intersections Intersections(intersection const &I1, intersection const &I2);
+// intersect Intersect(object *pObject, ray const &Ray);
+//------------------------------------------------------------------------------
+intersections IntersectSphere(sphere const &Sphere, ray const &Ray)
+{
+  intersections Result{};
+  // NOTE: See explanation from:
+  // https://stackoverflow.com/questions/1073336/circle-line-segment-collision-detection-algorithm#1084899
+  //
+  // NOTE: The vector from the sphere's center to the ray origin
+  //       Remember that the sphere is centered at the world origin
+  tup const Sphere2Ray = Ray.Origin - Point(0.f, 0.f, 0.f);
+  // std::cout << "Sphere2Ray : " << Sphere2Ray << std::endl;
+
+  float const A = Dot(Ray.Direction, Ray.Direction);
+  float const B = 2 * Dot(Ray.Direction, Sphere2Ray);
+  float const C = Dot(Sphere2Ray, Sphere2Ray) - 1.f;
+  float const Discriminant = B * B - 4 * A * C;
+  // std::cout << "A:" << A << ". B:" << B << ". C:" << C << ". Discriminant:" << Discriminant << std::endl;
+
+  if (Discriminant >= 0)
+  {
+    float const t1 = (-B - std::sqrt(Discriminant)) / (2 * A);
+    float const t2 = (-B + std::sqrt(Discriminant)) / (2 * A);
+    intersection I{};
+
+    if (t1 > t2)
+    {
+      I.t = t2;
+      Result.vI.push_back(I);
+      I.t = t1;
+      Result.vI.push_back(I);
+    }
+    else
+    {
+      I.t = t1;
+      Result.vI.push_back(I);
+      I.t = t2;
+      Result.vI.push_back(I);
+    }
+  }
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+bool IsKind(object const *pObject, shape const Kind)
+{
+  // NOTE: Not inline, so the check for null is kept even when called through this.
+  return (pObject != nullptr && pObject->Kind == Kind);
+}
+
+//------------------------------------------------------------------------------
+intersect_return IntersectObject(object const &Object, ray const &RayIn)
+{
+  // ---
+  // NOTE: The object to which we are trying to calculate the intersect may
+  //       kind of not be placed at origin. So use its transform to 'move' the
+  //       ray by the inverse, which is cached in the transform.
+  // ---
+  switch (Object.Kind)
+  {
+    case shape::SPHERE:
+      return (IntersectUnitSphere(Transform(RayIn, Object.Transform.Inv())));
+    case shape::MESH:
+      return (IntersectMesh(static_cast<mesh const &>(Object), Transform(RayIn, Object.Transform.Inv())));
+    case shape::CUBE:  // NOTE: The cube is a stub and is never hit.
+    case shape::NONE:
+      break;
+  }
+  return (intersect_return{});
+}
+
+//------------------------------------------------------------------------------
+// NOTE: The arena itself is trivially destructible, so it may be used for as long as the
+//       thread runs. The reaper frees the lists when the thread exits; a buffer freed after
+//       that goes to the heap.
+//------------------------------------------------------------------------------
+thread_local intersection_arena tArena{};
+
+struct arena_reaper
+{
+  ~arena_reaper()
+  {
+    for (void *&pList : tArena.vFree)
+    {
+      while (pList)
+      {
+        void *const pNext = *static_cast<void **>(pList);
+        ::operator delete(pList);
+        pList = pNext;
+      }
+    }
+    for (int &Count : tArena.vCount) Count = 0;
+    tArena.Closed = true;
+  }
+};
+thread_local arena_reaper tArenaReaper{};
+
+//------------------------------------------------------------------------------
+// \fn SizeClass - The class whose buffers fit Bytes, or -1 when none do.
+inline int SizeClass(size_t const Bytes)
+{
+  int Class{};
+  while (Class < intersection_arena::CLASSES && (intersection_arena::SMALLEST_BYTES << Class) < Bytes) ++Class;
+  return (Class < intersection_arena::CLASSES ? Class : -1);
+}
+
+//------------------------------------------------------------------------------
+// NOTE: A buffer of a size class is always the full class size, also after the thread
+//       closed its arena, so it may go into any free list of that class later on.
+void *ArenaAllocate(size_t const Bytes)
+{
+  int const Class = SizeClass(Bytes);
+  if (Class < 0) return (::operator new(Bytes));
+  if (tArena.Closed) return (::operator new(intersection_arena::SMALLEST_BYTES << Class));
+
+  void *const pBuffer = tArena.vFree[Class];
+  if (pBuffer)
+  {
+    tArena.vFree[Class] = *static_cast<void **>(pBuffer);
+    --tArena.vCount[Class];
+    ++tArena.Reuses;
+    return (pBuffer);
+  }
+
+  ++tArena.Mallocs;
+  return (::operator new(intersection_arena::SMALLEST_BYTES << Class));
+}
+
+//------------------------------------------------------------------------------
+// NOTE: A thread may free buffers without ever allocating one, so the reaper is set up
+//       here, with the first buffer that goes into a free list.
+void ArenaFree(void *pBuffer, size_t const Bytes)
+{
+  int const Class = SizeClass(Bytes);
+  if (Class < 0 || tArena.Closed || tArena.vCount[Class] >= intersection_arena::MAX_FREE)
+  {
+    ::operator delete(pBuffer);
+    return;
+  }
+  static_cast<void>(&tArenaReaper);
+  *static_cast<void **>(pBuffer) = tArena.vFree[Class];
+  tArena.vFree[Class] = pBuffer;
+  ++tArena.vCount[Class];
+}
+
+//------------------------------------------------------------------------------
+intersection_arena const &ThreadArena() { return (tArena); }
+
+//------------------------------------------------------------------------------
+intersections Intersect(shared_ptr_object PtrSphere, ray const &RayIn)
+{
+  intersections Result{};
+
+  intersect_return const XS = IntersectObject(*PtrSphere, RayIn);
+  for (int Idx = 0;     ///<!
+       Idx < XS.Count;  ///<!
+       ++Idx)
+  {
+    // NOTE: take a copy of the object for future reference.
+    Result.vI.push_back(Intersection(XS.t[Idx], PtrSphere));
+    Result.vI.back().Primitive = XS.Primitive[Idx];
+  }
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+intersection Intersection(float t, shared_ptr_object pObject)
+{
+  intersection Result{};
+  Result.t = t;
+  Result.pObject = pObject;
+
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+intersections Intersections(intersection const &I1, intersection const &I2)
+{
+  intersections Result{};
+  Result.vI.push_back(I1);
+  Result.vI.push_back(I2);
+
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+intersections &Intersections(intersections &XS, intersection const &I)
+{
+  XS.vI.push_back(I);
+  return (XS);
+}
+
+//------------------------------------------------------------------------------
+bool Equal(material const &A, material const &B)
+{
+  bool Result{};
+  Result = Equal(A.Ambient, B.Ambient) && Equal(A.Diffuse, B.Diffuse) && Equal(A.Shininess, B.Shininess) &&
+           Equal(A.Specular, B.Specular) && Equal(A.Color, B.Color);
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+bool Equal(sphere const &A, sphere const &B)
+{
+  bool const EqMaterial = A.Material == B.Material;
+  bool const EqTransform = A.Transform == B.Transform;
+  return (Equal(A.Center, B.Center) && Equal(A.Radius, B.Radius) && EqMaterial && EqTransform);
+}
+
+//------------------------------------------------------------------------------
+bool Equal(intersection const &A, intersection const &B)
+{
+  bool const Result = Equal(A.t, B.t);
+  // std::cout << "Result:" << Result << ". Equal -> A:" << A.t << " B:" << B.t << std::endl;
+
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+bool Equal(light const &A, light const &B)
+{
+  bool const Result = Equal(A.Intensity, B.Intensity) && Equal(A.Position, B.Position);
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+intersection Hit1(intersections const &Intersections)
+{
+  intersection Result{};
+
+  // ---
+  // NOTE: Check that there is anything in the vector.
+  // ---
+  if (Intersections.Count() == 2)
+  {
+    float const &H0 = Intersections.vI[0].t;
+    float const &H1 = Intersections.vI[1].t;
+    // Decide on the minimum t. Seed it with the first entry of intersections.
+    float Checkt = std::max<float>(H0, H1);
+
+    // NOTE: There is at least one hit since the checked value is not negative.
+    if (Checkt >= 0)
+    {
+      if ((H0 >= 0) && (H0 <= H1))
+      {
+        Result = Intersections.vI[0];
+        // std::cout << "Count2A:Updated result with t:" << Result.t << std::endl;
+      }
+      else if ((H1 >= 0) && ((H1 <= H0) || (H0 < 0)))
+      {
+        Result = Intersections.vI[1];
+        // std::cout << "Count2B:Updated result with t:" << Result.t << std::endl;
+      }
+    }
+  }
+  // NOTE: This part of the code is untested .... FIXME: (Willy Clarke)
+  else if (Intersections.Count() == 1)
+  {
+    // NOTE: assert here until this code is ready for testing.
+    Assert(Intersections.Count() == 0, __FUNCTION__, __LINE__);
+    float const &H0 = Intersections.vI[0].t;
+    if (H0 > 0)
+    {
+      Result = Intersections.vI[0];
+      std::cout << "Count1:Updated result with t:" << Result.t << std::endl;
+    }
+  }
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+intersection Hit(intersections const &Intersections)
+{
+  intersection Result{};
+
+  bool DoFirstUpdate{true};
+
+  for (auto I : Intersections.vI)
+  {
+    if (I.t > 0)
+    {
+      if (DoFirstUpdate)
+      {
+        Result = I;
+        DoFirstUpdate = false;
+      }
+      else if (I.t < Result.t)
+      {
+        Result = I;
+      }
+    }
+  }
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+ray Mul(matrix const &M, ray const &R)
+{
+  ray Result{};
+  Result.Origin = M * R.Origin;
+  Result.Direction = M * R.Direction;
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+ray Transform(ray const &R, matrix const &M) { return M * R; }
+
+//------------------------------------------------------------------------------
+// \fn NormalAt
+// \brief Calculate normal vector at given point. The resulting vector will
+//        be normalized to a length of 1.f.
+//------------------------------------------------------------------------------
+tup NormalAt(object const &O, tup const &P, int const Primitive)
+{
+  tup const ObjectPoint = O.Transform.Inv() * P;
+  tup ObjectNormal = ObjectPoint - Point(0.f, 0.f, 0.f);
+
+  // NOTE: The normal of a triangle is the same all over it, so only the triangle matters.
+  //       An intersection made without the triangle, e.g. by Intersection(t, Ptr), has
+  //       no valid index. Then the triangle whose plane is nearest to the point is used.
+  if (O.Kind == shape::MESH)
+  {
+    mesh const &Mesh = static_cast<mesh const &>(O);
+    if (Mesh.pData && !Mesh.pData->vTriangles.empty())
+    {
+      std::vector<triangle> const &vTriangles = Mesh.pData->vTriangles;
+      int const NumTriangles = static_cast<int>(vTriangles.size());
+      bool const Valid = Primitive >= 0 && Primitive < NumTriangles;
+      float Nearest = std::numeric_limits<float>::max();
+      for (int Idx = Valid ? Primitive : 0;               //<!
+           Idx < (Valid ? Primitive + 1 : NumTriangles);  //<!
+           ++Idx)
+      {
+        float const(&T)[3][3] = vTriangles[Idx].P;
+        tup const E1 = Vector(T[1][0] - T[0][0], T[1][1] - T[0][1], T[1][2] - T[0][2]);
+        tup const E2 = Vector(T[2][0] - T[0][0], T[2][1] - T[0][1], T[2][2] - T[0][2]);
+        tup const N = Cross(E1, E2);
+        float const Length = Mag(N);
+        if (Length == 0.f) continue;
+        float const Distance = std::abs(Dot(N, ObjectPoint - Point(T[0][0], T[0][1], T[0][2]))) / Length;
+        if (Distance < Nearest)
+        {
+          Nearest = Distance;
+          ObjectNormal = N;
+        }
+      }
+    }
+  }
+
+  tup WorldNormal = O.Transform.InvTransposed() * ObjectNormal;
+  WorldNormal.W = 0.f;
+
+  tup const Result = Normalize(WorldNormal);
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+// \fn Reflect
+// \brief Calculate the reflection vector based on the input and the surface normal.
+// \sa https://math.stackexchange.com/questions/13261/how-to-get-a-reflection-vector
+// \sa https://en.wikipedia.org/wiki/Vector_projection
+//------------------------------------------------------------------------------
+tup Reflect(tup const &In, tup const &Normal)
+{
+  tup Result{};
+  Result = In - Normal * 2.f * Dot(In, Normal);
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+light PointLight(tup const &Position, tup const &Intensity)
+{
+  light Result{};
+  Result.Position = Position;
+  Result.Intensity = Intensity;
+  return (Result);
+}
+//------------------------------------------------------------------------------
+tup Lighting(material const &Material,  //!<
+             light const &Light,        //!<
+             tup const &Position,       //!<
+             tup const &vEye,           //!<
+             tup const &vNormal,        //!<
+             bool const InShadow        //!<
+)
+{
+  tup Result{};
+  // Combine the surface color with the light''s color/intensity.
+  tup const EffectiveColor = Material.Color * Light.Intensity;
+
+  // Find the direction to the light source.
+  tup const vLight = Normalize(Light.Position - Position);
+
+  // Compute the ambient contribution
+  tup const Ambient = EffectiveColor * Material.Ambient;
+
+  // Light dot Normal represents the cosine of the angle between the
+  // light vector and the normal vector. A negative number means that
+  // the light is on the other side of the surface.
+  float const LightDotNormal = Dot(vLight, vNormal);
+
+  // Assert(LightDotNormal < 0.f, __FUNCTION__, __LINE__);
+
+  tup Diffuse{};
+  tup Specular{};
+
+  if (LightDotNormal < 0.f)  // pointing away ...
+  {
+    Diffuse = Color(0.f, 0.f, 0.f);
+    Specular = Color(0.f, 0.f, 0.f);
+  }
+  else
+  {
+    // Compute the diffuse contribution
+    Diffuse = EffectiveColor * Material.Diffuse * LightDotNormal;
+
+    // Reflect dot eye represents the cosine of the angle between the
+    // reflection vector and the eye vector.
+    // A negative value means that the light reflects away from the eye.
+    tup vReflect = Reflect(-vLight, vNormal);
+    float const ReflectDotEye = Dot(vReflect, vEye);
+    if (ReflectDotEye <= 0)
+    {
+      Specular = Color(0.f, 0.f, 0.f);  // Black
+    }
+    else
+    {
+      // Compute the specular contribution
+      float const Factor = std::pow(ReflectDotEye, Material.Shininess);
+      Specular = Light.Intensity * Material.Specular * Factor;
+    }
+  }
+
+  // Add the three contributions together to the the final shading
+  // NOTE: When Inshadow we ignore the specular and diffuse component.
+  if (InShadow)
+  {
+    Result = Ambient;
+  }
+  else
+  {
+    Result = Ambient + Diffuse + Specular;
+  }
+
+  return (Result);
+};
+
+/// ---
+/// World functions.
+/// ---
+// \fn World - Create a default world.
+world World()
+{
+  world W{};
+
+  light Light = ww::PointLight(ww::Point(-10.f, 10.f, -10.f), ww::Color(1.f, 1.f, 1.f));
+  // W.vLights.push_back(Light);
+  {
+    ww::shared_ptr_light PtrLight{};
+    PtrLight.reset(new ww::light);
+    *PtrLight = Light;
+    W.vPtrLights.push_back(PtrLight);
+  }
+
+  sphere S1{};
+  S1.Material.Color = ww::Color(0.8f, 1.0f, 0.6f);
+  S1.Material.Diffuse = 0.7f;
+  S1.Material.Specular = 0.2f;
+  // W.vObjects.push_back(S1);
+
+  {
+    ww::shared_ptr_object PtrSphere{};
+    PtrSphere.reset(new ww::sphere);
+    *PtrSphere = S1;
+    W.vPtrObjects.push_back(PtrSphere);
+  }
+
+  sphere S2{};
+  S2.Transform = ww::Scaling(0.5f, 0.5f, 0.5f);
+  // W.vObjects.push_back(S2);
+  {
+    ww::shared_ptr_object PtrSphere{};
+    PtrSphere.reset(new ww::sphere);
+    *PtrSphere = S2;
+    W.vPtrObjects.push_back(PtrSphere);
+  }
+
+  return (W);
+}
+
+//------------------------------------------------------------------------------
+void WorldAddObject(world &W, shared_ptr_object pObject) { W.vPtrObjects.push_back(pObject); }
+//------------------------------------------------------------------------------
+void WorldAddLight(world &W, shared_ptr_light pLight) { W.vPtrLights.push_back(pLight); }
+
+//------------------------------------------------------------------------------
+intersections IntersectWorld(world const &World, ray const &Ray)
+{
+  intersections XS{};
+
+  // NOTE: There may be up to two intersections with a sphere.
+  //       So we detect and get these intersections, and then
+  //       we add them to the resulting XS's vector of intersections.
+  auto AddIntersections = [&](int Idx) {
+    shared_ptr_object const &PtrObject = World.vPtrObjects[Idx];
+    intersect_return const I = IntersectObject(*PtrObject, Ray);
+
+    for (int N = 0;    ///<!
+         N < I.Count;  ///<!
+         ++N)
+    {
+      XS.vI.push_back(Intersection(I.t[N], PtrObject));
+      XS.vI.back().Primitive = I.Primitive[N];
+    }
+    return false;
+  };
+
+  if (IsBVHValid(World))
+  {
+    // NOTE: Intersections behind the ray origin are also wanted, so the whole line is checked.
+    TraverseBVH(World.BVH, Ray, -std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                AddIntersections);
+  }
+  else
+  {
+    for (int Idx = 0;          ///<!
+         Idx < World.Count();  ///<!
+         ++Idx)
+    {
+      AddIntersections(Idx);
+    }
+  }
+
+  // NOTE: Keep the intersections sorted in ascending order.
+  //       Use lambda function to extract the t value for each intersection.
+  std::sort(XS.vI.begin(), XS.vI.end(), [](intersection const &A, intersection const &B) { return A.t < B.t; });
+  return (XS);
+}
+
+//------------------------------------------------------------------------------
+world_hit ClosestHit(world const &World, ray const &Ray)
+{
+  world_hit Result{};
+  float tClosest = std::numeric_limits<float>::max();
+
+  // NOTE: Keep the intersection with the smallest positive t. The traversal
+  //       below uses tClosest to skip the nodes that are further away.
+  //       Ties go to the lower index, so the visit order does not matter.
+  auto Closest = [&](int Idx) {
+    intersect_return const XS = IntersectObject(*World.vPtrObjects[Idx], Ray);
+    for (int N = 0;     ///<!
+         N < XS.Count;  ///<!
+         ++N)
+    {
+      if (IsCloser(XS.t[N], Idx, tClosest, Result))
+      {
+        tClosest = XS.t[N];
+        Result.t = tClosest;
+        Result.Index = Idx;
+        Result.Primitive = XS.Primitive[N];
+      }
+    }
+    return false;
+  };
+
+  // NOTE: The same search over the sphere arrays.
+  sphere_soa const &S = World.Spheres;
+  simd const Level = CurrentSIMD();
+  auto ClosestSphere = [&](int const Slot, float const t) {
+    if (IsCloser(t, S.vObject[Slot], tClosest, Result))
+    {
+      tClosest = t;
+      Result.t = tClosest;
+      Result.Index = S.vObject[Slot];
+    }
+    return (false);
+  };
+
+  bool const UseSpheres = IsSphereSoAValid(World);
+  if (IsBVHValid(World))
+  {
+    if (UseSpheres)
+    {
+      TraverseBVHLeaves(World.BVH, Ray, 0.f, tClosest, [&](int const First, int const Count) {
+        return (VisitSphereHits(Level, S, Ray, First, Count, ClosestSphere));
+      });
+    }
+    else
+    {
+      TraverseBVH(World.BVH, Ray, 0.f, tClosest, Closest);
+    }
+  }
+  else if (UseSpheres)
+  {
+    VisitSphereHits(Level, S, Ray, 0, S.Count, ClosestSphere);
+  }
+  else
+  {
+    for (int Idx = 0;          ///<!
+         Idx < World.Count();  ///<!
+         ++Idx)
+    {
+      Closest(Idx);
+    }
+  }
+
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+void ClosestHits(world const &World, ray_packet const &Packet, world_hit *Hits)
+{
+  constexpr int MAX_RAYS = ray_packet::MAX_RAYS;
+  ray Rays[MAX_RAYS];
+  for (int Lane = 0;         ///<!
+       Lane < Packet.Count;  ///<!
+       ++Lane)
+  {
+    Rays[Lane] = PacketRay(Packet, Lane);
+    Hits[Lane] = world_hit{};
+  }
+
+  if (!IsSphereSoAValid(World))
+  {
+    for (int Lane = 0;         ///<!
+         Lane < Packet.Count;  ///<!
+         ++Lane)
+    {
+      Hits[Lane] = ClosestHit(World, Rays[Lane]);
+    }
+    return;
+  }
+
+  // NOTE: Same as ClosestSphere in ClosestHit, with one running minimum per ray.
+  sphere_soa const &S = World.Spheres;
+  simd const Level = CurrentSIMD();
+  float tClosest[MAX_RAYS];
+  std::fill(tClosest, tClosest + MAX_RAYS, std::numeric_limits<float>::max());
+  auto ClosestSphere = [&](int const Lane, int const Slot, float const t) {
+    if (IsCloser(t, S.vObject[Slot], tClosest[Lane], Hits[Lane]))
+    {
+      tClosest[Lane] = t;
+      Hits[Lane].t = t;
+      Hits[Lane].Index = S.vObject[Slot];
+    }
+  };
+
+  int const AllLanes = (1 << Packet.Count) - 1;
+  if (!IsBVHValid(World))
+  {
+    for (int Slot = 0;    ///<!
+         Slot < S.Count;  ///<!
+         ++Slot)
+    {
+      VisitPacketHits(Level, S, Slot, Packet, AllLanes, ClosestSphere);
+    }
+    return;
+  }
+
+  // NOTE: The packet walks the BVH together. Every stack entry holds the rays that hit
+  //       the box of the node, and where each of them enters it. A ray drops out of a
+  //       node when it has found a hit in front of the box, just like in TraverseBVHLeaves.
+  struct stack_entry
+  {
+    int Node;
+    int Active;
+    float tNear[MAX_RAYS];
+  };
+  stack_entry Stack[BVH_STACK_SIZE];
+  int Top{};
+
+  tup InvDir[MAX_RAYS];
+  for (int Lane = 0;         ///<!
+       Lane < Packet.Count;  ///<!
+       ++Lane)
+  {
+    InvDir[Lane] = tup{1.f / Rays[Lane].Direction.X, 1.f / Rays[Lane].Direction.Y, 1.f / Rays[Lane].Direction.Z, 0.f};
+  }
+
+  // NOTE: Test the box of Node against the Active rays, and push the node for those that hit it.
+  auto Push = [&](int const Node, int const Active) {
+    stack_entry &Entry = Stack[Top];
+    Entry.Node = Node;
+    Entry.Active = 0;
+    for (int Bits = Active;  ///<!
+         Bits;               ///<!
+         Bits &= Bits - 1)
+    {
+      int const Lane = __builtin_ctz(Bits);
+      if (IntersectBounds(World.BVH.vNodes[Node].Box, Rays[Lane], InvDir[Lane], 0.f, tClosest[Lane],
+                          Entry.tNear[Lane]))
+      {
+        Entry.Active |= 1 << Lane;
+      }
+    }
+    if (Entry.Active) ++Top;
+    return (Entry.Active);
+  };
+
+  // NOTE: With this few rays left the shared walk costs more than it saves.
+  int const FewRays = std::max<int>(1, Packet.Count / 4);
+
+  Push(0, AllLanes);
+  while (Top > 0)
+  {
+    // NOTE: The pushes below reuse the slot of Entry, so it is not read after them.
+    stack_entry const &Entry = Stack[--Top];
+    int const Node = Entry.Node;
+
+    // NOTE: The node may have been pushed before a closer hit was found.
+    int Active{};
+    for (int Bits = Entry.Active;  ///<!
+         Bits;                     ///<!
+         Bits &= Bits - 1)
+    {
+      int const Lane = __builtin_ctz(Bits);
+      if (Entry.tNear[Lane] <= tClosest[Lane]) Active |= 1 << Lane;
+    }
+    if (!Active) continue;
+
+    if (__builtin_popcount(Active) <= FewRays)
+    {
+      // NOTE: The packet has diverged. Each remaining ray finishes this subtree alone.
+      for (int Bits = Active;  ///<!
+           Bits;               ///<!
+           Bits &= Bits - 1)
+      {
+        int const Lane = __builtin_ctz(Bits);
+        auto Closest = [&](int const Slot, float const t) {
+          ClosestSphere(Lane, Slot, t);
+          return (false);
+        };
+        TraverseBVHLeaves(
+            World.BVH, Rays[Lane], 0.f, tClosest[Lane],
+            [&](int const First, int const Count) {
+              return (VisitSphereHits(Level, S, Rays[Lane], First, Count, Closest));
+            },
+            Node);
+      }
+      continue;
+    }
+
+    bvh_node const &BVHNode = World.BVH.vNodes[Node];
+    if (BVHNode.Count > 0)
+    {
+      for (int Slot = BVHNode.First;              ///<!
+           Slot < BVHNode.First + BVHNode.Count;  ///<!
+           ++Slot)
+      {
+        VisitPacketHits(Level, S, Slot, Packet, Active, ClosestSphere);
+      }
+    }
+    else
+    {
+      Assert(Top + 2 <= BVH_STACK_SIZE, __FUNCTION__, __LINE__);
+
+      // NOTE: Push the far child first, as seen by the first ray, so that the near child is visited first.
+      int const Lane = __builtin_ctz(Active);
+      float tLeft{};
+      float tRight{};
+      bool const HitLeft = IntersectBounds(World.BVH.vNodes[BVHNode.Left].Box, Rays[Lane], InvDir[Lane], 0.f,
+                                           tClosest[Lane], tLeft);
+      bool const HitRight = IntersectBounds(World.BVH.vNodes[BVHNode.Right].Box, Rays[Lane], InvDir[Lane], 0.f,
+                                            tClosest[Lane], tRight);
+      if (HitLeft && (!HitRight || tLeft <= tRight))
+      {
+        Push(BVHNode.Right, Active);
+        Push(BVHNode.Left, Active);
+      }
+      else
+      {
+        Push(BVHNode.Left, Active);
+        Push(BVHNode.Right, Active);
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+intersection HitWorld(world const &World, ray const &Ray)
+{
+  intersection Result{};
+
+  world_hit const H = ClosestHit(World, Ray);
+  if (H.Index >= 0)
+  {
+    Result = Intersection(H.t, World.vPtrObjects[H.Index]);
+    Result.Primitive = H.Primitive;
+  }
+
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+bool IntersectTriangle(triangle const &Triangle, ray const &Ray, float &t)
+{
+  return (IntersectTriangle(WatertightRay(Ray), Triangle, t));
+}
+
+//------------------------------------------------------------------------------
+shared_ptr_mesh_data MeshData(std::vector<tup> vVertices, std::vector<int> vIndices)
+{
+  if (vIndices.size() % 3) return (nullptr);
+  for (int const Index : vIndices)
+  {
+    if (Index < 0 || Index >= static_cast<int>(vVertices.size())) return (nullptr);
+  }
+
+  std::shared_ptr<mesh_data> pData = std::make_shared<mesh_data>();
+  mesh_data &Data = *pData;
+  Data.vVertices = std::move(vVertices);
+  Data.vIndices = std::move(vIndices);
+
+  int const Count = static_cast<int>(Data.vIndices.size() / 3);
+  std::vector<bvh_entry> vEntries(Count);
+  for (int Idx = 0;  ///<!
+       Idx < Count;  ///<!
+       ++Idx)
+  {
+    bvh_entry &E = vEntries[Idx];
+    for (int Corner = 0;  ///<!
+         Corner < 3;      ///<!
+         ++Corner)
+    {
+      tup const &V = Data.vVertices[Data.vIndices[3 * Idx + Corner]];
+      E.Box = Merge(E.Box, bounds{V, V});
+    }
+    E.Centroid = (E.Box.Min + E.Box.Max) * 0.5f;
+    E.Index = Idx;
+    Data.Box = Merge(Data.Box, E.Box);
+  }
+  BuildBVHFromEntries(Data.BVH, vEntries);
+
+  // NOTE: Copy the corners in the leaf order, so the leaves refer to vTriangles directly.
+  Data.vTriangles.resize(Count);
+  for (int Idx = 0;  ///<!
+       Idx < Count;  ///<!
+       ++Idx)
+  {
+    int const Source = Data.BVH.vIndices[Idx];
+    for (int Corner = 0;  ///<!
+         Corner < 3;      ///<!
+         ++Corner)
+    {
+      tup const &V = Data.vVertices[Data.vIndices[3 * Source + Corner]];
+      Data.vTriangles[Idx].P[Corner][0] = V.X;
+      Data.vTriangles[Idx].P[Corner][1] = V.Y;
+      Data.vTriangles[Idx].P[Corner][2] = V.Z;
+    }
+  }
+
+  return (pData);
+}
+
+//------------------------------------------------------------------------------
+shared_ptr_object PtrMesh(shared_ptr_mesh_data pData)
+{
+  std::shared_ptr<mesh> pMesh = std::make_shared<mesh>();
+  pMesh->pData = std::move(pData);
+  return (pMesh);
+}
+
+//------------------------------------------------------------------------------
+bool ReadFromOBJ(std::string const &Filename, obj_data &Obj, std::string &Error, obj_stats &Stats,
+                 int const NumThreads)
+{
+  auto const Start = std::chrono::steady_clock::now();
+  Stats = obj_stats{};
+
+  // NOTE: Clearing keeps the storage of the buffers for the resize below.
+  Obj.vVertices.clear();
+  Obj.vNormals.clear();
+  Obj.vIndices.clear();
+  Obj.vNormalIndices.clear();
+
+  mapped_file const File(Filename);
+  if (!File.pData)
+  {
+    Error = "Unable to open and map the file.";
+    return (false);
+  }
+  Stats.FileBytes = File.Size;
+
+  // ---
+  // NOTE: One chunk per thread, cut after a line break.
+  // ---
+  int Count = NumThreads > 0 ? NumThreads : static_cast<int>(std::thread::hardware_concurrency());
+  Count = std::max<int>(1, static_cast<int>(std::min<size_t>(Count, File.Size / MIN_OBJ_CHUNK)));
+  std::vector<obj_chunk> vChunks(Count);
+  char const *const End = File.pData + File.Size;
+  for (int Idx = 0;  ///<!
+       Idx < Count;  ///<!
+       ++Idx)
+  {
+    obj_chunk &Chunk = vChunks[Idx];
+    Chunk.Begin = Idx ? vChunks[Idx - 1].End : File.pData;
+    Chunk.End = Idx + 1 < Count ? File.pData + File.Size / Count * (Idx + 1) : End;
+    if (Chunk.End < Chunk.Begin) Chunk.End = Chunk.Begin;
+    if (Chunk.End < End && Chunk.End > Chunk.Begin && Chunk.End[-1] != '\n') NextLine(Chunk.End, End);
+  }
+  Stats.Threads = Count;
+
+  // NOTE: Each worker takes the next free chunk until all are done.
+  auto RunChunks = [&](auto const &Pass) {
+    std::atomic<int> NextChunk{};
+    auto Worker = [&]() {
+      for (int Idx = NextChunk++;  ///<!
+           Idx < Count;            ///<!
+           Idx = NextChunk++)
+      {
+        Pass(vChunks[Idx]);
+      }
+    };
+    std::vector<std::thread> vThreads{};
+    for (int Idx = 1;  ///<! The calling thread is worker number 0.
+         Idx < Count;  ///<!
+         ++Idx)
+    {
+      vThreads.emplace_back(Worker);
+    }
+    Worker();
+    for (auto &Thread : vThreads)
+    {
+      Thread.join();
+    }
+  };
+  RunChunks([](obj_chunk &Chunk) { CountOBJ(Chunk); });
+
+  // ---
+  // NOTE: Size the buffers once, and tell each chunk where its part of them starts.
+  // ---
+  obj_chunk Total{};
+  for (obj_chunk &Chunk : vChunks)
+  {
+    Chunk.FirstLine = Total.Lines;
+    Chunk.FirstVertex = Total.Vertices;
+    Chunk.FirstNormal = Total.Normals;
+    Chunk.FirstIndex = Total.Indices;
+    Total.Lines += Chunk.Lines;
+    Total.Vertices += Chunk.Vertices;
+    Total.Normals += Chunk.Normals;
+    Total.Indices += Chunk.Indices;
+  }
+  if (Total.Vertices > static_cast<size_t>(std::numeric_limits<int>::max()) ||
+      Total.Normals > static_cast<size_t>(std::numeric_limits<int>::max()))
+  {
+    Error = "Too many vertices or normals.";
+    return (false);
+  }
+  Obj.vVertices.resize(Total.Vertices);
+  Obj.vNormals.resize(Total.Normals);
+  Obj.vIndices.resize(Total.Indices);
+  Obj.vNormalIndices.resize(Total.Indices);
+
+  RunChunks([&](obj_chunk &Chunk) { ParseOBJ(Chunk, Obj); });
+  for (obj_chunk const &Chunk : vChunks)
+  {
+    if (Chunk.Error.empty()) continue;
+    Error = Chunk.Error;
+    Obj.vVertices.clear();
+    Obj.vNormals.clear();
+    Obj.vIndices.clear();
+    Obj.vNormalIndices.clear();
+    return (false);
+  }
+
+  Stats.BufferBytes = Obj.vVertices.capacity() * sizeof(tup) + Obj.vNormals.capacity() * sizeof(tup) +
+                      Obj.vIndices.capacity() * sizeof(int) + Obj.vNormalIndices.capacity() * sizeof(int);
+  struct rusage Usage
+  {
+  };
+  if (::getrusage(RUSAGE_SELF, &Usage) == 0) Stats.MaxRSSKB = Usage.ru_maxrss;
+  Stats.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+  return (true);
+}
+
+//------------------------------------------------------------------------------
+bool ReadScene(std::string const &Filename, world &World, camera &Camera, std::string &Error, scene_stats &Stats)
+{
+  auto const Start = std::chrono::steady_clock::now();
+  Stats = scene_stats{};
+  World.vPtrObjects.clear();
+  World.vPtrLights.clear();
+
+  mapped_file const File(Filename);
+  if (!File.pData)
+  {
+    Error = "Unable to open and map the file.";
+    return (false);
+  }
+  Stats.FileBytes = File.Size;
+
+  scene_reader R(World, Camera, Error);
+  size_t const Slash = Filename.rfind('/');
+  if (Slash != std::string::npos) R.Directory = Filename.substr(0, Slash + 1);
+
+  bool Ok{true};
+  char const *P = File.pData;
+  char const *const End = File.pData + File.Size;
+  while (Ok && P < End)
+  {
+    char const *const Begin = P;
+    NextLine(P, End);
+    char const *LineEnd = P;
+    while (LineEnd > Begin && (LineEnd[-1] == '\n' || LineEnd[-1] == '\r')) --LineEnd;
+    ++R.Line;
+    Ok = ReadSceneLine(R, Begin, LineEnd);
+  }
+  Ok = Ok && FinishItem(R);
+  if (Ok && !R.HasCamera)
+  {
+    Ok = false;
+    Error = "The scene has no camera.";
+  }
+  if (!Ok)
+  {
+    World.vPtrObjects.clear();
+    World.vPtrLights.clear();
+    return (false);
+  }
+  Stats.Lines = R.Line;
+  Stats.Objects = World.vPtrObjects.size();
+  Stats.Lights = World.vPtrLights.size();
+  auto const Parsed = std::chrono::steady_clock::now();
+  Stats.ParseSeconds = std::chrono::duration<double>(Parsed - Start).count();
+
+  BuildBVH(World);
+  BuildSphereSoA(World);
+  auto const Built = std::chrono::steady_clock::now();
+  Stats.BuildSeconds = std::chrono::duration<double>(Built - Parsed).count();
+  Stats.Seconds = std::chrono::duration<double>(Built - Start).count();
+  return (true);
+}
+
+//------------------------------------------------------------------------------
+bool WriteSceneCache(std::string const &Filename, world const &World, camera const &Camera, std::string &Error)
+{
+  cache_header H = CacheHeader();
+  H.HSize = Camera.HSize;
+  H.VSize = Camera.VSize;
+  H.FieldOfView = Camera.FieldOfView;
+  H.PixelSize = Camera.PixelSize;
+  H.HalfWidth = Camera.HalfWidth;
+  H.HalfHeight = Camera.HalfHeight;
+  H.CameraMatrix = Camera.Transform.Matrix();
+  H.CameraInv = Camera.Transform.Inv();
+
+  // ---
+  // NOTE: Flatten the objects. The data of a mesh is written once, however many meshes share it.
+  // ---
+  std::vector<cache_object> vObjects(World.vPtrObjects.size());
+  std::vector<mesh_data const *> vMeshData{};
+  std::unordered_map<mesh_data const *, int> MeshIndex{};
+  for (size_t Idx = 0;                  ///<!
+       Idx < World.vPtrObjects.size();  ///<!
+       ++Idx)
+  {
+    object const &Object = *World.vPtrObjects[Idx];
+    cache_object &C = vObjects[Idx];
+    C.Kind = static_cast<int32_t>(Object.Kind);
+    C.Material = Object.Material;
+    C.Center = Object.Center;
+    C.Matrix = Object.Transform.Matrix();
+    C.Inv = Object.Transform.Inv();
+    switch (Object.Kind)
+    {
+      case shape::SPHERE:
+        C.Radius = static_cast<sphere const &>(Object).Radius;
+        break;
+      case shape::CUBE:
+        break;
+      case shape::MESH:
+      {
+        mesh_data const *pData = static_cast<mesh const &>(Object).pData.get();
+        if (!pData) break;
+        auto const Inserted = MeshIndex.emplace(pData, static_cast<int>(vMeshData.size()));
+        if (Inserted.second) vMeshData.push_back(pData);
+        C.Mesh = Inserted.first->second;
+        break;
+      }
+      case shape::NONE:
+        Error = "Object " + std::to_string(Idx) + " has no shape and can not be cached.";
+        return (false);
+    }
+  }
+
+  std::vector<light> vLights{};
+  vLights.reserve(World.vPtrLights.size());
+  for (auto const &pLight : World.vPtrLights)
+  {
+    vLights.push_back(*pLight);
+  }
+
+  cache_writer W(Filename);
+  if (!W.O)
+  {
+    Error = "Unable to create the file.";
+    return (false);
+  }
+  W.Write(&H, 1);
+  H.Objects = W.Write(vObjects);
+  H.Lights = W.Write(vLights);
+  H.Nodes = W.Write(World.BVH.vNodes);
+  H.Indices = W.Write(World.BVH.vIndices);
+  H.SoACount = World.Spheres.Count;
+  H.SoAStride = World.Spheres.Stride;
+  H.SoABVHOrder = World.Spheres.BVHOrder;
+  H.SoAInv = W.Write(World.Spheres.vInv);
+  H.SoAObject = W.Write(World.Spheres.vObject);
+
+  // NOTE: The arrays of all the meshes, one after the other, and the ranges of each mesh.
+  std::vector<cache_mesh> vMeshes(vMeshData.size());
+  cache_mesh Total{};
+  for (size_t Idx = 0;          ///<!
+       Idx < vMeshData.size();  ///<!
+       ++Idx)
+  {
+    mesh_data const &D = *vMeshData[Idx];
+    cache_mesh &M = vMeshes[Idx];
+    M.Vertices = cache_section{Total.Vertices.Count, D.vVertices.size()};
+    M.Indices = cache_section{Total.Indices.Count, D.vIndices.size()};
+    M.Triangles = cache_section{Total.Triangles.Count, D.vTriangles.size()};
+    M.Nodes = cache_section{Total.Nodes.Count, D.BVH.vNodes.size()};
+    M.BVHIndices = cache_section{Total.BVHIndices.Count, D.BVH.vIndices.size()};
+    M.Box = D.Box;
+    Total.Vertices.Count += D.vVertices.size();
+    Total.Indices.Count += D.vIndices.size();
+    Total.Triangles.Count += D.vTriangles.size();
+    Total.Nodes.Count += D.BVH.vNodes.size();
+    Total.BVHIndices.Count += D.BVH.vIndices.size();
+  }
+  H.Meshes = W.Write(vMeshes);
+  // NOTE: One section of the same array of every mesh, padded only before the first.
+  auto WriteAll = [&](auto const Member) {
+    cache_section Section{};
+    for (size_t Idx = 0;          ///<!
+         Idx < vMeshData.size();  ///<!
+         ++Idx)
+    {
+      cache_section const Part = W.Write(Member(*vMeshData[Idx]), Idx == 0);
+      if (!Idx) Section.Offset = Part.Offset;
+      Section.Count += Part.Count;
+    }
+    return (Section);
+  };
+  H.MeshVertices = WriteAll([](mesh_data const &D) -> auto const & { return (D.vVertices); });
+  H.MeshIndices = WriteAll([](mesh_data const &D) -> auto const & { return (D.vIndices); });
+  H.Triangles = WriteAll([](mesh_data const &D) -> auto const & { return (D.vTriangles); });
+  H.MeshNodes = WriteAll([](mesh_data const &D) -> auto const & { return (D.BVH.vNodes); });
+  H.MeshBVHIndices = WriteAll([](mesh_data const &D) -> auto const & { return (D.BVH.vIndices); });
+
+  W.O.seekp(0);
+  W.O.write(reinterpret_cast<char const *>(&H), sizeof(H));
+  W.O.close();
+  if (!W.O)
+  {
+    Error = "Unable to write the file.";
+    return (false);
+  }
+  return (true);
+}
+
+//------------------------------------------------------------------------------
+bool ReadSceneCache(std::string const &Filename, world &World, camera &Camera, std::string &Error,
+                    scene_stats &Stats)
+{
+  auto const Start = std::chrono::steady_clock::now();
+  Stats = scene_stats{};
+  World.vPtrObjects.clear();
+  World.vPtrLights.clear();
+  World.BVH = bvh{};
+  World.Spheres = sphere_soa{};
+
+  mapped_file const File(Filename);
+  if (!File.pData)
+  {
+    Error = "Unable to open and map the file.";
+    return (false);
+  }
+  Stats.FileBytes = File.Size;
+
+  cache_header const Expected = CacheHeader();
+  cache_header H{};
+  if (File.Size < sizeof(H) || !std::equal(Expected.Magic, Expected.Magic + 8, File.pData))
+  {
+    Error = "Not a scene cache.";
+    return (false);
+  }
+  std::memcpy(static_cast<void *>(&H), File.pData, sizeof(H));
+  if (H.Version != Expected.Version)
+  {
+    Error = "Scene cache version " + std::to_string(H.Version) + ", expected " + std::to_string(Expected.Version) + ".";
+    return (false);
+  }
+  if (H.HeaderBytes != Expected.HeaderBytes || H.ObjectBytes != Expected.ObjectBytes ||
+      H.MeshBytes != Expected.MeshBytes || H.NodeBytes != Expected.NodeBytes ||
+      H.TriangleBytes != Expected.TriangleBytes)
+  {
+    Error = "The scene cache was written by another build.";
+    return (false);
+  }
+
+  // ---
+  // NOTE: Copy the records out of the mapping. Every range and index is checked, so a corrupt
+  //       file is an error and not a crash in the renderer.
+  // ---
+  auto Fail = [&](char const *Message) {
+    World.vPtrObjects.clear();
+    World.vPtrLights.clear();
+    World.BVH = bvh{};
+    World.Spheres = sphere_soa{};
+    Error = Message;
+    return (false);
+  };
+
+  std::vector<cache_mesh> vCacheMeshes{};
+  if (!ReadSection(File, H.Meshes, vCacheMeshes)) return (Fail("The scene cache is truncated."));
+  std::vector<shared_ptr_mesh_data> vMeshes{};
+  vMeshes.reserve(vCacheMeshes.size());
+  for (cache_mesh const &M : vCacheMeshes)
+  {
+    auto pData = std::make_shared<mesh_data>();
+    bool const Ok = ReadSection(File, H.MeshVertices, pData->vVertices, M.Vertices.Offset, M.Vertices.Count) &&
+                    ReadSection(File, H.MeshIndices, pData->vIndices, M.Indices.Offset, M.Indices.Count) &&
+                    ReadSection(File, H.Triangles, pData->vTriangles, M.Triangles.Offset, M.Triangles.Count) &&
+                    ReadSection(File, H.MeshNodes, pData->BVH.vNodes, M.Nodes.Offset, M.Nodes.Count) &&
+                    ReadSection(File, H.MeshBVHIndices, pData->BVH.vIndices, M.BVHIndices.Offset,
+                                M.BVHIndices.Count);
+    if (!Ok) return (Fail("The scene cache is truncated."));
+    // NOTE: IntersectMesh() reads the triangles in leaf order, straight from the leaves.
+    size_t const NumTriangles = pData->vTriangles.size();
+    bool const BVHOk = pData->BVH.vIndices.size() == NumTriangles &&
+                       (NumTriangles == 0 || !pData->BVH.vNodes.empty()) &&
+                       IsBVHInRange(pData->BVH, NumTriangles, NumTriangles);
+    if (!BVHOk) return (Fail("A mesh BVH in the scene cache is corrupt."));
+    pData->Box = M.Box;
+    vMeshes.push_back(std::move(pData));
+  }
+
+  std::vector<cache_object> vObjects{};
+  std::vector<light> vLights{};
+  if (!ReadSection(File, H.Objects, vObjects) || !ReadSection(File, H.Lights, vLights) ||
+      !ReadSection(File, H.Nodes, World.BVH.vNodes) || !ReadSection(File, H.Indices, World.BVH.vIndices) ||
+      !ReadSection(File, H.SoAInv, World.Spheres.vInv) || !ReadSection(File, H.SoAObject, World.Spheres.vObject))
+  {
+    return (Fail("The scene cache is truncated."));
+  }
+  if (!IsBVHInRange(World.BVH, vObjects.size(), World.BVH.vIndices.size()))
+  {
+    return (Fail("The BVH in the scene cache is corrupt."));
+  }
+
+  object_arena<sphere> Spheres{};
+  object_arena<mesh> Meshes{};
+  World.vPtrObjects.reserve(vObjects.size());
+  for (cache_object const &C : vObjects)
+  {
+    shared_ptr_object pObject{};
+    switch (static_cast<shape>(C.Kind))
+    {
+      case shape::SPHERE:
+        pObject = Spheres.New();
+        static_cast<sphere &>(*pObject).Radius = C.Radius;
+        break;
+      case shape::CUBE:
+        pObject = std::make_shared<cube>();
+        break;
+      case shape::MESH:
+        if (C.Mesh >= static_cast<int>(vMeshes.size())) return (Fail("A mesh in the scene cache is corrupt."));
+        pObject = Meshes.New();
+        if (C.Mesh >= 0) static_cast<mesh &>(*pObject).pData = vMeshes[C.Mesh];
+        break;
+      default:
+        return (Fail("An object in the scene cache has an unknown shape."));
+    }
+    pObject->Material = C.Material;
+    pObject->Center = C.Center;
+    pObject->Transform.SetWithInverse(C.Matrix, C.Inv);
+    World.vPtrObjects.push_back(std::move(pObject));
+  }
+  for (light const &Light : vLights)
+  {
+    World.vPtrLights.push_back(std::make_shared<light>(Light));
+  }
+
+  sphere_soa &S = World.Spheres;
+  S.Count = H.SoACount;
+  S.Stride = H.SoAStride;
+  S.BVHOrder = H.SoABVHOrder != 0;
+  bool const SoAOk = S.Count >= 0 && S.Count <= S.Stride && static_cast<size_t>(S.Count) == S.vObject.size() &&
+                     (!S.BVHOrder || static_cast<size_t>(S.Count) == World.BVH.vIndices.size()) &&
+                     S.vInv.size() * 8 == 16 * static_cast<size_t>(S.Stride) &&
+                     std::all_of(S.vObject.begin(), S.vObject.end(),
+                                 [&](int const Index) { return (Index >= 0 && Index < World.Count()); });
+  if (!SoAOk) return (Fail("The sphere arrays in the scene cache are corrupt."));
+
+  Camera = camera{};
+  Camera.HSize = H.HSize;
+  Camera.VSize = H.VSize;
+  Camera.FieldOfView = H.FieldOfView;
+  Camera.PixelSize = H.PixelSize;
+  Camera.HalfWidth = H.HalfWidth;
+  Camera.HalfHeight = H.HalfHeight;
+  Camera.Transform.SetWithInverse(H.CameraMatrix, H.CameraInv);
+
+  Stats.Objects = World.vPtrObjects.size();
+  Stats.Lights = World.vPtrLights.size();
+  Stats.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+  return (true);
+}
+
+//------------------------------------------------------------------------------
+shared_ptr_object PtrDefaultSphere()
+{
+  shared_ptr_object pSphere{};
+  pSphere.reset(new sphere);
+  return (pSphere);
+}
+
+//------------------------------------------------------------------------------
+prepare_computation PrepareComputations(intersection const &I, ray const &R)
+{
+  return (PrepareComputations(*I.pObject, I.t, R, I.Primitive));
+}
+
+//------------------------------------------------------------------------------
+prepare_computation PrepareComputations(object const &Object, float const t, ray const &R, int const Primitive)
+{
+  prepare_computation Comps{};
+
+  // NOTE: Assign values we want to keep.
+  Comps.t = t;
+  Comps.pObject = &Object;
+
+  // NOTE: Compute some useful values.
+  Comps.Point = PositionAt(R, Comps.t);
+  Comps.Eye = -R.Direction;
+  Comps.Normal = NormalAt(Object, Comps.Point, Primitive);
+
+  // NOTE: Adjust Point for floating point inaccuracy.
+  Comps.Point = Comps.Point + Comps.Normal * EPSILON;
+
+  // NOTE: We use the dot product between the Normal and the Eye to figure out if the normal points
+  //       away from the Eye. If negative they are (roughly) pointing in opposite directions.
+  if (Dot(Comps.Normal, Comps.Eye) < 0.f)
+  {
+    Comps.Inside = true;  // NOTE: Default for the flag is false, no need to clear it once again.
+    Comps.Normal = -Comps.Normal;
+  }
+
+  return (Comps);
+}
+
+//------------------------------------------------------------------------------
+tup ShadeHit(world const &W, prepare_computation const &Comps)
+{
+  tup Color{};
+
+  for (auto const &pWorldLight : W.vPtrLights)
+  {
+    light const &WorldLight = *pWorldLight;
+
+    // NOTE: Only the shadow from this light matters for its contribution.
+    bool const Shadowed = IsShadowed(W, Comps.Point, WorldLight);
+
+    tup C = Lighting(Comps.pObject->Material,  //!<
+                     WorldLight,               //!<
+                     Comps.Point,              //!<
+                     Comps.Eye,                //!<
+                     Comps.Normal,             //!<
+                     Shadowed                  //!<
+    );
+
+    // NOTE: Add the colors from the various lights.
+    Color = Color + C;
+  }
+  return (Color);
+}
+
+//------------------------------------------------------------------------------
+tup ColorAt(world const &World, ray const &Ray)
+{
+  // 1. and 2. Find the Hit of the given ray with the world. ClosestHit() gives the same
+  //    hit as calling Hit() on the result of IntersectWorld(), but without allocating.
+  world_hit const H = ClosestHit(World, Ray);
+  return (ColorAt(World, Ray, H));
+}
+
+//------------------------------------------------------------------------------
+tup ColorAt(world const &World, ray const &Ray, world_hit const &H)
+{
+  tup Result{};
+
+  // 3. Return the Color black if there is no such intersection.
+  if (H.Index < 0) return Result;
+
+  // 4. Otherwise pre-compute the necessary values with PrepareComputations
+  prepare_computation const PC = PrepareComputations(*World.vPtrObjects[H.Index], H.t, Ray, H.Primitive);
+
+  // 5. Call shade hit to find the color at the hit.
+  Result = ShadeHit(World, PC);
+
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+matrix ViewTransform(tup const &From, tup const &To, tup const &Up)
+{
+  // 1. Compute the Forward vector by subtracting the From from To.
+  tup const Forward = Normalize(To - From);
+
+  // 2. Compute the Left vector by taking the cross product of Forward and the
+  //    normalized Up vector.
+  tup const UpNorm = Normalize(Up);
+  tup const Left = Cross(Forward, UpNorm);
+
+  // 3. Compute the TrueUp vector by taking the cross product of Left and Forward.
+  //    This allows us to use an original Up vector to be approximately up. Framing
+  //    a scene is a lot easier when we dont have to calculate a precise up vector.
+  // tup const Left = Normalize(Cross(Forward, UpNorm));
+  tup const TrueUp = Cross(Left, Forward);
+
+  // 4. With Left, TrueUp and Forward we can now construct a matrix that represent
+  //    an orientation transformation.
+  matrix const Orientation = Matrix44(tup{Left.X, Left.Y, Left.Z, 0.f},              //!<
+                                      tup{TrueUp.X, TrueUp.Y, TrueUp.Z, 0.f},        //!<
+                                      tup{-Forward.X, -Forward.Y, -Forward.Z, 0.f},  //!<
+                                      tup{0.f, 0.f, 0.f, 1.f}                        //!<
+  );
+
+  // 5. Finally, append a translation to the transformation to move the scene into place
+  //    before orienting it. Multiply Orientation by Translation(-From.X, -From.Y, -From.Z)
+  //    and we are done.
+  matrix const Result = Orientation * Translation(-From.X, -From.Y, -From.Z);
+
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+camera Camera(int const HSize, int const VSize, float const FieldOfView)
+{
+  camera C{};
+
+  C.HSize = HSize;
+  C.VSize = VSize;
+  C.FieldOfView = FieldOfView;
+
+  // 1. You know the canvas is one unit away, and you know the angle of the field of view.
+  //    By cutting the field of view in half, you create a right triangle,
+  float HalfView = std::tan(C.FieldOfView / 2.f);
+
+  // 2. The aspect ratio is the ratio of the Horisontal to the Vertical size.
+  float const Aspect = float(C.HSize) / float(C.VSize);  // Who is going to create a canvas of zero height?
+
+  // 3. Now if the Horisontal size is greater than or equal to the vertical size (aspect >= 1),
+  //    then the HalfView is Half of the Width of the canvas and HalfView/Aspect is half the
+  //    canvas' Height.
+  //    If the vertial size is greater than the horizontal size (Aspect < 1), then the HalfView
+  //    is instead the height of the canvas, and the half of the canvas' Width is HalfView * Aspect.
+  if (Aspect >= 1.f)
+  {
+    C.HalfWidth = HalfView;
+    C.HalfHeight = HalfView / Aspect;
+  }
+  else
+  {
+    C.HalfWidth = HalfView * Aspect;
+    C.HalfHeight = HalfView;
+  }
+
+  // 4. Compute the size of a single pixel on the canvas by dividing the full width of the
+  //    canvas (half width * 2) by the horizontal size in pixels of the canvas (HSize).
+  //    This is the pixel size.
+  C.PixelSize = (C.HalfWidth * 2.f) / C.HSize;
+
+  return (C);
+}
+
+//------------------------------------------------------------------------------
+ray RayForPixel(camera const &Camera, int const Px, int const Py)
+{
+  // The offset from edge of the canvas to the pixel's center
+  float const XOffset = (Px + 0.5f) * Camera.PixelSize;
+  float const YOffset = (Py + 0.5f) * Camera.PixelSize;
+
+  // The untransformed coordinates of the pixel in world-space.
+  // (remember that the camera looks toward -z, so +x is toward the *left*).
+  float const WorldX = Camera.HalfWidth - XOffset;
+  float const WorldY = Camera.HalfHeight - YOffset;
+
+  // Using the camera matrix, transform the canvas point and the origin,
+  // and compute the ray's direction vector.
+  // Remember that the canvas is at z=-1.
+  tup const Pixel = Camera.Transform.Inv() * Point(WorldX, WorldY, -1.f);
+  tup const Origin = Camera.Transform.Inv() * Point(0.f, 0.f, 0.f);
+  tup const Direction = Normalize(Pixel - Origin);
+  ray const R = Ray(Origin, Direction);
+
+  return (R);
+}
+
+//------------------------------------------------------------------------------
+ray_generator RayGenerator(camera const &Camera)
+{
+  ray_generator G{};
+  matrix const &Inv = Camera.Transform.Inv();
+
+  // NOTE: The pixel position is linear in Px and Py, see RayForPixel above, so the
+  //       pixel steps are the transformed steps along X and Y on the canvas.
+  float const HalfPixel = 0.5f * Camera.PixelSize;
+  G.Origin = Inv * Point(0.f, 0.f, 0.f);
+  G.Pixel00 = Inv * Point(Camera.HalfWidth - HalfPixel, Camera.HalfHeight - HalfPixel, -1.f);
+  G.DX = Inv * Vector(-Camera.PixelSize, 0.f, 0.f);
+  G.DY = Inv * Vector(0.f, -Camera.PixelSize, 0.f);
+  return (G);
+}
+
+//------------------------------------------------------------------------------
+tup ScanlineStart(ray_generator const &G, int const Py)
+{
+  tup const Result = G.Pixel00 + float(Py) * G.DY;
   return (Result);
 }
 
 //------------------------------------------------------------------------------
-intersections &Intersections(intersections &XS, intersection const &I)
+ray RayForPixel(ray_generator const &G, tup const &Pixel)
 {
-  XS.vI.push_back(I);
-  return (XS);
+  ray const R = Ray(G.Origin, Normalize(Pixel - G.Origin));
+  return (R);
 }
 
 //------------------------------------------------------------------------------
-bool Equal(material const &A, material const &B)
+ray RayForSample(ray_generator const &G, float const X, float const Y)
 {
-  bool Result{};
-  Result = Equal(A.Ambient, B.Ambient) && Equal(A.Diffuse, B.Diffuse) && Equal(A.Shininess, B.Shininess) &&
-           Equal(A.Specular, B.Specular) && Equal(A.Color, B.Color);
-  return (Result);
+  // NOTE: Added up in the same order as ScanlineStart(G, Y) + float(X) * G.DX.
+  ray const R = RayForPixel(G, G.Pixel00 + Y * G.DY + X * G.DX);
+  return (R);
 }
 
 //------------------------------------------------------------------------------
-bool Equal(sphere const &A, sphere const &B)
+ray_packet RayPacket(ray_generator const &G, tile const &Block)
 {
-  bool const EqMaterial = A.Material == B.Material;
-  bool const EqTransform = A.Transform == B.Transform;
-  return (Equal(A.Center, B.Center) && Equal(A.Radius, B.Radius) && EqMaterial && EqTransform);
+  ray_packet Packet{};
+  for (int Y = Block.Y0;  ///<!
+       Y < Block.Y1;      ///<!
+       ++Y)
+  {
+    tup const Start = ScanlineStart(G, Y);
+    for (int X = Block.X0;  ///<!
+         X < Block.X1;      ///<!
+         ++X)
+    {
+      Assert(Packet.Count < ray_packet::MAX_RAYS, __FUNCTION__, __LINE__);
+
+      // NOTE: The same ray as RenderTile traces for the pixel, component by component.
+      ray const R = RayForPixel(G, Start + float(X) * G.DX);
+      for (int C = 0;  ///<!
+           C < 4;      ///<!
+           ++C)
+      {
+        Packet.Origin[C][Packet.Count] = R.Origin.C[C];
+        Packet.Direction[C][Packet.Count] = R.Direction.C[C];
+      }
+      ++Packet.Count;
+    }
+  }
+  return (Packet);
 }
 
 //------------------------------------------------------------------------------
-bool Equal(intersection const &A, intersection const &B)
+ray PacketRay(ray_packet const &Packet, int const Lane)
 {
-  bool const Result = Equal(A.t, B.t);
-  // std::cout << "Result:" << Result << ". Equal -> A:" << A.t << " B:" << B.t << std::endl;
+  ray R{};
+  for (int C = 0;  ///<!
+       C < 4;      ///<!
+       ++C)
+  {
+    R.Origin.C[C] = Packet.Origin[C][Lane];
+    R.Direction.C[C] = Packet.Direction[C][Lane];
+  }
+  return (R);
+}
 
-  return (Result);
+//------------------------------------------------------------------------------
+canvas Render(camera const &Camera, world const &World, int const PacketSize)
+{
+  canvas Image(Camera.HSize, Camera.VSize);
+
+  // NOTE: The whole canvas is one single tile.
+  tile const Tile{0, 0, Camera.HSize, Camera.VSize};
+  RenderTile(Camera, World, Tile, Image, PacketSize);
+
+  return (Image);
 }
 
 //------------------------------------------------------------------------------
-bool Equal(light const &A, light const &B)
+std::vector<tile> Tiles(int const W, int const H, int const TileSize)
 {
-  bool const Result = Equal(A.Intensity, B.Intensity) && Equal(A.Position, B.Position);
+  std::vector<tile> Result{};
+  int const Size = std::max<int>(1, TileSize);
+
+  for (int Y = 0;  ///<!
+       Y < H;      ///<!
+       Y += Size)
+  {
+    for (int X = 0;  ///<!
+         X < W;      ///<!
+         X += Size)
+    {
+      tile const T{X, Y, std::min<int>(X + Size, W), std::min<int>(Y + Size, H)};
+      Result.push_back(T);
+    }
+  }
+
   return (Result);
 }
 
 //------------------------------------------------------------------------------
-intersection Hit1(intersections const &Intersections)
+void RenderTile(camera const &Camera, world const &World, tile const &Tile, canvas &Image, int const PacketSize,
+                int const Samples)
 {
-  intersection Result{};
+  ray_generator const G = RayGenerator(Camera);
 
-  // ---
-  // NOTE: Check that there is anything in the vector.
-  // ---
-  if (Intersections.Count() == 2)
+  if (Samples > 1)
   {
-    float const &H0 = Intersections.vI[0].t;
-    float const &H1 = Intersections.vI[1].t;
-    // Decide on the minimum t. Seed it with the first entry of intersections.
-    float Checkt = std::max<float>(H0, H1);
-
-    // NOTE: There is at least one hit since the checked value is not negative.
-    if (Checkt >= 0)
+    // NOTE: N x N rays on a regular grid inside each pixel, averaged.
+    int N{1};
+    while ((N + 1) * (N + 1) <= Samples) ++N;
+    float const Weight = 1.f / float(N * N);
+    for (int Y = Tile.Y0;  ///<!
+         Y < Tile.Y1;      ///<!
+         ++Y)
     {
-      if ((H0 >= 0) && (H0 <= H1))
+      for (int X = Tile.X0;  ///<!
+           X < Tile.X1;      ///<!
+           ++X)
       {
-        Result = Intersections.vI[0];
-        // std::cout << "Count2A:Updated result with t:" << Result.t << std::endl;
+        tup Sum = Color(0.f, 0.f, 0.f);
+        for (int SY = 0;  ///<!
+             SY < N;      ///<!
+             ++SY)
+        {
+          for (int SX = 0;  ///<!
+               SX < N;      ///<!
+               ++SX)
+          {
+            float const DX = (SX + 0.5f) / N - 0.5f;
+            float const DY = (SY + 0.5f) / N - 0.5f;
+            Sum = Sum + ColorAt(World, RayForSample(G, X + DX, Y + DY));
+          }
+        }
+        WritePixel(Image, X, Y, Sum * Weight);
       }
-      else if ((H1 >= 0) && ((H1 <= H0) || (H0 < 0)))
+    }
+    return;
+  }
+
+  if (PacketSize > 1)
+  {
+    // NOTE: Blocks of PacketSize x PacketSize pixels, smaller along the right and bottom
+    //       edge of the tile. The packet holds the rays in the same order as the loops below.
+    int const Size = std::min<int>(PacketSize, 4);
+    world_hit Hits[ray_packet::MAX_RAYS];
+    for (int Y0 = Tile.Y0;  ///<!
+         Y0 < Tile.Y1;      ///<!
+         Y0 += Size)
+    {
+      for (int X0 = Tile.X0;  ///<!
+           X0 < Tile.X1;      ///<!
+           X0 += Size)
       {
-        Result = Intersections.vI[1];
-        // std::cout << "Count2B:Updated result with t:" << Result.t << std::endl;
+        tile const Block{X0, Y0, std::min<int>(X0 + Size, Tile.X1), std::min<int>(Y0 + Size, Tile.Y1)};
+        ray_packet const Packet = RayPacket(G, Block);
+        ClosestHits(World, Packet, Hits);
+
+        int Lane{};
+        for (int Y = Block.Y0;  ///<!
+             Y < Block.Y1;      ///<!
+             ++Y)
+        {
+          for (int X = Block.X0;  ///<!
+               X < Block.X1;      ///<!
+               ++X, ++Lane)
+          {
+            tup const Color = ColorAt(World, PacketRay(Packet, Lane), Hits[Lane]);
+            WritePixel(Image, X, Y, Color);
+          }
+        }
       }
     }
+    return;
   }
-  // NOTE: This part of the code is untested .... FIXME: (Willy Clarke)
-  else if (Intersections.Count() == 1)
+
+  for (int Y = Tile.Y0;  ///<!
+       Y < Tile.Y1;      ///<!
+       ++Y)
   {
-    // NOTE: assert here until this code is ready for testing.
-    Assert(Intersections.Count() == 0, __FUNCTION__, __LINE__);
-    float const &H0 = Intersections.vI[0].t;
-    if (H0 > 0)
+    tup const Start = ScanlineStart(G, Y);
+    for (int X = Tile.X0;  ///<!
+         X < Tile.X1;      ///<!
+         ++X)
     {
-      Result = Intersections.vI[0];
-      std::cout << "Count1:Updated result with t:" << Result.t << std::endl;
+      ray const R = RayForPixel(G, Start + float(X) * G.DX);
+      tup const Color = ColorAt(World, R);
+      WritePixel(Image, X, Y, Color);
     }
   }
-  return (Result);
 }
 
 //------------------------------------------------------------------------------
-intersection Hit(intersections const &Intersections)
+void RunTasks(int const Count, int const NumThreads, std::function<void(int Index, int Worker)> const &Task,
+              schedule_stats &Stats)
 {
-  intersection Result{};
-
-  bool DoFirstUpdate{true};
-
-  for (auto I : Intersections.vI)
+  auto const Start = std::chrono::steady_clock::now();
+  int Workers = NumThreads > 0 ? NumThreads : static_cast<int>(std::thread::hardware_concurrency());
+  Workers = std::max<int>(1, std::min<int>(Workers, Count));
+  Stats = schedule_stats{};
+  Stats.vWorkers.assign(Workers, worker_stats{});
+
+  // NOTE: Every worker starts with its own contiguous share, so neighbouring tiles stay on
+  //       one thread until the cheap shares run out and their workers start to steal.
+  std::vector<task_deque> vDeques(Workers);
+  for (int Idx = 0;    ///<!
+       Idx < Workers;  ///<!
+       ++Idx)
   {
-    if (I.t > 0)
+    uint32_t const Front = uint32_t(int64_t(Count) * Idx / Workers);
+    uint32_t const Back = uint32_t(int64_t(Count) * (Idx + 1) / Workers);
+    vDeques[Idx].Tasks.store(task_deque::Pack(Front, Back), std::memory_order_relaxed);
+  }
+
+  auto Worker = [&](int const Self) {
+    worker_stats Own{};
+    task_deque &Deque = vDeques[Self];
+    for (;;)
     {
-      if (DoFirstUpdate)
-      {
-        Result = I;
-        DoFirstUpdate = false;
-      }
-      else if (I.t < Result.t)
+      int Index = Deque.PopFront();
+      for (int Offset = 1;                 ///<! The other deques, from the next one on.
+           Index < 0 && Offset < Workers;  ///<!
+           ++Offset)
       {
-        Result = I;
+        uint32_t First{};
+        int const Stolen = vDeques[(Self + Offset) % Workers].StealHalf(First);
+        if (!Stolen) continue;
+
+        // NOTE: Keep the first and leave the rest in the own deque, which is empty, where
+        //       others may steal it again.
+        ++Own.Steals;
+        Own.Stolen += Stolen;
+        Deque.Tasks.store(task_deque::Pack(First + 1, First + Stolen), std::memory_order_release);
+        Index = int(First);
       }
+      if (Index < 0) break;
+
+      auto const Begin = std::chrono::steady_clock::now();
+      Task(Index, Self);
+      Own.BusySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - Begin).count();
+      ++Own.Tasks;
     }
+    Stats.vWorkers[Self] = Own;
+  };
+
+  std::vector<std::thread> vThreads{};
+  for (int Idx = 1;    ///<! The calling thread is worker number 0.
+       Idx < Workers;  ///<!
+       ++Idx)
+  {
+    vThreads.emplace_back(Worker, Idx);
   }
-  return (Result);
+  Worker(0);
+  for (auto &Thread : vThreads)
+  {
+    Thread.join();
+  }
+  Stats.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
 }
 
 //------------------------------------------------------------------------------
-ray Mul(matrix const &M, ray const &R)
+canvas RenderParallel(camera const &Camera, world const &World, int const NumThreads, int const TileSize,
+                      int const PacketSize, int const Samples)
 {
-  ray Result{};
-  Result.Origin = M * R.Origin;
-  Result.Direction = M * R.Direction;
-  return (Result);
+  schedule_stats Stats{};
+  return (RenderParallel(Camera, World, Stats, NumThreads, TileSize, PacketSize, Samples));
 }
 
 //------------------------------------------------------------------------------
-ray Transform(ray const &R, matrix const &M) { return M * R; }
-
-//------------------------------------------------------------------------------
-// \fn NormalAt
-// \brief Calculate normal vector at given point. The resulting vector will
-//        be normalized to a length of 1.f.
-//------------------------------------------------------------------------------
-tup NormalAt(object const &O, tup const &P)
+canvas RenderParallel(camera const &Camera, world const &World, schedule_stats &Stats, int const NumThreads,
+                      int const TileSize, int const PacketSize, int const Samples)
 {
-  tup const ObjectPoint = Inverse(O.Transform) * P;
-  tup const ObjectNormal = ObjectPoint - Point(0.f, 0.f, 0.f);
-
-  tup WorldNormal = Transpose(Inverse(O.Transform)) * ObjectNormal;
-  WorldNormal.W = 0.f;
-
-  tup const Result = Normalize(WorldNormal);
-  return (Result);
-}
+  canvas Image(Camera.HSize, Camera.VSize);
 
-//------------------------------------------------------------------------------
-// \fn Reflect
-// \brief Calculate the reflection vector based on the input and the surface normal.
-// \sa https://math.stackexchange.com/questions/13261/how-to-get-a-reflection-vector
-// \sa https://en.wikipedia.org/wiki/Vector_projection
-//------------------------------------------------------------------------------
-tup Reflect(tup const &In, tup const &Normal)
-{
-  tup Result{};
-  Result = In - Normal * 2.f * Dot(In, Normal);
-  return (Result);
+  // NOTE: The tiles do not overlap and the canvas is already sized, so the workers never
+  //       write to the same pixel and no lock is needed. The tiles are only read, so they
+  //       share cache lines without contention.
+  std::vector<tile> const vTiles = Tiles(Camera.HSize, Camera.VSize, TileSize);
+  RunTasks(
+      static_cast<int>(vTiles.size()), NumThreads,
+      [&](int const Index, int) { RenderTile(Camera, World, vTiles[Index], Image, PacketSize, Samples); }, Stats);
+  return (Image);
 }
 
 //------------------------------------------------------------------------------
-light PointLight(tup const &Position, tup const &Intensity)
-{
-  light Result{};
-  Result.Position = Position;
-  Result.Intensity = Intensity;
-  return (Result);
-}
-//------------------------------------------------------------------------------
-tup Lighting(material const &Material,  //!<
-             light const &Light,        //!<
-             tup const &Position,       //!<
-             tup const &vEye,           //!<
-             tup const &vNormal,        //!<
-             bool const InShadow        //!<
-)
+canvas RenderProgressive(camera const &Camera, world const &World, progress_callback const &Progress,
+                         float const FlushSeconds, int const NumThreads)
 {
-  tup Result{};
-  // Combine the surface color with the light''s color/intensity.
-  tup const EffectiveColor = Material.Color * Light.Intensity;
+  canvas Image(Camera.HSize, Camera.VSize);
+  ray_generator const G = RayGenerator(Camera);
 
-  // Find the direction to the light source.
-  tup const vLight = Normalize(Light.Position - Position);
+  int Count = NumThreads > 0 ? NumThreads : static_cast<int>(std::thread::hardware_concurrency());
+  Count = std::max<int>(1, Count);
 
-  // Compute the ambient contribution
-  tup const Ambient = EffectiveColor * Material.Ambient;
+  auto LastFlush = std::chrono::steady_clock::now();
+  auto Flush = [&](int const Step) {
+    Progress(Image, Step);
+    LastFlush = std::chrono::steady_clock::now();
+  };
 
-  // Light dot Normal represents the cosine of the angle between the
-  // light vector and the normal vector. A negative number means that
-  // the light is on the other side of the surface.
-  float const LightDotNormal = Dot(vLight, vNormal);
+  for (int Step = PROGRESSIVE_STEP;  ///<!
+       Step > 0;                     ///<!
+       Step /= 2)
+  {
+    // ---
+    // NOTE: Render the pixels on the grid of this pass that are not on the grid of the pass
+    //       before, then fill the block of Step x Step pixels below and to the right of each
+    //       pixel on the grid with its color. The rendered pixels of earlier passes are kept,
+    //       and every pixel is rendered once, with the same ray as in RenderTile.
+    // ---
+    auto RenderRow = [&](int const Y) {
+      tup const Start = ScanlineStart(G, Y);
+      bool const CoarseRow = Step < PROGRESSIVE_STEP && Y % (2 * Step) == 0;
+      for (int X = 0;         ///<!
+           X < Camera.HSize;  ///<!
+           X += Step)
+      {
+        if (!(CoarseRow && X % (2 * Step) == 0))
+        {
+          WritePixel(Image, X, Y, ColorAt(World, RayForPixel(G, Start + float(X) * G.DX)));
+        }
+      }
+      for (int FillY = Y;                                  ///<!
+           FillY < std::min<int>(Y + Step, Camera.VSize);  ///<!
+           ++FillY)
+      {
+        for (int X = 0;         ///<!
+             X < Camera.HSize;  ///<!
+             ++X)
+        {
+          if (FillY != Y || X % Step) WritePixel(Image, X, FillY, PixelAt(Image, X - X % Step, Y));
+        }
+      }
+    };
+
+    // NOTE: The rows of the pass are done in batches. Each row only writes its own block of
+    //       rows, so the workers need no lock, and the canvas is only flushed between batches.
+    int const Rows = (Camera.VSize + Step - 1) / Step;
+    int const Batch = 4 * Count;
+    for (int First = 0;  ///<!
+         First < Rows;   ///<!
+         First += Batch)
+    {
+      int const Last = std::min<int>(First + Batch, Rows);
+      std::atomic<int> NextRow{First};
+      auto Worker = [&]() {
+        for (int Row = NextRow++;  ///<!
+             Row < Last;           ///<!
+             Row = NextRow++)
+        {
+          RenderRow(Row * Step);
+        }
+      };
 
-  // Assert(LightDotNormal < 0.f, __FUNCTION__, __LINE__);
+      std::vector<std::thread> vThreads{};
+      for (int Idx = 1;                               ///<! The calling thread is worker number 0.
+           Idx < std::min<int>(Count, Last - First);  ///<!
+           ++Idx)
+      {
+        vThreads.emplace_back(Worker);
+      }
+      Worker();
+      for (auto &Thread : vThreads)
+      {
+        Thread.join();
+      }
 
-  tup Diffuse{};
-  tup Specular{};
+      std::chrono::duration<float> const SinceFlush = std::chrono::steady_clock::now() - LastFlush;
+      if (Last < Rows && SinceFlush.count() >= FlushSeconds) Flush(Step);
+    }
 
-  if (LightDotNormal < 0.f)  // pointing away ...
-  {
-    Diffuse = Color(0.f, 0.f, 0.f);
-    Specular = Color(0.f, 0.f, 0.f);
+    // NOTE: The end of every pass is shown, the coarse one as soon as it is ready.
+    Flush(Step);
   }
-  else
-  {
-    // Compute the diffuse contribution
-    Diffuse = EffectiveColor * Material.Diffuse * LightDotNormal;
 
-    // Reflect dot eye represents the cosine of the angle between the
-    // reflection vector and the eye vector.
-    // A negative value means that the light reflects away from the eye.
-    tup vReflect = Reflect(-vLight, vNormal);
-    float const ReflectDotEye = Dot(vReflect, vEye);
-    if (ReflectDotEye <= 0)
+  return (Image);
+}
+
+//------------------------------------------------------------------------------
+canvas RenderProgressive(camera const &Camera, world const &World, std::string const &Filename,
+                         float const FlushSeconds, int const NumThreads)
+{
+  // NOTE: Write to a temporary file and rename it, so a viewer never reads a half written image.
+  std::string const Temporary = Filename + ".tmp";
+  auto WriteFile = [&](canvas const &Image, int const) {
+    if (Filename == "-")
     {
-      Specular = Color(0.f, 0.f, 0.f);  // Black
+      WriteToPPMBinary(Image, Filename);
     }
-    else
+    else if (WriteToPPMBinary(Image, Temporary) == 0)
     {
-      // Compute the specular contribution
-      float const Factor = std::pow(ReflectDotEye, Material.Shininess);
-      Specular = Light.Intensity * Material.Specular * Factor;
+      std::rename(Temporary.c_str(), Filename.c_str());
     }
-  }
-
-  // Add the three contributions together to the the final shading
-  // NOTE: When Inshadow we ignore the specular and diffuse component.
-  if (InShadow)
-  {
-    Result = Ambient;
-  }
-  else
-  {
-    Result = Ambient + Diffuse + Specular;
-  }
-
-  return (Result);
-};
+  };
+  return (RenderProgressive(Camera, World, progress_callback(WriteFile), FlushSeconds, NumThreads));
+}
 
-/// ---
-/// World functions.
-/// ---
-// \fn World - Create a default world.
-world World()
+//------------------------------------------------------------------------------
+canvas RenderAdaptive(camera const &Camera, world const &World, antialias const &Settings, antialias_stats &Stats)
 {
-  world W{};
-
-  light Light = ww::PointLight(ww::Point(-10.f, 10.f, -10.f), ww::Color(1.f, 1.f, 1.f));
-  // W.vLights.push_back(Light);
+  Stats = antialias_stats{};
+  Stats.Rays = static_cast<long long>(Camera.HSize) * Camera.VSize;
+  canvas const Center = RenderParallel(Camera, World, Settings.Threads);
+  canvas Image = Center;
+  if (Settings.MaxDepth < 1) return (Image);
+
+  // NOTE: Find the edges in the image of one ray per pixel, so the result does not depend
+  //       on the order that the pixels are refined in.
+  std::vector<int> vRefine{};
+  for (int Y = 0;         ///<!
+       Y < Camera.VSize;  ///<!
+       ++Y)
   {
-    ww::shared_ptr_light PtrLight{};
-    PtrLight.reset(new ww::light);
-    *PtrLight = Light;
-    W.vPtrLights.push_back(PtrLight);
+    for (int X = 0;         ///<!
+         X < Camera.HSize;  ///<!
+         ++X)
+    {
+      tup const C = PixelAt(Center, X, Y);
+      bool const Edge = (X > 0 && Contrast(C, PixelAt(Center, X - 1, Y)) > Settings.Threshold) ||
+                        (X + 1 < Camera.HSize && Contrast(C, PixelAt(Center, X + 1, Y)) > Settings.Threshold) ||
+                        (Y > 0 && Contrast(C, PixelAt(Center, X, Y - 1)) > Settings.Threshold) ||
+                        (Y + 1 < Camera.VSize && Contrast(C, PixelAt(Center, X, Y + 1)) > Settings.Threshold);
+      if (Edge) vRefine.push_back(Y * Camera.HSize + X);
+    }
   }
 
-  sphere S1{};
-  S1.Material.Color = ww::Color(0.8f, 1.0f, 0.6f);
-  S1.Material.Diffuse = 0.7f;
-  S1.Material.Specular = 0.2f;
-  // W.vObjects.push_back(S1);
+  // NOTE: The pixels to refine are handed out one at a time, as the cost varies a lot.
+  ray_generator const G = RayGenerator(Camera);
+  std::atomic<size_t> NextPixel{};
+  std::atomic<long long> ExtraRays{};
+  auto Worker = [&]() {
+    long long Rays{};
+    for (size_t Idx = NextPixel++;  ///<!
+         Idx < vRefine.size();      ///<!
+         Idx = NextPixel++)
+    {
+      int const X = vRefine[Idx] % Camera.HSize;
+      int const Y = vRefine[Idx] / Camera.HSize;
+      WritePixel(Image, X, Y, SampleArea(World, G, Settings, float(X), float(Y), 1.f, 1, Rays));
+    }
+    ExtraRays += Rays;
+  };
+
+  int Count = Settings.Threads > 0 ? Settings.Threads : static_cast<int>(std::thread::hardware_concurrency());
+  Count = std::max<int>(1, std::min<int>(Count, static_cast<int>(vRefine.size())));
 
+  std::vector<std::thread> vThreads{};
+  for (int Idx = 1;  ///<! The calling thread is worker number 0.
+       Idx < Count;  ///<!
+       ++Idx)
   {
-    ww::shared_ptr_object PtrSphere{};
-    PtrSphere.reset(new ww::sphere);
-    *PtrSphere = S1;
-    W.vPtrObjects.push_back(PtrSphere);
+    vThreads.emplace_back(Worker);
   }
-
-  sphere S2{};
-  S2.Transform = ww::Scaling(0.5f, 0.5f, 0.5f);
-  // W.vObjects.push_back(S2);
+  Worker();
+  for (auto &Thread : vThreads)
   {
-    ww::shared_ptr_object PtrSphere{};
-    PtrSphere.reset(new ww::sphere);
-    *PtrSphere = S2;
-    W.vPtrObjects.push_back(PtrSphere);
+    Thread.join();
   }
 
-  return (W);
+  Stats.ExtraRays = ExtraRays;
+  Stats.Rays += Stats.ExtraRays;
+  Stats.RefinedPixels = static_cast<int>(vRefine.size());
+  return (Image);
 }
 
 //------------------------------------------------------------------------------
-void WorldAddObject(world &W, shared_ptr_object pObject) { W.vPtrObjects.push_back(pObject); }
-//------------------------------------------------------------------------------
-void WorldAddLight(world &W, shared_ptr_light pLight) { W.vPtrLights.push_back(pLight); }
-
-//------------------------------------------------------------------------------
-intersections IntersectWorld(world const &World, ray const &Ray)
+canvas RenderCost(camera const &Camera, world const &World, cost_map &Cost)
 {
-  intersections XS{};
+  canvas Image(Camera.HSize, Camera.VSize);
+  Cost.W = Camera.HSize;
+  Cost.H = Camera.VSize;
+  Cost.vPixels.assign(Image.vXY.size(), pixel_cost{});
 
-  for (auto const PtrObject : World.vPtrObjects)
+  ray_generator const G = RayGenerator(Camera);
+  for (int Y = 0;         ///<!
+       Y < Camera.VSize;  ///<!
+       ++Y)
   {
-    if (PtrObject->isA<ww::sphere>())
+    tup const Start = ScanlineStart(G, Y);
+    for (int X = 0;         ///<!
+         X < Camera.HSize;  ///<!
+         ++X)
     {
-      // ww::sphere *pSphere = dynamic_cast<ww::sphere *>(PtrObject.get());
-
-      // NOTE: There may be up to two intersections with a sphere.
-      //       So we detect and get these intersections, and then
-      //       we add them to the resulting XS's vector of intersections.
-      intersections const I = Intersect(PtrObject, Ray);
+#if WW_PIXEL_COST
+      tPixelCost = pixel_cost{};
+#endif
+      auto const Begin = std::chrono::steady_clock::now();
+      ray const R = RayForPixel(G, Start + float(X) * G.DX);
+      tup const Color = ColorAt(World, R);
+      auto const End = std::chrono::steady_clock::now();
 
-      for (auto const &Element : I.vI)
-      {
-        XS.vI.push_back(Element);
-      }
+      pixel_cost &P = Cost.vPixels[Y * Camera.HSize + X];
+#if WW_PIXEL_COST
+      P = tPixelCost;
+#endif
+      P.Nanoseconds = std::chrono::duration<float, std::nano>(End - Begin).count();
+      WritePixel(Image, X, Y, Color);
     }
   }
 
-  // NOTE: Keep the intersections sorted in ascending order.
-  //       Use lambda function to extract the t value for each intersection.
-  std::sort(XS.vI.begin(), XS.vI.end(), [](intersection const &A, intersection const &B) { return A.t < B.t; });
-  return (XS);
-}
-
-//------------------------------------------------------------------------------
-shared_ptr_object PtrDefaultSphere()
-{
-  shared_ptr_object pSphere{};
-  pSphere.reset(new sphere);
-  return (pSphere);
+  return (Image);
 }
 
 //------------------------------------------------------------------------------
-prepare_computation PrepareComputations(intersection const &I, ray const &R)
+canvas CostHeatmap(cost_map const &Cost, cost_channel const Channel)
 {
-  prepare_computation Comps{};
-
-  // NOTE: Assign values we want to keep.
-  Comps.t = I.t;
-  Comps.pObject = I.pObject;
+  canvas Image(Cost.W, Cost.H);
 
-  // NOTE: Compute some useful values.
-  Comps.Point = PositionAt(R, Comps.t);
-  Comps.Eye = -R.Direction;
-  Comps.Normal = NormalAt(*Comps.pObject, Comps.Point);
+  auto Value = [Channel](pixel_cost const &P) {
+    switch (Channel)
+    {
+      case cost_channel::TESTS:
+        return (static_cast<float>(P.Tests));
+      case cost_channel::SHADOW_RAYS:
+        return (static_cast<float>(P.ShadowRays));
+      case cost_channel::NANOSECONDS:
+        break;
+    }
+    return (P.Nanoseconds);
+  };
 
-  // NOTE: Adjust Point for floating point inaccuracy.
-  Comps.Point = Comps.Point + Comps.Normal * EPSILON;
+  float Max{};
+  for (pixel_cost const &P : Cost.vPixels)
+  {
+    Max = std::max(Max, Value(P));
+  }
+  if (Max <= 0.f) return (Image);
 
-  // NOTE: We use the dot product between the Normal and the Eye to figure out if the normal points
-  //       away from the Eye. If negative they are (roughly) pointing in opposite directions.
-  if (Dot(Comps.Normal, Comps.Eye) < 0.f)
+  // NOTE: The color ramp. V from 0 to 1 is spread over the four steps between the stops.
+  tup const Stops[5] = {Color(0.f, 0.f, 0.f), Color(0.f, 0.f, 1.f), Color(1.f, 0.f, 0.f), Color(1.f, 1.f, 0.f),
+                        Color(1.f, 1.f, 1.f)};
+  for (size_t Idx = 0;             ///<!
+       Idx < Cost.vPixels.size();  ///<!
+       ++Idx)
   {
-    Comps.Inside = true;  // NOTE: Default for the flag is false, no need to clear it once again.
-    Comps.Normal = -Comps.Normal;
+    float const V = 4.f * Value(Cost.vPixels[Idx]) / Max;
+    int const Stop = std::min<int>(3, static_cast<int>(V));
+    float const F = V - Stop;
+    Image.vXY[Idx] = Stops[Stop] * (1.f - F) + Stops[Stop + 1] * F;
   }
 
-  return (Comps);
+  return (Image);
 }
 
 //------------------------------------------------------------------------------
-tup ShadeHit(world const &W, prepare_computation const &Comps)
+int WriteCostCSV(cost_map const &Cost, std::string const &Filename, int const TileSize)
 {
-  tup Color{};
+  FILE *fp = std::fopen(Filename.c_str(), "w");
+  if (!fp) return (-1);
 
-  for (auto pWorldLight : W.vPtrLights)
+  std::fprintf(fp, "x0,y0,x1,y1,pixels,tests,shadow_rays,ns,ns_per_pixel\n");
+  for (tile const &T : Tiles(Cost.W, Cost.H, TileSize))
   {
-    light const &WorldLight = *pWorldLight;
-
-    bool const Shadowed = IsShadowed(W, Comps.Point);
-
-    tup C = Lighting(Comps.pObject->Material,  //!<
-                     WorldLight,               //!<
-                     Comps.Point,              //!<
-                     Comps.Eye,                //!<
-                     Comps.Normal,             //!<
-                     Shadowed                  //!<
-    );
-
-    // NOTE: Add the colors from the various lights.
-    Color = Color + C;
+    unsigned long long Tests{};
+    unsigned long long ShadowRays{};
+    double Nanoseconds{};
+    for (int Y = T.Y0;  ///<!
+         Y < T.Y1;      ///<!
+         ++Y)
+    {
+      for (int X = T.X0;  ///<!
+           X < T.X1;      ///<!
+           ++X)
+      {
+        pixel_cost const &P = Cost.vPixels[Y * Cost.W + X];
+        Tests += P.Tests;
+        ShadowRays += P.ShadowRays;
+        Nanoseconds += P.Nanoseconds;
+      }
+    }
+    int const Pixels = (T.X1 - T.X0) * (T.Y1 - T.Y0);
+    std::fprintf(fp, "%d,%d,%d,%d,%d,%llu,%llu,%.0f,%.1f\n", T.X0, T.Y0, T.X1, T.Y1, Pixels, Tests, ShadowRays,
+                 Nanoseconds, Nanoseconds / Pixels);
   }
-  return (Color);
+
+  return (std::fclose(fp) == 0 ? 0 : -1);
 }
 
 //------------------------------------------------------------------------------
-tup ColorAt(world const &World, ray const &Ray)
+bounds Bounds(object const &Object)
 {
-  tup Result{};
-  // 1. Call IntersectWorld() to find out the intersections of the given ray with the world.
-  intersections const IS = IntersectWorld(World, Ray);
+  bounds Result{};
 
-  // 2. Find the Hit from the resulting intersections.
-  intersection const I = Hit(IS);
+  // NOTE: In object space the sphere (and the cube) fits inside the box from
+  //       (-1,-1,-1) to (1,1,1), and a mesh inside the box of its vertices.
+  //       Transform all eight corners to world space and grow the box around them.
+  bounds Local{Point(-1.f, -1.f, -1.f), Point(1.f, 1.f, 1.f)};
+  if (Object.Kind == shape::MESH)
+  {
+    mesh const &Mesh = static_cast<mesh const &>(Object);
+    if (!Mesh.pData || Mesh.pData->vTriangles.empty()) return (Result);
+    Local = Mesh.pData->Box;
+  }
 
-  // 3. Return the Color black if there is no such intersection.
-  if (IS.Count() == 0) return Result;
+  for (int Idx = 0;  ///<!
+       Idx < 8;      ///<!
+       ++Idx)
+  {
+    tup const Corner = Point((Idx & 1) ? Local.Max.X : Local.Min.X,  //!<
+                             (Idx & 2) ? Local.Max.Y : Local.Min.Y,  //!<
+                             (Idx & 4) ? Local.Max.Z : Local.Min.Z);
+    tup const P = Object.Transform.Matrix() * Corner;
+    for (int C = 0;  ///<!
+         C < 3;      ///<!
+         ++C)
+    {
+      Result.Min.C[C] = std::min<float>(Result.Min.C[C], P.C[C]);
+      Result.Max.C[C] = std::max<float>(Result.Max.C[C], P.C[C]);
+    }
+  }
 
-  // 4. Otherwise pre-compute the necessary values with PrepareComputations
-  prepare_computation const PC = PrepareComputations(I, Ray);
+  return (Result);
+}
 
-  // 5. Call shade hit to find the color at the hit.
-  Result = ShadeHit(World, PC);
+//------------------------------------------------------------------------------
+bounds Merge(bounds const &A, bounds const &B)
+{
+  bounds Result{};
+  for (int C = 0;  ///<!
+       C < 3;      ///<!
+       ++C)
+  {
+    Result.Min.C[C] = std::min<float>(A.Min.C[C], B.Min.C[C]);
+    Result.Max.C[C] = std::max<float>(A.Max.C[C], B.Max.C[C]);
+  }
+  return (Result);
+}
 
+//------------------------------------------------------------------------------
+float SurfaceArea(bounds const &B)
+{
+  tup const D = B.Max - B.Min;
+  if (D.X < 0.f || D.Y < 0.f || D.Z < 0.f) return (0.f);
+  float const Result = 2.f * (D.X * D.Y + D.Y * D.Z + D.Z * D.X);
   return (Result);
 }
 
 //------------------------------------------------------------------------------
-matrix ViewTransform(tup const &From, tup const &To, tup const &Up)
+bool IsBVHValid(world const &World)
 {
-  // 1. Compute the Forward vector by subtracting the From from To.
-  tup const Forward = Normalize(To - From);
+  bool const Result = !World.BVH.vNodes.empty() && (World.BVH.vIndices.size() == World.vPtrObjects.size());
+  return (Result);
+}
 
-  // 2. Compute the Left vector by taking the cross product of Forward and the
-  //    normalized Up vector.
-  tup const UpNorm = Normalize(Up);
-  tup const Left = Cross(Forward, UpNorm);
+//------------------------------------------------------------------------------
+void BuildBVH(world &World)
+{
+  std::vector<bvh_entry> vEntries{};
+  vEntries.reserve(World.vPtrObjects.size());
+  for (size_t Idx = 0;                  ///<!
+       Idx < World.vPtrObjects.size();  ///<!
+       ++Idx)
+  {
+    bvh_entry E{};
+    E.Box = Bounds(*World.vPtrObjects[Idx]);
+    E.Centroid = (E.Box.Min + E.Box.Max) * 0.5f;
+    E.Index = static_cast<int>(Idx);
+    vEntries.push_back(E);
+  }
+  BuildBVHFromEntries(World.BVH, vEntries);
 
-  // 3. Compute the TrueUp vector by taking the cross product of Left and Forward.
-  //    This allows us to use an original Up vector to be approximately up. Framing
-  //    a scene is a lot easier when we dont have to calculate a precise up vector.
-  // tup const Left = Normalize(Cross(Forward, UpNorm));
-  tup const TrueUp = Cross(Left, Forward);
+  // NOTE: The sphere arrays follow the order of the leaves.
+  if (World.Spheres.Count > 0) BuildSphereSoA(World);
+}
 
-  // 4. With Left, TrueUp and Forward we can now construct a matrix that represent
-  //    an orientation transformation.
-  matrix const Orientation = Matrix44(tup{Left.X, Left.Y, Left.Z, 0.f},              //!<
-                                      tup{TrueUp.X, TrueUp.Y, TrueUp.Z, 0.f},        //!<
-                                      tup{-Forward.X, -Forward.Y, -Forward.Z, 0.f},  //!<
-                                      tup{0.f, 0.f, 0.f, 1.f}                        //!<
-  );
+//------------------------------------------------------------------------------
+bool IsShadowed(world const &World, tup const &Point)
+{
+  // NOTE: Count the number of times the point is in a shadow.
+  size_t ShadowCount{};
 
-  // 5. Finally, append a translation to the transformation to move the scene into place
-  //    before orienting it. Multiply Orientation by Translation(-From.X, -From.Y, -From.Z)
-  //    and we are done.
-  matrix const Result = Orientation * Translation(-From.X, -From.Y, -From.Z);
+  for (auto const &pLight : World.vPtrLights)
+  {
+    if (IsShadowed(World, Point, *pLight))
+    {
+      ShadowCount++;
+    }
+  }
 
-  return (Result);
+  // NOTE: The Point is in shadow only when it is in shadow from all light sources.
+  return (ShadowCount == World.vPtrLights.size());
 }
 
 //------------------------------------------------------------------------------
-camera Camera(int const HSize, int const VSize, float const FieldOfView)
+bool IsShadowed(world const &World, tup const &Point, light const &Light)
 {
-  camera C{};
+  // 1. Measure the distance from Point to the light source by subtracting
+  //    Point from the light posistion, and taking the magnitude of the
+  //    resulting vector. Call this distance.
+  tup const V = Light.Position - Point;
+  Assert(IsVector(V), __FUNCTION__, __LINE__);
+  float const Distance = Mag(V);
+  tup const Direction = Normalize(V);
+
+  // 2. Create a ray from Point toward the light source by normalizing the
+  //    vector from step #1.
+  ray const R = Ray(Point, Direction);
+
+  // 3. and 4. Intersect the world with that ray and check to see if there is a
+  //    hit with t less than distance. If so, the hit lies between the Point and the
+  //    light source, and the point is in shadow. The first such hit is enough.
+  return (IsOccluded(World, R, Distance));
+}
 
-  C.HSize = HSize;
-  C.VSize = VSize;
-  C.FieldOfView = FieldOfView;
+//------------------------------------------------------------------------------
+bool IsOccluded(world const &World, ray const &Ray, float const Distance)
+{
+  COUNT_COST(ShadowRays, 1);
+  bool Result{};
 
-  // 1. You know the canvas is one unit away, and you know the angle of the field of view.
-  //    By cutting the field of view in half, you create a right triangle,
-  float HalfView = std::tan(C.FieldOfView / 2.f);
+  auto AnyHit = [&](int Idx) {
+    intersect_return const XS = IntersectObject(*World.vPtrObjects[Idx], Ray);
+    for (int N = 0;     ///<!
+         N < XS.Count;  ///<!
+         ++N)
+    {
+      if (XS.t[N] > 0 && XS.t[N] < Distance)
+      {
+        Result = true;
+        break;
+      }
+    }
+    return (Result);
+  };
 
-  // 2. The aspect ratio is the ratio of the Horisontal to the Vertical size.
-  float const Aspect = float(C.HSize) / float(C.VSize);  // Who is going to create a canvas of zero height?
+  auto AnySphere = [&](int const, float const t) {
+    Result = t > 0 && t < Distance;
+    return (Result);
+  };
 
-  // 3. Now if the Horisontal size is greater than or equal to the vertical size (aspect >= 1),
-  //    then the HalfView is Half of the Width of the canvas and HalfView/Aspect is half the
-  //    canvas' Height.
-  //    If the vertial size is greater than the horizontal size (Aspect < 1), then the HalfView
-  //    is instead the height of the canvas, and the half of the canvas' Width is HalfView * Aspect.
-  if (Aspect >= 1.f)
+  simd const Level = CurrentSIMD();
+  bool const UseSpheres = IsSphereSoAValid(World);
+  if (IsBVHValid(World))
   {
-    C.HalfWidth = HalfView;
-    C.HalfHeight = HalfView / Aspect;
+    if (UseSpheres)
+    {
+      TraverseBVHLeaves(World.BVH, Ray, 0.f, Distance, [&](int const First, int const Count) {
+        return (VisitSphereHits(Level, World.Spheres, Ray, First, Count, AnySphere));
+      });
+    }
+    else
+    {
+      TraverseBVH(World.BVH, Ray, 0.f, Distance, AnyHit);
+    }
+  }
+  else if (UseSpheres)
+  {
+    VisitSphereHits(Level, World.Spheres, Ray, 0, World.Spheres.Count, AnySphere);
   }
   else
   {
-    C.HalfWidth = HalfView * Aspect;
-    C.HalfHeight = HalfView;
+    for (int Idx = 0;                     ///<!
+         Idx < World.Count() && !Result;  ///<!
+         ++Idx)
+    {
+      AnyHit(Idx);
+    }
   }
 
-  // 4. Compute the size of a single pixel on the canvas by dividing the full width of the
-  //    canvas (half width * 2) by the horizontal size in pixels of the canvas (HSize).
-  //    This is the pixel size.
-  C.PixelSize = (C.HalfWidth * 2.f) / C.HSize;
-
-  return (C);
+  return (Result);
 }
 
 //------------------------------------------------------------------------------
-ray RayForPixel(camera const &Camera, int const Px, int const Py)
+bool IsSphereSoAValid(world const &World)
 {
-  // The offset from edge of the canvas to the pixel's center
-  float const XOffset = (Px + 0.5f) * Camera.PixelSize;
-  float const YOffset = (Py + 0.5f) * Camera.PixelSize;
-
-  // The untransformed coordinates of the pixel in world-space.
-  // (remember that the camera looks toward -z, so +x is toward the *left*).
-  float const WorldX = Camera.HalfWidth - XOffset;
-  float const WorldY = Camera.HalfHeight - YOffset;
-
-  // Using the camera matrix, transform the canvas point and the origin,
-  // and compute the ray's direction vector.
-  // Remember that the canvas is at z=-1.
-  tup const Pixel = Inverse(Camera.Transform) * Point(WorldX, WorldY, -1.f);
-  tup const Origin = Inverse(Camera.Transform) * Point(0.f, 0.f, 0.f);
-  tup const Direction = Normalize(Pixel - Origin);
-  ray const R = Ray(Origin, Direction);
-
-  return (R);
+  sphere_soa const &S = World.Spheres;
+  bool const Result = S.Count > 0 && S.Count == World.Count() && S.BVHOrder == IsBVHValid(World);
+  return (Result);
 }
 
 //------------------------------------------------------------------------------
-canvas Render(camera const &Camera, world const &World)
+void BuildSphereSoA(world &World)
 {
-  canvas Image(Camera.HSize, Camera.VSize);
+  sphere_soa &S = World.Spheres;
+  S = sphere_soa{};
 
-  for (int Y = 0;             ///<!
-       Y < Camera.VSize - 1;  ///<!
-       ++Y)
+  for (auto const &pObject : World.vPtrObjects)
   {
-    for (int X = 0;             ///<!
-         X < Camera.HSize - 1;  ///<!
-         ++X)
+    if (pObject->Kind != shape::SPHERE) return;
+  }
+
+  S.BVHOrder = IsBVHValid(World);
+  if (S.BVHOrder)
+  {
+    S.vObject = World.BVH.vIndices;
+  }
+  else
+  {
+    for (int Idx = 0;          ///<!
+         Idx < World.Count();  ///<!
+         ++Idx)
     {
-      ray const R = RayForPixel(Camera, X, Y);
-      tup const Color = ColorAt(World, R);
-      WritePixel(Image, X, Y, Color);
+      S.vObject.push_back(Idx);
     }
   }
 
-  return (Image);
-}
-
-//------------------------------------------------------------------------------
-bool IsShadowed(world const &World, tup const &Point)
-{
-  // NOTE: Count the number of times the point is in a shadow.
-  size_t ShadowCount{};
-
-  for (size_t Idx = 0;                 ///<!
-       Idx < World.vPtrLights.size();  ///<!
-       ++Idx)
+  // NOTE: The padding lets the kernels load a whole chunk from any sphere. It is
+  //       zero, and the lanes it ends up in are masked away.
+  S.Count = World.Count();
+  S.Stride = (S.Count + 7) / 8 * 8 + 8;
+  S.vInv.assign(16 * S.Stride / 8, lane8{});
+  for (int Slot = 0;    ///<!
+       Slot < S.Count;  ///<!
+       ++Slot)
   {
-    // 1. Measure the distance from Point to the light source by subtracting
-    //    Point from the light posistion, and taking the magnitude of the
-    //    resulting vector. Call this distance.
-    tup const V = World.vPtrLights[Idx]->Position - Point;
-    Assert(IsVector(V), __FUNCTION__, __LINE__);
-    float const Distance = Mag(V);
-    tup const Direction = Normalize(V);
-
-    // 2. Create a ray from Point toward the light source by normalizing the
-    //    vector from step #1.
-    ray const R = Ray(Point, Direction);
-
-    // 3. Intersect the world with that ray.
-    intersections const Intersections = IntersectWorld(World, R);
-
-    // 4. Check to see if there was a hit, and if so, whether t is less than
-    //    distance. If so, the hit lies between the Point and the light source,
-    //    and the point is in shadow.
-    intersection const H = Hit(Intersections);
-
-    if (H.pObject && H.t < Distance)
+    matrix const &Inv = World.vPtrObjects[S.vObject[Slot]]->Transform.Inv();
+    for (int Row = 0;  ///<!
+         Row < 4;      ///<!
+         ++Row)
     {
-      ShadowCount++;
+      for (int Col = 0;  ///<!
+           Col < 4;      ///<!
+           ++Col)
+      {
+        S.Inv(Row, Col)[Slot] = Inv.R[Row].C[Col];
+      }
     }
   }
-
-  // NOTE: The Point is in shadow only when it is in shadow from all light sources.
-  return (ShadowCount == World.vPtrLights.size());
 }
 };  // namespace ww
 
@@ -11,6 +11,7 @@
 #define COMMON_DATASTRUCTURES_HPP
 
 #include <iomanip>  // for setw().
+#include <functional>
 #include <iostream>
 #include <limits>
 #include <strstream>
@@ -30,14 +31,23 @@
 #define Assert(Condition, ...)
 #endif
 
+//------------------------------------------------------------------------------
+// NOTE: Build with WW_PIXEL_COST=1 to count the intersection tests and shadow rays of every
+//       pixel in RenderCost(). Without it the counting is compiled out of the renderer.
+#ifndef WW_PIXEL_COST
+#define WW_PIXEL_COST 0
+#endif
+
 namespace ww
 {
 constexpr float EPSILON = 0.0035000;  // 1E27 * std::numeric_limits<float>::min();
 constexpr double PI = 3.141592653589793238463;
 constexpr float PI_F = 3.14159265358979f;
+constexpr int PROGRESSIVE_STEP = 8;  //!< Pixel spacing of the first pass of RenderProgressive().
 
 //------------------------------------------------------------------------------
-union tup {
+// NOTE: 16 byte aligned so that a tuple can be loaded into one SSE register.
+union alignas(16) tup {
   tup() : X{}, Y{}, Z{}, W{} {};
   tup(float IX, float IY, float IZ, float IW) : X{IX}, Y{IY}, Z{IZ}, W{IW} {};
   tup(float IX, float IY) : X{IX}, Y{IY}, Z{}, W{} {};
@@ -112,6 +122,34 @@ union matrix {
   };
 };
 
+//------------------------------------------------------------------------------
+// \struct transform
+// \brief A transformation matrix that carries its inverse and the transpose of its
+//        inverse. Both are recomputed only when a new matrix is assigned, so the
+//        intersection and normal calculations never have to invert the matrix. The
+//        matrices are private, so the inverse can not go stale behind its back.
+// ---
+struct transform
+{
+  transform();
+  transform(matrix const &Other);
+  transform &operator=(matrix const &Other);
+  operator matrix const &() const { return M; }
+
+  // \fn SetWithInverse - Take Other and its inverse Inv as they are, without inverting
+  //                      again. For inverses that were computed before, e.g. in a scene cache.
+  void SetWithInverse(matrix const &Other, matrix const &Inv);
+
+  matrix const &Matrix() const { return M; }                      //!< The transformation itself.
+  matrix const &Inv() const { return MInv; }                      //!< Inverse of Matrix.
+  matrix const &InvTransposed() const { return MInvTransposed; }  //!< Transpose of the inverse, for normals.
+
+private:
+  matrix M{};
+  matrix MInv{};
+  matrix MInvTransposed{};
+};
+
 //------------------------------------------------------------------------------
 struct material
 {
@@ -122,6 +160,25 @@ struct material
   tup Color{1.f, 1.f, 1.f, 0.f};
 };
 
+//------------------------------------------------------------------------------
+// \enum shape
+// \brief The kind of an object. The intersection is dispatched with a switch on the
+//        kind, so no RTTI is used per ray. A new primitive adds its kind here, sets it
+//        in its constructor and adds a case to IntersectObject.
+// ---
+enum class shape
+{
+  NONE,    //!< A plain object. Never hit.
+  SPHERE,  //!< Unit sphere at the origin in object space.
+  CUBE,    //!< Stub. Never hit yet.
+  MESH,    //!< Triangle mesh, see mesh_data.
+};
+
+struct object;
+
+// \fn IsKind - True when pObject is not null and is of the given kind.
+bool IsKind(object const *pObject, shape const Kind);
+
 /// ---
 /// \struct base struct for the raytracing objects
 /// ---
@@ -130,19 +187,21 @@ struct object
   tup Center{};
   material Material{};
 
-  //!< The transform of the object, initialize to identity matrix
-  matrix Transform{
-      tup{1.f, 0.f, 0.f, 0.f},  //!<
-      tup{0.f, 1.f, 0.f, 0.f},  //!<
-      tup{0.f, 0.f, 1.f, 0.f},  //!<
-      tup{0.f, 0.f, 0.f, 1.f}   //!<
-  };                            //!<
+  //!< The transform of the object, initialize to identity matrix.
+  //!< Assigning a matrix updates the cached inverse.
+  transform Transform{};
+
+  shape Kind{shape::NONE};  //!< Set by the constructor of the derived struct.
+
   object() {}
+  explicit object(shape const K) : Kind(K) {}
   virtual ~object() {}
+
+  // NOTE: T is sphere, cube or any other struct with a static KIND.
   template <typename T>
-  bool isA()
+  bool isA() const
   {
-    return (dynamic_cast<T *>(this) != NULL);
+    return (IsKind(this, T::KIND));
   }
 };
 
@@ -154,6 +213,9 @@ struct object
 /// ---
 struct sphere : public object
 {
+  static constexpr shape KIND = shape::SPHERE;
+  sphere() : object(KIND) {}
+
   float Radius{1.f};  //!< Radius.
 };
 
@@ -164,6 +226,9 @@ struct sphere : public object
 /// ---
 struct cube : public object
 {
+  static constexpr shape KIND = shape::CUBE;
+  cube() : object(KIND) {}
+
   float L{1.f};
 };
 
@@ -177,15 +242,95 @@ struct intersection
 {
   float t{};
   shared_ptr_object pObject{};  //!< The pointer need to be cast to a valid object type.
+  int Primitive{-1};            //!< The triangle of a mesh that was hit. -1 for other objects.
+};
+
+/// ---
+/// \struct intersect_return
+/// \brief The t values where a ray intersects a single object, in ascending order.
+/// \detail Returned by value, so finding the intersections does not allocate.
+/// ---
+struct intersect_return
+{
+  int Count{};
+  float t[2]{};
+  int Primitive[2]{-1, -1};  //!< The triangle hit at each t, for a mesh.
+};
+
+/// ---
+/// \struct world_hit
+/// \brief The closest hit in a world. Refers to the object by its index in
+///        world::vPtrObjects, so no shared pointer is copied.
+/// ---
+struct world_hit
+{
+  float t{};
+  int Index{-1};      //!< -1 when nothing was hit.
+  int Primitive{-1};  //!< The triangle of a mesh that was hit. -1 for other objects.
+};
+
+//------------------------------------------------------------------------------
+// \struct intersection_arena
+// \brief Per thread storage for the lists of intersections. A buffer that is freed is kept
+//        in a free list of its size class, in the arena of the thread that frees it, and the
+//        next list of that size on the thread takes it from there. After the first few rays
+//        building intersections does not call malloc, and no reset is needed, so a list may
+//        live as long as it likes. Buffers over the largest class, and those freed into a
+//        class that already holds MAX_FREE buffers, go straight to the heap.
+// ---
+struct intersection_arena
+{
+  static constexpr int CLASSES = 12;            //!< Size classes of 64 bytes << 0 to 11.
+  static constexpr size_t SMALLEST_BYTES = 64;  //!< Buffer size of class 0.
+  static constexpr int MAX_FREE = 64;           //!< Free buffers kept per class.
+
+  void *vFree[CLASSES];   //!< The first bytes of a free buffer point to the next one.
+  int vCount[CLASSES];    //!< Buffers in each free list.
+  long long Mallocs;     //!< Buffers taken from the heap on this thread.
+  long long Reuses;      //!< Buffers taken from a free list on this thread.
+  bool Closed;           //!< The thread is exiting and the lists are freed.
+};
+
+// \fn ArenaAllocate - Take Bytes from the arena of the calling thread.
+void *ArenaAllocate(size_t const Bytes);
+
+// \fn ArenaFree - Give back a buffer from ArenaAllocate() of the same size.
+void ArenaFree(void *pBuffer, size_t const Bytes);
+
+// \fn ThreadArena - The arena of the calling thread, to read its counters.
+intersection_arena const &ThreadArena();
+
+//------------------------------------------------------------------------------
+// \struct arena_allocator
+// \brief A standard allocator on top of the intersection arena of the calling thread.
+// ---
+template <typename T>
+struct arena_allocator
+{
+  typedef T value_type;
+
+  arena_allocator() = default;
+  template <typename U>
+  arena_allocator(arena_allocator<U> const &)
+  {
+  }
+
+  T *allocate(size_t const N) { return (static_cast<T *>(ArenaAllocate(N * sizeof(T)))); }
+  void deallocate(T *p, size_t const N) { ArenaFree(p, N * sizeof(T)); }
+
+  // NOTE: Friends, so they do not hide the operator== of the other types in ww.
+  friend bool operator==(arena_allocator const &, arena_allocator const &) { return (true); }
+  friend bool operator!=(arena_allocator const &, arena_allocator const &) { return (false); }
 };
 
 /// ---
 /// \struct intersections
-/// \brief A collection of intersect's as defined above.
+/// \brief A collection of intersect's as defined above. The list is stored in the
+///        intersection arena of the thread, so building one does not hit the heap.
 /// ---
 struct intersections
 {
-  std::vector<intersection> vI{};
+  std::vector<intersection, arena_allocator<intersection>> vI{};
   int Count() const { return (int)vI.size(); }
 };
 /// ---
@@ -223,15 +368,168 @@ struct light
 
 typedef std::shared_ptr<light> shared_ptr_light;
 
+//------------------------------------------------------------------------------
+// \struct bounds
+// \brief Axis aligned bounding box in world space.
+// ---
+struct bounds
+{
+  tup Min{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+          1.f};
+  tup Max{-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+          -std::numeric_limits<float>::max(), 1.f};
+};
+
+//------------------------------------------------------------------------------
+// \struct bvh_node
+// \brief A node in the bounding volume hierarchy. A leaf holds Count objects starting
+//        at First in bvh::vIndices. An inner node has Count == 0 and two children.
+// ---
+struct bvh_node
+{
+  bounds Box{};
+  int Left{-1};   //!< Index of the left child in bvh::vNodes.
+  int Right{-1};  //!< Index of the right child in bvh::vNodes.
+  int First{};    //!< First entry in bvh::vIndices for a leaf.
+  int Count{};    //!< Number of objects in a leaf. Zero for inner nodes.
+};
+
+//------------------------------------------------------------------------------
+// \struct bvh
+// \brief Bounding volume hierarchy over the objects of a world. The root is vNodes[0].
+// ---
+struct bvh
+{
+  std::vector<bvh_node> vNodes{};
+  std::vector<int> vIndices{};  //!< Index into world::vPtrObjects, or mesh_data::vIndices / 3, for each leaf entry.
+  double BuildSeconds{};        //!< Time spent by the last build.
+};
+
+//------------------------------------------------------------------------------
+// \struct triangle
+// \brief The corners of a triangle in object space, copied out of the vertex buffer so
+//        that the triangles of a BVH leaf are next to each other in memory.
+// ---
+struct triangle
+{
+  float P[3][3];  //!< P[Corner][Axis].
+};
+
+//------------------------------------------------------------------------------
+// \struct mesh_data
+// \brief The triangles of a mesh in object space. Shared, and never changed after it is
+//        built by MeshData(), so any number of meshes may use it with their own transform
+//        and material.
+// ---
+struct mesh_data
+{
+  std::vector<tup> vVertices{};        //!< The vertex buffer, as points.
+  std::vector<int> vIndices{};         //!< The index buffer, three vertices per triangle.
+  std::vector<triangle> vTriangles{};  //!< The triangles in the leaf order of BVH.
+  bvh BVH{};                           //!< Over the triangles. Leaf entries are indices into vTriangles.
+  bounds Box{};                        //!< Object space bounds of all the vertices.
+};
+
+typedef std::shared_ptr<mesh_data const> shared_ptr_mesh_data;
+
+/// ---
+/// \struct mesh
+/// \brief A triangle mesh. The triangles are intersected through the BVH of the mesh
+///        data, in object space, like the unit sphere of a sphere.
+/// ---
+struct mesh : public object
+{
+  static constexpr shape KIND = shape::MESH;
+  mesh() : object(KIND) {}
+
+  shared_ptr_mesh_data pData{};  //!< Empty for a mesh without triangles.
+};
+
+//------------------------------------------------------------------------------
+// \struct obj_data
+// \brief The contents of a Wavefront OBJ file as flat buffers, ready for MeshData().
+// ---
+struct obj_data
+{
+  std::vector<tup> vVertices{};       //!< From the v lines, as points.
+  std::vector<tup> vNormals{};        //!< From the vn lines, as vectors.
+  std::vector<int> vIndices{};        //!< Into vVertices, three per triangle. Polygons are split into fans.
+  std::vector<int> vNormalIndices{};  //!< Into vNormals for each entry of vIndices, -1 where the face has none.
+};
+
+//------------------------------------------------------------------------------
+// \struct obj_stats
+// \brief What a call to ReadFromOBJ() cost.
+// ---
+struct obj_stats
+{
+  double Seconds{};      //!< Wall time of the whole load.
+  size_t FileBytes{};    //!< Size of the file, which is mapped and not copied.
+  size_t BufferBytes{};  //!< Heap held by obj_data. The buffers are sized once, so this is the peak.
+  long MaxRSSKB{};       //!< Peak resident set size of the process after the load.
+  int Threads{};         //!< Threads that parsed the file.
+};
+
+//------------------------------------------------------------------------------
+// \struct scene_stats
+// \brief What a call to ReadScene() cost.
+// ---
+struct scene_stats
+{
+  double Seconds{};       //!< Wall time of the whole load.
+  double ParseSeconds{};  //!< Reading the file and creating the objects.
+  double BuildSeconds{};  //!< Building the BVH and the sphere arrays.
+  size_t FileBytes{};     //!< Size of the file, which is mapped and not copied.
+  size_t Lines{};
+  size_t Objects{};
+  size_t Lights{};
+};
+
+//------------------------------------------------------------------------------
+// \struct lane8
+// \brief Eight floats on a 32 byte boundary, the width of an AVX register.
+// ---
+struct alignas(32) lane8
+{
+  float V[8];
+};
+
+//------------------------------------------------------------------------------
+// \struct sphere_soa
+// \brief The inverse transforms of all the spheres in a world, stored as a structure
+//        of arrays. Element Row * 4 + Col of every inverse is in one contiguous, 32 byte
+//        aligned array, so one ray is tested against 4 or 8 spheres per instruction.
+//        The spheres are unit spheres in object space, so the inverse is all that the
+//        intersection needs. The material is read from the object that is hit.
+// ---
+struct sphere_soa
+{
+  int Count{};                 //!< Number of spheres. Zero when not built.
+  int Stride{};                //!< Floats per array. Count rounded up to 8, plus 8 for padding.
+  bool BVHOrder{};             //!< True when the spheres are in the order of bvh::vIndices.
+  std::vector<lane8> vInv{};   //!< The 16 arrays, one after the other.
+  std::vector<int> vObject{};  //!< Index in world::vPtrObjects of every sphere.
+
+  float const *Inv(int const Row, int const Col) const
+  {
+    return (reinterpret_cast<float const *>(vInv.data()) + (Row * 4 + Col) * Stride);
+  }
+  float *Inv(int const Row, int const Col) { return (reinterpret_cast<float *>(vInv.data()) + (Row * 4 + Col) * Stride); }
+};
+
 //------------------------------------------------------------------------------
 // \struct world :
 //                Contains a vector of the objects
 //                Contains a vector of light source's.
+//                Contains an optional bounding volume hierarchy over the objects.
+//                Contains optional sphere arrays for batched intersection.
 //
 struct world
 {
   std::vector<shared_ptr_object> vPtrObjects{};
   std::vector<shared_ptr_light> vPtrLights{};
+  bvh BVH{};             //!< Built by BuildBVH(). Must be rebuilt when objects are moved.
+  sphere_soa Spheres{};  //!< Built by BuildSphereSoA(). Must be rebuilt when objects are moved.
   int Count() const { return static_cast<int>(vPtrObjects.size()); }
 };
 
@@ -246,7 +544,7 @@ struct prepare_computation
   float t{};
   bool Inside{};  //!< Set to true when the eye is inside an object. Reverses the sign of the normal vector to ensure
                   //!< correct illumination.
-  shared_ptr_object pObject{};
+  object const *pObject{};  //!< The object that was hit. Owned by the world, not by the computation.
   tup Point{};
   tup Normal{};
   tup Eye{};
@@ -264,15 +562,160 @@ struct camera
   float HalfWidth{};
   float HalfHeight{};
 
-  //!< The transform of the object, initialize to identity matrix
-  matrix Transform{
-      tup{1.f, 0.f, 0.f, 0.f},  //!<
-      tup{0.f, 1.f, 0.f, 0.f},  //!<
-      tup{0.f, 0.f, 1.f, 0.f},  //!<
-      tup{0.f, 0.f, 0.f, 1.f}   //!<
-  };                            //!<
+  //!< The view transform, initialized to the identity matrix. The inverse is cached
+  //!< when a new matrix is assigned.
+  transform Transform{};
 };
 
+//------------------------------------------------------------------------------
+// \struct ray_generator
+// \brief The camera rays of one frame in world space. The origin and the center of the
+//        top left pixel are transformed once, after that the pixel position only moves
+//        by the world space steps of one pixel to the right (DX) and one pixel down (DY).
+//        Pixel Px on a scanline is at ScanlineStart + Px * DX. Each pixel is computed from
+//        the start of its scanline rather than from its neighbour, so the position does
+//        not depend on where a tile starts, and a parallel render equals a serial one.
+// ---
+struct ray_generator
+{
+  tup Origin{};   //!< World space position of the camera.
+  tup Pixel00{};  //!< World space center of pixel 0,0 on the canvas.
+  tup DX{};       //!< World space step of one pixel in X.
+  tup DY{};       //!< World space step of one pixel in Y.
+};
+
+//------------------------------------------------------------------------------
+// \struct ray_packet
+// \brief The camera rays of a small block of pixels, stored as a structure of arrays.
+//        Component C of the origin of ray Lane is Origin[C][Lane]. The arrays are 32 byte
+//        aligned and padded to MAX_RAYS, so 4 or 8 rays are loaded per instruction.
+//        The rays are in row major order within the block.
+// ---
+struct alignas(32) ray_packet
+{
+  static constexpr int MAX_RAYS = 16;  //!< A 4x4 block.
+
+  alignas(32) float Origin[4][MAX_RAYS]{};
+  alignas(32) float Direction[4][MAX_RAYS]{};
+  int Count{};  //!< Number of rays in use. Lanes from Count up to MAX_RAYS are ignored.
+};
+
+//------------------------------------------------------------------------------
+// \struct antialias
+// \brief Settings of the adaptive anti-aliasing in RenderAdaptive().
+// ---
+struct antialias
+{
+  float Threshold{0.1f};  //!< A pixel is refined when a color channel differs this much from a neighbour.
+  int MaxDepth{2};        //!< Subdivisions per pixel. Up to 4^MaxDepth samples, 16 for the default.
+  int Threads{};          //!< Worker threads. Zero selects the number of hardware threads.
+};
+
+//------------------------------------------------------------------------------
+// \struct antialias_stats
+// \brief The rays spent by RenderAdaptive().
+// ---
+struct antialias_stats
+{
+  long long Rays{};       //!< All the camera rays, including the one per pixel.
+  long long ExtraRays{};  //!< The camera rays spent on top of the one per pixel.
+  int RefinedPixels{};    //!< The pixels that were supersampled.
+};
+
+//------------------------------------------------------------------------------
+// \struct pixel_cost
+// \brief What one pixel cost RenderCost(). The counts stay zero unless WW_PIXEL_COST is set.
+// ---
+struct pixel_cost
+{
+  unsigned Tests{};       //!< Ray against sphere or triangle intersection tests.
+  unsigned ShadowRays{};  //!< Rays traced toward a light.
+  float Nanoseconds{};    //!< Wall time spent on the pixel.
+};
+
+//------------------------------------------------------------------------------
+// \struct cost_map
+// \brief The pixel_cost of every pixel of a frame, row by row like canvas.
+// ---
+struct cost_map
+{
+  int W{};
+  int H{};
+  std::vector<pixel_cost> vPixels{};
+};
+
+// \enum cost_channel - Which count of pixel_cost a heatmap shows.
+enum class cost_channel
+{
+  TESTS,
+  SHADOW_RAYS,
+  NANOSECONDS,
+};
+
+//------------------------------------------------------------------------------
+// \struct tile
+// \brief A rectangular part of the canvas. The pixels from X0 up to, but not including,
+//        X1 (and Y0 to Y1) are rendered by one worker thread.
+// ---
+struct tile
+{
+  int X0{};
+  int Y0{};
+  int X1{};
+  int Y1{};
+};
+
+//------------------------------------------------------------------------------
+// \struct worker_stats
+// \brief What one thread of RunTasks() did.
+// ---
+struct worker_stats
+{
+  int Tasks{};           //!< Tasks run, own and stolen.
+  int Steals{};          //!< Successful steals from the other threads.
+  int Stolen{};          //!< Tasks taken in those steals.
+  double BusySeconds{};  //!< Time spent in the tasks.
+};
+
+//------------------------------------------------------------------------------
+// \struct schedule_stats
+// \brief What a call to RunTasks() cost, per thread. The utilisation of a thread is the
+//        part of the wall time it spent in tasks; low values call for smaller tasks.
+// ---
+struct schedule_stats
+{
+  double Seconds{};  //!< Wall time of the whole call.
+  std::vector<worker_stats> vWorkers{};
+
+  double Utilisation(int const Worker) const { return (Seconds > 0.0 ? vWorkers[Worker].BusySeconds / Seconds : 0.0); }
+};
+
+//------------------------------------------------------------------------------
+// \enum simd
+// \brief The instruction set used by the matrix product, the 4x4 inverse and the
+//        sphere and ray packet kernels. The level is read once per call of those, not
+//        per tuple. Add, Sub, Dot, Mul(float, tup), Mul(tup, tup) and Mul(matrix, tup)
+//        always use SSE when the build has it. All levels give bit identical results
+//        as long as the compiler does not contract the scalar code into fused
+//        multiply-adds.
+// ---
+enum class simd
+{
+  SCALAR,  //!< Plain C++. Always available, used as reference in the tests.
+  SSE,     //!< 128 bit SSE. Part of the x86-64 baseline.
+  AVX      //!< 256 bit AVX for the matrix product and the sphere kernels, SSE for the rest.
+};
+
+// \fn SIMDSupported - The best instruction set supported by both the build and the CPU.
+simd SIMDSupported();
+
+// \fn SIMDLevel - The instruction set in use. Defaults to SIMDSupported().
+simd SIMDLevel();
+
+// \fn SetSIMDLevel - Select the instruction set. Levels above SIMDSupported() are lowered.
+// \return The level that was selected.
+simd SetSIMDLevel(simd const Level);
+
 //------------------------------------------------------------------------------
 // NOTE: Declarations.
 tup Add(tup const &A, tup const &B);
@@ -318,9 +761,39 @@ tup PixelAt(canvas const &Canvas, int X, int Y);
 std::strstream PPMHeader(canvas const &Canvas, int X, int Y);
 std::string PPMHeader(canvas const &Canvas);
 void WriteToPPM(canvas const &Canvas, std::string const &Filename = "test.ppm");
+
+// \fn WriteToPPMFile - Write the canvas as P3 to a file.
+// \return 0 on success, -1 when the file cannot be written.
 int WriteToPPMFile(canvas const &Canvas, std::string const &Filename = "test.ppm");
+
 std::shared_ptr<canvas> ReadFromPPM(std::string const &Filename = "test.ppm");
 
+// \fn ReadFromPPM - Read a P3 or P6 file. Malformed files are rejected with a message in Error.
+// \return The canvas, or an empty pointer on failure.
+std::shared_ptr<canvas> ReadFromPPM(std::string const &Filename, std::string &Error);
+
+// \fn ReadFromPPM - Read a P3 or P6 file straight into Canvas. The file is memory mapped and
+//                   parsed in place. Canvas is resized to the image and keeps its storage when
+//                   it is already big enough, so it can be reused for a series of images.
+// \return True on success. On failure Error tells why, and Canvas is left empty.
+bool ReadFromPPM(std::string const &Filename, canvas &Canvas, std::string &Error);
+
+// ---
+// NOTE: Binary (P6) Portable Pix Map. One byte per color, about a quarter of the size of P3.
+// ---
+// \fn PPMBinary - Quantize the whole canvas into one contiguous buffer with the P6 header
+//                 followed by 3 bytes per pixel.
+std::vector<unsigned char> PPMBinary(canvas const &Canvas);
+
+// \fn WriteToPPMBinary - Write the canvas as P6 with a single buffered write.
+// \param FileDescriptor - An open file descriptor, for example STDOUT_FILENO or a pipe to an encoder.
+// \return 0 on success, -1 on failure with errno set.
+int WriteToPPMBinary(canvas const &Canvas, int const FileDescriptor);
+
+// \fn WriteToPPMBinary - Write the canvas as P6 to a file. The Filename "-" writes to stdout.
+// \return 0 on success, -1 on failure with errno set.
+int WriteToPPMBinary(canvas const &Canvas, std::string const &Filename);
+
 // ---
 // NOTE: Matrix functions.
 // ---
@@ -347,8 +820,22 @@ is_invertible_return IsInvertible(matrix const &M);
 /// \brief The inverse is not always possible to calculate. When inversion is
 ///        not possible the Zero matrix will be returned.
 /// \return Inverse when possible, Zero matrix otherwise.
+///
+/// \note 4x4 matrices are inverted in closed form from their 2x2 sub-determinants,
+///       and affine transforms through InverseAffine.
 matrix Inverse(matrix const &M);
 
+/// \fn InverseAffine Inverse of an affine transform, one where the last row is 0, 0, 0, 1.
+///     The 3x3 block and the translation are inverted separately.
+matrix InverseAffine(matrix const &M);
+
+/// \fn InverseCofactor Inverse through the cofactor matrix, for any dimension.
+///     The reference the closed form Inverse is checked and benchmarked against.
+matrix InverseCofactor(matrix const &M);
+
+/// \fn IsAffine True when the last row of the 4x4 matrix M is exactly 0, 0, 0, 1.
+bool IsAffine(matrix const &M);
+
 /// ---
 /// \fn Identity matrix
 /// \return Returs a 4x4 identity matrix.
@@ -395,6 +882,71 @@ matrix TranslateScaleRotate(                   //!<
 /// ---
 intersections Intersect(shared_ptr_object Sphere, ray const &Ray);
 
+/// ---
+/// \fn IntersectObject - Intersect the ray with the object without allocating.
+/// \return The t values, or Count == 0 for a miss or an object type that can not be intersected.
+///         For a mesh only the closest hit with a positive t is returned, with its triangle.
+/// ---
+intersect_return IntersectObject(object const &Object, ray const &Ray);
+
+/// ---
+/// \fn IntersectTriangle - Watertight ray/triangle test. Rays through a shared edge or
+///                         vertex hit at least one of the triangles, never none.
+/// \return True for a hit with t > 0. t is set to the hit.
+/// ---
+bool IntersectTriangle(triangle const &Triangle, ray const &Ray, float &t);
+
+/// ---
+/// \fn MeshData - Copy the triangles out of the vertex and index buffers and build the BVH
+///                over them.
+/// \return Empty when the number of indices is not a multiple of three, or an index is
+///         outside of the vertex buffer.
+/// ---
+shared_ptr_mesh_data MeshData(std::vector<tup> vVertices, std::vector<int> vIndices);
+
+/// ---
+/// \fn PtrMesh - Create a mesh with the given triangles and return a shared pointer to it.
+/// ---
+shared_ptr_object PtrMesh(shared_ptr_mesh_data pData);
+
+/// ---
+/// \fn ReadFromOBJ - Read the v, vn and f lines of a Wavefront OBJ file into Obj. The file is
+///                   memory mapped, split into chunks at line breaks and parsed by NumThreads
+///                   threads, zero for the number of hardware threads. Files under a megabyte
+///                   per thread use fewer threads. Obj keeps its storage for the next file.
+/// \return True on success. On failure Error tells why and on which line, and Obj is empty.
+/// ---
+bool ReadFromOBJ(std::string const &Filename, obj_data &Obj, std::string &Error, obj_stats &Stats,
+                 int const NumThreads = 0);
+
+/// ---
+/// \fn ReadScene - Read a scene file in the YAML like format of the book into World and Camera:
+///                 a list of "- add: camera|light|sphere|obj" and "- define: name" items, with
+///                 their keys indented below them. The file is read in a single pass and the
+///                 spheres are allocated in blocks. The BVH and the sphere arrays are built.
+///                 The file of an obj is relative to the scene file and loaded once.
+/// \return True on success. On failure Error tells why and on which line, and World is empty.
+/// ---
+bool ReadScene(std::string const &Filename, world &World, camera &Camera, std::string &Error, scene_stats &Stats);
+
+/// ---
+/// \fn WriteSceneCache - Write World and Camera to a binary scene cache that ReadSceneCache()
+///                       loads without parsing or building anything: the objects with their
+///                       inverse transforms, the lights, the meshes with their BVHs, and the
+///                       BVH and the sphere arrays of the world when they are built.
+/// \return True on success. On failure Error tells why.
+/// ---
+bool WriteSceneCache(std::string const &Filename, world const &World, camera const &Camera, std::string &Error);
+
+/// ---
+/// \fn ReadSceneCache - Map a file written by WriteSceneCache() and copy it into World and
+///                      Camera. Only Stats.Seconds, FileBytes, Objects and Lights are set.
+/// \return True on success. False, with the reason in Error and an empty World, when the file
+///         is not a scene cache, is of another version or build, or is truncated or corrupt.
+/// ---
+bool ReadSceneCache(std::string const &Filename, world &World, camera &Camera, std::string &Error,
+                    scene_stats &Stats);
+
 /// ---
 /// \fn PtrDefaultSphere - Create a sphere and return shared pointer to this object.
 /// ---
@@ -419,7 +971,7 @@ ray Transform(ray const &R, matrix const &M);
 /// ---
 /// Surface normal functions
 /// ---
-tup NormalAt(object const &O, tup const &P);
+tup NormalAt(object const &O, tup const &P, int const Primitive = -1);
 tup Reflect(tup const &In, tup const &Normal);
 
 /// ---
@@ -440,6 +992,26 @@ tup Lighting(material const &Material,    //!<
 /// \fn World - Create a default world with two spheres and a light.
 world World();
 intersections IntersectWorld(world const &World, ray const &Ray);
+
+// \fn HitWorld - Find the closest intersection with a positive t along the ray.
+// \brief Same result as Hit(IntersectWorld(World, Ray)), but the objects are visited
+//        front to back through the BVH when it is built, and no sorting is done.
+// \return The hit. pObject is empty when nothing is hit.
+intersection HitWorld(world const &World, ray const &Ray);
+
+// \fn ClosestHit - Find the closest intersection with a positive t along the ray.
+// \brief Keeps only the running minimum t and the object index, so the query does not
+//        allocate and does not touch the reference counts of the objects.
+// \return The hit. Index is -1 when nothing is hit. When two objects are hit at the
+//         same t, the one with the lower index wins, whatever order they are visited in.
+world_hit ClosestHit(world const &World, ray const &Ray);
+
+// \fn ClosestHits - ClosestHit for every ray of the packet, written to Hits[Lane].
+// \brief The rays share one walk through the BVH, and each sphere is tested against 4
+//        or 8 rays at a time. When only a few rays are left in a part of the BVH, they
+//        continue one at a time. Falls back to ClosestHit when there are no sphere arrays.
+//        The hits are the same as from ClosestHit.
+void ClosestHits(world const &World, ray_packet const &Packet, world_hit *Hits);
 void WorldAddObject(world &W, shared_ptr_object pObject);
 void WorldAddLight(world &W, shared_ptr_light pLight);
 
@@ -453,9 +1025,11 @@ void WorldAddLight(world &W, shared_ptr_light pLight);
 //        be reversed should the eye be inside of the object.
 // \return struct with eye and normal vector and hit point.
 prepare_computation PrepareComputations(intersection const &I, ray const &R);
+prepare_computation PrepareComputations(object const &Object, float const t, ray const &R, int const Primitive = -1);
 
 // \fn ShadeHit
-// \brief Calculates the color at the intersection captured by Comps.
+// \brief Calculates the color at the intersection captured by Comps. Each light
+//        casts one shadow ray, and its own shadow decides its contribution.
 // \return tup with the color.
 tup ShadeHit(world const &W, prepare_computation const &Comps);
 
@@ -465,6 +1039,9 @@ tup ShadeHit(world const &W, prepare_computation const &Comps);
 // \return tup with the color.
 tup ColorAt(world const &World, ray const &Ray);
 
+// \fn ColorAt - The color for a ray whose closest hit is already known.
+tup ColorAt(world const &World, ray const &Ray, world_hit const &Hit);
+
 // \fn ViewTransform
 // \brief Orient the world releative to the eye. Line everything up to get the view we want.
 matrix ViewTransform(tup const &From, tup const &To, tup const &Up);
@@ -481,13 +1058,148 @@ camera Camera(int const HSize, int const VSize, float const FieldOfView);
 // \return Ray
 ray RayForPixel(camera const &C, int const Px, int const Py);
 
+// \fn RayGenerator - Transform the camera into world space once for a frame.
+ray_generator RayGenerator(camera const &C);
+
+// \fn ScanlineStart - World space center of pixel 0 on scanline Py.
+tup ScanlineStart(ray_generator const &G, int const Py);
+
+// \fn RayForPixel - Ray from the camera through the world space pixel position Pixel.
+ray RayForPixel(ray_generator const &G, tup const &Pixel);
+
+// \fn RayForSample - Ray through the canvas position X, Y, where pixel Px, Py has its
+//                    center at X = Px and Y = Py. The same ray as above for whole numbers.
+ray RayForSample(ray_generator const &G, float const X, float const Y);
+
+// \fn RayPacket - The rays through the pixels of Block, at most ray_packet::MAX_RAYS.
+ray_packet RayPacket(ray_generator const &G, tile const &Block);
+
+// \fn PacketRay - Ray number Lane of the packet.
+ray PacketRay(ray_packet const &Packet, int const Lane);
+
 // \fn Render - Use the camera to render an image of the given world.
-canvas Render(camera const &Camera, world const &World);
+// \param PacketSize - 1 traces every pixel alone. 2 or 4 traces blocks of 2x2 or 4x4
+//                     pixels as ray packets. The image is the same either way.
+canvas Render(camera const &Camera, world const &World, int const PacketSize = 1);
+
+// \fn Tiles - Split a canvas of W x H pixels into tiles of TileSize x TileSize pixels.
+//             The tiles along the right and bottom edge may be smaller.
+std::vector<tile> Tiles(int const W, int const H, int const TileSize);
+
+// \fn RenderTile - Render the pixels covered by Tile into Image.
+// \brief Only the pixels inside the tile are written, so several threads may render
+//        separate tiles into the same canvas.
+// \param Samples - Rays per pixel, on a regular N x N grid inside the pixel and averaged.
+//                  Rounded down to a square. Above 1 the rays are traced one by one and
+//                  PacketSize is not used.
+void RenderTile(camera const &Camera, world const &World, tile const &Tile, canvas &Image, int const PacketSize = 1,
+                int const Samples = 1);
+
+// \fn RunTasks - Call Task(Index, Worker) once for every Index from 0 up to Count, on NumThreads
+//                threads with work stealing. Zero threads selects the number of hardware threads.
+// \brief Every thread starts with a deque of its own contiguous share of the indices and takes
+//        them from the front. A thread that runs dry steals half of what is left in the deque
+//        of another thread, from the back. The calling thread is worker number 0.
+void RunTasks(int const Count, int const NumThreads, std::function<void(int Index, int Worker)> const &Task,
+              schedule_stats &Stats);
+
+// \fn RenderParallel - Render the image with a pool of worker threads.
+// \param NumThreads - Number of worker threads. Zero selects the number of hardware threads.
+// \param TileSize - Width and height in pixels of each tile handed to a worker.
+// \param PacketSize - As for Render().
+// \param Samples - As for RenderTile().
+// \return The same image as Render(), pixel by pixel, for one sample per pixel.
+canvas RenderParallel(camera const &Camera, world const &World, int const NumThreads = 0, int const TileSize = 16,
+                      int const PacketSize = 1, int const Samples = 1);
+
+// \fn RenderParallel - As above. The tiles are scheduled by RunTasks(), and Stats tells how
+//                      busy each thread was.
+canvas RenderParallel(camera const &Camera, world const &World, schedule_stats &Stats, int const NumThreads = 0,
+                      int const TileSize = 16, int const PacketSize = 1, int const Samples = 1);
+
+// \fn progress_callback - Called by RenderProgressive with the image so far, and the
+//                         pixel spacing of the pass it is in.
+typedef std::function<void(canvas const &Image, int const Step)> progress_callback;
+
+// \fn RenderProgressive - Render the image in passes that get finer, for a quick preview.
+// \brief The first pass renders every PROGRESSIVE_STEP'th pixel in X and Y and fills the
+//        blocks in between with its color. Every following pass halves the spacing and only
+//        renders the pixels that are new on its grid, until the last pass at full resolution.
+//        Progress is called at the end of every pass, and within a pass when FlushSeconds
+//        have passed since the last call. The rows of a pass are shared by NumThreads
+//        threads; zero selects the number of hardware threads.
+// \return The same image as Render(), pixel by pixel.
+canvas RenderProgressive(camera const &Camera, world const &World, progress_callback const &Progress,
+                         float const FlushSeconds = 1.f, int const NumThreads = 0);
+
+// \fn RenderProgressive - As above, and each update is written to Filename as a binary PPM.
+//                         The file is replaced in one step, so a viewer never sees half an
+//                         image. The Filename "-" writes every update to stdout.
+canvas RenderProgressive(camera const &Camera, world const &World, std::string const &Filename,
+                         float const FlushSeconds = 1.f, int const NumThreads = 0);
+
+// \fn RenderAdaptive - Render with anti-aliasing only where it is needed.
+// \brief Traces one ray per pixel first, as Render(). The pixels that differ more than
+//        Settings.Threshold from one of their four neighbours are then traced again with
+//        2x2 samples, and each quarter whose samples still differ that much is split again,
+//        down to Settings.MaxDepth levels. The other pixels are the same as from Render().
+canvas RenderAdaptive(camera const &Camera, world const &World, antialias const &Settings, antialias_stats &Stats);
+
+// \fn RenderCost - Render as Render() does, one pixel after the other on this thread, and
+//                  record what each pixel cost in Cost. The times are always measured; the
+//                  tests and shadow rays only when built with WW_PIXEL_COST.
+// \return The same image as Render(), pixel by pixel.
+canvas RenderCost(camera const &Camera, world const &World, cost_map &Cost);
+
+// \fn CostHeatmap - False color image of one channel of Cost. Black is no cost, and the
+//                   most expensive pixel is white, through blue, red and yellow.
+canvas CostHeatmap(cost_map const &Cost, cost_channel const Channel);
+
+// \fn WriteCostCSV - Write the sums of Cost over tiles of TileSize x TileSize pixels as
+//                    CSV, one tile per line, for a spreadsheet or a script.
+// \return 0 on success, -1 on failure.
+int WriteCostCSV(cost_map const &Cost, std::string const &Filename, int const TileSize = 16);
+
+//------------------------------------------------------------------------------
+// Bounding volume hierarchy functions -----------------------------------------
+//------------------------------------------------------------------------------
+// \fn Bounds - World space bounding box of the object, found by transforming the
+//              corners of the object space box with the object's Transform.
+bounds Bounds(object const &Object);
+bounds Merge(bounds const &A, bounds const &B);
+float SurfaceArea(bounds const &B);
+
+// \fn BuildBVH - Build World.BVH over all the objects in the world using the surface
+//                area heuristic (SAH). The objects must not be added, removed or moved
+//                after the build, or the BVH must be built again.
+void BuildBVH(world &World);
+
+// \fn IsBVHValid - True when World.BVH is built and covers all the objects in World.
+bool IsBVHValid(world const &World);
+
+// \fn BuildSphereSoA - Copy the inverse transforms of the spheres in World into
+//                      World.Spheres, in the leaf order of the BVH when there is one.
+//                      Nothing is built when the world has other objects than spheres.
+//                      BuildBVH rebuilds the arrays when they exist, to keep the order.
+void BuildSphereSoA(world &World);
+
+// \fn IsSphereSoAValid - True when World.Spheres is built, covers all the objects in
+//                        World, and is in the same order as the BVH, if any.
+bool IsSphereSoAValid(world const &World);
 
 //------------------------------------------------------------------------------
 // Shadow functions ------------------------------------------------------------
 //------------------------------------------------------------------------------
 bool IsShadowed(world const &World, tup const &Point);
+
+// \fn IsShadowed - Check if Point is in the shadow of the given light. One shadow ray.
+bool IsShadowed(world const &World, tup const &Point, light const &Light);
+
+// \fn IsOccluded - Any-hit query for shadow rays.
+// \brief Stops at the first object that the ray hits with 0 < t < Distance. No sorting and
+//        no allocation. Uses the BVH of the world when it is built.
+// \return True when something lies between the ray origin and Distance along the ray.
+bool IsOccluded(world const &World, ray const &Ray, float const Distance);
 };  // namespace ww
 
 // ---
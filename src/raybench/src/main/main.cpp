@@ -0,0 +1,832 @@
+/******************************************************************************
+ * Filename : main.cpp
+ * Date     : 2026 Oct 16
+ * Author   : Willy Clarke (willy@clarke.no)
+ * Version  : 0.0.1
+ * Copyright: W. Clarke
+ * License  : MIT
+ * Descripti: Render and micro benchmarks for my Raytracing challenge.
+ *          : Every result is printed as one JSON object per line, so the
+ *          : output of two builds can be compared with diff or a script.
+ ******************************************************************************/
+#include <datastructures.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include "scenes.hpp"
+
+// ---
+// NOTE: Count every allocation made through the global operator new, the array and the
+//       over-aligned forms included, alignas(32) lanes and the like.
+// ---
+namespace
+{
+std::atomic<long long> gAllocations{};
+
+void *CountedAllocate(std::size_t const Size)
+{
+  ++gAllocations;
+  if (void *p = std::malloc(Size ? Size : 1)) return (p);
+  throw std::bad_alloc();
+}
+
+void *CountedAllocate(std::size_t const Size, std::align_val_t const Align)
+{
+  ++gAllocations;
+  // NOTE: aligned_alloc wants a size that is a multiple of the alignment.
+  std::size_t const A = static_cast<std::size_t>(Align);
+  std::size_t const Rounded = (Size + A - 1) / A * A;
+  if (void *p = std::aligned_alloc(A, Rounded ? Rounded : A)) return (p);
+  throw std::bad_alloc();
+}
+};  // namespace
+
+void *operator new(std::size_t Size) { return (CountedAllocate(Size)); }
+void *operator new[](std::size_t Size) { return (CountedAllocate(Size)); }
+void *operator new(std::size_t Size, std::align_val_t Align) { return (CountedAllocate(Size, Align)); }
+void *operator new[](std::size_t Size, std::align_val_t Align) { return (CountedAllocate(Size, Align)); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+namespace
+{
+// ---
+// NOTE: Settings from the command line.
+// ---
+struct options
+{
+  double MinSeconds{0.25};  //!< Repeat a benchmark until it has run this long.
+  int Threads{};            //!< 0 for Render, otherwise RenderParallel with this many threads.
+  int PacketSize{1};        //!< 1 traces single rays, 2 or 4 traces 2x2 or 4x4 ray packets.
+  int TileSize{16};         //!< Tile size of RenderParallel.
+  std::string Filter{};     //!< Only run benchmarks whose name contains this.
+  std::string Heatmap{};    //!< Where the Cost benchmarks write their heatmaps, when set.
+};
+
+// ---
+// NOTE: Keep the optimizer from removing the work of a benchmark.
+// ---
+volatile float gSink{};
+
+// ---
+// NOTE: Time Run repeatedly until MinSeconds has passed. The allocations are
+//       counted over the first call only, so they are per frame or per operation.
+// ---
+struct timing
+{
+  long long Calls{};
+  double Seconds{};
+  long long Allocations{};
+};
+
+timing Time(options const &Options, std::function<void()> const &Run)
+{
+  timing Result{};
+  long long const AllocationsBefore = gAllocations;
+  Run();
+  Result.Allocations = gAllocations - AllocationsBefore;
+
+  auto const Start = std::chrono::steady_clock::now();
+  do
+  {
+    Run();
+    ++Result.Calls;
+    Result.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+  } while (Result.Seconds < Options.MinSeconds);
+  return (Result);
+}
+
+// ---
+// NOTE: Render World Options.MinSeconds worth of frames at W x H and print rays/s,
+//       ns/ray and allocations per frame. Only the camera rays are counted.
+// ---
+void BenchScene(options const &Options, std::string const &Name, ww::world const &World, int const W, int const H)
+{
+  std::string const FullName = Name + "_" + std::to_string(W) + "x" + std::to_string(H);
+  if (FullName.find(Options.Filter) == std::string::npos) return;
+
+  ww::camera const Camera = bench::SceneCamera(W, H);
+  ww::schedule_stats Stats{};
+  timing const T = Time(Options, [&]() {
+    ww::canvas const Canvas =
+        Options.Threads ? ww::RenderParallel(Camera, World, Stats, Options.Threads, Options.TileSize, Options.PacketSize)
+                        : ww::Render(Camera, World, Options.PacketSize);
+  });
+
+  // NOTE: The utilisation of the threads in the last frame, lowest and mean.
+  double MinUse{Stats.vWorkers.empty() ? 0.0 : 1.0};
+  double MeanUse{};
+  int Steals{};
+  for (int Worker = 0;                                    ///<!
+       Worker < static_cast<int>(Stats.vWorkers.size());  ///<!
+       ++Worker)
+  {
+    MinUse = std::min(MinUse, Stats.Utilisation(Worker));
+    MeanUse += Stats.Utilisation(Worker) / Stats.vWorkers.size();
+    Steals += Stats.vWorkers[Worker].Steals;
+  }
+
+  double const Rays = double(W) * H * T.Calls;
+  int const Hit = bench::ObjectsHit(World, Camera);
+  std::cout << "{\"suite\":\"scene\",\"name\":\"" << FullName << "\""                      //!<
+            << ",\"objects\":" << World.vPtrObjects.size()                               //!<
+            << ",\"objects_hit\":" << Hit                                                //!<
+            << ",\"lights\":" << World.vPtrLights.size()                                 //!<
+            << ",\"width\":" << W << ",\"height\":" << H                                 //!<
+            << ",\"threads\":" << Options.Threads                                        //!<
+            << ",\"packet\":" << Options.PacketSize                                      //!<
+            << ",\"frames\":" << T.Calls << ",\"seconds\":" << T.Seconds                 //!<
+            << ",\"rays_per_s\":" << Rays / T.Seconds                                    //!<
+            << ",\"tile\":" << Options.TileSize << ",\"steals\":" << Steals               //!<
+            << ",\"min_utilisation\":" << MinUse << ",\"mean_utilisation\":" << MeanUse  //!<
+            << ",\"ns_per_ray\":" << 1e9 * T.Seconds / Rays                              //!<
+            << ",\"allocs_per_frame\":" << T.Allocations << "}" << std::endl;
+
+  if (Hit < 2) std::cerr << FullName << ": Only " << Hit << " object is hit by the camera rays." << std::endl;
+}
+
+// ---
+// NOTE: Find the closest hit of every camera ray of a W x H frame, without shading, and
+//       print rays/s. Shows the gain of the ray packets on the primary rays alone.
+// ---
+void BenchPrimary(options const &Options, std::string const &Name, ww::world const &World, int const W, int const H)
+{
+  std::string const FullName = "Primary" + Name + "_" + std::to_string(W) + "x" + std::to_string(H);
+  if (FullName.find(Options.Filter) == std::string::npos) return;
+
+  ww::camera const Camera = bench::SceneCamera(W, H);
+  ww::ray_generator const G = ww::RayGenerator(Camera);
+  int const Size = std::max<int>(1, std::min<int>(Options.PacketSize, 4));
+  timing const T = Time(Options, [&]() {
+    ww::world_hit Hits[ww::ray_packet::MAX_RAYS];
+    for (int Y = 0;  ///<!
+         Y < H;      ///<!
+         Y += Size)
+    {
+      for (int X = 0;  ///<!
+           X < W;      ///<!
+           X += Size)
+      {
+        ww::tile const Block{X, Y, std::min<int>(X + Size, W), std::min<int>(Y + Size, H)};
+        ww::ray_packet const Packet = ww::RayPacket(G, Block);
+        if (Size > 1)
+        {
+          ww::ClosestHits(World, Packet, Hits);
+        }
+        else
+        {
+          Hits[0] = ww::ClosestHit(World, ww::PacketRay(Packet, 0));
+        }
+        gSink = gSink + Hits[0].t;
+      }
+    }
+  });
+
+  double const Rays = double(W) * H * T.Calls;
+  std::cout << "{\"suite\":\"primary\",\"name\":\"" << FullName << "\""  //!<
+            << ",\"packet\":" << Options.PacketSize                        //!<
+            << ",\"frames\":" << T.Calls << ",\"seconds\":" << T.Seconds   //!<
+            << ",\"rays_per_s\":" << Rays / T.Seconds                      //!<
+            << ",\"ns_per_ray\":" << 1e9 * T.Seconds / Rays << "}" << std::endl;
+}
+
+// ---
+// NOTE: Build the BVH of World and find the closest hit of every camera ray of a W x H
+//       frame with and without it. Prints the build time and both rays/s.
+// ---
+void BenchBVH(options const &Options, std::string const &Name, ww::world const &World, int const W, int const H)
+{
+  std::string const FullName = "BVH" + Name + "_" + std::to_string(W) + "x" + std::to_string(H);
+  if (FullName.find(Options.Filter) == std::string::npos) return;
+
+  ww::world Linear = World;
+  Linear.BVH = ww::bvh{};
+  Linear.Spheres = ww::sphere_soa{};
+  ww::BuildSphereSoA(Linear);
+
+  ww::world Built = Linear;
+  timing const Build = Time(Options, [&]() { ww::BuildBVH(Built); });
+
+  ww::camera const Camera = bench::SceneCamera(W, H);
+  auto Trace = [&](ww::world const &Traced, int &Hits) {
+    return (Time(Options, [&]() {
+      Hits = 0;
+      for (int Y = 0;  ///<!
+           Y < H;      ///<!
+           ++Y)
+      {
+        for (int X = 0;  ///<!
+             X < W;      ///<!
+             ++X)
+        {
+          Hits += ww::ClosestHit(Traced, ww::RayForPixel(Camera, X, Y)).Index >= 0;
+        }
+      }
+    }));
+  };
+  int LinearHits{};
+  int BVHHits{};
+  timing const L = Trace(Linear, LinearHits);
+  timing const B = Trace(Built, BVHHits);
+
+  double const Rays = double(W) * H;
+  std::cout << "{\"suite\":\"bvh\",\"name\":\"" << FullName << "\""              //!<
+            << ",\"objects\":" << Built.vPtrObjects.size()                        //!<
+            << ",\"nodes\":" << Built.BVH.vNodes.size()                           //!<
+            << ",\"build_ms\":" << 1e3 * Build.Seconds / Build.Calls             //!<
+            << ",\"rays_per_s_linear\":" << Rays * L.Calls / L.Seconds           //!<
+            << ",\"rays_per_s_bvh\":" << Rays * B.Calls / B.Seconds << "}" << std::endl;
+
+  if (LinearHits != BVHHits)
+  {
+    std::cerr << FullName << ": " << LinearHits << " hits without the BVH, " << BVHHits << " with it." << std::endl;
+  }
+}
+
+// ---
+// NOTE: Render one W x H frame with RenderProgressive and print when the first preview and
+//       the full image were ready. Threads as for RenderProgressive, 0 uses all of them.
+// ---
+void BenchProgressive(options const &Options, std::string const &Name, ww::world const &World, int const W,
+                      int const H)
+{
+  std::string const FullName = "Progressive" + Name + "_" + std::to_string(W) + "x" + std::to_string(H);
+  if (FullName.find(Options.Filter) == std::string::npos) return;
+
+  ww::camera const Camera = bench::SceneCamera(W, H);
+  auto const Start = std::chrono::steady_clock::now();
+  double FirstPreview{};
+  int Updates{};
+  auto Progress = [&](ww::canvas const &, int const) {
+    if (!Updates++) FirstPreview = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+  };
+  ww::RenderProgressive(Camera, World, Progress, 1.f, Options.Threads);
+  double const Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+  std::cout << "{\"suite\":\"progressive\",\"name\":\"" << FullName << "\""  //!<
+            << ",\"threads\":" << Options.Threads                              //!<
+            << ",\"updates\":" << Updates                                      //!<
+            << ",\"first_preview_s\":" << FirstPreview                         //!<
+            << ",\"seconds\":" << Seconds << "}" << std::endl;
+}
+
+// ---
+// NOTE: Render W x H frames with RenderAdaptive at the default settings and print the
+//       frame time and the rays spent on anti-aliasing, next to the one ray per pixel.
+// ---
+void BenchAdaptive(options const &Options, std::string const &Name, ww::world const &World, int const W, int const H)
+{
+  std::string const FullName = "Adaptive" + Name + "_" + std::to_string(W) + "x" + std::to_string(H);
+  if (FullName.find(Options.Filter) == std::string::npos) return;
+
+  ww::camera const Camera = bench::SceneCamera(W, H);
+  ww::antialias Settings{};
+  Settings.Threads = std::max<int>(1, Options.Threads);
+  ww::antialias_stats Stats{};
+  timing const T = Time(Options, [&]() { ww::canvas const Canvas = ww::RenderAdaptive(Camera, World, Settings, Stats); });
+
+  std::cout << "{\"suite\":\"adaptive\",\"name\":\"" << FullName << "\""                    //!<
+            << ",\"threads\":" << Settings.Threads                                          //!<
+            << ",\"frames\":" << T.Calls << ",\"seconds\":" << T.Seconds                    //!<
+            << ",\"ms_per_frame\":" << 1e3 * T.Seconds / T.Calls                            //!<
+            << ",\"rays\":" << Stats.Rays << ",\"extra_rays\":" << Stats.ExtraRays           //!<
+            << ",\"refined_pixels\":" << Stats.RefinedPixels                                //!<
+            << ",\"rays_per_pixel\":" << double(Stats.Rays) / (double(W) * H) << "}" << std::endl;
+}
+
+// ---
+// NOTE: Render W x H frames with RenderCost and print the sums of the pixel costs. With
+//       --heatmap the time and test heatmaps and the tile CSV are written next to it.
+// ---
+void BenchCost(options const &Options, std::string const &Name, ww::world const &World, int const W, int const H)
+{
+  std::string const FullName = "Cost" + Name + "_" + std::to_string(W) + "x" + std::to_string(H);
+  if (FullName.find(Options.Filter) == std::string::npos) return;
+
+  ww::camera const Camera = bench::SceneCamera(W, H);
+  ww::cost_map Cost{};
+  timing const T = Time(Options, [&]() { ww::canvas const Canvas = ww::RenderCost(Camera, World, Cost); });
+
+  long long Tests{};
+  long long ShadowRays{};
+  double Nanoseconds{};
+  for (ww::pixel_cost const &P : Cost.vPixels)
+  {
+    Tests += P.Tests;
+    ShadowRays += P.ShadowRays;
+    Nanoseconds += P.Nanoseconds;
+  }
+
+  if (!Options.Heatmap.empty())
+  {
+    std::string const Prefix = Options.Heatmap + FullName;
+    ww::WriteToPPMBinary(ww::CostHeatmap(Cost, ww::cost_channel::NANOSECONDS), Prefix + "_ns.ppm");
+    ww::WriteToPPMBinary(ww::CostHeatmap(Cost, ww::cost_channel::TESTS), Prefix + "_tests.ppm");
+    ww::WriteToPPMBinary(ww::CostHeatmap(Cost, ww::cost_channel::SHADOW_RAYS), Prefix + "_shadow_rays.ppm");
+    ww::WriteCostCSV(Cost, Prefix + ".csv");
+  }
+
+  double const Pixels = double(W) * H;
+  std::cout << "{\"suite\":\"cost\",\"name\":\"" << FullName << "\""                 //!<
+            << ",\"counted\":" << (WW_PIXEL_COST ? "true" : "false")                  //!<
+            << ",\"frames\":" << T.Calls << ",\"seconds\":" << T.Seconds              //!<
+            << ",\"ms_per_frame\":" << 1e3 * T.Seconds / T.Calls                       //!<
+            << ",\"tests_per_pixel\":" << Tests / Pixels                               //!<
+            << ",\"shadow_rays_per_pixel\":" << ShadowRays / Pixels                    //!<
+            << ",\"ns_per_pixel\":" << Nanoseconds / Pixels << "}" << std::endl;
+}
+
+// ---
+// NOTE: Write a tessellated sphere of 4 Rings^2 triangles to Filename as an OBJ file, with
+//       a normal per vertex and one quad per face.
+// ---
+bool WriteSphereOBJ(std::string const &Filename, int const Rings)
+{
+  FILE *fp = std::fopen(Filename.c_str(), "w");
+  if (!fp) return (false);
+
+  int const Segments = 2 * Rings;
+  for (int R = 0;   ///<!
+       R <= Rings;  ///<!
+       ++R)
+  {
+    float const Theta = M_PI * R / Rings;
+    for (int S = 0;      ///<!
+         S <= Segments;  ///<!
+         ++S)
+    {
+      float const Phi = 2.f * M_PI * S / Segments;
+      float const X = std::sin(Theta) * std::cos(Phi);
+      float const Y = std::cos(Theta);
+      float const Z = std::sin(Theta) * std::sin(Phi);
+      std::fprintf(fp, "v %.6f %.6f %.6f\nvn %.6f %.6f %.6f\n", X, Y, Z, X, Y, Z);
+    }
+  }
+  for (int R = 0;  ///<!
+       R < Rings;  ///<!
+       ++R)
+  {
+    for (int S = 0;     ///<!
+         S < Segments;  ///<!
+         ++S)
+    {
+      int const I = R * (Segments + 1) + S + 1;
+      int const J = I + Segments + 1;
+      std::fprintf(fp, "f %d//%d %d//%d %d//%d %d//%d\n", I, I, I + 1, I + 1, J + 1, J + 1, J, J);
+    }
+  }
+  return (std::fclose(fp) == 0);
+}
+
+// ---
+// NOTE: Load a sphere of 4 Rings^2 triangles from an OBJ file and print the load time,
+//       MB/s, the size of the buffers and the peak resident set size.
+// ---
+void BenchOBJ(options const &Options, int const Rings)
+{
+  std::string const FullName = "OBJ_" + std::to_string(4 * Rings * Rings);
+  if (FullName.find(Options.Filter) == std::string::npos) return;
+
+  std::string const Filename = FullName + ".obj";
+  if (!WriteSphereOBJ(Filename, Rings)) return;
+
+  ww::obj_data Obj{};
+  ww::obj_stats Stats{};
+  std::string Error{};
+  bool Ok{true};
+  timing const T = Time(Options, [&]() { Ok = Ok && ww::ReadFromOBJ(Filename, Obj, Error, Stats, Options.Threads); });
+  std::remove(Filename.c_str());
+  if (!Ok)
+  {
+    std::cerr << FullName << ": " << Error << std::endl;
+    return;
+  }
+
+  double const MB = Stats.FileBytes / double(1 << 20);
+  std::cout << "{\"suite\":\"load\",\"name\":\"" << FullName << "\""                           //!<
+            << ",\"threads\":" << Stats.Threads                                                //!<
+            << ",\"loads\":" << T.Calls << ",\"seconds\":" << T.Seconds                        //!<
+            << ",\"ms_per_load\":" << 1e3 * T.Seconds / T.Calls                                 //!<
+            << ",\"file_mb\":" << MB << ",\"mb_per_s\":" << MB * T.Calls / T.Seconds             //!<
+            << ",\"triangles\":" << Obj.vIndices.size() / 3                                    //!<
+            << ",\"buffer_mb\":" << Stats.BufferBytes / double(1 << 20)                        //!<
+            << ",\"max_rss_kb\":" << Stats.MaxRSSKB                                            //!<
+            << ",\"allocs_per_load\":" << T.Allocations << "}" << std::endl;
+}
+
+// ---
+// NOTE: Write the camera and light of the chapter 7 scene and an N x N grid of small
+//       spheres on a floor to Filename as a scene file, like SphereGridWorld().
+// ---
+bool WriteGridScene(std::string const &Filename, int const N)
+{
+  FILE *fp = std::fopen(Filename.c_str(), "w");
+  if (!fp) return (false);
+
+  std::fprintf(fp, "- add: camera\n  width: 400\n  height: 200\n  field-of-view: 1.0471976\n"
+                   "  from: [0, 1.5, -5]\n  to: [0, 1, 0]\n  up: [0, 1, 0]\n"
+                   "- add: light\n  at: [-10, 10, -10]\n  intensity: [1, 1, 1]\n"
+                   "- define: ball\n  value:\n    diffuse: 0.7\n    specular: 0.3\n"
+                   "- add: sphere\n  material:\n    color: [1, 0.9, 0.9]\n    specular: 0\n"
+                   "  transform:\n    - [scale, 20, 0.01, 20]\n");
+  float const Spacing = 8.f / N;
+  float const Radius = 0.4f * Spacing;
+  float const Height = 0.01f + Radius;
+  for (int Z = 0;  ///<!
+       Z < N;      ///<!
+       ++Z)
+  {
+    for (int X = 0;  ///<!
+         X < N;      ///<!
+         ++X)
+    {
+      std::fprintf(fp, "- add: sphere\n  material: ball\n  transform:\n    - [scale, %g, %g, %g]\n"
+                       "    - [translate, %g, %g, %g]\n",
+                   Radius, Radius, Radius, -4.f + Spacing * (X + 0.5f), Height, -4.f + Spacing * (Z + 0.5f));
+    }
+  }
+  return (std::fclose(fp) == 0);
+}
+
+// ---
+// NOTE: Load a scene of N x N spheres and print the load time, split into the parse and
+//       the build of the BVH, and the objects per second.
+// ---
+void BenchScene(options const &Options, int const N)
+{
+  std::string const FullName = "Scene_" + std::to_string(N * N + 1);
+  if (FullName.find(Options.Filter) == std::string::npos) return;
+
+  std::string const Filename = FullName + ".yml";
+  if (!WriteGridScene(Filename, N)) return;
+
+  ww::world World{};
+  ww::camera Camera{};
+  ww::scene_stats Stats{};
+  std::string Error{};
+  bool Ok{true};
+  timing const T = Time(Options, [&]() { Ok = Ok && ww::ReadScene(Filename, World, Camera, Error, Stats); });
+  std::remove(Filename.c_str());
+  if (!Ok)
+  {
+    std::cerr << FullName << ": " << Error << std::endl;
+    return;
+  }
+
+  double const MB = Stats.FileBytes / double(1 << 20);
+  int const Hit = bench::ObjectsHit(World, Camera);
+  std::cout << "{\"suite\":\"load\",\"name\":\"" << FullName << "\""                           //!<
+            << ",\"loads\":" << T.Calls << ",\"seconds\":" << T.Seconds                        //!<
+            << ",\"ms_per_load\":" << 1e3 * T.Seconds / T.Calls                                 //!<
+            << ",\"parse_ms\":" << 1e3 * Stats.ParseSeconds                                    //!<
+            << ",\"build_ms\":" << 1e3 * Stats.BuildSeconds                                    //!<
+            << ",\"file_mb\":" << MB << ",\"objects\":" << Stats.Objects                        //!<
+            << ",\"objects_hit\":" << Hit                                                     //!<
+            << ",\"objects_per_s\":" << Stats.Objects * T.Calls / T.Seconds                     //!<
+            << ",\"allocs_per_load\":" << T.Allocations << "}" << std::endl;
+
+  if (Hit < 2) std::cerr << FullName << ": Only " << Hit << " object is hit by the camera rays." << std::endl;
+}
+
+// ---
+// NOTE: Load a scene of N x N spheres from a text file once, write it to a scene cache and
+//       time the load of the cache, which is the time to the first ray on a restart.
+// ---
+void BenchSceneCache(options const &Options, int const N)
+{
+  std::string const FullName = "SceneCache_" + std::to_string(N * N + 1);
+  if (FullName.find(Options.Filter) == std::string::npos) return;
+
+  std::string const Filename = FullName + ".yml";
+  std::string const CacheName = FullName + ".wwscene";
+  ww::world World{};
+  ww::camera Camera{};
+  ww::scene_stats Text{};
+  std::string Error{};
+  bool Ok = WriteGridScene(Filename, N) && ww::ReadScene(Filename, World, Camera, Error, Text) &&
+            ww::WriteSceneCache(CacheName, World, Camera, Error);
+  std::remove(Filename.c_str());
+
+  ww::scene_stats Stats{};
+  timing const T = Time(Options, [&]() { Ok = Ok && ww::ReadSceneCache(CacheName, World, Camera, Error, Stats); });
+  std::remove(CacheName.c_str());
+  if (!Ok)
+  {
+    std::cerr << FullName << ": " << Error << std::endl;
+    return;
+  }
+
+  std::cout << "{\"suite\":\"load\",\"name\":\"" << FullName << "\""                           //!<
+            << ",\"loads\":" << T.Calls << ",\"seconds\":" << T.Seconds                        //!<
+            << ",\"ms_per_load\":" << 1e3 * T.Seconds / T.Calls                                 //!<
+            << ",\"text_ms_per_load\":" << 1e3 * Text.Seconds                                  //!<
+            << ",\"file_mb\":" << Stats.FileBytes / double(1 << 20)                            //!<
+            << ",\"objects\":" << Stats.Objects                                                //!<
+            << ",\"objects_per_s\":" << Stats.Objects * T.Calls / T.Seconds                     //!<
+            << ",\"allocs_per_load\":" << T.Allocations << "}" << std::endl;
+}
+
+// ---
+// NOTE: Call Run Options.MinSeconds worth of times and print ns and allocations per call.
+//       Run is called once before, so the intersection arena of the thread is warm and
+//       the allocations are those of the steady state.
+// ---
+void BenchMicro(options const &Options, std::string const &Name, std::function<void()> const &Run)
+{
+  if (Name.find(Options.Filter) == std::string::npos) return;
+
+  Run();
+  timing const T = Time(Options, Run);
+  std::cout << "{\"suite\":\"micro\",\"name\":\"" << Name << "\""             //!<
+            << ",\"calls\":" << T.Calls << ",\"seconds\":" << T.Seconds       //!<
+            << ",\"ns_per_call\":" << 1e9 * T.Seconds / T.Calls               //!<
+            << ",\"allocs_per_call\":" << T.Allocations << "}" << std::endl;
+}
+
+void RunMicroBenchmarks(options const &Options)
+{
+  ww::shared_ptr_object const PtrSphere = ww::PtrDefaultSphere();
+  PtrSphere->Transform = ww::Translation(0.5f, 0.f, 0.f) * ww::Scaling(2.f, 1.f, 1.f);
+  ww::ray const Ray = ww::Ray(ww::Point(0.f, 0.f, -5.f), ww::Vector(0.f, 0.f, 1.f));
+
+  BenchMicro(Options, "Intersect", [&]() {
+    ww::intersections const XS = ww::Intersect(PtrSphere, Ray);
+    gSink = gSink + XS.Count();
+  });
+  BenchMicro(Options, "IntersectObject", [&]() {
+    ww::intersect_return const XS = ww::IntersectObject(*PtrSphere, Ray);
+    gSink = gSink + XS.Count;
+  });
+
+  // ---
+  // NOTE: The calls on the hot path of a render, on the chapter 8 scene. None of them
+  //       should allocate.
+  // ---
+  ww::world const Ch8 = bench::Ch8World();
+  ww::camera const Camera = bench::SceneCamera(100, 50);
+  ww::ray const CameraRay = ww::RayForPixel(Camera, 50, 30);
+  BenchMicro(Options, "IntersectWorld_Ch8", [&]() {
+    ww::intersections const XS = ww::IntersectWorld(Ch8, CameraRay);
+    gSink = gSink + XS.Count();
+  });
+  ww::intersection const Hit = ww::HitWorld(Ch8, CameraRay);
+  BenchMicro(Options, "PrepareComputations_Ch8", [&]() {
+    ww::prepare_computation const Comps = ww::PrepareComputations(Hit, CameraRay);
+    gSink = gSink + Comps.t;
+  });
+  ww::tup const HitPoint = ww::PositionAt(CameraRay, Hit.t);
+  BenchMicro(Options, "IsShadowed_Ch8", [&]() { gSink = gSink + ww::IsShadowed(Ch8, HitPoint); });
+  BenchMicro(Options, "ColorAt_Ch8", [&]() {
+    ww::tup const C = ww::ColorAt(Ch8, CameraRay);
+    gSink = gSink + C.R;
+  });
+  ww::canvas Tile(100, 50);
+  BenchMicro(Options, "RenderTile_Ch8_16x16", [&]() {
+    ww::RenderTile(Camera, Ch8, ww::tile{40, 20, 56, 36}, Tile);
+    gSink = gSink + Tile.vXY[0].R;
+  });
+
+  ww::matrix const A = ww::Translation(1.f, -2.f, 3.f) * ww::RotateY(0.3f) * ww::Scaling(2.f, 1.f, 0.5f);
+  ww::matrix const B = ww::Matrix44(ww::tup{8.f, 2.f, 2.f, 2.f},   //!<
+                                    ww::tup{3.f, -1.f, 7.f, 0.f},  //!<
+                                    ww::tup{7.f, 0.f, 5.f, 4.f},   //!<
+                                    ww::tup{-6.f, -2.f, 0.f, 5.f});
+  BenchMicro(Options, "Inverse", [&]() {
+    ww::matrix const M = ww::Inverse(B);
+    gSink = gSink + ww::Get(M, 0, 0);
+  });
+  BenchMicro(Options, "InverseAffine", [&]() {
+    ww::matrix const M = ww::Inverse(A);
+    gSink = gSink + ww::Get(M, 0, 0);
+  });
+  BenchMicro(Options, "InverseCofactor", [&]() {
+    ww::matrix const M = ww::InverseCofactor(B);
+    gSink = gSink + ww::Get(M, 0, 0);
+  });
+  BenchMicro(Options, "MulMatrix", [&]() {
+    ww::matrix const M = ww::Mul(A, B);
+    gSink = gSink + ww::Get(M, 0, 0);
+  });
+  ww::tup const P = ww::Point(1.f, 2.f, 3.f);
+  BenchMicro(Options, "MulTuple", [&]() {
+    ww::tup const T = ww::Mul(A, P);
+    gSink = gSink + T.X;
+  });
+
+  ww::material const Material{};
+  ww::light const Light = ww::PointLight(ww::Point(0.f, 10.f, -10.f), ww::Color(1.f, 1.f, 1.f));
+  ww::tup const Position = ww::Point(0.f, 0.f, 0.f);
+  ww::tup const vEye = ww::Vector(0.f, 0.f, -1.f);
+  ww::tup const vNormal = ww::Vector(0.f, 0.f, -1.f);
+  BenchMicro(Options, "Lighting", [&]() {
+    ww::tup const C = ww::Lighting(Material, Light, Position, vEye, vNormal);
+    gSink = gSink + C.R;
+  });
+
+  ww::canvas Canvas(100, 50);
+  for (size_t Idx = 0;           ///<!
+       Idx < Canvas.vXY.size();  ///<!
+       ++Idx)
+  {
+    Canvas.vXY[Idx] = ww::Color((Idx % 100) / 99.f, 0.5f, (Idx / 100) / 49.f);
+  }
+  BenchMicro(Options, "WriteToPPM_100x50", [&]() { ww::WriteToPPM(Canvas, "raybench.ppm"); });
+  BenchMicro(Options, "WriteToPPMBinary_100x50", [&]() { ww::WriteToPPMBinary(Canvas, "raybench.ppm"); });
+  std::remove("raybench.ppm");
+}
+
+void RunSceneBenchmarks(options const &Options)
+{
+  int const Resolutions[][2] = {{100, 50}, {200, 100}, {400, 200}};
+
+  ww::world const Ch7 = bench::Ch7World();
+  ww::world const Ch8 = bench::Ch8World();
+  ww::world const Grid10 = bench::SphereGridWorld(10);
+  ww::world const Grid32 = bench::SphereGridWorld(32);
+  ww::world const Lights8 = bench::ManyLightsWorld(8);
+  ww::world const Ch8Mesh = bench::Ch8MeshWorld();
+  ww::world const MeshSphere = bench::MeshSphereWorld(224);
+  for (auto const &R : Resolutions)
+  {
+    BenchScene(Options, "Ch7", Ch7, R[0], R[1]);
+    BenchScene(Options, "Ch8", Ch8, R[0], R[1]);
+    BenchScene(Options, "Grid10", Grid10, R[0], R[1]);
+    BenchScene(Options, "Grid32", Grid32, R[0], R[1]);
+    BenchScene(Options, "Lights8", Lights8, R[0], R[1]);
+    BenchScene(Options, "Ch8Mesh", Ch8Mesh, R[0], R[1]);
+    BenchScene(Options, "MeshSphere", MeshSphere, R[0], R[1]);
+  }
+  for (auto const &R : Resolutions)
+  {
+    BenchPrimary(Options, "Ch8", Ch8, R[0], R[1]);
+    BenchPrimary(Options, "Grid10", Grid10, R[0], R[1]);
+    BenchPrimary(Options, "Grid32", Grid32, R[0], R[1]);
+  }
+  BenchBVH(Options, "Grid10", Grid10, 200, 100);
+  BenchBVH(Options, "Grid32", Grid32, 200, 100);
+  BenchProgressive(Options, "Grid32", Grid32, 400, 200);
+  BenchAdaptive(Options, "Ch8", Ch8, 400, 200);
+  BenchAdaptive(Options, "Grid32", Grid32, 400, 200);
+  BenchProgressive(Options, "Grid32", Grid32, 1600, 800);
+  BenchCost(Options, "Ch8", Ch8, 400, 200);
+  BenchCost(Options, "Grid32", Grid32, 400, 200);
+  BenchCost(Options, "MeshSphere", MeshSphere, 400, 200);
+}
+
+void RunLoadBenchmarks(options const &Options)
+{
+  BenchOBJ(Options, 50);
+  BenchOBJ(Options, 500);
+  BenchScene(Options, 100);
+  BenchScene(Options, 1000);
+  BenchSceneCache(Options, 100);
+  BenchSceneCache(Options, 1000);
+}
+
+// ---
+// Simple help message
+// ---
+void PrintHelp()
+{
+  std::cout << "\nCommand line switches:"                                                 //!<
+               "\n--help          : \033[32;1mShow help\033[0m"                           //!<
+               "\n--filter <text> : \033[32;1mOnly run benchmarks with text in the name\033[0m"  //!<
+               "\n--seconds <s>   : \033[32;1mMinimum time per benchmark, default 0.25\033[0m"   //!<
+               "\n--threads <n>   : \033[32;1mRender scenes with n threads\033[0m"               //!<
+               "\n--packet <n>    : \033[32;1mTrace n x n ray packets, n is 1, 2 or 4\033[0m"    //!<
+               "\n--tile <n>      : \033[32;1mTile size of the threads, default 16\033[0m"       //!<
+               "\n--heatmap <pre> : \033[32;1mWrite cost heatmaps and CSV named pre...\033[0m"       //!<
+            << std::endl;
+}
+
+// ---
+// NOTE: Read a whole number from Min to Max from Text.
+// ---
+bool ParseInt(char const *Text, int const Min, int const Max, int &Value)
+{
+  char *pEnd{};
+  long const L = std::strtol(Text, &pEnd, 10);
+  if (pEnd == Text || *pEnd != '\0' || L < Min || L > Max) return (false);
+  Value = static_cast<int>(L);
+  return (true);
+}
+
+// ---
+// NOTE: Read a number of seconds above 0 from Text.
+// ---
+bool ParseSeconds(char const *Text, double &Value)
+{
+  char *pEnd{};
+  double const D = std::strtod(Text, &pEnd);
+  if (pEnd == Text || *pEnd != '\0' || !(D > 0.0) || !std::isfinite(D)) return (false);
+  Value = D;
+  return (true);
+}
+
+// ---
+// NOTE: Read the command line switches into Options. Returns false with the
+//       reason in Error for an unknown switch, a missing or bad value.
+// ---
+bool ParseOptions(int const argc, char *argv[], options &Options, std::string &Error)
+{
+  int const MaxValue = 1 << 20;
+  for (int Idx = 1;  ///<!
+       Idx < argc;   ///<!
+       ++Idx)
+  {
+    std::string const Arg{argv[Idx]};
+    bool const TakesValue = Arg == "--filter" || Arg == "--seconds" || Arg == "--threads" || Arg == "--packet" ||
+                            Arg == "--tile" || Arg == "--heatmap";
+    if (!TakesValue)
+    {
+      Error = "Unknown switch '" + Arg + "'.";
+      return (false);
+    }
+    if (Idx + 1 == argc)
+    {
+      Error = "Missing value for " + Arg + ".";
+      return (false);
+    }
+
+    char const *Value = argv[++Idx];
+    bool Ok{true};
+    if ("--filter" == Arg)
+    {
+      Options.Filter = Value;
+    }
+    else if ("--seconds" == Arg)
+    {
+      Ok = ParseSeconds(Value, Options.MinSeconds);
+    }
+    else if ("--threads" == Arg)
+    {
+      Ok = ParseInt(Value, 0, MaxValue, Options.Threads);
+    }
+    else if ("--packet" == Arg)
+    {
+      Ok = ParseInt(Value, 1, 4, Options.PacketSize) && Options.PacketSize != 3;
+    }
+    else if ("--tile" == Arg)
+    {
+      Ok = ParseInt(Value, 1, MaxValue, Options.TileSize);
+    }
+    else
+    {
+      Options.Heatmap = Value;
+    }
+
+    if (!Ok)
+    {
+      Error = "Bad value '" + std::string(Value) + "' for " + Arg + ".";
+      return (false);
+    }
+  }
+  return (true);
+}
+};  // namespace
+
+// ---
+// NOTE: Main function.
+// ---
+auto main(int argc, char *argv[]) -> int
+{
+  options Options{};
+  for (int Idx = 1;  ///<!
+       Idx < argc;   ///<!
+       ++Idx)
+  {
+    if (std::string(argv[Idx]) == "--help")
+    {
+      PrintHelp();
+      return 0;
+    }
+  }
+
+  std::string Error{};
+  if (!ParseOptions(argc, argv, Options, Error))
+  {
+    std::cerr << Error << std::endl;
+    PrintHelp();
+    return 1;
+  }
+
+  RunMicroBenchmarks(Options);
+  RunSceneBenchmarks(Options);
+  RunLoadBenchmarks(Options);
+  return 0;
+}
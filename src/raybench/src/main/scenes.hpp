@@ -0,0 +1,302 @@
+/******************************************************************************
+ * Filename : scenes.hpp
+ * Date     : 2026 Oct 16
+ * Author   : Willy Clarke (willy@clarke.no)
+ * Version  : 0.0.1
+ * Copyright: W. Clarke
+ * License  : MIT
+ * Descripti: The canonical scenes used by the render benchmarks.
+ ******************************************************************************/
+#ifndef SRC_RAYBENCH_SRC_MAIN_SCENES_HPP
+#define SRC_RAYBENCH_SRC_MAIN_SCENES_HPP
+
+#include <datastructures.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace bench
+{
+//------------------------------------------------------------------------------
+// \fn AddSphere - Add a sphere with the given transform and material to World.
+inline void AddSphere(ww::world &World, ww::matrix const &Transform, ww::material const &Material)
+{
+  ww::shared_ptr_object PtrSphere = ww::PtrDefaultSphere();
+  PtrSphere->Transform = Transform;
+  PtrSphere->Material = Material;
+  World.vPtrObjects.push_back(PtrSphere);
+}
+
+//------------------------------------------------------------------------------
+// \fn AddLight - Add a white point light at Position.
+inline void AddLight(ww::world &World, ww::tup const &Position, float const Intensity = 1.f)
+{
+  ww::shared_ptr_light pLight{};
+  pLight.reset(new ww::light);
+  *pLight = ww::PointLight(Position, ww::Color(Intensity, Intensity, Intensity));
+  World.vPtrLights.push_back(pLight);
+}
+
+//------------------------------------------------------------------------------
+// \fn Ch7World - The floor, walls and three spheres from the end of chapter 7.
+//               The sphere arrays are built, like for all the scenes below.
+inline ww::world Ch7World()
+{
+  ww::world World = ww::World();
+  World.vPtrLights.clear();
+  World.vPtrObjects.clear();
+
+  ww::material Wall{};
+  Wall.Color = ww::Color(1.f, 0.9f, 0.9f);
+  Wall.Specular = 0.f;
+  AddSphere(World, ww::Scaling(10.f, 0.01f, 10.f), Wall);
+  AddSphere(World,
+            ww::Translation(0.f, 0.f, 5.f) * ww::RotateY(-M_PI_4) *  //!<
+                ww::RotateX(M_PI_2) * ww::Scaling(10.f, 0.01f, 10.f),
+            Wall);
+  AddSphere(World,
+            ww::Translation(0.f, 0.f, 5.f) * ww::RotateY(M_PI_4) *  //!<
+                ww::RotateX(M_PI_2) * ww::Scaling(10.f, 0.01f, 10.f),
+            Wall);
+
+  ww::material M{};
+  M.Diffuse = 0.7f;
+  M.Specular = 0.3f;
+  M.Color = ww::Color(0.1f, 1.0f, 0.5f);
+  AddSphere(World, ww::Translation(-0.5f, 1.f, 0.5f), M);
+  M.Color = ww::Color(0.5f, 1.0f, 0.1f);
+  AddSphere(World, ww::Translation(1.5f, 0.5f, -0.5f) * ww::Scaling(0.5f, 0.5f, 0.5f), M);
+  M.Color = ww::Color(1.0f, 0.8f, 0.1f);
+  AddSphere(World, ww::Translation(-1.5f, 0.33f, -0.75f) * ww::Scaling(0.33f, 0.33f, 0.33f), M);
+
+  AddLight(World, ww::Point(-10.f, 10.f, -10.f));
+  ww::BuildSphereSoA(World);
+  return (World);
+}
+
+//------------------------------------------------------------------------------
+// \fn Ch8World - The chapter 7 scene with the two extra shadow casters of chapter 8.
+inline ww::world Ch8World()
+{
+  ww::world World = Ch7World();
+
+  ww::material M{};
+  M.Diffuse = 0.99f;
+  M.Specular = 0.7f;
+  M.Color = ww::Color(0.8f, 0.999f, 0.f);
+  AddSphere(World,
+            ww::Translation(0.0f, 1.75f, -2.0f) * ww::RotateZ(5.f * M_PI_2 / 4.f) *  //!<
+                ww::RotateY(3.f * M_PI_2 / 4.f) * ww::RotateX(1.f * M_PI_2 / 4.f) *  //!<
+                ww::Scaling(0.9f, 0.9f, 0.2f),
+            M);
+  M.Color = ww::Color(0.1f, 0.999f, 8.f);
+  AddSphere(World,
+            ww::Translation(-1.0f, 1.0f, -3.5f) * ww::RotateZ(5.f * M_PI_2 / 4.f) *  //!<
+                ww::RotateY(3.f * M_PI_2 / 4.f) * ww::RotateX(1.f * M_PI_2 / 7.f) *  //!<
+                ww::Scaling(0.9f, 0.4f, 0.4f),
+            M);
+  ww::BuildSphereSoA(World);
+  return (World);
+}
+
+//------------------------------------------------------------------------------
+// \fn SphereGridWorld - N x N small spheres on a floor, seen from above at an angle.
+//                      A BVH and the sphere arrays are built for the grid.
+inline ww::world SphereGridWorld(int const N)
+{
+  ww::world World = ww::World();
+  World.vPtrLights.clear();
+  World.vPtrObjects.clear();
+
+  ww::material Floor{};
+  Floor.Color = ww::Color(1.f, 0.9f, 0.9f);
+  Floor.Specular = 0.f;
+  AddSphere(World, ww::Scaling(20.f, 0.01f, 20.f), Floor);
+
+  // NOTE: The spheres rest on top of the floor, which is 0.01 thick, so the smallest still show.
+  float const Spacing = 8.f / N;
+  float const Radius = 0.4f * Spacing;
+  float const Height = 0.01f + Radius;
+  for (int Z = 0;  ///<!
+       Z < N;      ///<!
+       ++Z)
+  {
+    for (int X = 0;  ///<!
+         X < N;      ///<!
+         ++X)
+    {
+      ww::material M{};
+      M.Color = ww::Color(float(X) / N, 0.5f, float(Z) / N);
+      M.Diffuse = 0.7f;
+      M.Specular = 0.3f;
+      AddSphere(World,
+                ww::Translation(-4.f + Spacing * (X + 0.5f), Height, -4.f + Spacing * (Z + 0.5f)) *  //!<
+                    ww::Scaling(Radius, Radius, Radius),
+                M);
+    }
+  }
+
+  AddLight(World, ww::Point(-10.f, 10.f, -10.f));
+  ww::BuildBVH(World);
+  ww::BuildSphereSoA(World);
+  return (World);
+}
+
+//------------------------------------------------------------------------------
+// \fn ManyLightsWorld - The chapter 8 scene lit by Count lights on a circle above it.
+inline ww::world ManyLightsWorld(int const Count)
+{
+  ww::world World = Ch8World();
+  World.vPtrLights.clear();
+  for (int Idx = 0;  ///<!
+       Idx < Count;  ///<!
+       ++Idx)
+  {
+    float const Angle = 2.f * M_PI * Idx / Count;
+    AddLight(World, ww::Point(10.f * std::cos(Angle), 10.f, 10.f * std::sin(Angle) - 5.f), 1.f / Count);
+  }
+  return (World);
+}
+
+//------------------------------------------------------------------------------
+// \fn AddMesh - Add a mesh with the given transform and material to World.
+inline void AddMesh(ww::world &World, ww::shared_ptr_mesh_data const &pData, ww::matrix const &Transform,
+                    ww::material const &Material)
+{
+  ww::shared_ptr_object PtrMesh = ww::PtrMesh(pData);
+  PtrMesh->Transform = Transform;
+  PtrMesh->Material = Material;
+  World.vPtrObjects.push_back(PtrMesh);
+}
+
+//------------------------------------------------------------------------------
+// \fn QuadMeshData - Two triangles from (-1,0,-1) to (1,0,1), facing up.
+inline ww::shared_ptr_mesh_data QuadMeshData()
+{
+  return (ww::MeshData({ww::Point(-1.f, 0.f, -1.f), ww::Point(1.f, 0.f, -1.f),  //!<
+                        ww::Point(1.f, 0.f, 1.f), ww::Point(-1.f, 0.f, 1.f)},   //!<
+                       {0, 2, 1, 0, 3, 2}));
+}
+
+//------------------------------------------------------------------------------
+// \fn SphereMeshData - A unit sphere of Rings x 2 Rings quads, 4 Rings^2 triangles.
+inline ww::shared_ptr_mesh_data SphereMeshData(int const Rings)
+{
+  int const Segments = 2 * Rings;
+  std::vector<ww::tup> vVertices{};
+  std::vector<int> vIndices{};
+  for (int R = 0;   ///<!
+       R <= Rings;  ///<!
+       ++R)
+  {
+    float const Theta = M_PI * R / Rings;
+    for (int S = 0;      ///<!
+         S <= Segments;  ///<!
+         ++S)
+    {
+      float const Phi = 2.f * M_PI * S / Segments;
+      vVertices.push_back(ww::Point(std::sin(Theta) * std::cos(Phi), std::cos(Theta), std::sin(Theta) * std::sin(Phi)));
+    }
+  }
+  for (int R = 0;  ///<!
+       R < Rings;  ///<!
+       ++R)
+  {
+    for (int S = 0;     ///<!
+         S < Segments;  ///<!
+         ++S)
+    {
+      int const I = R * (Segments + 1) + S;
+      int const J = I + Segments + 1;
+      for (int const Index : {I, I + 1, J + 1, I, J + 1, J})
+      {
+        vIndices.push_back(Index);
+      }
+    }
+  }
+  return (ww::MeshData(vVertices, vIndices));
+}
+
+//------------------------------------------------------------------------------
+// \fn Ch8MeshWorld - The chapter 8 scene with the floor and the walls as two triangle quads
+//                    instead of flattened spheres.
+inline ww::world Ch8MeshWorld()
+{
+  ww::world World = Ch8World();
+  World.vPtrObjects.erase(World.vPtrObjects.begin(), World.vPtrObjects.begin() + 3);
+
+  ww::shared_ptr_mesh_data const pQuad = QuadMeshData();
+  ww::material Wall{};
+  Wall.Color = ww::Color(1.f, 0.9f, 0.9f);
+  Wall.Specular = 0.f;
+  AddMesh(World, pQuad, ww::Scaling(10.f, 1.f, 10.f), Wall);
+  AddMesh(World, pQuad,
+          ww::Translation(0.f, 0.f, 5.f) * ww::RotateY(-M_PI_4) *  //!<
+              ww::RotateX(-M_PI_2) * ww::Scaling(10.f, 1.f, 10.f),
+          Wall);
+  AddMesh(World, pQuad,
+          ww::Translation(0.f, 0.f, 5.f) * ww::RotateY(M_PI_4) *  //!<
+              ww::RotateX(-M_PI_2) * ww::Scaling(10.f, 1.f, 10.f),
+          Wall);
+  ww::BuildSphereSoA(World);
+  return (World);
+}
+
+//------------------------------------------------------------------------------
+// \fn MeshSphereWorld - A tessellated sphere of 4 Rings^2 triangles on a quad floor.
+inline ww::world MeshSphereWorld(int const Rings)
+{
+  ww::world World = ww::World();
+  World.vPtrLights.clear();
+  World.vPtrObjects.clear();
+
+  ww::material Floor{};
+  Floor.Color = ww::Color(1.f, 0.9f, 0.9f);
+  Floor.Specular = 0.f;
+  AddMesh(World, QuadMeshData(), ww::Scaling(10.f, 1.f, 10.f), Floor);
+
+  ww::material M{};
+  M.Diffuse = 0.7f;
+  M.Specular = 0.3f;
+  M.Color = ww::Color(0.1f, 1.0f, 0.5f);
+  AddMesh(World, SphereMeshData(Rings), ww::Translation(0.f, 1.f, 0.5f), M);
+
+  AddLight(World, ww::Point(-10.f, 10.f, -10.f));
+  return (World);
+}
+
+//------------------------------------------------------------------------------
+// \fn SceneCamera - The camera of the chapter 7 scene, at the given resolution.
+inline ww::camera SceneCamera(int const W, int const H)
+{
+  ww::camera Camera = ww::Camera(W, H, M_PI / 3.f);
+  Camera.Transform = ww::ViewTransform(ww::Point(0.f, 1.5f, -5.f), ww::Point(0.f, 1.f, 0.f), ww::Vector(0.f, 1.f, 0.f));
+  return (Camera);
+}
+
+//------------------------------------------------------------------------------
+// \fn ObjectsHit - The number of objects of World that some camera ray hits. A scene whose
+//                 objects are never hit, a degenerate transform say, is timed as an empty one.
+inline int ObjectsHit(ww::world const &World, ww::camera const &Camera)
+{
+  std::vector<ww::object const *> vHit{};
+  for (int Y = 0;         ///<!
+       Y < Camera.VSize;  ///<!
+       ++Y)
+  {
+    for (int X = 0;         ///<!
+         X < Camera.HSize;  ///<!
+         ++X)
+    {
+      ww::intersection const I = ww::HitWorld(World, ww::RayForPixel(Camera, X, Y));
+      if (I.pObject) vHit.push_back(I.pObject.get());
+    }
+  }
+  std::sort(vHit.begin(), vHit.end());
+  return (static_cast<int>(std::unique(vHit.begin(), vHit.end()) - vHit.begin()));
+}
+
+};  // namespace bench
+
+#endif
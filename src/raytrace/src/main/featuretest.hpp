@@ -13,7 +13,9 @@
 #include <datastructures.hpp>
 
 #include <cmath>
+#include <fstream>
 #include <iostream>
+#include <iterator>
 #include <memory>  // for shared pointer.
 
 #include "gtest/gtest.h"
@@ -419,6 +421,21 @@ TEST(Canvas, WritePPMLong2)
   }
 }
 
+//------------------------------------------------------------------------------
+TEST(Canvas, WriteToPPMFile)
+{
+  ww::canvas Canvas(3, 2);
+  WritePixel(Canvas, 2, 1, ww::Color(1.f, 0.5f, 0.f));
+  EXPECT_EQ(ww::WriteToPPMFile(Canvas, "WriteToPPMFile.ppm"), 0);
+  std::shared_ptr<ww::canvas> const ptrCanvas = ww::ReadFromPPM("WriteToPPMFile.ppm");
+  ASSERT_EQ(ptrCanvas != nullptr, true);
+  EXPECT_EQ(ptrCanvas->W, 3);
+  EXPECT_EQ(ww::Equal(ww::PixelAt(*ptrCanvas, 2, 1).R, 1.f), true);
+
+  // NOTE: A file that cannot be opened is an error, not a crash.
+  EXPECT_EQ(ww::WriteToPPMFile(Canvas, "no/such/directory/x.ppm"), -1);
+}
+
 //------------------------------------------------------------------------------
 TEST(Canvas, ReadFromPPM)
 {
@@ -437,6 +454,120 @@ TEST(Canvas, ReadFromPPM)
   }
 }
 
+//------------------------------------------------------------------------------
+TEST(Canvas, PPMBinary)
+{
+  ww::canvas Canvas(5, 3);
+  WritePixel(Canvas, 0, 0, ww::Color(1.5f, 0.f, 0.5f));
+  WritePixel(Canvas, 4, 2, ww::Color(-0.5f, 0.f, 1.f));
+
+  std::vector<unsigned char> const Buffer = ww::PPMBinary(Canvas);
+  std::string const Header = "P6\n5 3\n255\n";
+  EXPECT_EQ(Buffer.size(), Header.size() + 5 * 3 * 3);
+  EXPECT_EQ(std::string(Buffer.begin(), Buffer.begin() + Header.size()), Header);
+
+  // NOTE: The colors are clamped to 0..1 and quantized the same way as for P3.
+  unsigned char const *pBody = Buffer.data() + Header.size();
+  EXPECT_EQ(pBody[0], 255);
+  EXPECT_EQ(pBody[1], 0);
+  EXPECT_EQ(pBody[2], 127);
+  EXPECT_EQ(pBody[3 * 14 + 0], 0);
+  EXPECT_EQ(pBody[3 * 14 + 1], 0);
+  EXPECT_EQ(pBody[3 * 14 + 2], 255);
+}
+
+//------------------------------------------------------------------------------
+TEST(Canvas, WriteToPPMBinary)
+{
+  char const *ptrFilename = "WriteToPPMBinary.ppm";
+  ww::canvas Canvas(64, 32);
+  for (size_t Idx = 0;           //<!
+       Idx < Canvas.vXY.size();  //<!
+       ++Idx)
+  {
+    Canvas.vXY[Idx] = ww::Color((Idx % 64) / 63.f, 0.5f, (Idx / 64) / 31.f);
+  }
+  EXPECT_EQ(ww::WriteToPPMBinary(Canvas, ptrFilename), 0);
+
+  std::ifstream I(ptrFilename, std::ifstream::in | std::ifstream::binary);
+  std::vector<unsigned char> const FromFile((std::istreambuf_iterator<char>(I)), std::istreambuf_iterator<char>());
+  EXPECT_EQ(FromFile == ww::PPMBinary(Canvas), true);
+
+  // NOTE: A directory that does not exist.
+  EXPECT_EQ(ww::WriteToPPMBinary(Canvas, "no/such/directory/x.ppm"), -1);
+}
+
+//------------------------------------------------------------------------------
+TEST(Canvas, ReadFromPPMBinary)
+{
+  char const *ptrFilename = "ReadFromPPMBinary.ppm";
+  ww::canvas Canvas(64, 32);
+  for (size_t Idx = 0;           //<!
+       Idx < Canvas.vXY.size();  //<!
+       ++Idx)
+  {
+    Canvas.vXY[Idx] = ww::Color((Idx % 64) / 63.f, 0.5f, (Idx / 64) / 31.f);
+  }
+  EXPECT_EQ(ww::WriteToPPMBinary(Canvas, ptrFilename), 0);
+
+  // NOTE: Both formats are quantized the same way, so they read back equal.
+  ww::WriteToPPM(Canvas, "ReadFromPPMAscii.ppm");
+  std::shared_ptr<ww::canvas> const Ascii = ww::ReadFromPPM("ReadFromPPMAscii.ppm");
+
+  std::string Error{};
+  ww::canvas Cv(1, 1);
+  EXPECT_EQ(ww::ReadFromPPM(ptrFilename, Cv, Error), true);
+  EXPECT_EQ(Cv.W, 64);
+  EXPECT_EQ(Cv.H, 32);
+  EXPECT_EQ(Ascii->vXY.size(), Cv.vXY.size());
+  for (size_t Idx = 0;       //<!
+       Idx < Cv.vXY.size();  //<!
+       ++Idx)
+  {
+    EXPECT_EQ(Cv.vXY[Idx] == Ascii->vXY[Idx], true);
+    EXPECT_NEAR(Cv.vXY[Idx].R, Canvas.vXY[Idx].R, 1.f / 255.f);
+  }
+}
+
+//------------------------------------------------------------------------------
+TEST(Canvas, ReadFromPPMRejectsMalformed)
+{
+  auto Read = [](char const *ptrFilename, std::string const &Content) -> bool {
+    {
+      std::ofstream O(ptrFilename, std::ofstream::out | std::ofstream::binary);
+      O << Content;
+    }
+    std::string Error{};
+    ww::canvas Cv(2, 2);
+    bool const Result = ww::ReadFromPPM(ptrFilename, Cv, Error);
+    EXPECT_EQ(Result, Error.empty());
+    if (!Result) EXPECT_EQ(Cv.vXY.size(), 0);
+    return (Result);
+  };
+
+  char const *ptrFilename = "Malformed.ppm";
+  EXPECT_EQ(Read(ptrFilename, "P3\n# A comment\n2 1\n255\n0 0 0 255 128 64\n"), true);
+  EXPECT_EQ(Read(ptrFilename, "P6\n1 1\n255\n\x01\x02\x03"), true);
+  EXPECT_EQ(Read(ptrFilename, "P6\n1 1\n65535\n\x01\x02\x03\x04\x05\x06"), true);
+
+  EXPECT_EQ(Read(ptrFilename, ""), false);
+  EXPECT_EQ(Read(ptrFilename, "P5\n1 1\n255\n0"), false);
+  EXPECT_EQ(Read(ptrFilename, "P3\n2\n"), false);
+  EXPECT_EQ(Read(ptrFilename, "P3\n0 1\n255\n"), false);
+  EXPECT_EQ(Read(ptrFilename, "P3\n1 1\n70000\n0 0 0"), false);
+  EXPECT_EQ(Read(ptrFilename, "P3\n99999999999 1\n255\n0 0 0"), false);
+  EXPECT_EQ(Read(ptrFilename, "P3\n2 1\n255\n0 0 0 1 1\n"), false);
+  EXPECT_EQ(Read(ptrFilename, "P3\n1 1\n255\n0 x 0\n"), false);
+  EXPECT_EQ(Read(ptrFilename, "P3\n1 1\n255\n0 256 0\n"), false);
+  EXPECT_EQ(Read(ptrFilename, "P6\n2 1\n255\n\x01\x02\x03"), false);
+  EXPECT_EQ(Read(ptrFilename, "P6\n1 1\n255"), false);
+  EXPECT_EQ(Read(ptrFilename, "P6\n1 1\n255#\x01\x02\x03"), false);
+
+  std::string Error{};
+  EXPECT_EQ(ww::ReadFromPPM("no/such/file.ppm", Error) == nullptr, true);
+  EXPECT_EQ(Error.empty(), false);
+}
+
 //------------------------------------------------------------------------------
 TEST(ObjectPointer, Features)
 {
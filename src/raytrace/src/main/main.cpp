@@ -13,6 +13,7 @@
 
 #include "featuretest.hpp"
 #include "projectile.hpp"
+#include "render.hpp"
 #include "testsmatrix.hpp"
 
 namespace
@@ -24,12 +25,14 @@ void PrintHelp()
 {
   // NOTE: For Anis escape sequences:
   // https://stackoverflow.com/questions/4842424/list-of-ansi-color-escape-sequences
-  std::cout << "\nCommand line switches:"                                     //!<
-               "\n--help        : \033[32;1mShow help\033[0m"                 //!<
-               "\n--test        : \033[32;1mRun test\033[0m"                  //!<
-               "\n--projectile  : \033[32;1mRun the projectile tests\033[0m"  //!<
-               "\n--test-matrix : \033[32;1mRun the Matrix test\033[0m"       //!<
+  std::cout << "\nCommand line switches:"                                           //!<
+               "\n--help        : \033[32;1mShow help\033[0m"                       //!<
+               "\n--test        : \033[32;1mRun test\033[0m"                        //!<
+               "\n--projectile  : \033[32;1mRun the projectile tests\033[0m"        //!<
+               "\n--test-matrix : \033[32;1mRun the Matrix test\033[0m"             //!<
+               "\n--render      : \033[32;1mRender a scene file, see below\033[0m"  //!<
             << std::endl;
+  rtrender::PrintRenderHelp(std::cout);
 }
 };  // namespace
 // ---
@@ -57,6 +60,10 @@ auto main(int argc, char *argv[]) -> int
     {
       rtcch3::RunMatrixTest(argc, argv);
     }
+    else if ("--render" == Argv1)
+    {
+      return (rtrender::RunRender(argc, argv));
+    }
   }
   else
   {
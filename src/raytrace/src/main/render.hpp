@@ -0,0 +1,241 @@
+/******************************************************************************
+ * Filename : render.hpp
+ * Date     : 2026 Oct 16
+ * Author   : Willy Clarke (willy@clarke.no)
+ * Version  : 0.0.1
+ * Copyright: W. Clarke
+ * License  : MIT
+ * Descripti: The --render command: render a scene file to an image from the
+ *          : command line and report the time and rays per second.
+ ******************************************************************************/
+#ifndef SRC_RAYTRACE_SRC_MAIN_RENDER_HPP
+#define SRC_RAYTRACE_SRC_MAIN_RENDER_HPP
+
+#include <datastructures.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace rtrender
+{
+//------------------------------------------------------------------------------
+// \struct render_options
+// \brief The switches of --render. Zero keeps the resolution of the scene camera, and
+//        zero threads selects the number of hardware threads.
+// ---
+struct render_options
+{
+  std::string Scene{};               //!< A scene file, or a scene cache when it ends in .wwscene.
+  int Width{};                       //!< Zero keeps the width of the camera.
+  int Height{};                      //!< Zero keeps the height of the camera.
+  int Threads{};                     //!< Zero selects the number of hardware threads.
+  int Samples{1};                    //!< Rays per pixel, a square.
+  int TileSize{16};                  //!< Width and height of the tiles handed to the threads.
+  std::string Output{"render.ppm"};  //!< "-" writes the image to stdout.
+  std::string Format{"p6"};          //!< p6 for binary PPM, p3 for plain text PPM.
+};
+
+//------------------------------------------------------------------------------
+// \fn PrintRenderHelp
+void PrintRenderHelp(std::ostream &O)
+{
+  O << "\nUsage: --render <scene> [switches]"                                                       //!<
+       "\n<scene>           : \033[32;1mA scene file, or a scene cache ending in .wwscene\033[0m"   //!<
+       "\n--width <w>       : \033[32;1mImage width, default from the camera of the scene\033[0m"   //!<
+       "\n--height <h>      : \033[32;1mImage height, default from the camera of the scene\033[0m"  //!<
+       "\n--threads <n>     : \033[32;1mRender threads, default one per hardware thread\033[0m"     //!<
+       "\n--samples <n>     : \033[32;1mRays per pixel, 1, 4, 9, 16 ..., default 1\033[0m"          //!<
+       "\n--tile <n>        : \033[32;1mTile size in pixels, default 16\033[0m"                     //!<
+       "\n--output <file>   : \033[32;1mImage file, default render.ppm, - for stdout\033[0m"        //!<
+       "\n--format <p6|p3>  : \033[32;1mBinary or plain text PPM, default p6\033[0m"                //!<
+    << std::endl;
+}
+
+//------------------------------------------------------------------------------
+constexpr int MAX_INT_VALUE = 1 << 20;  //!< Largest number ParseInt accepts.
+
+// \fn ParseInt - Read a whole number from Min to MAX_INT_VALUE from Text.
+bool ParseInt(char const *Text, int const Min, int &Value)
+{
+  char *pEnd{};
+  long const L = std::strtol(Text, &pEnd, 10);
+  if (pEnd == Text || *pEnd != '\0' || L < Min || L > MAX_INT_VALUE) return (false);
+  Value = static_cast<int>(L);
+  return (true);
+}
+
+//------------------------------------------------------------------------------
+// \fn ParseRenderOptions - Read the switches that follow --render, argv[2] and on.
+// \return False with the reason in Error for an unknown switch, a missing or bad value.
+bool ParseRenderOptions(int const argc, char *argv[], render_options &Options, std::string &Error)
+{
+  for (int Idx = 2;  //<!
+       Idx < argc;   //<!
+       ++Idx)
+  {
+    std::string const Arg{argv[Idx]};
+    bool const TakesValue = Arg == "--width" || Arg == "--height" || Arg == "--threads" || Arg == "--samples" ||
+                            Arg == "--tile" || Arg == "--output" || Arg == "--format";
+    if (TakesValue && Idx + 1 == argc)
+    {
+      Error = "Missing value for " + Arg + ".";
+      return (false);
+    }
+
+    bool Ok{true};
+    if ("--width" == Arg)
+    {
+      Ok = ParseInt(argv[++Idx], 1, Options.Width);
+    }
+    else if ("--height" == Arg)
+    {
+      Ok = ParseInt(argv[++Idx], 1, Options.Height);
+    }
+    else if ("--threads" == Arg)
+    {
+      Ok = ParseInt(argv[++Idx], 0, Options.Threads);
+    }
+    else if ("--samples" == Arg)
+    {
+      int N{1};
+      Ok = ParseInt(argv[++Idx], 1, Options.Samples);
+      while (N * N < Options.Samples) ++N;
+      Ok = Ok && N * N == Options.Samples;
+    }
+    else if ("--tile" == Arg)
+    {
+      Ok = ParseInt(argv[++Idx], 1, Options.TileSize);
+    }
+    else if ("--output" == Arg)
+    {
+      Options.Output = argv[++Idx];
+    }
+    else if ("--format" == Arg)
+    {
+      Options.Format = argv[++Idx];
+      Ok = Options.Format == "p6" || Options.Format == "p3";
+    }
+    else if (Options.Scene.empty() && !Arg.empty() && Arg[0] != '-')
+    {
+      Options.Scene = Arg;
+    }
+    else
+    {
+      Error = "Unknown switch '" + Arg + "'.";
+      return (false);
+    }
+
+    if (!Ok)
+    {
+      Error = "Bad value '" + std::string(argv[Idx]) + "' for " + Arg + ".";
+      return (false);
+    }
+  }
+
+  if (Options.Scene.empty())
+  {
+    Error = "No scene file.";
+    return (false);
+  }
+  if (Options.Format == "p3" && Options.Output == "-")
+  {
+    Error = "Only p6 can be written to stdout.";
+    return (false);
+  }
+  return (true);
+}
+
+//------------------------------------------------------------------------------
+// \fn RunRender - Load the scene, render it with RenderParallel and write the image.
+//                 The times and the rays per second are printed at the end, to stderr
+//                 when the image goes to stdout.
+// \return The exit code of the program.
+int RunRender(int argc, char *argv[])
+{
+  render_options Options{};
+  std::string Error{};
+  if (!ParseRenderOptions(argc, argv, Options, Error))
+  {
+    std::cerr << Error << std::endl;
+    PrintRenderHelp(std::cerr);
+    return (1);
+  }
+  std::ostream &Report = Options.Output == "-" ? std::cerr : std::cout;
+
+  // ---
+  // NOTE: Load the scene.
+  // ---
+  auto const Start = std::chrono::steady_clock::now();
+  ww::world World{};
+  ww::camera Camera{};
+  ww::scene_stats Stats{};
+  bool const IsCache = Options.Scene.size() >= 8 && Options.Scene.compare(Options.Scene.size() - 8, 8, ".wwscene") == 0;
+  bool const Ok = IsCache ? ww::ReadSceneCache(Options.Scene, World, Camera, Error, Stats)
+                          : ww::ReadScene(Options.Scene, World, Camera, Error, Stats);
+  if (!Ok)
+  {
+    std::cerr << Options.Scene << ": " << Error << std::endl;
+    return (1);
+  }
+
+  // NOTE: A new resolution keeps the field of view and the view transform of the camera.
+  if (Options.Width || Options.Height)
+  {
+    ww::camera Resized = ww::Camera(Options.Width ? Options.Width : Camera.HSize,
+                                    Options.Height ? Options.Height : Camera.VSize, Camera.FieldOfView);
+    Resized.Transform = Camera.Transform;
+    Camera = Resized;
+  }
+
+  // ---
+  // NOTE: Render and write the image.
+  // ---
+  auto const LoadDone = std::chrono::steady_clock::now();
+  ww::schedule_stats Schedule{};
+  ww::canvas const Image =
+      ww::RenderParallel(Camera, World, Schedule, Options.Threads, Options.TileSize, 1, Options.Samples);
+  auto const RenderDone = std::chrono::steady_clock::now();
+
+  int const Written = Options.Format == "p3" ? ww::WriteToPPMFile(Image, Options.Output)
+                                             : ww::WriteToPPMBinary(Image, Options.Output);
+  auto const WriteDone = std::chrono::steady_clock::now();
+  if (Written != 0)
+  {
+    std::cerr << Options.Output << ": Unable to write the image." << std::endl;
+    return (1);
+  }
+
+  double const LoadSeconds = std::chrono::duration<double>(LoadDone - Start).count();
+  double const RenderSeconds = std::chrono::duration<double>(RenderDone - LoadDone).count();
+  double const WriteSeconds = std::chrono::duration<double>(WriteDone - RenderDone).count();
+  double const Rays = double(Camera.HSize) * Camera.VSize * Options.Samples;
+
+  // NOTE: The part of the render time each thread spent on tiles, and the tiles it stole.
+  std::ostringstream Busy{};
+  int Steals{};
+  for (int Worker = 0;                                       //<!
+       Worker < static_cast<int>(Schedule.vWorkers.size());  //<!
+       ++Worker)
+  {
+    Busy << " " << std::lround(100.0 * Schedule.Utilisation(Worker)) << "%";
+    Steals += Schedule.vWorkers[Worker].Stolen;
+  }
+  Busy << ", " << Steals << " tiles stolen";
+
+  Report << Options.Scene << ": " << Stats.Objects << " objects, " << Stats.Lights << " lights"              //!<
+         << "\nImage  : " << Camera.HSize << " x " << Camera.VSize << ", " << Options.Samples                //!<
+         << " samples per pixel, " << Schedule.vWorkers.size() << " threads, tiles of " << Options.TileSize  //!<
+         << "\nLoad   : " << LoadSeconds << " s"                                                             //!<
+         << "\nRender : " << RenderSeconds << " s, " << Rays / RenderSeconds << " camera rays/s"             //!<
+         << "\nBusy   :" << Busy.str()                                                                       //!<
+         << "\nWrite  : " << WriteSeconds << " s to " << Options.Output                                      //!<
+         << "\nTotal  : " << LoadSeconds + RenderSeconds + WriteSeconds << " s" << std::endl;
+  return (0);
+}
+};  // namespace rtrender
+
+#endif
@@ -12,14 +12,114 @@
 
 #include <datastructures.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdio>   // for std::remove.
+#include <cstdlib>  // for mkstemps.
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <memory>  // for shared pointer.
+#include <random>
+#include <string>
+#include <thread>
+
+#include <unistd.h>  // for close.
 
 #include "gtest/gtest.h"
+#include "render.hpp"
 
 namespace rtcch3
 {
+//------------------------------------------------------------------------------
+// NOTE: Create a world with Count randomly placed and scaled spheres.
+ww::world RandomSpheresWorld(int const Count, unsigned const Seed)
+{
+  ww::world World{};
+  std::mt19937 Gen(Seed);
+  std::uniform_real_distribution<float> Pos(-10.f, 10.f);
+  std::uniform_real_distribution<float> Size(0.1f, 1.f);
+  std::uniform_real_distribution<float> Angle(0.f, 2.f * M_PI);
+
+  for (int Idx = 0;  //<!
+       Idx < Count;  //<!
+       ++Idx)
+  {
+    ww::shared_ptr_object PtrSphere = ww::PtrDefaultSphere();
+    PtrSphere->Transform = ww::Translation(Pos(Gen), Pos(Gen), Pos(Gen)) *  //!<
+                           ww::RotateY(Angle(Gen)) *                        //!<
+                           ww::Scaling(Size(Gen), Size(Gen), Size(Gen));
+    World.vPtrObjects.push_back(PtrSphere);
+  }
+
+  ww::shared_ptr_light pLight{};
+  pLight.reset(new ww::light);
+  *pLight = ww::PointLight(ww::Point(-10.f, 10.f, -10.f), ww::Color(1.f, 1.f, 1.f));
+  World.vPtrLights.push_back(pLight);
+
+  return (World);
+}
+
+//------------------------------------------------------------------------------
+// NOTE: Rays from random points outside of the spheres towards random points inside.
+std::vector<ww::ray> RandomRays(int const Count, unsigned const Seed)
+{
+  std::vector<ww::ray> vRays{};
+  std::mt19937 Gen(Seed);
+  std::uniform_real_distribution<float> Pos(-10.f, 10.f);
+
+  for (int Idx = 0;  //<!
+       Idx < Count;  //<!
+       ++Idx)
+  {
+    ww::tup const From = ww::Point(Pos(Gen), Pos(Gen), -15.f);
+    ww::tup const To = ww::Point(Pos(Gen), Pos(Gen), Pos(Gen));
+    vRays.push_back(ww::Ray(From, To - From));
+  }
+  return (vRays);
+}
+
+//------------------------------------------------------------------------------
+// \struct temp_file
+// \brief A file with a unique name in the temporary directory, removed again when the
+//        test is done with it, so the tests leave nothing in the working directory.
+// ---
+struct temp_file
+{
+  explicit temp_file(char const *Extension, std::string const &Content = "")
+  {
+    char const *pDir = std::getenv("TMPDIR");
+    Path = std::string(pDir && *pDir ? pDir : "/tmp") + "/ww_test_XXXXXX" + Extension;
+    int const FD = mkstemps(&Path[0], static_cast<int>(std::strlen(Extension)));
+    EXPECT_GE(FD, 0) << Path;
+    if (FD >= 0) close(FD);
+    Write(Content);
+  }
+  ~temp_file() { std::remove(Path.c_str()); }
+  temp_file(temp_file const &) = delete;
+  temp_file &operator=(temp_file const &) = delete;
+
+  // \fn Write - Replace the contents of the file by Content.
+  void Write(std::string const &Content) const
+  {
+    std::ofstream O(Path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    O << Content;
+  }
+
+  // \fn Read - The contents of the file.
+  std::string Read() const
+  {
+    std::ifstream I(Path, std::ifstream::binary);
+    return (std::string(std::istreambuf_iterator<char>(I), std::istreambuf_iterator<char>()));
+  }
+
+  char const *Name() const { return (Path.c_str()); }
+
+  std::string Path{};
+};
+
 //------------------------------------------------------------------------------
 TEST(Matrix, InitializationToZero)
 {
@@ -383,6 +483,66 @@ TEST(Matrix, Inversion)
   }
 }
 
+//------------------------------------------------------------------------------
+TEST(Matrix, ClosedFormInverseEqualsCofactorInverse)
+{
+  std::mt19937 Gen(11);
+  std::uniform_real_distribution<float> Value(-10.f, 10.f);
+  auto RandomTup = [&]() { return ww::tup{Value(Gen), Value(Gen), Value(Gen), Value(Gen)}; };
+
+  for (int Count = 0;  //<!
+       Count < 100;    //<!
+       ++Count)
+  {
+    ww::matrix const M{RandomTup(), RandomTup(), RandomTup(), RandomTup()};
+    EXPECT_EQ(ww::IsAffine(M), false);
+    ww::matrix const Inv = ww::Inverse(M);
+    EXPECT_EQ(ww::Equal(Inv, ww::InverseCofactor(M)), true);
+    EXPECT_EQ(ww::Equal(M * Inv, ww::I()), true);
+  }
+
+  // NOTE: A singular matrix gives the zero matrix.
+  ww::matrix const Singular = ww::Matrix44(ww::tup{-4.f, 2.f, -2.f, -3.f},  //
+                                           ww::tup{9.f, 6.f, 2.f, 6.f},     //
+                                           ww::tup{0.f, -5.f, 1.f, -5.f},   //
+                                           ww::tup{0.f, 0.f, 0.f, 0.f});
+  EXPECT_EQ(ww::Equal(ww::Inverse(Singular), ww::Matrix44()), true);
+}
+
+//------------------------------------------------------------------------------
+TEST(Matrix, AffineInverse)
+{
+  ww::matrix const M = ww::Translation(1.f, -2.f, 3.f) *  //!<
+                       ww::RotateY(0.3f) *                //!<
+                       ww::RotateX(-1.1f) *               //!<
+                       ww::Shearing(0.5f, 0.f, 0.f, 0.2f, 0.f, 0.f) * ww::Scaling(2.f, 1.f, 0.5f);
+  EXPECT_EQ(ww::IsAffine(M), true);
+
+  ww::matrix const Inv = ww::Inverse(M);
+  EXPECT_EQ(ww::Equal(Inv, ww::InverseCofactor(M)), true);
+  EXPECT_EQ(ww::Equal(M * Inv, ww::I()), true);
+  EXPECT_EQ(Inv.R[3] == ww::Point(0.f, 0.f, 0.f), true);
+
+  EXPECT_EQ(ww::Equal(ww::InverseAffine(ww::Scaling(1.f, 0.f, 1.f)), ww::Matrix44()), true);
+}
+
+//------------------------------------------------------------------------------
+TEST(Matrix, SmallScalingsAreInvertible)
+{
+  // NOTE: The determinant is 0.001, below EPSILON, but far from singular.
+  ww::matrix const S = ww::Scaling(0.1f, 0.1f, 0.1f);
+  EXPECT_EQ(ww::Equal(ww::Inverse(S), ww::Scaling(10.f, 10.f, 10.f)), true);
+  EXPECT_EQ(ww::Equal(ww::InverseAffine(S), ww::Scaling(10.f, 10.f, 10.f)), true);
+  EXPECT_EQ(ww::Equal(ww::InverseCofactor(S), ww::Scaling(10.f, 10.f, 10.f)), true);
+  EXPECT_EQ(ww::InverseCofactor(S).ID.IsInvertible, true);
+
+  // NOTE: The same through the closed form, with a last row that is not 0, 0, 0, 1.
+  ww::matrix M = S;
+  M.R[3].C[0] = 0.05f;
+  EXPECT_EQ(ww::IsAffine(M), false);
+  EXPECT_EQ(ww::Equal(M * ww::Inverse(M), ww::I()), true);
+}
+
 //------------------------------------------------------------------------------
 TEST(Matrix, PuttingItTogether)
 {
@@ -906,6 +1066,22 @@ TEST(RaySphere, IntersectionSphere)
   EXPECT_EQ(TheSpheresAreEqual, true);
 }
 
+//------------------------------------------------------------------------------
+TEST(RaySphere, KindDispatch)
+{
+  ww::sphere S{};
+  ww::cube C{};
+  ww::object O{};
+  EXPECT_EQ(S.Kind == ww::shape::SPHERE, true);
+  EXPECT_EQ(C.Kind == ww::shape::CUBE, true);
+  EXPECT_EQ(O.Kind == ww::shape::NONE, true);
+
+  // NOTE: A copy keeps the kind, also through a pointer to the base.
+  ww::shared_ptr_object PtrCopy = std::make_shared<ww::sphere>(S);
+  EXPECT_EQ(PtrCopy->isA<ww::sphere>(), true);
+  EXPECT_EQ(PtrCopy->isA<ww::cube>(), false);
+}
+
 //------------------------------------------------------------------------------
 // NOTE: Aggregate intersection objects together so that we can work with multiple
 //       intersections at once.
@@ -1052,6 +1228,23 @@ TEST(RaySphere, SphereChangeTransformation)
   EXPECT_EQ(ww::Equal(S.Transform, ww::Translation(2.f, 3.f, 4.f)), true);
 }
 
+//------------------------------------------------------------------------------
+TEST(RaySphere, SphereTransformCachesInverse)
+{
+  ww::sphere S{};
+  EXPECT_EQ(ww::Equal(S.Transform.Inv(), ww::I()), true);
+  EXPECT_EQ(ww::Equal(S.Transform.InvTransposed(), ww::I()), true);
+
+  ww::matrix const M = ww::Translation(2.f, 3.f, 4.f) * ww::Scaling(1.f, 2.f, 4.f) * ww::RotateZ(M_PI / 5.f);
+  S.Transform = M;
+  EXPECT_EQ(ww::Equal(S.Transform.Inv(), ww::Inverse(M)), true);
+  EXPECT_EQ(ww::Equal(S.Transform.InvTransposed(), ww::Transpose(ww::Inverse(M))), true);
+
+  // NOTE: A copy of the object keeps the cached inverse.
+  ww::sphere const Copy = S;
+  EXPECT_EQ(ww::Equal(Copy.Transform.Inv(), ww::Inverse(M)), true);
+}
+
 //------------------------------------------------------------------------------
 TEST(RaySphere, SphereIntersectScaled)
 {
@@ -1592,6 +1785,45 @@ TEST(Ch7MakingAScene, IntersectWorldWithRay)
   }
 }
 
+//------------------------------------------------------------------------------
+TEST(Ch7MakingAScene, ClosestHitWithRay)
+{
+  ww::world const World = ww::World();
+
+  // NOTE: The first hit is on the outer sphere, object 0.
+  ww::ray const Ray = ww::Ray(ww::Point(0.f, 0.f, -5.f), ww::Vector(0.f, 0.f, 1.f));
+  ww::world_hit const H = ww::ClosestHit(World, Ray);
+  EXPECT_EQ(H.t, 4.f);
+  EXPECT_EQ(H.Index, 0);
+
+  // NOTE: From inside the outer sphere the inner sphere, object 1, is closest.
+  ww::ray const Inside = ww::Ray(ww::Point(0.f, 0.f, 0.75f), ww::Vector(0.f, 0.f, -1.f));
+  ww::world_hit const HI = ww::ClosestHit(World, Inside);
+  EXPECT_EQ(ww::Equal(HI.t, 0.25f), true);
+  EXPECT_EQ(HI.Index, 1);
+  EXPECT_EQ(HI.t, ww::Hit(ww::IntersectWorld(World, Inside)).t);
+
+  // NOTE: A miss.
+  ww::ray const Miss = ww::Ray(ww::Point(0.f, 0.f, -5.f), ww::Vector(0.f, 1.f, 0.f));
+  EXPECT_EQ(ww::ClosestHit(World, Miss).Index, -1);
+  EXPECT_EQ(ww::HitWorld(World, Miss).pObject, nullptr);
+}
+
+//------------------------------------------------------------------------------
+TEST(Ch7MakingAScene, IntersectObjectDoesNotNeedASharedPointer)
+{
+  ww::sphere S{};
+  ww::ray const Ray = ww::Ray(ww::Point(0.f, 0.f, -5.f), ww::Vector(0.f, 0.f, 1.f));
+  ww::intersect_return const XS = ww::IntersectObject(S, Ray);
+  EXPECT_EQ(XS.Count, 2);
+  EXPECT_EQ(XS.t[0], 4.f);
+  EXPECT_EQ(XS.t[1], 6.f);
+
+  // NOTE: The cube is only a stub and is never hit.
+  ww::cube C{};
+  EXPECT_EQ(ww::IntersectObject(C, Ray).Count, 0);
+}
+
 //------------------------------------------------------------------------------
 TEST(Ch7MakingAScene, PrecomputingStateOfIntersection)
 {
@@ -1602,7 +1834,7 @@ TEST(Ch7MakingAScene, PrecomputingStateOfIntersection)
   ww::prepare_computation Comps = ww::PrepareComputations(I, R);
 
   EXPECT_EQ(I.t, Comps.t);
-  EXPECT_EQ(I.pObject == Comps.pObject, true);
+  EXPECT_EQ(I.pObject.get() == Comps.pObject, true);
   EXPECT_EQ(ww::Equal(Comps.Point, ww::Point(0.f, 0.f, -1.f)), true);
   std::cout << Comps.Point << "\n" << std::endl;
 
@@ -1867,6 +2099,32 @@ TEST(Ch7ImplementingACamera, ConstructingARayWhenTheCameraIsTransformed)
   EXPECT_EQ(R.Direction == ww::Vector(Sqrt2O2, 0.f, -Sqrt2O2), true);
 }
 
+//------------------------------------------------------------------------------
+TEST(Ch7ImplementingACamera, RayGeneratorIsEqualToRayForPixel)
+{
+  ww::camera C = ww::Camera(201, 101, M_PI / 2.f);
+  C.Transform = ww::RotateY(M_PI / 4.f) * ww::Translation(0.f, -2.f, 5.f);
+  EXPECT_EQ(ww::Equal(C.Transform.Inv(), ww::Inverse(C.Transform)), true);
+
+  ww::ray_generator const G = ww::RayGenerator(C);
+  EXPECT_EQ(G.Origin == ww::Point(0.f, 2.f, -5.f), true);
+  for (int Y = 0;    //<!
+       Y < C.VSize;  //<!
+       Y += 10)
+  {
+    ww::tup const Start = ww::ScanlineStart(G, Y);
+    for (int X = 0;    //<!
+         X < C.HSize;  //<!
+         X += 10)
+    {
+      ww::ray const Expected = ww::RayForPixel(C, X, Y);
+      ww::ray const R = ww::RayForPixel(G, Start + float(X) * G.DX);
+      EXPECT_EQ(R.Origin == Expected.Origin, true);
+      EXPECT_EQ(R.Direction == Expected.Direction, true);
+    }
+  }
+}
+
 //------------------------------------------------------------------------------
 TEST(Ch7ImplementingACamera, RenderingAWorldWithACamera)
 {
@@ -1883,6 +2141,339 @@ TEST(Ch7ImplementingACamera, RenderingAWorldWithACamera)
   EXPECT_EQ(ww::PixelAt(Image, 5, 5) == ww::Color(0.38066f, 0.47583f, 0.2855f), true);
 }
 
+//------------------------------------------------------------------------------
+TEST(Ch7ImplementingACamera, TilesCoverTheCanvas)
+{
+  std::vector<ww::tile> const vTiles = ww::Tiles(37, 21, 16);
+  EXPECT_EQ(vTiles.size(), 6);
+
+  int Area{};
+  for (auto const &T : vTiles)
+  {
+    Area += (T.X1 - T.X0) * (T.Y1 - T.Y0);
+  }
+  EXPECT_EQ(Area, 37 * 21);
+  EXPECT_EQ(vTiles.back().X1, 37);
+  EXPECT_EQ(vTiles.back().Y1, 21);
+}
+
+//------------------------------------------------------------------------------
+TEST(Ch7ImplementingACamera, RenderParallelIsEqualToRender)
+{
+  ww::world const W = ww::World();
+
+  ww::camera C = ww::Camera(37, 21, M_PI / 2.f);
+  C.Transform = ww::ViewTransform(ww::Point(0.f, 0.f, -5.f), ww::Point(0.f, 0.f, 0.f), ww::Vector(0.f, 1.f, 0.f));
+
+  ww::canvas const Serial = ww::Render(C, W);
+  ww::canvas const Parallel = ww::RenderParallel(C, W, 4, 8);
+
+  EXPECT_EQ(Serial.vXY.size(), Parallel.vXY.size());
+  for (size_t Idx = 0;           //<!
+       Idx < Serial.vXY.size();  //<!
+       ++Idx)
+  {
+    // NOTE: Bit identical, not just equal within EPSILON.
+    EXPECT_EQ(Serial.vXY[Idx].R, Parallel.vXY[Idx].R);
+    EXPECT_EQ(Serial.vXY[Idx].G, Parallel.vXY[Idx].G);
+    EXPECT_EQ(Serial.vXY[Idx].B, Parallel.vXY[Idx].B);
+  }
+}
+
+//------------------------------------------------------------------------------
+TEST(Ch7ImplementingACamera, RenderParallelAveragesTheSamples)
+{
+  ww::world const W = ww::World();
+
+  ww::camera C = ww::Camera(37, 21, M_PI / 2.f);
+  C.Transform = ww::ViewTransform(ww::Point(0.f, 0.f, -5.f), ww::Point(0.f, 0.f, 0.f), ww::Vector(0.f, 1.f, 0.f));
+  ww::ray_generator const G = ww::RayGenerator(C);
+
+  // NOTE: 5 samples are rounded down to 2 x 2.
+  for (int const Samples : {4, 5, 9})
+  {
+    ww::canvas const Image = ww::RenderParallel(C, W, 3, 8, 1, Samples);
+    int const N = Samples == 9 ? 3 : 2;
+    for (int const Y : {0, 10, 14})
+    {
+      for (int const X : {0, 18, 25})
+      {
+        ww::tup Sum = ww::Color(0.f, 0.f, 0.f);
+        for (int S = 0;  //<!
+             S < N * N;  //<!
+             ++S)
+        {
+          float const DX = (S % N + 0.5f) / N - 0.5f;
+          float const DY = (S / N + 0.5f) / N - 0.5f;
+          Sum = Sum + ww::ColorAt(W, ww::RayForSample(G, X + DX, Y + DY));
+        }
+        EXPECT_EQ(ww::Equal(ww::PixelAt(Image, X, Y), Sum * (1.f / (N * N))), true) << X << ", " << Y;
+      }
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+TEST(Scheduler, RunsEveryTaskOnce)
+{
+  for (int const Threads : {1, 3, 8})
+  {
+    std::vector<std::atomic<int>> vRuns(1000);
+    ww::schedule_stats Stats{};
+    ww::RunTasks(1000, Threads, [&](int const Index, int) { ++vRuns[Index]; }, Stats);
+
+    ASSERT_EQ(Stats.vWorkers.size(), Threads);
+    EXPECT_EQ(std::all_of(vRuns.begin(), vRuns.end(), [](std::atomic<int> const &N) { return (N == 1); }), true);
+    int Tasks{};
+    for (int Worker = 0;    //<!
+         Worker < Threads;  //<!
+         ++Worker)
+    {
+      Tasks += Stats.vWorkers[Worker].Tasks;
+      EXPECT_GE(Stats.vWorkers[Worker].Stolen, Stats.vWorkers[Worker].Steals);
+      EXPECT_GE(Stats.Utilisation(Worker), 0.0);
+      EXPECT_LE(Stats.Utilisation(Worker), 1.0);
+    }
+    EXPECT_EQ(Tasks, 1000);
+  }
+
+  // NOTE: No more threads than tasks.
+  ww::schedule_stats Stats{};
+  ww::RunTasks(2, 8, [](int, int) {}, Stats);
+  EXPECT_EQ(Stats.vWorkers.size(), 2);
+}
+
+//------------------------------------------------------------------------------
+TEST(Scheduler, IdleThreadsStealFromABusyOne)
+{
+  // NOTE: Only the share of worker 0 is slow. The others finish theirs and take over.
+  std::vector<int> vWorker(400, -1);
+  ww::schedule_stats Stats{};
+  ww::RunTasks(
+      400, 4,
+      [&](int const Index, int const Worker) {
+        vWorker[Index] = Worker;
+        if (Index < 100) std::this_thread::sleep_for(std::chrono::microseconds(200));
+      },
+      Stats);
+
+  int Steals{};
+  for (ww::worker_stats const &W : Stats.vWorkers)
+  {
+    Steals += W.Steals;
+  }
+  EXPECT_GT(Steals, 0);
+  EXPECT_GT(std::count_if(vWorker.begin(), vWorker.begin() + 100, [](int const Worker) { return (Worker != 0); }), 0);
+  EXPECT_LT(Stats.vWorkers[0].Tasks, 100);
+}
+
+//------------------------------------------------------------------------------
+TEST(Ch7ImplementingACamera, RenderProgressiveIsEqualToRender)
+{
+  ww::world W = RandomSpheresWorld(60, 41);
+  ww::BuildBVH(W);
+
+  // NOTE: The size is not a multiple of 8, so the blocks along the edges are cut.
+  ww::camera C = ww::Camera(45, 27, M_PI / 2.f);
+  C.Transform = ww::ViewTransform(ww::Point(0.f, 0.f, -20.f), ww::Point(0.f, 0.f, 0.f), ww::Vector(0.f, 1.f, 0.f));
+  ww::canvas const Expected = ww::Render(C, W);
+
+  // NOTE: Flush after every batch of rows, from several threads.
+  std::vector<int> vSteps{};
+  ww::canvas Preview(0, 0);
+  auto Progress = [&](ww::canvas const &Image, int const Step) {
+    if (vSteps.empty()) Preview = Image;
+    vSteps.push_back(Step);
+  };
+  ww::canvas const Progressive = ww::RenderProgressive(C, W, Progress, 0.f, 3);
+
+  for (size_t Idx = 0;             //<!
+       Idx < Expected.vXY.size();  //<!
+       ++Idx)
+  {
+    EXPECT_EQ(Progressive.vXY[Idx].R, Expected.vXY[Idx].R);
+    EXPECT_EQ(Progressive.vXY[Idx].G, Expected.vXY[Idx].G);
+    EXPECT_EQ(Progressive.vXY[Idx].B, Expected.vXY[Idx].B);
+  }
+
+  // NOTE: The passes get finer, and the last update is the full image.
+  EXPECT_EQ(vSteps.front(), ww::PROGRESSIVE_STEP);
+  EXPECT_EQ(vSteps.back(), 1);
+  EXPECT_EQ(std::is_sorted(vSteps.rbegin(), vSteps.rend()), true);
+
+  // NOTE: The coarse pass is a single batch of rows, so the first update is its end, and
+  //       it already covers the whole canvas with blocks of the coarse pixels.
+  int const S = ww::PROGRESSIVE_STEP;
+  EXPECT_EQ(Preview.W, C.HSize);
+  EXPECT_EQ(Preview.H, C.VSize);
+  for (int Y = 0;    //<!
+       Y < C.VSize;  //<!
+       ++Y)
+  {
+    for (int X = 0;    //<!
+         X < C.HSize;  //<!
+         ++X)
+    {
+      EXPECT_EQ(ww::PixelAt(Preview, X, Y).R, ww::PixelAt(Expected, X - X % S, Y - Y % S).R);
+    }
+  }
+
+  // NOTE: The file version leaves the full image on disk.
+  temp_file const File(".ppm");
+  ww::RenderProgressive(C, W, File.Path, 0.f, 2);
+  ww::canvas FromFile{};
+  std::string Error{};
+  EXPECT_EQ(ww::ReadFromPPM(File.Path, FromFile, Error), true);
+  EXPECT_EQ(FromFile.W, C.HSize);
+  EXPECT_EQ(FromFile.H, C.VSize);
+}
+
+//------------------------------------------------------------------------------
+TEST(Ch7ImplementingACamera, RayForSampleIsEqualToRayForPixel)
+{
+  ww::camera C = ww::Camera(21, 11, M_PI / 2.f);
+  C.Transform = ww::RotateY(M_PI / 4.f) * ww::Translation(0.f, -2.f, 5.f);
+  ww::ray_generator const G = ww::RayGenerator(C);
+
+  for (int Y = 0;    //<!
+       Y < C.VSize;  //<!
+       ++Y)
+  {
+    for (int X = 0;    //<!
+         X < C.HSize;  //<!
+         ++X)
+    {
+      ww::ray const Expected = ww::RayForPixel(G, ww::ScanlineStart(G, Y) + float(X) * G.DX);
+      ww::ray const R = ww::RayForSample(G, float(X), float(Y));
+      for (int Idx = 0;  //<!
+           Idx < 4;      //<!
+           ++Idx)
+      {
+        EXPECT_EQ(R.Origin.C[Idx], Expected.Origin.C[Idx]);
+        EXPECT_EQ(R.Direction.C[Idx], Expected.Direction.C[Idx]);
+      }
+    }
+  }
+
+  // NOTE: Half a pixel to the right is half way to the next pixel.
+  ww::ray const Half = ww::RayForSample(G, 3.5f, 2.f);
+  ww::ray const Expected = ww::RayForPixel(G, ww::ScanlineStart(G, 2) + 3.5f * G.DX);
+  EXPECT_EQ(Half.Direction == Expected.Direction, true);
+}
+
+//------------------------------------------------------------------------------
+TEST(Ch7ImplementingACamera, RenderAdaptiveRefinesOnlyTheEdges)
+{
+  ww::world const W = ww::World();
+  ww::camera C = ww::Camera(41, 23, M_PI / 2.f);
+  C.Transform = ww::ViewTransform(ww::Point(0.f, 0.f, -5.f), ww::Point(0.f, 0.f, 0.f), ww::Vector(0.f, 1.f, 0.f));
+  ww::canvas const Expected = ww::Render(C, W);
+
+  ww::antialias Settings{};
+  Settings.Threads = 3;
+  ww::antialias_stats Stats{};
+  ww::canvas const Image = ww::RenderAdaptive(C, W, Settings, Stats);
+
+  // NOTE: The pixels that were not refined are the same as from Render. The refined
+  //       pixels are on the silhouette of the spheres, a small part of the image.
+  int Changed{};
+  for (size_t Idx = 0;             //<!
+       Idx < Expected.vXY.size();  //<!
+       ++Idx)
+  {
+    Changed += !(Image.vXY[Idx].R == Expected.vXY[Idx].R && Image.vXY[Idx].G == Expected.vXY[Idx].G &&
+                 Image.vXY[Idx].B == Expected.vXY[Idx].B);
+  }
+  EXPECT_GT(Changed, 0);
+  EXPECT_LE(Changed, Stats.RefinedPixels);
+  EXPECT_LT(Stats.RefinedPixels, C.HSize * C.VSize / 4);
+
+  // NOTE: Each refined pixel takes 4 rays, and up to 16 more for the second level.
+  EXPECT_GE(Stats.ExtraRays, 4 * Stats.RefinedPixels);
+  EXPECT_LE(Stats.ExtraRays, 20 * Stats.RefinedPixels);
+  EXPECT_EQ(Stats.Rays, C.HSize * C.VSize + Stats.ExtraRays);
+
+  // NOTE: Nothing is refined when no neighbours differ enough, or without subdivisions.
+  for (float const Threshold : {100.f, 0.1f})
+  {
+    Settings.Threshold = Threshold;
+    Settings.MaxDepth = Threshold > 1.f ? 2 : 0;
+    ww::canvas const Same = ww::RenderAdaptive(C, W, Settings, Stats);
+    EXPECT_EQ(Stats.ExtraRays, 0);
+    EXPECT_EQ(Stats.Rays, C.HSize * C.VSize);
+    for (size_t Idx = 0;             //<!
+         Idx < Expected.vXY.size();  //<!
+         ++Idx)
+    {
+      EXPECT_EQ(Same.vXY[Idx].R, Expected.vXY[Idx].R);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+TEST(Ch7ImplementingACamera, RenderCostIsEqualToRender)
+{
+  ww::world const W = ww::World();
+  ww::camera C = ww::Camera(41, 23, M_PI / 2.f);
+  C.Transform = ww::ViewTransform(ww::Point(0.f, 0.f, -5.f), ww::Point(0.f, 0.f, 0.f), ww::Vector(0.f, 1.f, 0.f));
+  ww::canvas const Expected = ww::Render(C, W);
+
+  ww::cost_map Cost{};
+  ww::canvas const Image = ww::RenderCost(C, W, Cost);
+  ASSERT_EQ(Cost.W, C.HSize);
+  ASSERT_EQ(Cost.H, C.VSize);
+  ASSERT_EQ(Cost.vPixels.size(), Expected.vXY.size());
+
+  int Hits{};
+  for (size_t Idx = 0;             //<!
+       Idx < Expected.vXY.size();  //<!
+       ++Idx)
+  {
+    EXPECT_EQ(Image.vXY[Idx] == Expected.vXY[Idx], true);
+    EXPECT_GE(Cost.vPixels[Idx].Nanoseconds, 0.f);
+
+    // NOTE: The camera ray tests both spheres of the world, which has no BVH. A pixel on a
+    //       sphere also sends a shadow ray toward the light, which tests up to two more.
+    bool const Hit = !(Expected.vXY[Idx] == ww::Color(0.f, 0.f, 0.f));
+    Hits += Hit;
+#if WW_PIXEL_COST
+    EXPECT_EQ(Cost.vPixels[Idx].ShadowRays, Hit ? 1 : 0);
+    EXPECT_GE(Cost.vPixels[Idx].Tests, Hit ? 3 : 2);
+    EXPECT_LE(Cost.vPixels[Idx].Tests, Hit ? 4 : 2);
+#else
+    EXPECT_EQ(Cost.vPixels[Idx].ShadowRays, 0);
+    EXPECT_EQ(Cost.vPixels[Idx].Tests, 0);
+#endif
+  }
+  EXPECT_GT(Hits, 0);
+
+  // NOTE: The most expensive pixel is white, and black is no cost.
+  Cost.vPixels[7].Nanoseconds = 1e9f;
+  Cost.vPixels[8].Nanoseconds = 0.f;
+  ww::canvas const Heatmap = ww::CostHeatmap(Cost, ww::cost_channel::NANOSECONDS);
+  EXPECT_EQ(Heatmap.vXY[7] == ww::Color(1.f, 1.f, 1.f), true);
+  EXPECT_EQ(Heatmap.vXY[8] == ww::Color(0.f, 0.f, 0.f), true);
+#if WW_PIXEL_COST
+  ww::canvas const Shadows = ww::CostHeatmap(Cost, ww::cost_channel::SHADOW_RAYS);
+  for (size_t Idx = 0;             //<!
+       Idx < Expected.vXY.size();  //<!
+       ++Idx)
+  {
+    EXPECT_EQ(Shadows.vXY[Idx] == ww::Color(1.f, 1.f, 1.f), Cost.vPixels[Idx].ShadowRays == 1);
+  }
+#endif
+
+  // NOTE: A header and a line for each of the 3 x 2 tiles.
+  temp_file const File(".csv");
+  ASSERT_EQ(ww::WriteCostCSV(Cost, File.Path, 16), 0);
+  std::ifstream I(File.Path);
+  std::string Line{};
+  int Lines{};
+  while (std::getline(I, Line)) ++Lines;
+  EXPECT_EQ(Lines, 7);
+  EXPECT_EQ(ww::WriteCostCSV(Cost, "no/such/directory/cost.csv"), -1);
+}
+
 //------------------------------------------------------------------------------
 TEST(Ch7ImplementingACamera, PuttingItTogether)
 {
@@ -2031,6 +2622,39 @@ TEST(Ch8Shadows, ShadeHitIsGivenAnIntersectionInShadow)
   EXPECT_EQ(C == ww::Color(0.1f, 0.1f, 0.1f), true);
 }
 
+//------------------------------------------------------------------------------
+TEST(Ch8Shadows, ShadeHitWithOneOfTwoLightsInShadow)
+{
+  ww::world W = ww::World();
+  *W.vPtrLights[0] = ww::PointLight(ww::Point(0.f, 0.f, -10.f), ww::Color(1.f, 1.f, 1.f));
+
+  ww::shared_ptr_light PtrLight2{};
+  PtrLight2.reset(new ww::light);
+  *PtrLight2 = ww::PointLight(ww::Point(0.f, 0.f, 20.f), ww::Color(0.5f, 0.5f, 0.5f));
+  W.vPtrLights.push_back(PtrLight2);
+
+  W.vPtrObjects.clear();
+  ww::shared_ptr_object PtrS1 = ww::PtrDefaultSphere();
+  W.vPtrObjects.push_back(PtrS1);
+  ww::shared_ptr_object PtrS2 = ww::PtrDefaultSphere();
+  PtrS2->Transform = ww::Translation(0.f, 0.f, 10.f);
+  W.vPtrObjects.push_back(PtrS2);
+
+  // NOTE: The hit is on the back of S2 at z = 11. S2 itself blocks the first light,
+  //       while the second light is in full view.
+  ww::ray const R = ww::Ray(ww::Point(0.f, 0.f, 15.f), ww::Vector(0.f, 0.f, -1.f));
+  ww::intersection const I = ww::Intersection(4.f, PtrS2);
+  ww::prepare_computation const Comps = ww::PrepareComputations(I, R);
+
+  EXPECT_EQ(ww::IsShadowed(W, Comps.Point, *W.vPtrLights[0]), true);
+  EXPECT_EQ(ww::IsShadowed(W, Comps.Point, *W.vPtrLights[1]), false);
+  EXPECT_EQ(ww::IsShadowed(W, Comps.Point), false);
+
+  ww::tup const Expect = ww::Lighting(PtrS2->Material, *W.vPtrLights[0], Comps.Point, Comps.Eye, Comps.Normal, true) +
+                         ww::Lighting(PtrS2->Material, *W.vPtrLights[1], Comps.Point, Comps.Eye, Comps.Normal, false);
+  EXPECT_EQ(ww::ShadeHit(W, Comps) == Expect, true);
+}
+
 //------------------------------------------------------------------------------
 TEST(Ch8Shadows, TheHitShouldOffsetThePoint)
 {
@@ -2047,6 +2671,41 @@ TEST(Ch8Shadows, TheHitShouldOffsetThePoint)
   EXPECT_EQ(Comps.Point.Z < -ww::EPSILON / 2.f, true);
 }
 
+//------------------------------------------------------------------------------
+TEST(Ch8Shadows, OcclusionStopsAtTheDistance)
+{
+  ww::world const W = ww::World();
+  ww::ray const R = ww::Ray(ww::Point(0.f, 0.f, -5.f), ww::Vector(0.f, 0.f, 1.f));
+
+  // NOTE: The outer sphere is hit at t = 4.
+  EXPECT_EQ(ww::IsOccluded(W, R, 10.f), true);
+  EXPECT_EQ(ww::IsOccluded(W, R, 4.5f), true);
+  EXPECT_EQ(ww::IsOccluded(W, R, 3.5f), false);
+
+  // NOTE: Objects behind the ray origin do not occlude.
+  ww::ray const Away = ww::Ray(ww::Point(0.f, 0.f, -5.f), ww::Vector(0.f, 0.f, -1.f));
+  EXPECT_EQ(ww::IsOccluded(W, Away, 100.f), false);
+}
+
+//------------------------------------------------------------------------------
+TEST(Ch8Shadows, OcclusionIsEqualWithAndWithoutBVH)
+{
+  ww::world const Linear = RandomSpheresWorld(200, 7);
+  ww::world WithBVH = Linear;
+  ww::BuildBVH(WithBVH);
+
+  for (auto const &R : RandomRays(500, 8))
+  {
+    for (float const Distance : {2.f, 8.f, 30.f})
+    {
+      ww::intersection const H = ww::Hit(ww::IntersectWorld(Linear, R));
+      bool const Expect = H.pObject && H.t < Distance;
+      EXPECT_EQ(ww::IsOccluded(Linear, R, Distance), Expect);
+      EXPECT_EQ(ww::IsOccluded(WithBVH, R, Distance), Expect);
+    }
+  }
+}
+
 //------------------------------------------------------------------------------
 TEST(Ch8Shadows, PuttingItTogether)
 {
@@ -2143,6 +2802,1181 @@ TEST(Ch8Shadows, PuttingItTogether)
   ww::canvas Canvas = ww::Render(Camera, World);
   ww::WriteToPPM(Canvas, "Ch8MakingAScene.ppm");
 }
+//------------------------------------------------------------------------------
+TEST(SIMD, SetLevelIsLimitedBySupport)
+{
+  ww::simd const Old = ww::SIMDLevel();
+  EXPECT_EQ(ww::SetSIMDLevel(ww::simd::SCALAR) == ww::simd::SCALAR, true);
+  EXPECT_EQ(ww::SIMDLevel() == ww::simd::SCALAR, true);
+  EXPECT_EQ(ww::SetSIMDLevel(ww::simd::AVX) == ww::SIMDSupported(), true);
+  ww::SetSIMDLevel(Old);
+}
+
+//------------------------------------------------------------------------------
+TEST(SIMD, KernelsAreBitExact)
+{
+  ww::simd const Old = ww::SIMDLevel();
+  std::mt19937 Gen(6);
+  std::uniform_real_distribution<float> Value(-10.f, 10.f);
+  auto RandomTup = [&]() { return ww::tup{Value(Gen), Value(Gen), Value(Gen), Value(Gen)}; };
+
+  auto ExpectBitEqual = [](ww::tup const &A, ww::tup const &B) {
+    for (int Idx = 0;  //<!
+         Idx < 4;      //<!
+         ++Idx)
+    {
+      EXPECT_EQ(A.C[Idx], B.C[Idx]);
+    }
+  };
+
+  for (int Count = 0;  //<!
+       Count < 100;    //<!
+       ++Count)
+  {
+    ww::tup const A = RandomTup();
+    ww::tup const B = RandomTup();
+    float const S = Value(Gen);
+    ww::matrix const M1{RandomTup(), RandomTup(), RandomTup(), RandomTup()};
+    ww::matrix const M2{RandomTup(), RandomTup(), RandomTup(), RandomTup()};
+
+    // NOTE: The tuple functions do not follow the level, so they are checked against the
+    //       scalar code written out here.
+    ExpectBitEqual(A + B, ww::tup{A.X + B.X, A.Y + B.Y, A.Z + B.Z, A.W + B.W});
+    ExpectBitEqual(A - B, ww::tup{A.X - B.X, A.Y - B.Y, A.Z - B.Z, A.W - B.W});
+    ExpectBitEqual(S * A, ww::tup{S * A.X, S * A.Y, S * A.Z, S * A.W});
+    ExpectBitEqual(A * B, ww::tup{A.X * B.X, A.Y * B.Y, A.Z * B.Z, A.W * B.W});
+    EXPECT_EQ(ww::Dot(A, B), A.X * B.X + A.Y * B.Y + A.Z * B.Z + A.W * B.W);
+    ww::tup MulMT{};
+    for (int Row = 0;  //<!
+         Row < 4;      //<!
+         ++Row)
+    {
+      ww::tup const &R = M1.R[Row];
+      MulMT.C[Row] = R.C[0] * A.C[0] + R.C[1] * A.C[1] + R.C[2] * A.C[2] + R.C[3] * A.C[3];
+    }
+    ExpectBitEqual(M1 * A, MulMT);
+
+    ww::SetSIMDLevel(ww::simd::SCALAR);
+    ww::matrix const MulMM = M1 * M2;
+    ww::matrix const Inv = ww::Inverse(M1);
+
+    for (auto const Level : {ww::simd::SSE, ww::simd::AVX})
+    {
+      if (ww::SetSIMDLevel(Level) != Level) continue;
+      ww::matrix const M = M1 * M2;
+      for (int Row = 0;  //<!
+           Row < 4;      //<!
+           ++Row)
+      {
+        ExpectBitEqual(MulMM.R[Row], M.R[Row]);
+      }
+      EXPECT_EQ(M.Dimension, 4);
+      ww::matrix const MInv = ww::Inverse(M1);
+      for (int Row = 0;  //<!
+           Row < 4;      //<!
+           ++Row)
+      {
+        ExpectBitEqual(Inv.R[Row], MInv.R[Row]);
+      }
+    }
+  }
+  ww::SetSIMDLevel(Old);
+}
+
+//------------------------------------------------------------------------------
+TEST(SIMD, RenderIsBitExact)
+{
+  ww::simd const Old = ww::SIMDLevel();
+  ww::world const W = ww::World();
+
+  ww::camera C = ww::Camera(21, 11, M_PI / 2.f);
+  C.Transform = ww::ViewTransform(ww::Point(0.f, 0.f, -5.f), ww::Point(0.f, 0.f, 0.f), ww::Vector(0.f, 1.f, 0.f));
+
+  ww::SetSIMDLevel(ww::simd::SCALAR);
+  ww::canvas const Scalar = ww::Render(C, W);
+  ww::SetSIMDLevel(ww::SIMDSupported());
+  ww::canvas const Vector = ww::Render(C, W);
+
+  for (size_t Idx = 0;           //<!
+       Idx < Scalar.vXY.size();  //<!
+       ++Idx)
+  {
+    EXPECT_EQ(Scalar.vXY[Idx].R, Vector.vXY[Idx].R);
+    EXPECT_EQ(Scalar.vXY[Idx].G, Vector.vXY[Idx].G);
+    EXPECT_EQ(Scalar.vXY[Idx].B, Vector.vXY[Idx].B);
+  }
+  ww::SetSIMDLevel(Old);
+}
+
+//------------------------------------------------------------------------------
+TEST(SphereSoA, HitsAreEqualToTheObjectPath)
+{
+  ww::simd const Old = ww::SIMDLevel();
+
+  // NOTE: 203 spheres, so the last chunk of eight is only partly used.
+  ww::world const Objects = RandomSpheresWorld(203, 21);
+  ww::world Linear = Objects;
+  ww::BuildSphereSoA(Linear);
+  EXPECT_EQ(ww::IsSphereSoAValid(Linear), true);
+  EXPECT_EQ(Linear.Spheres.Stride % 8, 0);
+
+  ww::world WithBVH = Objects;
+  ww::BuildSphereSoA(WithBVH);
+  ww::BuildBVH(WithBVH);
+  EXPECT_EQ(ww::IsSphereSoAValid(WithBVH), true);
+  EXPECT_EQ(WithBVH.Spheres.vObject == WithBVH.BVH.vIndices, true);
+
+  for (auto const Level : {ww::simd::SCALAR, ww::simd::SSE, ww::simd::AVX})
+  {
+    if (ww::SetSIMDLevel(Level) != Level) continue;
+    for (auto const &R : RandomRays(300, 22))
+    {
+      ww::world_hit const Expected = ww::ClosestHit(Objects, R);
+      for (ww::world const *pWorld : {&Linear, &WithBVH})
+      {
+        ww::world_hit const H = ww::ClosestHit(*pWorld, R);
+        EXPECT_EQ(H.Index, Expected.Index);
+        EXPECT_EQ(H.t, Expected.t);
+        for (float const Distance : {1.f, 5.f, 30.f})
+        {
+          EXPECT_EQ(ww::IsOccluded(*pWorld, R, Distance), ww::IsOccluded(Objects, R, Distance));
+        }
+      }
+    }
+  }
+  ww::SetSIMDLevel(Old);
+}
+
+//------------------------------------------------------------------------------
+TEST(SphereSoA, OnlyBuiltForSpheres)
+{
+  ww::world W = ww::World();
+  ww::BuildSphereSoA(W);
+  EXPECT_EQ(ww::IsSphereSoAValid(W), true);
+
+  W.vPtrObjects.push_back(std::make_shared<ww::cube>());
+  EXPECT_EQ(ww::IsSphereSoAValid(W), false);
+  ww::BuildSphereSoA(W);
+  EXPECT_EQ(W.Spheres.Count, 0);
+  EXPECT_EQ(ww::IsSphereSoAValid(W), false);
+}
+
+//------------------------------------------------------------------------------
+TEST(RayPacket, ClosestHitsAreEqualToClosestHit)
+{
+  ww::simd const Old = ww::SIMDLevel();
+
+  ww::world Objects = RandomSpheresWorld(203, 31);
+  ww::world Linear = Objects;
+  ww::BuildSphereSoA(Linear);
+  ww::world WithBVH = Linear;
+  ww::BuildBVH(WithBVH);
+
+  // NOTE: Random rays do not share much of a path, so the packets diverge early.
+  std::vector<ww::ray> const vRays = RandomRays(160, 32);
+  for (auto const Level : {ww::simd::SCALAR, ww::simd::SSE, ww::simd::AVX})
+  {
+    if (ww::SetSIMDLevel(Level) != Level) continue;
+    // NOTE: Packets of 16, 11, 6 and 1 rays.
+    size_t First{};
+    for (int Packet = 0;        //<!
+         First < vRays.size();  //<!
+         ++Packet)
+    {
+      int const Size = ww::ray_packet::MAX_RAYS - (Packet % 4) * 5;
+      ww::ray_packet P{};
+      for (;                                        //<!
+           First < vRays.size() && P.Count < Size;  //<!
+           ++First, ++P.Count)
+      {
+        for (int C = 0;  //<!
+             C < 4;      //<!
+             ++C)
+        {
+          P.Origin[C][P.Count] = vRays[First].Origin.C[C];
+          P.Direction[C][P.Count] = vRays[First].Direction.C[C];
+        }
+      }
+
+      for (ww::world const *pWorld : {&Objects, &Linear, &WithBVH})
+      {
+        ww::world_hit vHits[ww::ray_packet::MAX_RAYS];
+        ww::ClosestHits(*pWorld, P, vHits);
+        for (int Lane = 0;    //<!
+             Lane < P.Count;  //<!
+             ++Lane)
+        {
+          ww::world_hit const Expected = ww::ClosestHit(Objects, ww::PacketRay(P, Lane));
+          EXPECT_EQ(vHits[Lane].Index, Expected.Index);
+          EXPECT_EQ(vHits[Lane].t, Expected.t);
+        }
+      }
+    }
+  }
+  ww::SetSIMDLevel(Old);
+}
+
+//------------------------------------------------------------------------------
+TEST(RayPacket, RenderIsEqualToSingleRays)
+{
+  ww::simd const Old = ww::SIMDLevel();
+
+  ww::world Objects = RandomSpheresWorld(150, 33);
+  ww::world Linear = Objects;
+  ww::BuildSphereSoA(Linear);
+  ww::world WithBVH = Linear;
+  ww::BuildBVH(WithBVH);
+
+  // NOTE: The size is not a multiple of 4, so the packets along the edges are partly used.
+  ww::camera C = ww::Camera(37, 23, M_PI / 2.f);
+  C.Transform = ww::ViewTransform(ww::Point(0.f, 0.f, -20.f), ww::Point(0.f, 0.f, 0.f), ww::Vector(0.f, 1.f, 0.f));
+
+  for (auto const Level : {ww::simd::SCALAR, ww::simd::SSE, ww::simd::AVX})
+  {
+    if (ww::SetSIMDLevel(Level) != Level) continue;
+    for (ww::world const *pWorld : {&Objects, &Linear, &WithBVH})
+    {
+      ww::canvas const Expected = ww::Render(C, *pWorld);
+      for (int const PacketSize : {2, 4})
+      {
+        ww::canvas const Packets = ww::Render(C, *pWorld, PacketSize);
+        ww::canvas const Parallel = ww::RenderParallel(C, *pWorld, 3, 6, PacketSize);
+        for (size_t Idx = 0;             //<!
+             Idx < Expected.vXY.size();  //<!
+             ++Idx)
+        {
+          EXPECT_EQ(Packets.vXY[Idx].R, Expected.vXY[Idx].R);
+          EXPECT_EQ(Packets.vXY[Idx].G, Expected.vXY[Idx].G);
+          EXPECT_EQ(Packets.vXY[Idx].B, Expected.vXY[Idx].B);
+          EXPECT_EQ(Parallel.vXY[Idx].R, Expected.vXY[Idx].R);
+          EXPECT_EQ(Parallel.vXY[Idx].G, Expected.vXY[Idx].G);
+          EXPECT_EQ(Parallel.vXY[Idx].B, Expected.vXY[Idx].B);
+        }
+      }
+    }
+  }
+  ww::SetSIMDLevel(Old);
+}
+
+//------------------------------------------------------------------------------
+// NOTE: A flat N x N grid of quads from (0,0,0) to (1,1,0), two triangles per quad.
+ww::shared_ptr_mesh_data GridMeshData(int const N)
+{
+  std::vector<ww::tup> vVertices{};
+  std::vector<int> vIndices{};
+  for (int Y = 0;  //<!
+       Y <= N;     //<!
+       ++Y)
+  {
+    for (int X = 0;  //<!
+         X <= N;     //<!
+         ++X)
+    {
+      vVertices.push_back(ww::Point(float(X) / N, float(Y) / N, 0.f));
+    }
+  }
+  for (int Y = 0;  //<!
+       Y < N;      //<!
+       ++Y)
+  {
+    for (int X = 0;  //<!
+         X < N;      //<!
+         ++X)
+    {
+      int const I = Y * (N + 1) + X;
+      for (int const Index : {I, I + 1, I + N + 2, I, I + N + 2, I + N + 1})
+      {
+        vIndices.push_back(Index);
+      }
+    }
+  }
+  return (ww::MeshData(vVertices, vIndices));
+}
+
+//------------------------------------------------------------------------------
+TEST(Mesh, IntersectTriangle)
+{
+  ww::triangle const T{{{0.f, 1.f, 0.f}, {-1.f, 0.f, 0.f}, {1.f, 0.f, 0.f}}};
+  float t{};
+
+  // NOTE: Parallel to the triangle, and past each of the three edges.
+  EXPECT_EQ(ww::IntersectTriangle(T, ww::Ray(ww::Point(0.f, -1.f, -2.f), ww::Vector(0.f, 1.f, 0.f)), t), false);
+  EXPECT_EQ(ww::IntersectTriangle(T, ww::Ray(ww::Point(1.f, 1.f, -2.f), ww::Vector(0.f, 0.f, 1.f)), t), false);
+  EXPECT_EQ(ww::IntersectTriangle(T, ww::Ray(ww::Point(-1.f, 1.f, -2.f), ww::Vector(0.f, 0.f, 1.f)), t), false);
+  EXPECT_EQ(ww::IntersectTriangle(T, ww::Ray(ww::Point(0.f, -1.f, -2.f), ww::Vector(0.f, 0.f, 1.f)), t), false);
+
+  // NOTE: A hit, from both sides, but not behind the ray.
+  EXPECT_EQ(ww::IntersectTriangle(T, ww::Ray(ww::Point(0.f, 0.5f, -2.f), ww::Vector(0.f, 0.f, 1.f)), t), true);
+  EXPECT_EQ(t, 2.f);
+  EXPECT_EQ(ww::IntersectTriangle(T, ww::Ray(ww::Point(0.f, 0.5f, 4.f), ww::Vector(0.f, 0.f, -2.f)), t), true);
+  EXPECT_EQ(t, 4.f);
+  EXPECT_EQ(ww::IntersectTriangle(T, ww::Ray(ww::Point(0.f, 0.5f, 2.f), ww::Vector(0.f, 0.f, 1.f)), t), false);
+}
+
+//------------------------------------------------------------------------------
+TEST(Mesh, WatertightOnSharedEdgesAndVertices)
+{
+  int const N = 8;
+  ww::shared_ptr_object const PtrMesh = ww::PtrMesh(GridMeshData(N));
+  PtrMesh->Transform = ww::Translation(-0.3f, 0.2f, 1.f) * ww::RotateY(0.4f) * ww::RotateX(0.3f);
+
+  // NOTE: Aim at every inner vertex and at the middle of every inner edge of the grid,
+  //       from a few origins. Each of these rays passes between two or more triangles.
+  for (ww::tup const &Origin : {ww::Point(0.1f, 0.2f, -3.f), ww::Point(-2.f, 1.7f, -1.f), ww::Point(3.f, -2.f, -5.f)})
+  {
+    int Misses{};
+    for (int Y = 1;  //<!
+         Y < 2 * N;  //<!
+         ++Y)
+    {
+      for (int X = 1;  //<!
+           X < 2 * N;  //<!
+           ++X)
+      {
+        ww::tup const Target = PtrMesh->Transform.Matrix() * ww::Point(0.5f * X / N, 0.5f * Y / N, 0.f);
+        ww::intersect_return const XS = ww::IntersectObject(*PtrMesh, ww::Ray(Origin, Target - Origin));
+        Misses += XS.Count == 0;
+        if (XS.Count) EXPECT_EQ(ww::Equal(XS.t[0], ww::Mag(Target - Origin)), true);
+      }
+    }
+    EXPECT_EQ(Misses, 0);
+  }
+}
+
+//------------------------------------------------------------------------------
+TEST(Mesh, BVHIsEqualToAllTriangles)
+{
+  // NOTE: A soup of random triangles.
+  std::mt19937 Gen(51);
+  std::uniform_real_distribution<float> Pos(-10.f, 10.f);
+  std::uniform_real_distribution<float> Offset(-1.f, 1.f);
+  std::vector<ww::tup> vVertices{};
+  std::vector<int> vIndices{};
+  for (int Idx = 0;  //<!
+       Idx < 600;    //<!
+       ++Idx)
+  {
+    ww::tup const Center = ww::Point(Pos(Gen), Pos(Gen), Pos(Gen));
+    for (int Corner = 0;  //<!
+         Corner < 3;      //<!
+         ++Corner)
+    {
+      vIndices.push_back(static_cast<int>(vVertices.size()));
+      vVertices.push_back(Center + ww::Vector(Offset(Gen), Offset(Gen), Offset(Gen)));
+    }
+  }
+  ww::shared_ptr_mesh_data const pData = ww::MeshData(vVertices, vIndices);
+  ASSERT_NE(pData, nullptr);
+  EXPECT_EQ(pData->vTriangles.size(), 600);
+  ww::mesh M{};
+  M.pData = pData;
+
+  int Hits{};
+  for (auto const &R : RandomRays(400, 52))
+  {
+    float tExpected = std::numeric_limits<float>::max();
+    int Expected{-1};
+    for (size_t Idx = 0;                  //<!
+         Idx < pData->vTriangles.size();  //<!
+         ++Idx)
+    {
+      float t{};
+      if (ww::IntersectTriangle(pData->vTriangles[Idx], R, t) && t < tExpected)
+      {
+        tExpected = t;
+        Expected = static_cast<int>(Idx);
+      }
+    }
+
+    ww::intersect_return const XS = ww::IntersectObject(M, R);
+    EXPECT_EQ(XS.Count, Expected < 0 ? 0 : 1);
+    if (Expected < 0) continue;
+    EXPECT_EQ(XS.t[0], tExpected);
+    EXPECT_EQ(XS.Primitive[0], Expected);
+    ++Hits;
+  }
+  EXPECT_GT(Hits, 0);
+
+  // NOTE: Bad index buffers are refused.
+  EXPECT_EQ(ww::MeshData(vVertices, {0, 1}), nullptr);
+  EXPECT_EQ(ww::MeshData(vVertices, {0, 1, static_cast<int>(vVertices.size())}), nullptr);
+}
+
+//------------------------------------------------------------------------------
+TEST(Mesh, InAWorld)
+{
+  // NOTE: A 20 x 20 floor of two triangles under the default world, as in chapter 7.
+  ww::world W = ww::World();
+  ww::shared_ptr_object const PtrFloor = ww::PtrMesh(GridMeshData(1));
+  PtrFloor->Transform = ww::Translation(-10.f, -1.f, 10.f) * ww::Scaling(20.f, 1.f, 20.f) * ww::RotateX(-M_PI / 2.f);
+  W.vPtrObjects.push_back(PtrFloor);
+
+  ww::ray const Down = ww::Ray(ww::Point(-3.f, 5.f, -3.f), ww::Vector(0.f, -1.f, 0.f));
+  ww::intersection const I = ww::Hit(ww::IntersectWorld(W, Down));
+  EXPECT_EQ(I.pObject, PtrFloor);
+  EXPECT_EQ(ww::Equal(I.t, 6.f), true);
+  EXPECT_GE(I.Primitive, 0);
+
+  ww::world_hit const H = ww::ClosestHit(W, Down);
+  EXPECT_EQ(H.Index, 2);
+  EXPECT_EQ(H.t, I.t);
+  EXPECT_EQ(H.Primitive, I.Primitive);
+
+  // NOTE: The normal of the floor points up, toward the ray.
+  ww::prepare_computation const Comps = ww::PrepareComputations(I, Down);
+  EXPECT_EQ(Comps.Normal == ww::Vector(0.f, 1.f, 0.f), true);
+  EXPECT_EQ(Comps.Inside, false);
+
+  // NOTE: Without the triangle, the normal is the one of the triangle under the point.
+  ww::prepare_computation const NoPrimitive = ww::PrepareComputations(ww::Intersection(I.t, PtrFloor), Down);
+  EXPECT_EQ(NoPrimitive.Normal == Comps.Normal, true);
+  EXPECT_EQ(ww::NormalAt(*PtrFloor, Comps.Point, 1000) == Comps.Normal, true);
+
+  // NOTE: The BVH gives the same hits, and the floor is lit.
+  ww::world WithBVH = W;
+  ww::BuildBVH(WithBVH);
+  for (auto const &R : RandomRays(200, 53))
+  {
+    ww::world_hit const A = ww::ClosestHit(W, R);
+    ww::world_hit const B = ww::ClosestHit(WithBVH, R);
+    EXPECT_EQ(A.Index, B.Index);
+    EXPECT_EQ(A.t, B.t);
+    EXPECT_EQ(A.Primitive, B.Primitive);
+  }
+  ww::tup const C = ww::ColorAt(WithBVH, Down);
+  EXPECT_GT(C.R, 0.1f);
+}
+
+//------------------------------------------------------------------------------
+// NOTE: Write Content to File and read it back as an OBJ file.
+bool ReadOBJ(temp_file const &File, std::string const &Content, ww::obj_data &Obj, std::string &Error,
+             int const NumThreads = 1)
+{
+  File.Write(Content);
+  ww::obj_stats Stats{};
+  Error.clear();
+  bool const Result = ww::ReadFromOBJ(File.Path, Obj, Error, Stats, NumThreads);
+  EXPECT_EQ(Result, Error.empty());
+  if (Result) EXPECT_EQ(Stats.FileBytes, Content.size());
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+TEST(OBJ, ReadVerticesNormalsAndFaces)
+{
+  std::string const Content = "# A unit square, and a triangle with normals\r\n"
+                              "mtllib square.mtl\n"
+                              "o Square\n"
+                              "v 0 0 0\n"
+                              "v 1.0 0 0\n"
+                              "  v\t1 1 0 1.0\n"
+                              "v -0 1e0 0.0 # the last corner\n"
+                              "vt 0.5 0.5\n"
+                              "vn 0 0 1\r\n"
+                              "vn -1.5 +2.25 -.5\n"
+                              "g front\n"
+                              "usemtl red\n"
+                              "s off\n"
+                              "f 1 2 3 4\n"
+                              "f -4//1 -3//2 -2//-1\n"
+                              "f 1/1/2 2/1/2 4/1/1\n"
+                              "l 1 2\n"
+                              "f 3 2 1";
+  ww::obj_data Obj{};
+  std::string Error{};
+  ASSERT_EQ(ReadOBJ(temp_file(".obj"), Content, Obj, Error), true);
+
+  ASSERT_EQ(Obj.vVertices.size(), 4);
+  EXPECT_EQ(Obj.vVertices[0] == ww::Point(0.f, 0.f, 0.f), true);
+  EXPECT_EQ(Obj.vVertices[1] == ww::Point(1.f, 0.f, 0.f), true);
+  EXPECT_EQ(Obj.vVertices[2] == ww::Point(1.f, 1.f, 0.f), true);
+  EXPECT_EQ(Obj.vVertices[3] == ww::Point(0.f, 1.f, 0.f), true);
+  ASSERT_EQ(Obj.vNormals.size(), 2);
+  EXPECT_EQ(Obj.vNormals[0] == ww::Vector(0.f, 0.f, 1.f), true);
+  EXPECT_EQ(Obj.vNormals[1] == ww::Vector(-1.5f, 2.25f, -0.5f), true);
+
+  // NOTE: The quad is split into a fan of two triangles.
+  std::vector<int> const Indices{0, 1, 2, 0, 2, 3, 0, 1, 2, 0, 1, 3, 2, 1, 0};
+  std::vector<int> const NormalIndices{-1, -1, -1, -1, -1, -1, 0, 1, 1, 1, 1, 0, -1, -1, -1};
+  EXPECT_EQ(Obj.vIndices, Indices);
+  EXPECT_EQ(Obj.vNormalIndices, NormalIndices);
+
+  // NOTE: The buffers feed a mesh directly.
+  ww::shared_ptr_mesh_data const pData = ww::MeshData(Obj.vVertices, Obj.vIndices);
+  ASSERT_NE(pData, nullptr);
+  EXPECT_EQ(pData->vTriangles.size(), 5);
+}
+
+//------------------------------------------------------------------------------
+TEST(OBJ, NumbersAreReadLikeStrtof)
+{
+  // NOTE: Nine significant digits is enough to print any float exactly.
+  std::mt19937 Gen(61);
+  std::uniform_int_distribution<int> Exponent(-37, 37);
+  std::uniform_real_distribution<float> Mantissa(-10.f, 10.f);
+  std::vector<std::string> vNumbers{"0", "-0.0", "1e-3", "+2.", "-.5", "1E+2", "123456789012345678901234567890",
+                                    "0.000000000000000000000000000000000001", "3.4028235e38", "1e-45"};
+  for (int Idx = 0;  //<!
+       Idx < 3000;   //<!
+       ++Idx)
+  {
+    char Buffer[32];
+    std::snprintf(Buffer, sizeof(Buffer), "%.9g", Mantissa(Gen) * std::pow(10.f, float(Exponent(Gen))));
+    vNumbers.push_back(Buffer);
+  }
+  while (vNumbers.size() % 3) vNumbers.push_back("1");
+
+  std::string Content{};
+  for (size_t Idx = 0;         //<!
+       Idx < vNumbers.size();  //<!
+       Idx += 3)
+  {
+    Content += "v " + vNumbers[Idx] + " " + vNumbers[Idx + 1] + " " + vNumbers[Idx + 2] + "\n";
+  }
+
+  ww::obj_data Obj{};
+  std::string Error{};
+  ASSERT_EQ(ReadOBJ(temp_file(".obj"), Content, Obj, Error), true) << Error;
+  ASSERT_EQ(Obj.vVertices.size(), vNumbers.size() / 3);
+  for (size_t Idx = 0;         //<!
+       Idx < vNumbers.size();  //<!
+       ++Idx)
+  {
+    EXPECT_EQ(Obj.vVertices[Idx / 3].C[Idx % 3], std::strtof(vNumbers[Idx].c_str(), nullptr)) << vNumbers[Idx];
+  }
+}
+
+//------------------------------------------------------------------------------
+TEST(OBJ, ThreadsGiveTheSameBuffers)
+{
+  // NOTE: A grid of quads, big enough to be split over three threads, with relative
+  //       indices that reach back into the chunk before.
+  int const N = 200;
+  std::string Content{};
+  char Buffer[96];
+  for (int Y = 0;  //<!
+       Y <= N;     //<!
+       ++Y)
+  {
+    for (int X = 0;  //<!
+         X <= N;     //<!
+         ++X)
+    {
+      std::snprintf(Buffer, sizeof(Buffer), "v %.6f %.6f %.6f\nvn 0 0 1\n", X * 0.013f, Y * 0.017f, (X ^ Y) * 0.001f);
+      Content += Buffer;
+    }
+    if (Y == 0) continue;
+    for (int X = 0;  //<!
+         X < N;      //<!
+         ++X)
+    {
+      int const Row = -(N + 1) - (N - X);
+      std::snprintf(Buffer, sizeof(Buffer), "f %d//%d %d/%d/%d %d//%d %d//-1\n", Row - 1, Row - 1, Row, 7, Row,
+                    -(N - X), -(N - X), -(N - X) - 1);
+      Content += Buffer;
+    }
+  }
+  ASSERT_GT(Content.size(), 3u << 20);
+
+  ww::obj_data One{};
+  ww::obj_data Three{};
+  std::string Error{};
+  temp_file const File(".obj");
+  ASSERT_EQ(ReadOBJ(File, Content, One, Error, 1), true);
+
+  ww::obj_stats Stats{};
+  // NOTE: Eight threads are asked for, but there is at most one per megabyte.
+  ASSERT_EQ(ww::ReadFromOBJ(File.Path, Three, Error, Stats, 8), true);
+  EXPECT_EQ(Stats.Threads, 3);
+  EXPECT_GT(Stats.BufferBytes, 0);
+  EXPECT_GT(Stats.MaxRSSKB, 0);
+
+  EXPECT_EQ(One.vVertices.size(), (N + 1) * (N + 1));
+  EXPECT_EQ(One.vIndices.size(), 6 * N * N);
+  auto const Same = [](ww::tup const &A, ww::tup const &B) { return (A == B); };
+  EXPECT_EQ(std::equal(One.vVertices.begin(), One.vVertices.end(), Three.vVertices.begin(), Three.vVertices.end(), Same),
+            true);
+  EXPECT_EQ(std::equal(One.vNormals.begin(), One.vNormals.end(), Three.vNormals.begin(), Three.vNormals.end(), Same),
+            true);
+  EXPECT_EQ(One.vIndices, Three.vIndices);
+  EXPECT_EQ(One.vNormalIndices, Three.vNormalIndices);
+  EXPECT_EQ(ww::MeshData(One.vVertices, One.vIndices) != nullptr, true);
+}
+
+//------------------------------------------------------------------------------
+TEST(OBJ, RejectsMalformed)
+{
+  ww::obj_data Obj{};
+  std::string Error{};
+  temp_file const File(".obj");
+  EXPECT_EQ(ReadOBJ(File, "v 1 2 3\nv 1 2 3\nv 1 2 3\nf 1 2 3\n", Obj, Error), true);
+
+  EXPECT_EQ(ReadOBJ(File, "v 1 2\n", Obj, Error), false);
+  EXPECT_EQ(Error, "Line 1: A vertex needs three numbers.");
+  EXPECT_EQ(ReadOBJ(File, "v 1 2 3\nv 1 2 3\nv 1 2 x\n", Obj, Error), false);
+  EXPECT_EQ(Error, "Line 3: A vertex needs three numbers.");
+  EXPECT_EQ(ReadOBJ(File, "v 1 2 3\nvn 1 2 3e\n", Obj, Error), false);
+  EXPECT_EQ(Error, "Line 2: A normal needs three numbers.");
+  EXPECT_EQ(ReadOBJ(File, "v 1 2 3\nv 1 2 3\nf 1 2\n", Obj, Error), false);
+  EXPECT_EQ(Error, "Line 3: A face needs at least three corners.");
+  EXPECT_EQ(ReadOBJ(File, "v 1 2 3\nv 1 2 3\nv 1 2 3\nf 1 2 4\n", Obj, Error), false);
+  EXPECT_EQ(Error, "Line 4: Bad or out of range vertex index.");
+  EXPECT_EQ(ReadOBJ(File, "v 1 2 3\nv 1 2 3\nf 0 1 2\n", Obj, Error), false);
+  EXPECT_EQ(ReadOBJ(File, "v 1 2 3\nv 1 2 3\nf -3 1 2\n", Obj, Error), false);
+  EXPECT_EQ(ReadOBJ(File, "v 1 2 3\nv 1 2 3\nv 1 2 3\nf 1//1 2 3\n", Obj, Error), false);
+  EXPECT_EQ(Error, "Line 4: Bad or out of range normal index.");
+  EXPECT_EQ(ReadOBJ(File, "v 1 2 3\nv 1 2 3\nv 1 2 3\nf 1/x 2 3\n", Obj, Error), false);
+  EXPECT_EQ(ReadOBJ(File, "v 1 2 3\nv 1 2 3\nv 1 2 3\nf 1 2 3x\n", Obj, Error), false);
+  EXPECT_EQ(Error, "Line 4: Bad face corner.");
+  EXPECT_EQ(Obj.vVertices.size(), 0);
+  EXPECT_EQ(Obj.vIndices.size(), 0);
+
+  ww::obj_stats Stats{};
+  EXPECT_EQ(ww::ReadFromOBJ("no/such/file.obj", Obj, Error, Stats), false);
+  EXPECT_EQ(Error.empty(), false);
+}
+
+//------------------------------------------------------------------------------
+// \fn ReadScene - Write Content to File and read it as a scene.
+bool ReadScene(temp_file const &File, std::string const &Content, ww::world &World, ww::camera &Camera,
+               std::string &Error)
+{
+  File.Write(Content);
+  ww::scene_stats Stats{};
+  Error.clear();
+  bool const Result = ww::ReadScene(File.Path, World, Camera, Error, Stats);
+  EXPECT_EQ(Result, Error.empty());
+  if (Result) EXPECT_EQ(Stats.FileBytes, Content.size());
+  if (Result) EXPECT_EQ(Stats.Objects, World.vPtrObjects.size());
+  return (Result);
+}
+
+//------------------------------------------------------------------------------
+TEST(Scene, ReadTheChapter7Scene)
+{
+  std::string const Content = "# The end of chapter 7\n"
+                              "- add: camera\n"
+                              "  width: 100\n"
+                              "  height: 50\n"
+                              "  field-of-view: 1.0471976\n"
+                              "  from: [0, 1.5, -5]\n"
+                              "  to: [0, 1, 0]\n"
+                              "  up: [0, 1, 0]\n"
+                              "\n"
+                              "- add: light\n"
+                              "  at: [-10, 10, -10]\n"
+                              "  intensity: [1, 1, 1]\n"
+                              "\n"
+                              "- define: wall\n"
+                              "  value:\n"
+                              "    color: [1, 0.9, 0.9]\n"
+                              "    specular: 0\n"
+                              "- define: flat\n"
+                              "  value:\n"
+                              "    - [scale, 10, 0.01, 10]\n"
+                              "- define: standing\n"
+                              "  extend: flat\n"
+                              "  value:\n"
+                              "    - [rotate-x, 1.5707964]\n"
+                              "    - [translate, 0, 0, 5]\n"
+                              "\n"
+                              "- add: sphere  # the floor\n"
+                              "  material: wall\n"
+                              "  transform:\n"
+                              "    - flat\n"
+                              "- add: sphere\r\n"
+                              "  material: wall\r\n"
+                              "  transform:\r\n"
+                              "    - standing\r\n"
+                              "    - [rotate-y, -0.7853982]\r\n"
+                              "- add: sphere\n"
+                              "  material:\n"
+                              "    color: [0.1, 1, 0.5]\n"
+                              "    diffuse: 0.7\n"
+                              "    specular: 0.3\n"
+                              "  transform:\n"
+                              "    - [translate, -0.5, 1, 0.5]\n"
+                              "- add: sphere";
+  ww::world World{};
+  ww::camera Camera{};
+  std::string Error{};
+  ASSERT_EQ(ReadScene(temp_file(".yml"), Content, World, Camera, Error), true) << Error;
+
+  ww::camera const Expected = ww::Camera(100, 50, M_PI / 3.f);
+  EXPECT_EQ(Camera.HSize, Expected.HSize);
+  EXPECT_EQ(Camera.VSize, Expected.VSize);
+  EXPECT_EQ(ww::Equal(Camera.FieldOfView, Expected.FieldOfView), true);
+  EXPECT_EQ(ww::Equal(Camera.Transform, ww::ViewTransform(ww::Point(0.f, 1.5f, -5.f), ww::Point(0.f, 1.f, 0.f),
+                                                          ww::Vector(0.f, 1.f, 0.f))),
+            true);
+
+  ASSERT_EQ(World.vPtrLights.size(), 1);
+  EXPECT_EQ(ww::Equal(*World.vPtrLights[0], ww::PointLight(ww::Point(-10.f, 10.f, -10.f), ww::Color(1.f, 1.f, 1.f))),
+            true);
+
+  ASSERT_EQ(World.vPtrObjects.size(), 4);
+  ww::material Wall{};
+  Wall.Color = ww::Color(1.f, 0.9f, 0.9f);
+  Wall.Specular = 0.f;
+  ww::material M{};
+  M.Diffuse = 0.7f;
+  M.Specular = 0.3f;
+  M.Color = ww::Color(0.1f, 1.0f, 0.5f);
+  ww::matrix const vTransforms[] = {
+      ww::Scaling(10.f, 0.01f, 10.f),
+      ww::RotateY(-M_PI_4) * ww::Translation(0.f, 0.f, 5.f) * ww::RotateX(M_PI_2) * ww::Scaling(10.f, 0.01f, 10.f),
+      ww::Translation(-0.5f, 1.f, 0.5f), ww::I()};
+  ww::material const vMaterials[] = {Wall, Wall, M, ww::material{}};
+  for (int Idx = 0;  //<!
+       Idx < 4;      //<!
+       ++Idx)
+  {
+    ww::object const &Object = *World.vPtrObjects[Idx];
+    EXPECT_EQ(Object.isA<ww::sphere>(), true);
+    EXPECT_EQ(ww::Equal(Object.Transform, vTransforms[Idx]), true) << Idx;
+    EXPECT_EQ(ww::Equal(Object.Material, vMaterials[Idx]), true) << Idx;
+  }
+  EXPECT_EQ(ww::IsBVHValid(World), true);
+}
+
+//------------------------------------------------------------------------------
+TEST(Scene, ObjFilesAreLoadedOnce)
+{
+  temp_file const Quad(".obj", "v -1 0 -1\nv 1 0 -1\nv 1 0 1\nv -1 0 1\nf 1 3 2 4\n");
+  std::string const Content = "- add: camera\n"
+                              "  width: 10\n"
+                              "  height: 10\n"
+                              "  field-of-view: 0.5\n"
+                              "- add: obj\n"
+                              "  file: " + Quad.Path + "\n"
+                              "- add: obj\n"
+                              "  file: " + Quad.Path + "\n"
+                              "  transform:\n"
+                              "    - [shear, 1, 0, 0, 0, 0, 0]\n";
+  ww::world World{};
+  ww::camera Camera{};
+  std::string Error{};
+  ASSERT_EQ(ReadScene(temp_file(".yml"), Content, World, Camera, Error), true) << Error;
+  ASSERT_EQ(World.vPtrObjects.size(), 2);
+  auto const *pA = dynamic_cast<ww::mesh const *>(World.vPtrObjects[0].get());
+  auto const *pB = dynamic_cast<ww::mesh const *>(World.vPtrObjects[1].get());
+  ASSERT_NE(pA, nullptr);
+  ASSERT_NE(pB, nullptr);
+  EXPECT_EQ(pA->pData, pB->pData);
+  EXPECT_EQ(pA->pData->vTriangles.size(), 2);
+  EXPECT_EQ(ww::Equal(pB->Transform, ww::Shearing(1.f, 0.f, 0.f, 0.f, 0.f, 0.f)), true);
+  EXPECT_EQ(World.vPtrLights.size(), 0);
+}
+
+//------------------------------------------------------------------------------
+TEST(Scene, RejectsMalformed)
+{
+  ww::world World{};
+  ww::camera Camera{};
+  std::string Error{};
+  temp_file const File(".yml");
+  std::string const Cam = "- add: camera\n  width: 10\n  height: 10\n  field-of-view: 0.5\n";
+  EXPECT_EQ(ReadScene(File, Cam + "- add: sphere\n", World, Camera, Error), true);
+  EXPECT_EQ(World.vPtrObjects.size(), 1);
+
+  EXPECT_EQ(ReadScene(File, "- add: sphere\n", World, Camera, Error), false);
+  EXPECT_EQ(Error, "The scene has no camera.");
+  EXPECT_EQ(World.vPtrObjects.size(), 0);
+  EXPECT_EQ(ReadScene(File, "- add: camera\n  width: 10\n- add: light\n", World, Camera, Error), false);
+  EXPECT_EQ(Error, "Line 1: A camera needs a width, a height and a field-of-view.");
+  EXPECT_EQ(ReadScene(File, Cam + "- add: cone\n", World, Camera, Error), false);
+  EXPECT_EQ(Error, "Line 5: Can not add 'cone'.");
+  EXPECT_EQ(ReadScene(File, Cam + "  depth: 3\n", World, Camera, Error), false);
+  EXPECT_EQ(Error, "Line 5: Unknown camera key 'depth'.");
+  EXPECT_EQ(ReadScene(File, Cam + "- add: light\n  at: [1, 2]\n", World, Camera, Error), false);
+  EXPECT_EQ(Error, "Line 6: Bad value for 'at'.");
+  EXPECT_EQ(ReadScene(File, Cam + "- add: sphere\n  material: glass\n", World, Camera, Error), false);
+  EXPECT_EQ(Error, "Line 6: Unknown material 'glass'.");
+  EXPECT_EQ(ReadScene(File, Cam + "- add: sphere\n  material:\n    gloss: 1\n", World, Camera, Error), false);
+  EXPECT_EQ(Error, "Line 7: Unknown material key 'gloss'.");
+  EXPECT_EQ(ReadScene(File, Cam + "- add: sphere\n  transform:\n    - [spin, 1]\n", World, Camera, Error), false);
+  EXPECT_EQ(Error, "Line 7: Expected translate, scale, rotate-x, rotate-y, rotate-z or shear with its numbers.");
+  EXPECT_EQ(ReadScene(File, Cam + "- add: sphere\n  transform:\n    - [scale, 1, x, 1]\n", World, Camera, Error),
+            false);
+  EXPECT_EQ(Error, "Line 7: Bad number in the transform.");
+  EXPECT_EQ(ReadScene(File, Cam + "- add: sphere\n\ttransform:\n", World, Camera, Error), false);
+  EXPECT_EQ(Error, "Line 6: Indent with spaces, not tabs.");
+  EXPECT_EQ(ReadScene(File, "add: camera\n", World, Camera, Error), false);
+  EXPECT_EQ(Error, "Line 1: Expected '- add:' or '- define:'.");
+  EXPECT_EQ(ReadScene(File, Cam + "- define: nothing\n", World, Camera, Error), false);
+  EXPECT_EQ(Error, "Line 5: A define needs a value.");
+  EXPECT_EQ(ReadScene(File, Cam + "- add: obj\n  file: no/such/file.obj\n", World, Camera, Error), false);
+  EXPECT_EQ(Error.find("Line 5: no/such/file.obj: "), 0);
+
+  ww::scene_stats Stats{};
+  EXPECT_EQ(ww::ReadScene("no/such/file.yml", World, Camera, Error, Stats), false);
+  EXPECT_EQ(Error.empty(), false);
+}
+
+//------------------------------------------------------------------------------
+// \fn ExpectSameWorld - The objects, lights and BVH of B are copies of those of A.
+void ExpectSameWorld(ww::world const &A, ww::world const &B)
+{
+  ASSERT_EQ(A.vPtrObjects.size(), B.vPtrObjects.size());
+  for (size_t Idx = 0;              //<!
+       Idx < A.vPtrObjects.size();  //<!
+       ++Idx)
+  {
+    ww::object const &OA = *A.vPtrObjects[Idx];
+    ww::object const &OB = *B.vPtrObjects[Idx];
+    EXPECT_EQ(OA.Kind, OB.Kind);
+    EXPECT_EQ(ww::Equal(OA.Material, OB.Material), true);
+    EXPECT_EQ(OA.Transform.Matrix() == OB.Transform.Matrix(), true);
+    EXPECT_EQ(OA.Transform.Inv() == OB.Transform.Inv(), true);
+    EXPECT_EQ(OA.Transform.InvTransposed() == OB.Transform.InvTransposed(), true);
+  }
+  ASSERT_EQ(A.vPtrLights.size(), B.vPtrLights.size());
+  for (size_t Idx = 0;             //<!
+       Idx < A.vPtrLights.size();  //<!
+       ++Idx)
+  {
+    EXPECT_EQ(ww::Equal(*A.vPtrLights[Idx], *B.vPtrLights[Idx]), true);
+  }
+  EXPECT_EQ(A.BVH.vNodes.size(), B.BVH.vNodes.size());
+  EXPECT_EQ(A.BVH.vIndices, B.BVH.vIndices);
+  EXPECT_EQ(A.Spheres.Count, B.Spheres.Count);
+  EXPECT_EQ(A.Spheres.vObject, B.Spheres.vObject);
+  EXPECT_EQ(ww::IsBVHValid(B), ww::IsBVHValid(A));
+}
+
+//------------------------------------------------------------------------------
+TEST(SceneCache, SpheresAreReadBackWithTheirBVH)
+{
+  ww::world World = RandomSpheresWorld(200, 7);
+  ww::BuildBVH(World);
+  ww::BuildSphereSoA(World);
+  ww::camera Camera = ww::Camera(41, 23, M_PI / 2.f);
+  Camera.Transform = ww::ViewTransform(ww::Point(0.f, 0.f, -20.f), ww::Point(0.f, 0.f, 0.f), ww::Vector(0.f, 1.f, 0.f));
+
+  std::string Error{};
+  temp_file const File(".wwscene");
+  ASSERT_EQ(ww::WriteSceneCache(File.Path, World, Camera, Error), true) << Error;
+  ww::world Read{};
+  ww::camera ReadCamera{};
+  ww::scene_stats Stats{};
+  ASSERT_EQ(ww::ReadSceneCache(File.Path, Read, ReadCamera, Error, Stats), true) << Error;
+  EXPECT_EQ(Stats.Objects, 200);
+  EXPECT_EQ(Stats.Lights, World.vPtrLights.size());
+
+  ExpectSameWorld(World, Read);
+  EXPECT_EQ(Read.Spheres.BVHOrder, true);
+  EXPECT_EQ(Read.Spheres.Stride, World.Spheres.Stride);
+  EXPECT_EQ(ReadCamera.HSize, Camera.HSize);
+  EXPECT_EQ(ReadCamera.Transform.Inv() == Camera.Transform.Inv(), true);
+
+  ww::canvas const Expected = ww::Render(Camera, World);
+  ww::canvas const Image = ww::Render(ReadCamera, Read);
+  ASSERT_EQ(Image.vXY.size(), Expected.vXY.size());
+  for (size_t Idx = 0;             //<!
+       Idx < Expected.vXY.size();  //<!
+       ++Idx)
+  {
+    EXPECT_EQ(Image.vXY[Idx] == Expected.vXY[Idx], true);
+  }
+}
+
+//------------------------------------------------------------------------------
+TEST(SceneCache, MeshesShareTheirData)
+{
+  ww::world World = ww::World();
+  ww::shared_ptr_mesh_data const pGrid = GridMeshData(8);
+  for (float const X : {-3.f, 3.f})
+  {
+    ww::shared_ptr_object PtrMesh = ww::PtrMesh(pGrid);
+    PtrMesh->Transform = ww::Translation(X, 0.f, 0.f);
+    World.vPtrObjects.push_back(PtrMesh);
+  }
+  ww::BuildBVH(World);
+  ww::camera Camera = ww::Camera(21, 11, M_PI / 2.f);
+  Camera.Transform = ww::ViewTransform(ww::Point(0.f, 2.f, -8.f), ww::Point(0.f, 0.f, 0.f), ww::Vector(0.f, 1.f, 0.f));
+
+  std::string Error{};
+  temp_file const File(".wwscene");
+  ASSERT_EQ(ww::WriteSceneCache(File.Path, World, Camera, Error), true) << Error;
+  ww::world Read{};
+  ww::camera ReadCamera{};
+  ww::scene_stats Stats{};
+  ASSERT_EQ(ww::ReadSceneCache(File.Path, Read, ReadCamera, Error, Stats), true) << Error;
+  ExpectSameWorld(World, Read);
+
+  auto const *pA = dynamic_cast<ww::mesh const *>(Read.vPtrObjects[2].get());
+  auto const *pB = dynamic_cast<ww::mesh const *>(Read.vPtrObjects[3].get());
+  ASSERT_NE(pA, nullptr);
+  ASSERT_NE(pB, nullptr);
+  EXPECT_EQ(pA->pData, pB->pData);
+  EXPECT_EQ(pA->pData->vIndices, pGrid->vIndices);
+  EXPECT_EQ(pA->pData->BVH.vIndices, pGrid->BVH.vIndices);
+  EXPECT_EQ(pA->pData->vTriangles.size(), pGrid->vTriangles.size());
+
+  ww::canvas const Expected = ww::Render(Camera, World);
+  ww::canvas const Image = ww::Render(ReadCamera, Read);
+  for (size_t Idx = 0;             //<!
+       Idx < Expected.vXY.size();  //<!
+       ++Idx)
+  {
+    EXPECT_EQ(Image.vXY[Idx] == Expected.vXY[Idx], true);
+  }
+}
+
+//------------------------------------------------------------------------------
+TEST(SceneCache, RejectsOtherFiles)
+{
+  ww::world World = RandomSpheresWorld(10, 3);
+  ww::BuildBVH(World);
+  ww::camera const Camera = ww::Camera(10, 10, M_PI / 2.f);
+  std::string Error{};
+  temp_file const File(".wwscene");
+  ASSERT_EQ(ww::WriteSceneCache(File.Path, World, Camera, Error), true) << Error;
+
+  std::string const Content = File.Read();
+  auto ReadBack = [&](std::string const &Bytes) {
+    File.Write(Bytes);
+    ww::world Read = ww::World();
+    ww::camera ReadCamera{};
+    ww::scene_stats Stats{};
+    bool const Result = ww::ReadSceneCache(File.Path, Read, ReadCamera, Error, Stats);
+    if (!Result) EXPECT_EQ(Read.vPtrObjects.size(), 0);
+    return (Result);
+  };
+  EXPECT_EQ(ReadBack(Content), true);
+
+  std::string Bytes = Content;
+  Bytes[0] = 'X';
+  EXPECT_EQ(ReadBack(Bytes), false);
+  EXPECT_EQ(Error, "Not a scene cache.");
+
+  Bytes = Content;
+  Bytes[8] += 1;
+  EXPECT_EQ(ReadBack(Bytes), false);
+  EXPECT_EQ(Error, "Scene cache version 2, expected 1.");
+
+  EXPECT_EQ(ReadBack(Content.substr(0, Content.size() - 100)), false);
+  EXPECT_EQ(Error, "The scene cache is truncated.");
+  EXPECT_EQ(ReadBack(Content.substr(0, 20)), false);
+
+  // NOTE: A child that points back to its parent, or to an ancestor, would make the traversal loop.
+  auto WithNode = [&](int const Node, int const Left, int const Right) {
+    ww::bvh_node const &Original = World.BVH.vNodes[Node];
+    size_t const At = Content.find(std::string(reinterpret_cast<char const *>(&Original), sizeof(ww::bvh_node)));
+    EXPECT_NE(At, std::string::npos);
+    ww::bvh_node Corrupt = Original;
+    Corrupt.Left = Left;
+    Corrupt.Right = Right;
+    std::string Result = Content;
+    std::memcpy(&Result[At], &Corrupt, sizeof(ww::bvh_node));
+    return (Result);
+  };
+  ww::bvh_node const &Root = World.BVH.vNodes[0];
+  ASSERT_EQ(Root.Count, 0);
+  EXPECT_EQ(ReadBack(WithNode(0, 0, Root.Right)), false);
+  EXPECT_EQ(Error, "The BVH in the scene cache is corrupt.");
+  int const Inner = World.BVH.vNodes[Root.Left].Count == 0 ? Root.Left : Root.Right;
+  ASSERT_EQ(World.BVH.vNodes[Inner].Count, 0);
+  EXPECT_EQ(ReadBack(WithNode(Inner, World.BVH.vNodes[Inner].Left, 0)), false);
+  EXPECT_EQ(ReadBack(WithNode(0, Root.Left, static_cast<int>(World.BVH.vNodes.size()))), false);
+
+  ww::camera ReadCamera{};
+  ww::scene_stats Stats{};
+  EXPECT_EQ(ww::ReadSceneCache("no/such/file.wwscene", World, ReadCamera, Error, Stats), false);
+  EXPECT_EQ(ww::WriteSceneCache("no/such/file.wwscene", World, Camera, Error), false);
+}
+
+//------------------------------------------------------------------------------
+TEST(BVH, BoundsOfATransformedSphere)
+{
+  ww::sphere S{};
+  S.Transform = ww::Translation(1.f, 2.f, 3.f) * ww::Scaling(2.f, 0.5f, 1.f);
+  ww::bounds const B = ww::Bounds(S);
+  EXPECT_EQ(B.Min == ww::Point(-1.f, 1.5f, 2.f), true);
+  EXPECT_EQ(B.Max == ww::Point(3.f, 2.5f, 4.f), true);
+  EXPECT_EQ(ww::Equal(ww::SurfaceArea(B), 2.f * (4.f * 1.f + 1.f * 2.f + 2.f * 4.f)), true);
+}
+
+//------------------------------------------------------------------------------
+TEST(BVH, BuildCoversAllObjects)
+{
+  ww::world World = RandomSpheresWorld(100, 1);
+  EXPECT_EQ(ww::IsBVHValid(World), false);
+
+  ww::BuildBVH(World);
+  EXPECT_EQ(ww::IsBVHValid(World), true);
+  EXPECT_EQ(World.BVH.vIndices.size(), 100);
+
+  // NOTE: Every object is referenced exactly once by a leaf.
+  std::vector<int> vSeen(World.vPtrObjects.size());
+  for (auto const &Node : World.BVH.vNodes)
+  {
+    for (int Idx = Node.First;           //<!
+         Idx < Node.First + Node.Count;  //<!
+         ++Idx)
+    {
+      vSeen[World.BVH.vIndices[Idx]]++;
+    }
+  }
+  for (auto const Seen : vSeen)
+  {
+    EXPECT_EQ(Seen, 1);
+  }
+
+  // NOTE: Adding an object makes the BVH stale, and the linear path is used again.
+  World.vPtrObjects.push_back(ww::PtrDefaultSphere());
+  EXPECT_EQ(ww::IsBVHValid(World), false);
+}
+
+//------------------------------------------------------------------------------
+TEST(BVH, IntersectionsAreEqualToLinear)
+{
+  ww::world const Linear = RandomSpheresWorld(200, 2);
+  ww::world WithBVH = Linear;
+  ww::BuildBVH(WithBVH);
+
+  for (auto const &R : RandomRays(500, 3))
+  {
+    ww::intersections const XS1 = ww::IntersectWorld(Linear, R);
+    ww::intersections const XS2 = ww::IntersectWorld(WithBVH, R);
+    EXPECT_EQ(XS1.Count(), XS2.Count());
+    for (int Idx = 0;        //<!
+         Idx < XS1.Count();  //<!
+         ++Idx)
+    {
+      EXPECT_EQ(XS1.vI[Idx].t, XS2.vI[Idx].t);
+    }
+
+    ww::intersection const H1 = ww::Hit(XS1);
+    ww::intersection const H2 = ww::HitWorld(WithBVH, R);
+    ww::intersection const H3 = ww::HitWorld(Linear, R);
+    EXPECT_EQ(H1.pObject == H2.pObject, true);
+    EXPECT_EQ(H1.pObject == H3.pObject, true);
+    EXPECT_EQ(H1.t, H2.t);
+  }
+}
+
+//------------------------------------------------------------------------------
+TEST(Arena, IntersectionListsReuseTheirBuffers)
+{
+  ww::world World = RandomSpheresWorld(200, 5);
+  ww::BuildBVH(World);
+  std::vector<ww::ray> const vRays = RandomRays(500, 6);
+
+  // NOTE: One pass to fill the free lists. The second pass finds every buffer there.
+  auto Pass = [&]() {
+    int Count{};
+    for (auto const &R : vRays)
+    {
+      ww::intersections const XS = ww::IntersectWorld(World, R);
+      Count += XS.Count();
+    }
+    return (Count);
+  };
+  int const Count = Pass();
+  long long const Mallocs = ww::ThreadArena().Mallocs;
+  long long const Reuses = ww::ThreadArena().Reuses;
+  EXPECT_EQ(Pass(), Count);
+  EXPECT_EQ(ww::ThreadArena().Mallocs, Mallocs);
+  EXPECT_GT(ww::ThreadArena().Reuses, Reuses);
+
+  ww::intersections XS = ww::Intersections(ww::Intersection(1.f, World.vPtrObjects[0]),  //!<
+                                           ww::Intersection(2.f, World.vPtrObjects[1]));
+  EXPECT_EQ(ww::ThreadArena().Mallocs, Mallocs);
+
+  // NOTE: A list freed on another thread goes to the arena of that thread, which frees it
+  //       when the thread exits, also when the thread never allocated a buffer itself.
+  //       Configure with -DWW_SANITIZE=ON to have LeakSanitizer check that.
+  std::thread Other([List = std::move(XS)]() mutable {
+    List.vI.clear();
+    List.vI.shrink_to_fit();
+    EXPECT_EQ(ww::ThreadArena().Mallocs, 0);
+    int Free{};
+    for (int const Count : ww::ThreadArena().vCount) Free += Count;
+    EXPECT_EQ(Free, 1);
+  });
+  Other.join();
+
+  // NOTE: A class keeps at most MAX_FREE buffers, the rest go back to the heap.
+  std::thread Freeing([]() {
+    size_t const Bytes = ww::intersection_arena::SMALLEST_BYTES;
+    std::vector<void *> vBuffers{};
+    for (int Idx = 0; Idx < 2 * ww::intersection_arena::MAX_FREE; ++Idx)
+    {
+      vBuffers.push_back(::operator new(Bytes));
+    }
+    for (void *pBuffer : vBuffers) ww::ArenaFree(pBuffer, Bytes);
+    EXPECT_EQ(ww::ThreadArena().vCount[0], ww::intersection_arena::MAX_FREE);
+  });
+  Freeing.join();
+}
+
+//------------------------------------------------------------------------------
+// NOTE: Parse the switches of "raytrace --render" followed by vArgs.
+bool ParseRender(std::vector<std::string> vArgs, rtrender::render_options &Options, std::string &Error)
+{
+  vArgs.insert(vArgs.begin(), {"raytrace", "--render"});
+  std::vector<char *> vArgv{};
+  for (std::string &Arg : vArgs) vArgv.push_back(&Arg[0]);
+  Options = rtrender::render_options{};
+  Error.clear();
+  return (rtrender::ParseRenderOptions(static_cast<int>(vArgv.size()), vArgv.data(), Options, Error));
+}
+
+//------------------------------------------------------------------------------
+TEST(Render, ParseOptions)
+{
+  rtrender::render_options Options{};
+  std::string Error{};
+  ASSERT_EQ(ParseRender({"scenes/ch7.yml", "--width", "64", "--height", "32", "--threads", "0", "--samples", "9",
+                         "--tile", "8", "--output", "-", "--format", "p6"},
+                        Options, Error),
+            true)
+      << Error;
+  EXPECT_EQ(Options.Scene, "scenes/ch7.yml");
+  EXPECT_EQ(Options.Width, 64);
+  EXPECT_EQ(Options.Height, 32);
+  EXPECT_EQ(Options.Threads, 0);
+  EXPECT_EQ(Options.Samples, 9);
+  EXPECT_EQ(Options.TileSize, 8);
+  EXPECT_EQ(Options.Output, "-");
+  EXPECT_EQ(Options.Format, "p6");
+
+  // NOTE: The defaults.
+  ASSERT_EQ(ParseRender({"a.yml"}, Options, Error), true) << Error;
+  EXPECT_EQ(Options.Samples, 1);
+  EXPECT_EQ(Options.Output, "render.ppm");
+  EXPECT_EQ(Options.Format, "p6");
+}
+
+//------------------------------------------------------------------------------
+TEST(Render, RejectBadOptions)
+{
+  rtrender::render_options Options{};
+  std::string Error{};
+  EXPECT_EQ(ParseRender({"a.yml", "--samples", "8"}, Options, Error), false);
+  EXPECT_EQ(Error, "Bad value '8' for --samples.");
+  EXPECT_EQ(ParseRender({"a.yml", "--format", "p3", "--output", "-"}, Options, Error), false);
+  EXPECT_EQ(Error, "Only p6 can be written to stdout.");
+  EXPECT_EQ(ParseRender({"a.yml", "--format", "png"}, Options, Error), false);
+  EXPECT_EQ(Error, "Bad value 'png' for --format.");
+  EXPECT_EQ(ParseRender({"--width", "10"}, Options, Error), false);
+  EXPECT_EQ(Error, "No scene file.");
+  EXPECT_EQ(ParseRender({"a.yml", "--width"}, Options, Error), false);
+  EXPECT_EQ(Error, "Missing value for --width.");
+  EXPECT_EQ(ParseRender({"a.yml", "--depth", "3"}, Options, Error), false);
+  EXPECT_EQ(Error, "Unknown switch '--depth'.");
+  EXPECT_EQ(ParseRender({"a.yml", "b.yml"}, Options, Error), false);
+  EXPECT_EQ(Error, "Unknown switch 'b.yml'.");
+
+  // NOTE: Whole numbers only, in range.
+  EXPECT_EQ(ParseRender({"a.yml", "--width", "0"}, Options, Error), false);
+  EXPECT_EQ(ParseRender({"a.yml", "--width", "12x"}, Options, Error), false);
+  EXPECT_EQ(ParseRender({"a.yml", "--threads", "-3"}, Options, Error), false);
+  EXPECT_EQ(ParseRender({"a.yml", "--tile", std::to_string(rtrender::MAX_INT_VALUE + 1)}, Options, Error), false);
+  EXPECT_EQ(ParseRender({"a.yml", "--tile", std::to_string(rtrender::MAX_INT_VALUE)}, Options, Error), true);
+}
+
 //------------------------------------------------------------------------------
 void RunMatrixTest(int argc, char *argv[])
 {